@@ -1,5 +1,16 @@
 # wd support in BASH
 
+# Use the wd loadable builtin if it's available, either from WD_BUILTIN or
+#  alongside this script.  This saves spawning a process for each completion
+#  and look-up
+WD_HAVE_BUILTIN=""
+if [ -z "${WD_BUILTIN}" ]; then
+    WD_BUILTIN="$(dirname "${BASH_SOURCE[0]}")/wd.so"
+fi
+if [ -f "${WD_BUILTIN}" ] && enable -f "${WD_BUILTIN}" wd 2>/dev/null; then
+    WD_HAVE_BUILTIN=1
+fi
+
 function wd_run()
 {
     local fmt=w
@@ -13,7 +24,13 @@ function wd_run()
     fi
 
     # Try and resolve the bookmark
-    local dir=$(wd -g "$2" -s ${fmt})
+    local dir=""
+    if [ -n "${WD_HAVE_BUILTIN}" ]; then
+        wd --reply -g "$2" -s ${fmt} && dir="${WD_REPLY}"
+    else
+        # -0 : NUL terminated, so that the path is passed through as-is
+        IFS= read -r -d '' dir < <(wd -0 -g "$2" -s ${fmt})
+    fi
 
     # Any useful result?
     if [ -d "${dir}" ]; then
@@ -64,23 +81,52 @@ function _wd_complete()
         fi
     fi
 
-    # -l b : Output bookmark names
-    # -e d : Only list directories, not files
-    # -C   : Double-escape paths
-    if [ "${OSTYPE}" = "cygwin" ]; 
+    # The builtin fills COMPREPLY itself, so only needs single escaping
+    if [ -n "${WD_HAVE_BUILTIN}" ] && [ "x${WD_PICK_CMD}" = "x" ];
+    then
+        if [ "${OSTYPE}" = "cygwin" ]; then
+            wd --complete "${word}" -l b${extra} -e d -c -s c
+        else
+            wd --complete "${word}" -l b${extra} -e d -c
+        fi
+        unset IFS
+        return
+    fi
+
+    local form=""
+    if [ "${OSTYPE}" = "cygwin" ];
     then
         # -s c : Cygwin formatted paths
-        local list=$(wd -l b${extra} -e d ${ESCAPE} -s c)
-    else
-        local list=$(wd -l b${extra} -e d ${ESCAPE})
+        form="-s c"
     fi
 
     # Are we using pick?
     if [ "x${WD_PICK_CMD}" != "x" ];
     then
+        # -l b : Output bookmark names
+        # -e d : Only list directories, not files
+        # -c   : Escape paths
+        local list=$(wd -l b${extra} -e d ${ESCAPE} ${form})
         COMPREPLY=($(echo "${list}" | pick -q "${word}"))
     else
-        COMPREPLY=($(compgen -W "${list}" -- "${word}"))
+        # -0 : NUL terminated & unescaped, so names are read as-is and only
+        #       the matches need quoting
+        local entries=()
+        local entry=""
+        local quoted=""
+        mapfile -d '' entries < <(wd -l b${extra} -e d -0 ${form})
+        COMPREPLY=()
+        for entry in "${entries[@]}"; do
+            if [[ "${entry}" == "${word}"* ]]; then
+                if [ -n "${extra}" ]; then
+                    # Leave the separator following the index unquoted
+                    printf -v quoted '%s %q' "${entry%% *}" "${entry#* }"
+                else
+                    printf -v quoted '%q' "${entry}"
+                fi
+                COMPREPLY+=("${quoted}")
+            fi
+        done
     fi
     unset IFS
 }
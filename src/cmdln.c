@@ -17,6 +17,7 @@
 #include "wd.h"
 #include "cmdln.h"
 #include "os_if.h"
+#include "timings.h"
 
 #include <stdio.h>
 #include <time.h>
@@ -30,6 +31,9 @@
 #define NEED_PARAMETER_STRING "No parameter specified for argument"
 #define INCOMPATIBLE_OP_STRING "Parameter incompatible with other arguments"
 #define UNRECOGNISED_PARAM_STRING "Parameter to argument not recognised"
+#define TOO_MANY_STRING "Argument specified too many times"
+#define NO_MEMORY_STRING "Not enough memory to process argument"
+#define INVALID_PATTERN_STRING "Pattern not valid for argument"
 #define STRINGIFY(_x) XSTRINGIFY(_x)
 #define XSTRINGIFY(_x) #_x
 #define TARGET_STRING STRINGIFY(TARGET)
@@ -38,6 +42,8 @@
 #define DEFAULT_LIST_FILE "/.wd_list"
 /** Name of environment variable to read options from */
 #define ENV_VAR_NAME      "WD_OPTS"
+/** Default for config_container_t::wd_render_ttl */
+#define DEFAULT_RENDER_TTL 5
 
 static int populate_default_list_fn( config_container_t* const p_config );
 static void show_help( const char* const p_cmd );
@@ -84,11 +90,30 @@ int init_cmdln( config_container_t* const p_config ) {
     p_config->wd_bookmark_name = NULL;
     p_config->wd_dir_form = WD_DIRFORM_NONE;
     p_config->wd_dir_list_opt = WD_DIRLIST_PATHS;
+    p_config->wd_sort_order = WD_SORT_NONE;
+    p_config->wd_import_format = WD_IMPORT_PLAIN;
+    p_config->wd_import_fn = NULL;
+    p_config->wd_sync_fn = NULL;
+    p_config->wd_scan_root_count = 0;
+    p_config->wd_scan_marker_count = 0;
+    p_config->wd_scan_prune_count = 0;
     p_config->wd_now_time = time(NULL);
     p_config->wd_entity_type = WD_ENTITY_ANY;
+    p_config->wd_tags = NULL;
+    p_config->wd_search = NULL;
     p_config->list_fn = NULL;
+    p_config->wd_layer_count = 0;
     p_config->wd_output_all = 1;
     p_config->wd_escape_output = 0;
+    p_config->wd_record_form = WD_RECORD_LINE;
+    p_config->wd_use_daemon = 0;
+    p_config->wd_shm_cache = 0;
+    p_config->wd_write_behind = 0;
+    p_config->wd_snapshot = 0;
+    p_config->wd_snapshot_ttl = 0;
+    p_config->wd_render_cache = 0;
+    p_config->wd_render_ttl = DEFAULT_RENDER_TTL;
+    p_config->wd_record_stats = 0;
 
     /* TODO: Consider only doing this if the file has not been specified on the
        command line for efficiency reasons */
@@ -117,6 +142,12 @@ static void show_help( const char* const p_cmd ) {
             "             t=d : Directories only\n"
             "             t=F : Files and unknowns\n"
             "             t=D : Directories and unknowns\n"
+            " --tag <t> : List only bookmarks with all of the comma-separated\n"
+            "             tags <t>, or with -a give them to the bookmark added\n"
+            " --search <g> : List only bookmarks whose path or name matches\n"
+            "             the glob <g> (*, ?, [...]).  Use -l to set the format\n"
+            " --search-re <r> : As --search, but with an extended regular\n"
+            "             expression matching any part of the path or name\n"
             " -s <c>   : Format paths for cygwin\n"
             " -g <id>  : Get bookmark path.  ID can be index, name or path\n"
             " -n <nam> : Get bookmark path with specified shortcut name\n"
@@ -125,11 +156,56 @@ static void show_help( const char* const p_cmd ) {
             " -f <fn>  : Use file <fn> for storing bookmarks\n"
             " -r [dir] : Remove specified path or current directory if none\n"
             " -a [dir] : Add specified path or current directory if none\n"
-            "             specified\n",
+            "             specified\n"
+            " --daemon : Run in the background, holding bookmark lists in memory\n"
+            "             to serve other invocations\n"
+            " --use-daemon : Pass operations to a running daemon, if there is\n"
+            "             one\n"
+            " --shm-cache : Share parsed bookmark lists with other invocations\n"
+            "             via shared memory\n"
+            " --write-behind : Exit once the result is output, saving changes\n"
+            "             to the list in the background\n"
+            " --layer <fn> : Search read-only list <fn> (may be repeated) for\n"
+            "             bookmarks not in the list, after any earlier layers\n"
+            " --snapshot : Read lists from local copies, which are checked\n"
+            "             against the list's size, time & inode before use\n"
+            " --snapshot-ttl <s> : Seconds for which a local copy is used\n"
+            "             without being checked (default 0)\n"
+            " --render-cache : Cache listings in rendered form\n"
+            " --render-ttl <s> : Seconds for which cached listings filtered by\n"
+            "             entity type or existence remain valid\n"
+            " -0       : Terminate listed items & retrieved paths with NUL\n"
+            "             rather than newline, without escaping\n"
+            " --length-prefixed : Precede listed items & retrieved paths with\n"
+            "             their length as 4 bytes (big-endian), without\n"
+            "             escaping\n"
+            " -o <k>   : Order dump & list output by k=name, path, added or\n"
+            "             accessed.  Indices still refer to the stored order\n"
+            " --import <f> <fn> : Add bookmarks for the paths in file <fn> (- for\n"
+            "             stdin), carrying over use counts & times where known\n"
+            "             f=plain    : One path per line\n"
+            "             f=z        : z datafile (~/.z)\n"
+            "             f=autojump : autojump database (autojump.txt)\n"
+            "             f=cdargs   : CDargs list (~/.cdargs)\n"
+            " --batch  : Perform commands read from stdin, one per line (or NUL\n"
+            "             terminated with -0), saving the list once at the end\n"
+            "             add [dir [<TAB>name]], remove <dir|name>, get <id>,\n"
+            "             list, rename <id><TAB><name>, tag <id>[<TAB>tags]\n"
+            " --sync <fn> : Merge the list with another copy of it, <fn>, saving\n"
+            "             the result to both.  The most recent change to each\n"
+            "             bookmark wins, including removals\n"
+            " --scan <dir> : Crawl <dir> (may be repeated) for directories\n"
+            "             containing a marker, adding bookmarks for them\n"
+            " --match <m> : Marker entry name (may be repeated, default .git)\n"
+            " --prune <n> : Don't descend into directories named <n>, as well\n"
+            "             as .git, .hg, .svn & node_modules\n"
+            " --timings : Report the time taken by each phase & counts of work\n"
+            "             done to stderr\n"
+            " --record-stats : Add the time taken by the invocation to the\n"
+            "             stats file, ~/.cache/wd/stats\n"
+            " --stats  : Summarise the times in the stats file by operation\n",
             p_cmd );
     /* TODO: Complete the description */
-    /* TODO: Add option to sort dump alphabetically by directory, by name,
-             by date added */
 }
 
 #define ARG_HAS_PARAMETER( arg_loop, argc, argv ) ((( arg_loop + 1 ) < argc ) && ( argv[ arg_loop + 1 ][0] != '-' ))
@@ -149,12 +225,154 @@ static int process_opts( config_container_t* const p_config, const int argc, cha
             show_help( argv[0] );
         } else if( p_cmd_line && ( 0 == strcmp( this_arg, "-p" )) ) {
             p_config->wd_prompt = 1;
+        } else if( p_cmd_line && ( 0 == strcmp( this_arg, "--daemon" )) ) {
+            p_config->wd_oper = WD_OPER_DAEMON;
+        } else if( p_cmd_line && ( 0 == strcmp( this_arg, "--import" )) ) {
+            if( p_config->wd_oper != WD_OPER_NONE ) {
+                fprintf( stderr, "%s: %s\n", INCOMPATIBLE_OP_STRING, this_arg );
+                ret_val = 0;
+            } else if(( arg_loop + 2 ) < argc ) {
+                const char* const fmt = argv[ ++arg_loop ];
+
+                p_config->wd_oper = WD_OPER_IMPORT;
+                /* May be "-", so not checked using ARG_HAS_PARAMETER */
+                p_config->wd_import_fn = argv[ ++arg_loop ];
+
+                if( 0 == strcmp( fmt, "plain" )) {
+                    p_config->wd_import_format = WD_IMPORT_PLAIN;
+                } else if( 0 == strcmp( fmt, "z" )) {
+                    p_config->wd_import_format = WD_IMPORT_Z;
+                } else if( 0 == strcmp( fmt, "autojump" )) {
+                    p_config->wd_import_format = WD_IMPORT_AUTOJUMP;
+                } else if( 0 == strcmp( fmt, "cdargs" )) {
+                    p_config->wd_import_format = WD_IMPORT_CDARGS;
+                } else {
+                    fprintf( stderr, "%s: %s '%s'\n", UNRECOGNISED_PARAM_STRING, this_arg, fmt );
+                    ret_val = 0;
+                }
+            } else {
+                fprintf( stderr, "%s: %s\n", NEED_PARAMETER_STRING, this_arg );
+                ret_val = 0;
+            }
+        } else if( p_cmd_line && ( 0 == strcmp( this_arg, "--batch" )) ) {
+            if( p_config->wd_oper != WD_OPER_NONE ) {
+                fprintf( stderr, "%s: %s\n", INCOMPATIBLE_OP_STRING, this_arg );
+                ret_val = 0;
+            } else {
+                p_config->wd_oper = WD_OPER_BATCH;
+            }
+        } else if( p_cmd_line && (( 0 == strcmp( this_arg, "--scan" )) ||
+                                  ( 0 == strcmp( this_arg, "--match" )) ||
+                                  ( 0 == strcmp( this_arg, "--prune" ))) ) {
+            const char** args = p_config->wd_scan_roots;
+            size_t* count = &( p_config->wd_scan_root_count );
+
+            if( this_arg[2] == 'm' ) {
+                args = p_config->wd_scan_markers;
+                count = &( p_config->wd_scan_marker_count );
+            } else if( this_arg[2] == 'p' ) {
+                args = p_config->wd_scan_prune;
+                count = &( p_config->wd_scan_prune_count );
+            }
+
+            if(( p_config->wd_oper != WD_OPER_NONE ) &&
+               ( p_config->wd_oper != WD_OPER_SCAN )) {
+                fprintf( stderr, "%s: %s\n", INCOMPATIBLE_OP_STRING, this_arg );
+                ret_val = 0;
+            } else if( !ARG_HAS_PARAMETER( arg_loop, argc, argv )) {
+                fprintf( stderr, "%s: %s\n", NEED_PARAMETER_STRING, this_arg );
+                ret_val = 0;
+            } else if( *count == WD_MAX_SCAN_ARGS ) {
+                fprintf( stderr, "%s: %s\n", TOO_MANY_STRING, this_arg );
+                ret_val = 0;
+            } else {
+                p_config->wd_oper = WD_OPER_SCAN;
+                args[ ( *count )++ ] = argv[ ++arg_loop ];
+            }
+        } else if( 0 == strcmp( this_arg, "--use-daemon" ) ) {
+            p_config->wd_use_daemon = 1;
+        } else if( 0 == strcmp( this_arg, "--shm-cache" ) ) {
+            p_config->wd_shm_cache = 1;
+        } else if( 0 == strcmp( this_arg, "--write-behind" ) ) {
+            p_config->wd_write_behind = 1;
+        } else if( 0 == strcmp( this_arg, "--snapshot" ) ) {
+            p_config->wd_snapshot = 1;
+        } else if( 0 == strcmp( this_arg, "--snapshot-ttl" ) ) {
+            if(( arg_loop + 1 ) < argc ) {
+                arg_loop++;
+                sscanf(argv[arg_loop],"%ld",(long int*)(&p_config->wd_snapshot_ttl));
+            } else {
+                fprintf( stderr, "%s: %s\n", NEED_PARAMETER_STRING, this_arg );
+                ret_val = 0;
+            }
+        } else if( p_cmd_line && ( 0 == strcmp( this_arg, "--sync" )) ) {
+            if( p_config->wd_oper != WD_OPER_NONE ) {
+                fprintf( stderr, "%s: %s\n", INCOMPATIBLE_OP_STRING, this_arg );
+                ret_val = 0;
+            } else if(( arg_loop + 1 ) < argc ) {
+                p_config->wd_oper = WD_OPER_SYNC;
+                p_config->wd_sync_fn = argv[ ++arg_loop ];
+            } else {
+                fprintf( stderr, "%s: %s\n", NEED_PARAMETER_STRING, this_arg );
+                ret_val = 0;
+            }
+        } else if( p_cmd_line && (( 0 == strcmp( this_arg, "--search" )) ||
+                                  ( 0 == strcmp( this_arg, "--search-re" )) )) {
+            /* A filtered listing, so a later -l may give its format */
+            if(( p_config->wd_oper != WD_OPER_NONE ) &&
+               ( p_config->wd_oper != WD_OPER_LIST )) {
+                fprintf( stderr, "%s: %s\n", INCOMPATIBLE_OP_STRING, this_arg );
+                ret_val = 0;
+            } else if( p_config->wd_search != NULL ) {
+                fprintf( stderr, "%s: %s\n", TOO_MANY_STRING, this_arg );
+                ret_val = 0;
+            } else if(( arg_loop + 1 ) < argc ) {
+                arg_loop++;
+                p_config->wd_search = search_compile( argv[ arg_loop ],
+                                                      ( 0 == strcmp( this_arg, "--search-re" )));
+                if( p_config->wd_search == NULL ) {
+                    fprintf( stderr, "%s: %s '%s'\n", INVALID_PATTERN_STRING, this_arg, argv[ arg_loop ] );
+                    ret_val = 0;
+                } else {
+                    p_config->wd_oper = WD_OPER_LIST;
+                }
+            } else {
+                fprintf( stderr, "%s: %s\n", NEED_PARAMETER_STRING, this_arg );
+                ret_val = 0;
+            }
+        } else if( p_cmd_line && ( 0 == strcmp( this_arg, "--stats" )) ) {
+            if( p_config->wd_oper != WD_OPER_NONE ) {
+                fprintf( stderr, "%s: %s\n", INCOMPATIBLE_OP_STRING, this_arg );
+                ret_val = 0;
+            } else {
+                p_config->wd_oper = WD_OPER_STATS;
+            }
+        } else if( 0 == strcmp( this_arg, "--timings" ) ) {
+            timings_enable( 1 );
+        } else if( 0 == strcmp( this_arg, "--record-stats" ) ) {
+            /* Collected as per --timings, but not reported */
+            timings_enable( 0 );
+            p_config->wd_record_stats = 1;
+        } else if( 0 == strcmp( this_arg, "--render-cache" ) ) {
+            p_config->wd_render_cache = 1;
+        } else if( 0 == strcmp( this_arg, "--render-ttl" ) ) {
+            if(( arg_loop + 1 ) < argc ) {
+                arg_loop++;
+                sscanf(argv[arg_loop],"%ld",(long int*)(&p_config->wd_render_ttl));
+            } else {
+                fprintf( stderr, "%s: %s\n", NEED_PARAMETER_STRING, this_arg );
+                ret_val = 0;
+            }
         } else if( 0 == strcmp( this_arg, "-t" ) ) {
             p_config->wd_store_access = 1;
         } else if( 0 == strcmp( this_arg, "-c" ) ) {
             p_config->wd_escape_output = 1;
         } else if( 0 == strcmp( this_arg, "-C" ) ) {
             p_config->wd_escape_output = 2;
+        } else if( 0 == strcmp( this_arg, "-0" ) ) {
+            p_config->wd_record_form = WD_RECORD_NUL;
+        } else if( 0 == strcmp( this_arg, "--length-prefixed" ) ) {
+            p_config->wd_record_form = WD_RECORD_LENGTH;
         } else if( 0 == strcmp( this_arg, "-z" ) ) {
             if(( arg_loop + 1 ) < argc ) {
                 arg_loop++;
@@ -209,6 +427,23 @@ static int process_opts( config_container_t* const p_config, const int argc, cha
                 fprintf( stderr, "%s: %s\n", NEED_PARAMETER_STRING, this_arg );
                 ret_val = 0;
             }
+        } else if( 0 == strcmp( this_arg, "--tag" ) ) {
+            if(( arg_loop + 1 ) < argc ) {
+                /* Copied, as options from the environment don't persist */
+                char* const tags = (char*)realloc( p_config->wd_tags,
+                                                   strlen( argv[ ++arg_loop ] ) + 1U );
+
+                if( tags != NULL ) {
+                    strcpy( tags, argv[ arg_loop ] );
+                    p_config->wd_tags = tags;
+                } else {
+                    fprintf( stderr, "%s: %s\n", NO_MEMORY_STRING, this_arg );
+                    ret_val = 0;
+                }
+            } else {
+                fprintf( stderr, "%s: %s\n", NEED_PARAMETER_STRING, this_arg );
+                ret_val = 0;
+            }
         } else if( 0 == strcmp( this_arg, "-s" ) ) {
             if(( arg_loop + 1 ) < argc ) {
                 arg_loop++;
@@ -232,6 +467,25 @@ static int process_opts( config_container_t* const p_config, const int argc, cha
                 fprintf( stderr, "%s: %s\n", NEED_PARAMETER_STRING, this_arg );
                 ret_val = 0;
             }
+        } else if( 0 == strcmp( this_arg, "-o" ) ) {
+            if(( arg_loop + 1 ) < argc ) {
+                arg_loop++;
+                if( 0 == strcmp( argv[ arg_loop ], "name" )) {
+                    p_config->wd_sort_order = WD_SORT_NAME;
+                } else if( 0 == strcmp( argv[ arg_loop ], "path" )) {
+                    p_config->wd_sort_order = WD_SORT_PATH;
+                } else if( 0 == strcmp( argv[ arg_loop ], "added" )) {
+                    p_config->wd_sort_order = WD_SORT_ADDED;
+                } else if( 0 == strcmp( argv[ arg_loop ], "accessed" )) {
+                    p_config->wd_sort_order = WD_SORT_ACCESSED;
+                } else {
+                    fprintf( stderr, "%s: %s '%s'\n", UNRECOGNISED_PARAM_STRING, this_arg, argv[ arg_loop ] );
+                    ret_val = 0;
+                }
+            } else {
+                fprintf( stderr, "%s: %s\n", NEED_PARAMETER_STRING, this_arg );
+                ret_val = 0;
+            }
         } else if( p_cmd_line && ( 0 == strcmp( this_arg, "-d" )) ) {
             p_config->wd_oper = WD_OPER_DUMP;
         } else if( p_cmd_line && ( 0 == strcmp( this_arg, "-l" )) ) {
@@ -324,12 +578,31 @@ static int process_opts( config_container_t* const p_config, const int argc, cha
                 /* Check to see if there's an argument to this command */
                 ret_val = 0;
             }
+        } else if( 0 == strcmp( this_arg, "--layer" ) ) {
+            if(( arg_loop + 1 ) >= argc ) {
+                fprintf( stderr, "%s: %s\n", NEED_PARAMETER_STRING, this_arg );
+                ret_val = 0;
+            } else if( p_config->wd_layer_count == WD_MAX_LAYERS ) {
+                fprintf( stderr, "%s: %s\n", TOO_MANY_STRING, this_arg );
+                ret_val = 0;
+            } else {
+                /* Copied, as options from the environment don't persist */
+                char* const fn = (char*)malloc( strlen( argv[ ++arg_loop ] ) + 1U );
+
+                if( fn != NULL ) {
+                    strcpy( fn, argv[ arg_loop ] );
+                    p_config->wd_layers[ p_config->wd_layer_count++ ] = fn;
+                } else {
+                    fprintf( stderr, "%s: %s\n", NO_MEMORY_STRING, this_arg );
+                    ret_val = 0;
+                }
+            }
         } else if( 0 == strcmp( this_arg, "-f" ) ) {
             arg_loop++;
             if( arg_loop < argc ) {
                 /* To be consistent, list_fn always points to malloc'd memory
                    rather than just pointing it to the parameter string */
-                p_config->list_fn = realloc( p_config->list_fn, strlen( argv[ arg_loop ] ));
+                p_config->list_fn = realloc( p_config->list_fn, strlen( argv[ arg_loop ] ) + 1U );
                 strcpy( p_config->list_fn, argv[ arg_loop ] );
             } else {
                 fprintf( stderr, "%s: %s\n", NEED_PARAMETER_STRING, this_arg );
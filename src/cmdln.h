@@ -24,6 +24,8 @@
 #if !defined CMDLN_H
 #define      CMDLN_H
 
+#include "search.h"
+
 #include <sys/param.h>
 
 /** Indicate what type of operation the user has requested */
@@ -34,10 +36,26 @@ typedef enum {
     WD_OPER_DUMP,            /**< Dump a report on all the current bookmarks */
     WD_OPER_LIST,            /**< List of the bookmark names and destinations */
     WD_OPER_GET_BY_BM_NAME,  /**< Get a bookmark based on the name */
-    WD_OPER_GET              /**< Get a bookmark based on either name or
+    WD_OPER_GET,             /**< Get a bookmark based on either name or
                                   destination */
+    WD_OPER_DAEMON,          /**< Run as a daemon, serving other invocations */
+    WD_OPER_IMPORT,          /**< Add bookmarks from another tool's database */
+    WD_OPER_BATCH,           /**< Perform operations read from stdin */
+    WD_OPER_SCAN,            /**< Add bookmarks for directories found by
+                                  crawling the filesystem */
+    WD_OPER_STATS,           /**< Summarise the latencies recorded by
+                                  previous invocations */
+    WD_OPER_SYNC             /**< Merge the list with another copy of it */
 } wd_oper_t;
 
+/** Format of a file from which bookmarks are imported */
+typedef enum {
+    WD_IMPORT_PLAIN,       /**< One path per line */
+    WD_IMPORT_Z,           /**< z's datafile: path|rank|time */
+    WD_IMPORT_AUTOJUMP,    /**< autojump's database: weight<TAB>path */
+    WD_IMPORT_CDARGS       /**< CDargs' list: name path */
+} wd_import_fmt_t;
+
 /** Status/type of a bookmark destination */
 typedef enum {
     WD_ENTITY_ANY,         /**< When filtering, match any type of entity */
@@ -63,8 +81,32 @@ typedef enum {
     WD_DIRLIST_BOOKMARKS = 0x4 /**< Show the bookmark name */
 } wd_dir_list_opt_t;
 
+/** Specify how the records of a listing (or a retrieved path) are delimited */
+typedef enum {
+    WD_RECORD_LINE,        /**< Newline terminated, escaped as requested */
+    WD_RECORD_NUL,         /**< NUL terminated & never escaped */
+    WD_RECORD_LENGTH       /**< Preceded by a 4-byte big-endian length & never
+                                escaped */
+} wd_record_form_t;
+
+/** Specify the order in which a list or dump is output */
+typedef enum {
+    WD_SORT_NONE,          /**< The order in which bookmarks are stored */
+    WD_SORT_NAME,          /**< By bookmark name, unnamed bookmarks last */
+    WD_SORT_PATH,          /**< By path */
+    WD_SORT_ADDED,         /**< Oldest added first, unknown times last */
+    WD_SORT_ACCESSED       /**< Least recently accessed first, unknown times
+                                last */
+} wd_sort_t;
+
 #define IS_BIT_SET( _val, _bit ) (((_val)&(_bit))==(_bit))
 
+/** Maximum number of each of the --scan, --match & --prune options */
+#define WD_MAX_SCAN_ARGS 16U
+
+/** Maximum number of --layer options */
+#define WD_MAX_LAYERS 8U
+
 /** Structure to wrap up all of the options/parameters read by this module.
     Should be initialised using init_cmdln() before use */
 typedef struct {
@@ -75,8 +117,29 @@ typedef struct {
     wd_dir_format_t wd_dir_form;
     /** Options to control the format when displaying a list */
     wd_dir_list_opt_t wd_dir_list_opt;
+    /** Order in which to output a list or dump */
+    wd_sort_t       wd_sort_order;
+    /** Format of the file to import from */
+    wd_import_fmt_t wd_import_format;
+    /** File to import from, "-" for stdin */
+    char*           wd_import_fn;
+    /** List file to merge with for WD_OPER_SYNC */
+    char*           wd_sync_fn;
+    /** Directories to crawl for WD_OPER_SCAN */
+    const char*     wd_scan_roots[ WD_MAX_SCAN_ARGS ];
+    size_t          wd_scan_root_count;
+    /** Names of entries marking a directory which should be bookmarked */
+    const char*     wd_scan_markers[ WD_MAX_SCAN_ARGS ];
+    size_t          wd_scan_marker_count;
+    /** Names of directories not to descend into, in addition to defaults */
+    const char*     wd_scan_prune[ WD_MAX_SCAN_ARGS ];
+    size_t          wd_scan_prune_count;
     /** Directory containing list of bookmarks */
     char*           list_fn;
+    /** Read-only lists searched after list_fn, in order.  Each points to
+        malloc'd memory */
+    char*           wd_layers[ WD_MAX_LAYERS ];
+    size_t          wd_layer_count;
     /** Directory read from the command line upon which operations should be
         performed */
     char            wd_oper_dir[ MAXPATHLEN ];
@@ -94,12 +157,44 @@ typedef struct {
     time_t          wd_now_time;
     /** Control which types of entity should be included in the output */
     wd_entity_t     wd_entity_type;
+    /** Comma-separated tags which listed entries must all have, or which
+        are given to an added entry.  NULL if none, otherwise points to
+        malloc'd memory */
+    char*           wd_tags;
+    /** Pattern which the path or name of listed entries must match.  NULL
+        if none. */
+    search_t        wd_search;
     /** Control whether or not all items should be output regardless of whether
         or not they seem to point to a valid entry in the current filesystem */
     int             wd_output_all;
     /** Control whether or not the string contents of a list should be escaped.
         May have the value 0 (no escape), 1 (single escape) or 2 (double-escape) */
     int             wd_escape_output;
+    /** Delimiting of records in listings and retrieved paths, intended for
+        consumption by scripts & programs */
+    wd_record_form_t wd_record_form;
+    /** Indicate whether or not operations should be passed to a running
+        daemon (falling back to direct file access if there is none) */
+    int             wd_use_daemon;
+    /** Indicate whether or not parsed lists should be shared with other wd
+        processes via shared memory */
+    int             wd_shm_cache;
+    /** Indicate whether or not changed lists should be saved by a detached
+        process after the result of the operation has been output */
+    int             wd_write_behind;
+    /** Indicate whether or not lists should be read from a local copy */
+    int             wd_snapshot;
+    /** Number of seconds for which a local copy is used without checking
+        whether the list has changed */
+    time_t          wd_snapshot_ttl;
+    /** Indicate whether or not listings should be cached in rendered form */
+    int             wd_render_cache;
+    /** Number of seconds for which a cached listing which depends on the
+        state of the filesystem remains valid */
+    time_t          wd_render_ttl;
+    /** Indicate whether or not the latency of the invocation should be
+        added to the stats file */
+    int             wd_record_stats;
 } config_container_t;
 
 /** Initialise the specified config with default values
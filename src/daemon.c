@@ -0,0 +1,514 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if defined __linux__
+/* For struct ucred */
+#define _GNU_SOURCE
+#endif
+
+#include "wd.h"
+#include "daemon.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/** Used to check that the client & daemon are speaking the same language */
+#define DAEMON_MAGIC   0x77644430UL
+/** Bump this whenever the request layout changes */
+#define DAEMON_VERSION 1U
+
+#define SOCKET_NAME         "wd.sock"
+#define SOCKET_NAME_FALLBACK_FMT "/tmp/wd-%lu.sock"
+
+/** Number of file descriptors passed from client to daemon (stdout &
+    stderr) */
+#define DAEMON_FD_COUNT 2
+
+/** Header sent by the client at the start of each request.  It is followed by
+    a config_container_t and then the strings which the config references */
+struct daemon_request_hdr
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t cfg_size;
+    uint32_t cmd_len;
+    uint32_t fn_len;
+    /** UINT32_MAX in the case that there is no bookmark name */
+    uint32_t name_len;
+};
+
+static volatile sig_atomic_t daemon_stop = 0;
+
+static void daemon_signal( int p_sig )
+{
+    daemon_stop = 1;
+}
+
+/** Determine the location of the per-user socket, preferring
+    $XDG_RUNTIME_DIR (which should only be accessible to the user) */
+static int socket_path( struct sockaddr_un* const p_addr )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    const char* runtime_dir = getenv( "XDG_RUNTIME_DIR" );
+    int len;
+
+    memset( p_addr, 0, sizeof( *p_addr ));
+    p_addr->sun_family = AF_UNIX;
+
+    if(( runtime_dir != NULL ) && ( runtime_dir[0] != '\0' )) {
+        len = snprintf( p_addr->sun_path, sizeof( p_addr->sun_path ),
+                        "%s/" SOCKET_NAME, runtime_dir );
+    } else {
+        len = snprintf( p_addr->sun_path, sizeof( p_addr->sun_path ),
+                        SOCKET_NAME_FALLBACK_FMT, (unsigned long)getuid() );
+    }
+
+    if(( len > 0 ) && ( (size_t)len < sizeof( p_addr->sun_path ))) {
+        ret_val = WD_SUCCESS;
+    }
+
+    return ret_val;
+}
+
+/** The socket may be in /tmp, where anyone could have created it, so
+    neither end trusts the other unless it belongs to the same user
+
+    \returns Non-zero if the process at the other end of p_sock is the user's */
+static int peer_is_user( const int p_sock )
+{
+#if defined SO_PEERCRED
+    struct ucred cred;
+    socklen_t len = sizeof( cred );
+
+    return(( getsockopt( p_sock, SOL_SOCKET, SO_PEERCRED, &cred, &len ) == 0 ) &&
+           ( len == sizeof( cred )) &&
+           ( cred.uid == getuid() ));
+#else
+    uid_t uid;
+    gid_t gid;
+
+    return(( getpeereid( p_sock, &uid, &gid ) == 0 ) &&
+           ( uid == getuid() ));
+#endif
+}
+
+/** Close any file descriptors passed in the control messages of p_msg */
+static void close_passed_fds( struct msghdr* const p_msg )
+{
+    struct cmsghdr* cmsg;
+
+    for( cmsg = CMSG_FIRSTHDR( p_msg );
+         cmsg != NULL;
+         cmsg = CMSG_NXTHDR( p_msg, cmsg )) {
+        if(( cmsg->cmsg_level == SOL_SOCKET ) &&
+           ( cmsg->cmsg_type == SCM_RIGHTS )) {
+            const size_t count = ( cmsg->cmsg_len - CMSG_LEN( 0 )) / sizeof( int );
+            size_t loop;
+
+            for( loop = 0; loop < count; loop++ ) {
+                int fd;
+
+                memcpy( &fd, CMSG_DATA( cmsg ) + ( loop * sizeof( int )),
+                        sizeof( fd ));
+                close( fd );
+            }
+        }
+    }
+}
+
+static int write_all( const int p_fd, const void* p_buf, size_t p_len )
+{
+    const char* src = (const char*)p_buf;
+
+    while( p_len > 0 ) {
+        ssize_t written = write( p_fd, src, p_len );
+        if( written < 0 ) {
+            if( errno != EINTR ) {
+                return WD_GENERIC_FAIL;
+            }
+        } else {
+            src += written;
+            p_len -= (size_t)written;
+        }
+    }
+    return WD_SUCCESS;
+}
+
+static int read_all( const int p_fd, void* p_buf, size_t p_len )
+{
+    char* dest = (char*)p_buf;
+
+    while( p_len > 0 ) {
+        ssize_t got = read( p_fd, dest, p_len );
+        if( got < 0 ) {
+            if( errno != EINTR ) {
+                return WD_GENERIC_FAIL;
+            }
+        } else if( got == 0 ) {
+            return WD_GENERIC_FAIL;
+        } else {
+            dest += got;
+            p_len -= (size_t)got;
+        }
+    }
+    return WD_SUCCESS;
+}
+
+/** Read a string of the specified length from the client, returning a
+    malloc'd, NUL terminated copy */
+static char* read_string( const int p_fd, const uint32_t p_len )
+{
+    char* ret_val = (char*)malloc( (size_t)p_len + 1U );
+
+    if( ret_val != NULL ) {
+        if( WD_SUCCEEDED( read_all( p_fd, ret_val, p_len ))) {
+            ret_val[ p_len ] = '\0';
+        } else {
+            free( ret_val );
+            ret_val = NULL;
+        }
+    }
+
+    return ret_val;
+}
+
+/** Receive the request header along with the client's file descriptors */
+static int recv_header( const int p_sock,
+                        struct daemon_request_hdr* const p_hdr,
+                        int p_fds[ DAEMON_FD_COUNT ] )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    union {
+        struct cmsghdr align;
+        char           buf[ CMSG_SPACE( sizeof( int ) * DAEMON_FD_COUNT ) ];
+    } control;
+    struct iovec iov;
+    struct msghdr msg;
+    struct cmsghdr* cmsg;
+    ssize_t got;
+
+    memset( &msg, 0, sizeof( msg ));
+    iov.iov_base = p_hdr;
+    iov.iov_len  = sizeof( *p_hdr );
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof( control.buf );
+
+    do {
+        got = recvmsg( p_sock, &msg, 0 );
+    } while(( got < 0 ) && ( errno == EINTR ));
+
+    /* Nothing is received on failure */
+    if( got >= 0 ) {
+        cmsg = CMSG_FIRSTHDR( &msg );
+        if(( got > 0 ) &&
+           !( msg.msg_flags & MSG_CTRUNC ) &&
+           ( cmsg != NULL ) &&
+           ( cmsg->cmsg_level == SOL_SOCKET ) &&
+           ( cmsg->cmsg_type == SCM_RIGHTS ) &&
+           ( cmsg->cmsg_len == CMSG_LEN( sizeof( int ) * DAEMON_FD_COUNT )) &&
+           ( CMSG_NXTHDR( &msg, cmsg ) == NULL )) {
+            memcpy( p_fds, CMSG_DATA( cmsg ), sizeof( int ) * DAEMON_FD_COUNT );
+
+            /* Header may have been split from the ancillary data */
+            if( WD_SUCCEEDED( read_all( p_sock, ((char*)p_hdr) + got,
+                                        sizeof( *p_hdr ) - (size_t)got ))) {
+                ret_val = WD_SUCCESS;
+            }
+        }
+
+        /* Whatever was passed with a malformed request mustn't be kept open */
+        if( !WD_SUCCEEDED( ret_val )) {
+            close_passed_fds( &msg );
+        }
+    }
+
+    return ret_val;
+}
+
+/** Carry out a single request from a client connected on p_sock */
+static void serve_client( const int p_sock,
+                          daemon_handler_t p_handler,
+                          list_cache_t p_cache )
+{
+    struct daemon_request_hdr hdr;
+    int fds[ DAEMON_FD_COUNT ];
+    config_container_t cfg;
+    char* cmd = NULL;
+    char* fn = NULL;
+    char* name = NULL;
+    int32_t status = WD_GENERIC_FAIL;
+
+    if( !WD_SUCCEEDED( recv_header( p_sock, &hdr, fds ))) {
+        DEBUG_OUT("daemon: failed to receive request header");
+    } else {
+        if(( hdr.magic == DAEMON_MAGIC ) &&
+           ( hdr.version == DAEMON_VERSION ) &&
+           ( hdr.cfg_size == sizeof( cfg )) &&
+           WD_SUCCEEDED( read_all( p_sock, &cfg, sizeof( cfg ))) &&
+           (( cmd = read_string( p_sock, hdr.cmd_len )) != NULL ) &&
+           (( fn = read_string( p_sock, hdr.fn_len )) != NULL ) &&
+           (( hdr.name_len == UINT32_MAX ) ||
+            (( name = read_string( p_sock, hdr.name_len )) != NULL ))) {
+            char* argv[] = { cmd, NULL };
+            int saved_out = dup( STDOUT_FILENO );
+            int saved_err = dup( STDERR_FILENO );
+
+            /* The pointers in the received config refer to the client's memory,
+               so patch them up to point to our copies */
+            cfg.list_fn = fn;
+            cfg.wd_bookmark_name = name;
+            cfg.wd_use_daemon = 0;
+            /* Operations involving layers aren't passed to the daemon, so
+               their names needn't be */
+            cfg.wd_layer_count = 0;
+            /* Lists are held in memory rather than read from local copies */
+            cfg.wd_snapshot = 0;
+            /* Nor are those involving tags or searches */
+            cfg.wd_tags = NULL;
+            cfg.wd_search = NULL;
+
+            if(( saved_out >= 0 ) && ( saved_err >= 0 ) &&
+               ( dup2( fds[0], STDOUT_FILENO ) >= 0 ) &&
+               ( dup2( fds[1], STDERR_FILENO ) >= 0 )) {
+
+                p_handler( &cfg, 1, argv, p_cache );
+
+                (void)fflush( stdout );
+                (void)fflush( stderr );
+                status = WD_SUCCESS;
+            }
+
+            if( saved_out >= 0 ) {
+                (void)dup2( saved_out, STDOUT_FILENO );
+                close( saved_out );
+            }
+            if( saved_err >= 0 ) {
+                (void)dup2( saved_err, STDERR_FILENO );
+                close( saved_err );
+            }
+        }
+
+        (void)write_all( p_sock, &status, sizeof( status ));
+
+        close( fds[0] );
+        close( fds[1] );
+    }
+
+    free( cmd );
+    free( fn );
+    free( name );
+}
+
+/** Main loop of the (already detached) daemon process.  Does not return */
+static void serve( const int p_sock,
+                   const struct sockaddr_un* const p_addr,
+                   daemon_handler_t p_handler )
+{
+    list_cache_t cache = new_list_cache();
+    struct sigaction sa;
+    int null_fd;
+
+    (void)setsid();
+
+    null_fd = open( "/dev/null", O_RDWR );
+    if( null_fd >= 0 ) {
+        (void)dup2( null_fd, STDIN_FILENO );
+        (void)dup2( null_fd, STDOUT_FILENO );
+        (void)dup2( null_fd, STDERR_FILENO );
+        if( null_fd > STDERR_FILENO ) {
+            close( null_fd );
+        }
+    }
+
+    /* No SA_RESTART so that accept() is interrupted */
+    memset( &sa, 0, sizeof( sa ));
+    sa.sa_handler = daemon_signal;
+    sigemptyset( &sa.sa_mask );
+    (void)sigaction( SIGTERM, &sa, NULL );
+    (void)sigaction( SIGINT, &sa, NULL );
+    (void)sigaction( SIGHUP, &sa, NULL );
+    /* Clients going away shouldn't take us with them */
+    signal( SIGPIPE, SIG_IGN );
+
+    while( !daemon_stop && ( cache != NULL )) {
+        int client = accept( p_sock, NULL, NULL );
+
+        if( client >= 0 ) {
+            if( peer_is_user( client )) {
+                serve_client( client, p_handler, cache );
+            } else {
+                DEBUG_OUT("daemon: ignoring client belonging to another user");
+            }
+            close( client );
+        } else if( errno != EINTR ) {
+            break;
+        }
+    }
+
+    (void)unlink( p_addr->sun_path );
+    free_list_cache( cache );
+    exit( EXIT_SUCCESS );
+}
+
+int daemon_run( const config_container_t* const p_config,
+                const char* const p_cmd,
+                daemon_handler_t p_handler )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    struct sockaddr_un addr;
+    int sock = -1;
+
+    /* Precondition check */
+    assert( p_config != NULL );
+    assert( p_cmd != NULL );
+    assert( p_handler != NULL );
+    /* !Precondition check */
+
+    if( !WD_SUCCEEDED( socket_path( &addr ))) {
+        fprintf( stderr, "%s: Error: Socket path too long\n", p_cmd );
+    } else if(( sock = socket( AF_UNIX, SOCK_STREAM, 0 )) < 0 ) {
+        fprintf( stderr, "%s: Error: Unable to create socket\n", p_cmd );
+    } else if( connect( sock, (struct sockaddr*)&addr, sizeof( addr )) == 0 ) {
+        fprintf( stderr, "%s: Error: Daemon already running on '%s'\n",
+                 p_cmd, addr.sun_path );
+    } else {
+        /* Ensure that only the user is able to connect */
+        mode_t old_mask = umask( 077 );
+        int bound;
+
+        /* Nothing listening, so any existing socket file is stale */
+        (void)unlink( addr.sun_path );
+
+        bound = bind( sock, (struct sockaddr*)&addr, sizeof( addr ));
+        (void)umask( old_mask );
+
+        if(( bound != 0 ) || ( listen( sock, SOMAXCONN ) != 0 )) {
+            fprintf( stderr, "%s: Error: Unable to listen on '%s'\n",
+                     p_cmd, addr.sun_path );
+        } else {
+            ret_val = WD_SUCCESS;
+
+            /* Detach from the invoking shell */
+            (void)fflush( stdout );
+            if( fork() == 0 ) {
+                serve( sock, &addr, p_handler );
+            }
+        }
+    }
+
+    if( sock >= 0 ) {
+        close( sock );
+    }
+
+    return ret_val;
+}
+
+int daemon_client_op( const config_container_t* const p_config,
+                      const char* const p_cmd )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    struct sockaddr_un addr;
+    int sock;
+
+    /* Precondition check */
+    assert( p_config != NULL );
+    assert( p_cmd != NULL );
+    /* !Precondition check */
+
+    if( WD_SUCCEEDED( socket_path( &addr )) &&
+        (( sock = socket( AF_UNIX, SOCK_STREAM, 0 )) >= 0 )) {
+        if( connect( sock, (struct sockaddr*)&addr, sizeof( addr )) == 0 ) {
+            if( !peer_is_user( sock )) {
+                fprintf( stderr, "%s: Warning: Ignoring daemon on '%s' which "
+                                 "belongs to another user\n",
+                         p_cmd, addr.sun_path );
+            } else {
+                struct daemon_request_hdr hdr;
+                union {
+                    struct cmsghdr align;
+                    char           buf[ CMSG_SPACE( sizeof( int ) * DAEMON_FD_COUNT ) ];
+                } control;
+                int fds[ DAEMON_FD_COUNT ] = { STDOUT_FILENO, STDERR_FILENO };
+                struct iovec iov;
+                struct msghdr msg;
+                struct cmsghdr* cmsg;
+                int32_t status;
+
+                hdr.magic    = DAEMON_MAGIC;
+                hdr.version  = DAEMON_VERSION;
+                hdr.cfg_size = sizeof( *p_config );
+                hdr.cmd_len  = (uint32_t)strlen( p_cmd );
+                hdr.fn_len   = (uint32_t)strlen( p_config->list_fn );
+                hdr.name_len = ( p_config->wd_bookmark_name == NULL ) ?
+                                   UINT32_MAX :
+                                   (uint32_t)strlen( p_config->wd_bookmark_name );
+
+                memset( &msg, 0, sizeof( msg ));
+                memset( &control, 0, sizeof( control ));
+                iov.iov_base = &hdr;
+                iov.iov_len  = sizeof( hdr );
+                msg.msg_iov = &iov;
+                msg.msg_iovlen = 1;
+                msg.msg_control = control.buf;
+                msg.msg_controllen = sizeof( control.buf );
+                cmsg = CMSG_FIRSTHDR( &msg );
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type  = SCM_RIGHTS;
+                cmsg->cmsg_len   = CMSG_LEN( sizeof( int ) * DAEMON_FD_COUNT );
+                memcpy( CMSG_DATA( cmsg ), fds, sizeof( fds ));
+
+                /* Anything we've buffered must be output ahead of the daemon's
+                   output */
+                (void)fflush( stdout );
+                (void)fflush( stderr );
+
+                if(( sendmsg( sock, &msg, 0 ) == (ssize_t)sizeof( hdr )) &&
+                   WD_SUCCEEDED( write_all( sock, p_config, sizeof( *p_config ))) &&
+                   WD_SUCCEEDED( write_all( sock, p_cmd, hdr.cmd_len )) &&
+                   WD_SUCCEEDED( write_all( sock, p_config->list_fn, hdr.fn_len )) &&
+                   (( p_config->wd_bookmark_name == NULL ) ||
+                    WD_SUCCEEDED( write_all( sock, p_config->wd_bookmark_name,
+                                             hdr.name_len )))) {
+                    /* Once the request has been sent, the daemon owns it - falling
+                       back would risk performing the operation twice */
+                    ret_val = WD_SUCCESS;
+
+                    if( !WD_SUCCEEDED( read_all( sock, &status, sizeof( status ))) ||
+                        !WD_SUCCEEDED( status )) {
+                        fprintf( stderr, "%s: Error: Daemon failed to handle request\n",
+                                 p_cmd );
+                    }
+                }
+            }
+        }
+        close( sock );
+    }
+
+    return ret_val;
+}
@@ -0,0 +1,64 @@
+/**
+   \file
+   \brief The daemon module allows a long-running wd process to hold bookmark
+          lists in memory and serve operations on behalf of short-lived
+          client invocations over a Unix domain socket
+
+   \copyright Copyright 2018 John Bailey
+
+   \section LICENSE
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if !defined( DAEMON_H )
+#define       DAEMON_H
+
+#include "cmdln.h"
+#include "list_cache.h"
+
+/** Function used by the daemon to carry out an operation on behalf of a
+    client.  stdout & stderr are redirected to the client's streams for the
+    duration of the call */
+typedef void (*daemon_handler_t)( const config_container_t* p_config,
+                                  int argc, char* argv[],
+                                  list_cache_t p_cache );
+
+/**
+    Run the daemon.  The process detaches from the terminal and serves
+    requests until terminated.
+
+    \param[in] p_config  Program settings
+    \param[in] p_cmd     String referencing the executing program
+    \param[in] p_handler Function to invoke for each request received
+    \returns WD_SUCCESS in the case that the daemon was started,
+             WD_GENERIC_FAIL otherwise (e.g. already running)
+*/
+int daemon_run( const config_container_t* const p_config,
+                const char* const p_cmd,
+                daemon_handler_t p_handler );
+
+/**
+    Attempt to have a running daemon perform the operation described by
+    p_config, with the output going to this process' stdout & stderr
+
+    \param[in] p_config  Program settings
+    \param[in] p_cmd     String referencing the executing program
+    \returns WD_SUCCESS in the case that the daemon handled the request,
+             WD_GENERIC_FAIL in the case that no daemon could be contacted, in
+             which case the caller should carry out the operation itself
+*/
+int daemon_client_op( const config_container_t* const p_config,
+                      const char* const p_cmd );
+
+#endif
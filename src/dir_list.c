@@ -17,12 +17,23 @@
 #include "wd.h"
 #include "dir_list.h"
 #include "cmdln.h"
+#include "out_buf.h"
+#include "search.h"
+#include "str_kernel.h"
+#include "timings.h"
 #if defined WIN32
 #include <windows.h>
 #endif
 
 #define FILE_HEADER_DESC_STRING "# WD directory list file"
 #define FILE_HEADER_VER_STRING "# File format: version 1"
+/** Marks a list containing records which older versions don't recognise
+    (they warn about them & drop them when saving).  Lists without such
+    records are still written as version 1. */
+#define FILE_HEADER_VER2_STRING "# File format: version 2"
+/** Marks a list which records removals.  As a comment, it's ignored by older
+    versions. */
+#define FILE_HEADER_REMOVALS_STRING "# Removals: recorded"
 
 #define USE_FAVOURITES_FILE_STR "USE_FAVOURITES"
 
@@ -38,34 +49,87 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
 #include <sys/stat.h>
 #include <time.h>
+#if !defined WIN32
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #define MIN_DIR_SIZE 100
 
 /* TODO: Since change #6, we support files as well as directories, so all of the
    "dir" references in this file are a little misleading */
 
-struct dir_list_item
-{
-    char*       dir_name;
-    char*       bookmark_name;
-    time_t      time_added;
-    time_t      time_accessed;
-    wd_entity_t type;
-    /* TODO: Other data here?  Time last usedc
-       Meta-data such as whether it exists?  Shortcut name? */
-};
+/* Entries are held column-wise, so that operations which only look at one
+   attribute of each entry (e.g. filtering by type) scan dense arrays.  Strings
+   are stored in a single pool and referred to by offset, and timestamps as
+   32-bit offsets from a per-list base time. */
+
+/** Offset used for a bookmark which has no name */
+#define NO_STRING UINT32_MAX
+/** Encoded form of a timestamp which isn't set (i.e. -1) */
+#define NO_TIME   INT32_MIN
 
-#define DLI_SIZE (sizeof( struct dir_list_item ))
+/** Bytes used by each entry's column values */
+#define ENTRY_SIZE ( sizeof( uint8_t ) + ( 3U * sizeof( uint32_t )) + \
+                     ( 2U * sizeof( int32_t )))
+
+/** Initial size of the string pool */
+#define MIN_POOL_SIZE 4096U
+
+/** Number of words in a tag bitset with room for p_count entries */
+#define TAG_WORDS( p_count ) ((( p_count ) + 63U ) / 64U )
+#define TAG_BIT( p_bits, p_idx ) \
+    ((( p_bits )[ ( p_idx ) / 64U ] >> (( p_idx ) % 64U )) & 1U )
+/** Separates the tags given on the command line & in list files */
+#define TAG_SEPARATOR ','
 
 struct dir_list_s
 {
-    size_t                dir_count;
-    struct dir_list_item* dir_list;
-    size_t                dir_size;
+    size_t    dir_count;
+    /** Number of entries for which the columns have room */
+    size_t    dir_size;
+
+    /** wd_entity_t of each entry */
+    uint8_t*  type;
+    /** Offset of each entry's path within pool */
+    uint32_t* dir_off;
+    /** Offset of each entry's bookmark name within pool, or NO_STRING */
+    uint32_t* name_off;
+    /** Time each entry was added, relative to time_base, or NO_TIME */
+    int32_t*  time_added;
+    /** Time each entry was last accessed, relative to time_base, or NO_TIME */
+    int32_t*  time_accessed;
+    time_t    time_base;
+    /** Number of times each entry has been used, if known (otherwise 0) */
+    uint32_t* hits;
+
+    /** NUL terminated strings referred to by dir_off & name_off */
+    char*     pool;
+    size_t    pool_used;
+    size_t    pool_size;
+    /** Bytes of pool used by strings of entries which have been removed */
+    size_t    pool_unused;
+
+    /** Names of the tags given to entries, in the order first used */
+    char**     tag_name;
+    size_t     tag_count;
+    /** For each tag, a bitset over entry indices in which the bits of the
+        entries with that tag are set.  Each has room for dir_size entries,
+        with those beyond dir_count clear, so that filtering by tags can be
+        done a word at a time. */
+    uint64_t** tag_bits;
+
+    /** Paths which have been removed, each with the time of its removal as
+        its time accessed, so that removals can be merged into other copies
+        of the list (see --sync).  NULL if there are none */
+    struct dir_list_s* removed;
 
     /* TODO: Is it the best thing to store the config here?  config contains
        things that this class doesn't care about */
@@ -73,6 +137,8 @@ struct dir_list_s
 };
 
 static wd_entity_t get_type( const char* const p_path );
+static int find_dir_location( dir_list_t p_list, const char* const p_dir, size_t* p_loc );
+static void remove_from_list( dir_list_t p_list, const size_t p_idx );
 static dir_list_t load_dir_list_from_file( const config_container_t* const p_config,
                                            const char* const p_fn );
 #if defined WIN32
@@ -80,803 +146,2956 @@ static dir_list_t load_dir_list_from_favourites( const config_container_t* const
                                                  const char* const p_fn );
 #endif
 
-
-static void increase_dir_alloc( dir_list_t p_list )
+static const char* item_dir( const dir_list_t p_list, const size_t p_idx )
 {
-    struct dir_list_item* new_mem;
-    size_t new_size;
-
-    /* TODO: check for wrap */
-    new_size = p_list->dir_size + MIN_DIR_SIZE;
+    return( p_list->pool + p_list->dir_off[ p_idx ] );
+}
 
-    new_mem = 
-        (struct dir_list_item*) realloc( p_list->dir_list,
-                                         new_size * DLI_SIZE );
-    if( new_mem != NULL )
-    {
-        DEBUG_OUT("Dir list now size " PFFST " (" PFFST " bytes per entry)",new_size,DLI_SIZE);
-        p_list->dir_list = new_mem;
-        p_list->dir_size = new_size;
-    }
-    else
-    {
-        DEBUG_OUT("realloc of dir allocation failed");
-    }
+static const char* item_name( const dir_list_t p_list, const size_t p_idx )
+{
+    const uint32_t off = p_list->name_off[ p_idx ];
+    return(( off == NO_STRING ) ? NULL : ( p_list->pool + off ));
 }
 
-size_t     dir_list_get_count( const dir_list_t p_list )
+static time_t decode_time( const dir_list_t p_list, const int32_t p_time )
 {
-    return( p_list->dir_count );
+    return(( p_time == NO_TIME ) ? (time_t)-1 :
+                                   (time_t)( p_list->time_base + p_time ));
 }
 
-int add_dir( dir_list_t p_list,
-             const char* const p_dir,
-             const char* const p_name,
-             const time_t      p_t_added,
-             const time_t      p_t_accessed,
-             const wd_entity_t p_type )
+/** Whether or not p_time can be encoded relative to p_base */
+static int time_fits( const time_t p_base, const time_t p_time )
 {
-    /* TODO: Check that item is of type p_list->cfg->wd_entity_type? */
-    int ret_val = WD_GENERIC_FAIL;
-    char* dest = NULL;
-    const size_t idx = p_list->dir_count;
+    const int64_t delta = (int64_t)p_time - (int64_t)p_base;
+    return(( p_time == -1 ) || (( delta > INT32_MIN ) && ( delta <= INT32_MAX )));
+}
 
-    if( idx == p_list->dir_size )
-    {
-        DEBUG_OUT("list does not have space, increasing allocation"); 
-        increase_dir_alloc( p_list );
-        DEBUG_OUT("increased allocation"); 
+static int32_t encode_time( const dir_list_t p_list, const time_t p_time )
+{
+    int64_t delta = (int64_t)p_time - (int64_t)p_list->time_base;
+
+    /* Anything beyond the range has already been made as close as possible by
+       fit_times() */
+    if( p_time == -1 ) {
+        delta = NO_TIME;
+    } else if( delta <= INT32_MIN ) {
+        delta = INT32_MIN + 1;
+    } else if( delta > INT32_MAX ) {
+        delta = INT32_MAX;
     }
 
-    DEBUG_OUT("Adding dir entry " PFFST,idx);
+    return( (int32_t)delta );
+}
 
-    /* Check to see if there's space now - it's possible that an attempt to
-       increase the allocation (above) actually failed */
-    if( idx < p_list->dir_size )
-    {
-        struct dir_list_item* const dir_item = &( p_list->dir_list[ idx ] );
+/** Ensure that the list's base time allows p_a & p_b to be encoded, by
+    re-basing the existing timestamps if necessary */
+static void fit_times( dir_list_t p_list, const time_t p_a, const time_t p_b )
+{
+    if( p_list->dir_count == 0 ) {
+        p_list->time_base = ( p_a != -1 ) ? p_a : ( p_b != -1 ) ? p_b : 0;
+    }
+
+    if( !time_fits( p_list->time_base, p_a ) ||
+        !time_fits( p_list->time_base, p_b )) {
+        int64_t min = INT64_MAX;
+        int64_t max = INT64_MIN;
+        size_t loop;
+
+        /* Centre the base within the range of timestamps */
+        for( loop = 0; loop < ( p_list->dir_count * 2U ) + 2U; loop++ ) {
+            const time_t t =
+                ( loop == 0 ) ? p_a :
+                ( loop == 1 ) ? p_b :
+                decode_time( p_list, ( loop & 1U ) ?
+                    p_list->time_accessed[ ( loop - 2U ) / 2U ] :
+                    p_list->time_added[ ( loop - 2U ) / 2U ] );
+            if( t != -1 ) {
+                if( (int64_t)t < min ) { min = (int64_t)t; }
+                if( (int64_t)t > max ) { max = (int64_t)t; }
+            }
+        }
 
-        size_t dest_len = strlen( p_dir );
+        {
+            const time_t old_base = p_list->time_base;
+            p_list->time_base = (time_t)( min + (( max - min ) / 2 ));
 
-        DEBUG_OUT("Destination length: " PFFST,dest_len);
-        dest = (char*)malloc(dest_len + 1);
-        if( dest != NULL ) {
-            strcpy( dest, p_dir );
-            dir_item->dir_name = dest;
+            DEBUG_OUT("re-basing timestamps from %ld to %ld",
+                      (long)old_base, (long)p_list->time_base);
 
-            if( p_name != NULL )
-            {
-                size_t name_len = strlen( p_name );
-                DEBUG_OUT("Name length: " PFFST,name_len);
-                dest = (char*)malloc( name_len + 1 );
-                if( dest != NULL ) {
-                    strcpy( dest, p_name );
-                    dir_item->bookmark_name = dest;
-                    ret_val = WD_SUCCESS;
-                } else {
-                    fprintf(stderr,"MALLOC FAILED\n");
-                    dir_item->bookmark_name = NULL;
+            for( loop = 0; loop < p_list->dir_count; loop++ ) {
+                if( p_list->time_added[ loop ] != NO_TIME ) {
+                    p_list->time_added[ loop ] = encode_time( p_list,
+                        (time_t)( old_base + p_list->time_added[ loop ] ));
                 }
-            } else {
-                dir_item->bookmark_name = NULL;
-                ret_val = WD_SUCCESS;
-            }
-
-            if( WD_SUCCEEDED( ret_val )) {
-                #if 1
-                dir_item->time_added = p_t_added;
-                #endif
-                #if 1
-                dir_item->time_accessed = p_t_accessed;
-                #endif
-                if( p_type == WD_ENTITY_UNKNOWN ) {
-                    dir_item->type = get_type( dir_item->dir_name );
-                } else {
-                    dir_item->type = p_type;
+                if( p_list->time_accessed[ loop ] != NO_TIME ) {
+                    p_list->time_accessed[ loop ] = encode_time( p_list,
+                        (time_t)( old_base + p_list->time_accessed[ loop ] ));
                 }
-
-                p_list->dir_count++;
             }
         }
-        else
-        {
-            fprintf(stderr,"MALLOC FAILED\n");
-        }
-    }
-    else
-    {
-        fprintf(stderr,"DIRLIST not big enough\n");
     }
+}
 
-    return( ret_val );
+static void set_time_accessed( dir_list_t p_list, const size_t p_idx, const time_t p_time )
+{
+    fit_times( p_list, p_time, -1 );
+    p_list->time_accessed[ p_idx ] = encode_time( p_list, p_time );
 }
 
-dir_list_t new_dir_list( void )
+/** Resize a column of the list */
+static int resize_column( void** const p_col, const size_t p_elem_size,
+                          const size_t p_count )
 {
-    dir_list_t ret_val = (dir_list_t)malloc( sizeof( struct dir_list_s ) );
+    int ret_val = WD_GENERIC_FAIL;
+    void* new_mem = realloc( *p_col, p_elem_size * p_count );
 
-    if( ret_val != NULL ) {
-        ret_val->dir_count = 0;
-        ret_val->dir_list = NULL;
-        ret_val->dir_size = 0;
+    TIMINGS_COUNT( WD_COUNTER_ALLOCS, 1U );
+    if( new_mem != NULL ) {
+        *p_col = new_mem;
+        ret_val = WD_SUCCESS;
+    }
 
-        /* Allocate some initial memory for the directory list - this saves us
-           having to deal with dir_list being NULL in the general case */
-        increase_dir_alloc( ret_val );
+    return( ret_val );
+}
+
+/** Resize the tag bitsets to hold p_count entries.  Bits for entries beyond
+    the current size are cleared. */
+static int resize_tag_bits( dir_list_t p_list, const size_t p_count )
+{
+    int ret_val = WD_SUCCESS;
+    const size_t old_words = TAG_WORDS( p_list->dir_size );
+    const size_t new_words = TAG_WORDS( p_count );
+    size_t tag;
+
+    for( tag = 0; WD_SUCCEEDED( ret_val ) && ( tag < p_list->tag_count ); tag++ ) {
+        ret_val = resize_column( (void**)&( p_list->tag_bits[ tag ] ),
+                                 sizeof( uint64_t ), new_words );
+        if( WD_SUCCEEDED( ret_val ) && ( new_words > old_words )) {
+            memset( p_list->tag_bits[ tag ] + old_words, 0,
+                    ( new_words - old_words ) * sizeof( uint64_t ));
+        }
     }
 
     return( ret_val );
 }
 
-static time_t sscan_time( const char* const p_str )
+/** Change the number of entries for which the columns have room to hold
+    at least p_count (and any existing entries), in multiples of
+    MIN_DIR_SIZE */
+static int resize_dirs( dir_list_t p_list, size_t p_count )
 {
-    time_t ret_val;
-    struct tm tm;
-    tm.tm_isdst = -1;
-    tm.tm_yday = -1;
-    tm.tm_wday = -1;
-    sscanf(p_str, TIME_SSCAN_STRING,
-                  &tm.tm_year,
-                  &tm.tm_mon,
-                  &tm.tm_mday,
-                  &tm.tm_hour,
-                  &tm.tm_min,
-                  &tm.tm_sec);
+    int ret_val = WD_GENERIC_FAIL;
+    size_t new_size;
 
-    /* tm's year is baselined at 1900 */
-    tm.tm_year -= 1900;
-    /* tm's month is the count of months since Jan */
-    tm.tm_mon -= 1;
+    if( p_count < p_list->dir_count ) {
+        p_count = p_list->dir_count;
+    }
+    new_size = (( p_count + MIN_DIR_SIZE - 1U ) / MIN_DIR_SIZE ) * MIN_DIR_SIZE;
+    if( new_size == 0 ) {
+        new_size = MIN_DIR_SIZE;
+    }
 
-    /* This call will ensure that tm_yday is calculated - we need that for the
-       conversion below */
-    mktime( &tm );
+    /* Columns which are successfully resized simply have spare room if
+       others fail to be enlarged */
+    if( WD_SUCCEEDED( resize_tag_bits( p_list, new_size )) &&
+        WD_SUCCEEDED( resize_column( (void**)&( p_list->type ),
+                                     sizeof( uint8_t ), new_size )) &&
+        WD_SUCCEEDED( resize_column( (void**)&( p_list->dir_off ),
+                                     sizeof( uint32_t ), new_size )) &&
+        WD_SUCCEEDED( resize_column( (void**)&( p_list->name_off ),
+                                     sizeof( uint32_t ), new_size )) &&
+        WD_SUCCEEDED( resize_column( (void**)&( p_list->time_added ),
+                                     sizeof( int32_t ), new_size )) &&
+        WD_SUCCEEDED( resize_column( (void**)&( p_list->time_accessed ),
+                                     sizeof( int32_t ), new_size )) &&
+        WD_SUCCEEDED( resize_column( (void**)&( p_list->hits ),
+                                     sizeof( uint32_t ), new_size )))
+    {
+        DEBUG_OUT("Dir list now size " PFFST " (" PFFST " bytes per entry)",new_size,ENTRY_SIZE);
+        p_list->dir_size = new_size;
+        ret_val = WD_SUCCESS;
+    }
+    else
+    {
+        DEBUG_OUT("realloc of dir allocation failed");
+        if( new_size < p_list->dir_size ) {
+            /* Some columns may have been shrunk */
+            p_list->dir_size = new_size;
+        }
+    }
 
-    /* The time in the file is already UTC, so using
-       mktime is the wrong thing to do, as this assumes that
-       the contents of tm is in local time
-       see http://pubs.opengroup.org/onlinepubs/007904975/basedefs/xbd_chap04.html#tag_04_14 */
-    ret_val = tm.tm_sec +
-              tm.tm_min*60 +
-              tm.tm_hour*3600 +
-              tm.tm_yday*86400 +
-              (tm.tm_year-70)*31536000 +
-              ((tm.tm_year-69)/4)*86400 -
-              ((tm.tm_year-1)/100)*86400 +
-              ((tm.tm_year+299)/400)*86400;
+    return( ret_val );
+}
 
-    return ret_val;
+static void increase_dir_alloc( dir_list_t p_list )
+{
+    /* TODO: check for wrap */
+    (void)resize_dirs( p_list, p_list->dir_size + MIN_DIR_SIZE );
 }
 
-dir_list_t load_dir_list( const config_container_t* const p_config, const char* const p_fn )
+/** Copy a string into the list's pool
+
+    \returns Offset of the string or NO_STRING if there wasn't room */
+static uint32_t pool_add( dir_list_t p_list, const char* const p_str )
 {
-    dir_list_t ret_val = NULL;
-#if defined WIN32
-    if( 0 == strcmp( p_fn, USE_FAVOURITES_FILE_STR )) {
-        ret_val = load_dir_list_from_favourites( p_config, p_fn );
-    } else {
-#endif
-        ret_val = load_dir_list_from_file( p_config, p_fn );
-#if defined WIN32
+    uint32_t ret_val = NO_STRING;
+    const size_t len = strlen( p_str ) + 1U;
+
+    if( p_list->pool_used + len > p_list->pool_size ) {
+        size_t new_size = ( p_list->pool_size == 0 ) ? MIN_POOL_SIZE :
+                                                       ( p_list->pool_size * 2U );
+        char* new_mem;
+
+        if( new_size < p_list->pool_used + len ) {
+            new_size = p_list->pool_used + len;
+        }
+        /* Offsets must be representable */
+        if( new_size > NO_STRING ) {
+            new_size = NO_STRING;
+        }
+
+        if( new_size >= p_list->pool_used + len ) {
+            new_mem = (char*)realloc( p_list->pool, new_size );
+            TIMINGS_COUNT( WD_COUNTER_ALLOCS, 1U );
+            if( new_mem != NULL ) {
+                p_list->pool = new_mem;
+                p_list->pool_size = new_size;
+            }
+        }
     }
-#endif
-    return ret_val;
+
+    if( p_list->pool_used + len <= p_list->pool_size ) {
+        ret_val = (uint32_t)p_list->pool_used;
+        memcpy( p_list->pool + p_list->pool_used, p_str, len );
+        p_list->pool_used += len;
+    }
+
+    return( ret_val );
 }
 
-#if defined WIN32
-#include "shrtcut.h"
-#include <shlobj.h>
-#include <dirent.h>
-static dir_list_t load_dir_list_from_favourites( const config_container_t* const p_config, const char* const p_fn )
+/** Discard the pool space used by the strings of removed entries */
+static void pool_compact( dir_list_t p_list )
 {
-    dir_list_t ret_val = NULL;
-    TCHAR path[MAX_PATH];
-    HRESULT hr = SHGetFolderPath(0, CSIDL_FAVORITES, 0, 0, path);
- 
-    if (WD_SUCCEEDED(hr)) {
-        DIR* FD;
-        DEBUG_OUT("got favourites drectory: %s", path);
-        /* TODO: recurse sub-directories */
-
-        CoInitialize( NULL );
+    char* new_pool = (char*)malloc( p_list->pool_size );
+
+    TIMINGS_COUNT( WD_COUNTER_ALLOCS, 1U );
+    if( new_pool != NULL ) {
+        size_t used = 0;
+        size_t loop;
+
+        for( loop = 0; loop < p_list->dir_count; loop++ ) {
+            uint32_t* const offs[] = { &( p_list->dir_off[ loop ] ),
+                                       &( p_list->name_off[ loop ] ) };
+            size_t str;
+
+            for( str = 0; str < sizeof( offs ) / sizeof( offs[0] ); str++ ) {
+                if( *offs[ str ] != NO_STRING ) {
+                    const size_t len = strlen( p_list->pool + *offs[ str ] ) + 1U;
+                    memcpy( new_pool + used, p_list->pool + *offs[ str ], len );
+                    *offs[ str ] = (uint32_t)used;
+                    used += len;
+                }
+            }
+        }
 
-        if (NULL != (FD = opendir (path))) 
-        {
-            struct dirent* in_file;
-            DEBUG_OUT("opened favourites drectory: %s", path);
-            ret_val = new_dir_list();
-            ret_val->cfg = p_config;
-            while ((in_file = readdir(FD))) 
-            {
-                if((0 != strcmp (in_file->d_name, ".")) &&
-                   (0 != strcmp (in_file->d_name, "..")))
-                {
-                    size_t len = strlen( in_file->d_name );
-                    if(( len > 4 ) &&
-                       ( 0 == stricmp( &(in_file->d_name[len-4]), ".lnk" ))) {
-                        char shortcut_full[ MAXPATHLEN ];
-                        char dest_path[ MAXPATHLEN ];
-                        char name[ MAXPATHLEN ];
-                        time_t added;
-                        time_t accessed;
-                        wd_entity_t ent_type;
-                        struct stat s;
-                        int err;
+        free( p_list->pool );
+        p_list->pool = new_pool;
+        p_list->pool_used = used;
+        p_list->pool_unused = 0;
+    }
+}
 
-                        DEBUG_OUT("found file: %s",in_file->d_name);
+size_t     dir_list_get_count( const dir_list_t p_list )
+{
+    return( p_list->dir_count );
+}
 
-                        /* TODO */
-                        dest_path[0] = 0;
-                        accessed = -1;
-                        added = -1;
-                        ent_type = WD_ENTITY_UNKNOWN;
+/** \returns Index of the tag named by the p_len characters at p_tag, or
+             tag_count if no entry has been given it */
+static size_t find_tag( const dir_list_t p_list, const char* const p_tag,
+                        const size_t p_len )
+{
+    size_t ret_val;
 
+    for( ret_val = 0; ret_val < p_list->tag_count; ret_val++ ) {
+        const char* const name = p_list->tag_name[ ret_val ];
 
-                        strcpy( shortcut_full, path );
-                        strcat( shortcut_full, "\\" );
-                        strcat( shortcut_full, in_file->d_name );
+        if(( 0 == strncmp( name, p_tag, p_len )) && ( name[ p_len ] == '\0' )) {
+            break;
+        }
+    }
 
-                        err = stat( shortcut_full, &s);
-                        if( err == -1 ) {
-                            /* TODO */
-                        } else {
-                            /* TODO: Are these really the appropriate attributes
-                               to use? */
-                            added = s.st_ctime;
-                            accessed = s.st_atime;
-                            ResolveIt( NULL, shortcut_full, dest_path,
-                                    MAXPATHLEN );
-                        }
+    return( ret_val );
+}
 
-                        strncpy( name, in_file->d_name, len-4 );
-                        name[len-4] = 0;
+/** Find the tag named by the p_len characters at p_tag, creating it (with
+    no entries) if necessary
 
+    \returns Index of the tag, or tag_count if it couldn't be created */
+static size_t get_tag( dir_list_t p_list, const char* const p_tag,
+                       const size_t p_len )
+{
+    size_t ret_val = find_tag( p_list, p_tag, p_len );
+
+    if( ret_val == p_list->tag_count ) {
+        char* const name = (char*)malloc( p_len + 1U );
+        uint64_t* const bits = (uint64_t*)calloc( TAG_WORDS( p_list->dir_size ),
+                                                  sizeof( uint64_t ));
+        int ok = ( name != NULL ) && ( bits != NULL ) &&
+                 WD_SUCCEEDED( resize_column( (void**)&( p_list->tag_name ),
+                                              sizeof( char* ), ret_val + 1U )) &&
+                 WD_SUCCEEDED( resize_column( (void**)&( p_list->tag_bits ),
+                                              sizeof( uint64_t* ), ret_val + 1U ));
+
+        if( ok ) {
+            memcpy( name, p_tag, p_len );
+            name[ p_len ] = '\0';
+            p_list->tag_name[ ret_val ] = name;
+            p_list->tag_bits[ ret_val ] = bits;
+            p_list->tag_count++;
+        } else {
+            free( name );
+            free( bits );
+        }
+    }
 
- 
-                        add_dir( ret_val, dest_path, name, added, accessed,
-                                 ent_type );
+    return( ret_val );
+}
 
-                        DEBUG_OUT("created new bookmark");
-                    }
-                }
-            }
+/** Remove entry p_idx from the tag bitsets, moving the bits of the entries
+    following it down to match the other columns */
+static void remove_from_tags( dir_list_t p_list, const size_t p_idx )
+{
+    const size_t words = TAG_WORDS( p_list->dir_count );
+    const size_t first = p_idx / 64U;
+    /* Bits below p_idx in its word are kept where they are */
+    const uint64_t low = ( UINT64_C( 1 ) << ( p_idx % 64U )) - 1U;
+    size_t tag;
+
+    for( tag = 0; tag < p_list->tag_count; tag++ ) {
+        uint64_t* const bits = p_list->tag_bits[ tag ];
+        size_t word;
+
+        bits[ first ] = ( bits[ first ] & low ) |
+                        (( bits[ first ] >> 1 ) & ~low );
+        for( word = first; ( word + 1U ) < words; word++ ) {
+            bits[ word ] |= bits[ word + 1U ] << 63;
+            bits[ word + 1U ] >>= 1;
         }
-        
-        CoUninitialize();
     }
-    return ret_val;
 }
-#endif
 
-static dir_list_t load_dir_list_from_file( const config_container_t* const p_config, const char* const p_fn )
+int dir_list_set_tags( dir_list_t p_list, const size_t p_idx,
+                       const char* const p_tags )
 {
-    FILE* file = fopen( p_fn, "rt" );
-    dir_list_t ret_val = NULL;
+    int ret_val = WD_GENERIC_FAIL;
 
-    if( file != NULL ) {
-        DEBUG_OUT("opened bookmark file");
+    /* Precondition check */
+    assert( p_list != NULL );
+    assert( p_idx < p_list->dir_count );
+    /* !Precondition check */
+
+    /* The list file is line-based, so can't hold these */
+    if(( p_tags == NULL ) || ( strpbrk( p_tags, "\r\n" ) == NULL )) {
+        const char* tag = p_tags;
+        size_t loop;
+
+        ret_val = WD_SUCCESS;
+        for( loop = 0; loop < p_list->tag_count; loop++ ) {
+            p_list->tag_bits[ loop ][ p_idx / 64U ] &= ~( UINT64_C( 1 ) << ( p_idx % 64U ));
+        }
+
+        while(( tag != NULL ) && ( *tag != '\0' ) && WD_SUCCEEDED( ret_val )) {
+            const char* const end = strchr( tag, TAG_SEPARATOR );
+            const size_t len = ( end != NULL ) ? (size_t)( end - tag ) : strlen( tag );
+
+            /* Empty tags, e.g. from a trailing separator, are ignored */
+            if( len != 0 ) {
+                const size_t idx = get_tag( p_list, tag, len );
+
+                if( idx < p_list->tag_count ) {
+                    p_list->tag_bits[ idx ][ p_idx / 64U ] |= UINT64_C( 1 ) << ( p_idx % 64U );
+                } else {
+                    ret_val = WD_GENERIC_FAIL;
+                }
+            }
+            tag = ( end != NULL ) ? ( end + 1 ) : NULL;
+        }
+    }
+
+    return( ret_val );
+}
+
+static int tag_compare( const void* p_a, const void* p_b )
+{
+    return( strcmp( *(const char* const*)p_a, *(const char* const*)p_b ));
+}
+
+char* dir_list_get_tags( const dir_list_t p_list, const size_t p_idx )
+{
+    char* ret_val = NULL;
+    const char** names = NULL;
+    size_t count = 0;
+    size_t len = 0;
+    size_t loop;
+
+    /* Precondition check */
+    assert( p_list != NULL );
+    assert( p_idx < p_list->dir_count );
+    /* !Precondition check */
+
+    for( loop = 0; loop < p_list->tag_count; loop++ ) {
+        if( TAG_BIT( p_list->tag_bits[ loop ], p_idx )) {
+            if( names == NULL ) {
+                names = (const char**)malloc( p_list->tag_count * sizeof( char* ));
+                if( names == NULL ) {
+                    break;
+                }
+            }
+            names[ count++ ] = p_list->tag_name[ loop ];
+            len += strlen( p_list->tag_name[ loop ] ) + 1U;
+        }
+    }
+
+    if(( count != 0 ) && ( names != NULL )) {
+        /* Sorted, so that the same tags are always written the same way */
+        qsort( names, count, sizeof( char* ), tag_compare );
+
+        ret_val = (char*)malloc( len );
+        if( ret_val != NULL ) {
+            char* pos = ret_val;
+
+            for( loop = 0; loop < count; loop++ ) {
+                const size_t name_len = strlen( names[ loop ] );
+
+                memcpy( pos, names[ loop ], name_len );
+                pos += name_len;
+                *( pos++ ) = TAG_SEPARATOR;
+            }
+            pos[ -1 ] = '\0';
+        }
+    }
+    free( names );
+
+    return( ret_val );
+}
+
+int dir_list_copy_tags( dir_list_t p_dest, const size_t p_dest_idx,
+                        const dir_list_t p_src, const size_t p_src_idx )
+{
+    char* const tags = dir_list_get_tags( p_src, p_src_idx );
+    const int ret_val = dir_list_set_tags( p_dest, p_dest_idx, tags );
+
+    free( tags );
+
+    return( ret_val );
+}
+
+/** \returns A bitset over the entries of p_list, with the bits of those
+             which have all of the tags in p_tags set, or NULL if there
+             wasn't the memory */
+static uint64_t* match_tags( const dir_list_t p_list, const char* const p_tags )
+{
+    const size_t words = TAG_WORDS( p_list->dir_count );
+    uint64_t* const ret_val = (uint64_t*)malloc(( words + 1U ) * sizeof( uint64_t ));
+    const char* tag = p_tags;
+
+    if( ret_val != NULL ) {
+        memset( ret_val, 0xff, ( words + 1U ) * sizeof( uint64_t ));
+
+        while(( tag != NULL ) && ( *tag != '\0' )) {
+            const char* const end = strchr( tag, TAG_SEPARATOR );
+            const size_t len = ( end != NULL ) ? (size_t)( end - tag ) : strlen( tag );
+
+            if( len != 0 ) {
+                const size_t idx = find_tag( p_list, tag, len );
+                size_t word;
+
+                if( idx == p_list->tag_count ) {
+                    /* No entry has the tag */
+                    memset( ret_val, 0, ( words + 1U ) * sizeof( uint64_t ));
+                    break;
+                }
+                for( word = 0; word < words; word++ ) {
+                    ret_val[ word ] &= p_list->tag_bits[ idx ][ word ];
+                }
+            }
+            tag = ( end != NULL ) ? ( end + 1 ) : NULL;
+        }
+    }
+
+    return( ret_val );
+}
+
+/** A live string in the pool, with the entry whose path or name it is */
+struct pool_string
+{
+    uint32_t off;
+    uint32_t entry;
+};
+
+static int pool_string_compare( const void* p_a, const void* p_b )
+{
+    const uint32_t a = ((const struct pool_string*)p_a)->off;
+    const uint32_t b = ((const struct pool_string*)p_b)->off;
+
+    return(( a > b ) - ( a < b ));
+}
+
+/** Set the bits in p_found (as per match_tags(), initially clear) of the
+    entries of p_list whose path or name contains p_lit.  Rather than each
+    string being searched in turn, the pool is scanned as a whole and each
+    occurrence mapped back to the string containing it, so strings without
+    it aren't looked at individually.
+
+    \returns WD_SUCCESS, or WD_GENERIC_FAIL if there wasn't the memory */
+static int find_literal( const dir_list_t p_list, const char* const p_lit,
+                         const size_t p_lit_len, uint64_t* const p_found )
+{
+    struct pool_string* const strs = (struct pool_string*)
+        malloc( 2U * p_list->dir_count * sizeof( struct pool_string ));
+    const char* const pool = p_list->pool;
+    size_t count = 0;
+    size_t pos = 0;
+    int sorted = 1;
+    size_t loop;
+
+    if( strs == NULL ) {
+        return(( p_list->dir_count == 0 ) ? WD_SUCCESS : WD_GENERIC_FAIL );
+    }
+
+    for( loop = 0; loop < p_list->dir_count; loop++ ) {
+        const uint32_t offs[ 2 ] = { p_list->dir_off[ loop ], p_list->name_off[ loop ] };
+        size_t str;
+
+        for( str = 0; str < 2U; str++ ) {
+            if( offs[ str ] != NO_STRING ) {
+                sorted &= ( count == 0 ) || ( strs[ count - 1U ].off <= offs[ str ] );
+                strs[ count ].off = offs[ str ];
+                strs[ count ].entry = (uint32_t)loop;
+                count++;
+            }
+        }
+    }
+    /* Strings are usually in the pool in the order of their entries, unless
+       an entry has been renamed */
+    if( !sorted ) {
+        qsort( strs, count, sizeof( struct pool_string ), pool_string_compare );
+    }
+
+    while( pos < p_list->pool_used ) {
+        const size_t hit = pos + str_find( pool + pos, p_list->pool_used - pos,
+                                           p_lit, p_lit_len );
+        const char* end;
+        size_t lo = 0;
+        size_t hi = count;
+
+        if( hit >= p_list->pool_used ) {
+            break;
+        }
+
+        /* Find the last string starting at or before the occurrence.  If
+           that ends before it, the occurrence is in the string of an entry
+           which has since been removed. */
+        while( lo < hi ) {
+            const size_t mid = lo + (( hi - lo ) / 2U );
+            if( strs[ mid ].off <= hit ) {
+                lo = mid + 1U;
+            } else {
+                hi = mid;
+            }
+        }
+        if(( lo != 0 ) &&
+           ( NULL == memchr( pool + strs[ lo - 1U ].off, '\0', hit - strs[ lo - 1U ].off ))) {
+            const uint32_t start = strs[ lo - 1U ].off;
+
+            /* A string may be shared by more than one entry */
+            for( ; ( lo != 0 ) && ( strs[ lo - 1U ].off == start ); lo-- ) {
+                const size_t entry = strs[ lo - 1U ].entry;
+                p_found[ entry / 64U ] |= UINT64_C( 1 ) << ( entry % 64U );
+            }
+        }
+
+        /* Further occurrences in the same string needn't be looked for */
+        end = (const char*)memchr( pool + hit, '\0', p_list->pool_used - hit );
+        pos = ( end != NULL ) ? ((size_t)( end - pool ) + 1U ) : p_list->pool_used;
+    }
+
+    free( strs );
+
+    return( WD_SUCCESS );
+}
+
+/** Clear the bits in p_bits (as per match_tags()) of the entries of p_list
+    whose path and name both don't match p_search.  Only entries containing
+    the search's literal, if it has one, are matched against its pattern.
+
+    \returns WD_SUCCESS, or WD_GENERIC_FAIL if there wasn't the memory */
+static int match_search( const dir_list_t p_list, const search_t p_search,
+                         uint64_t* const p_bits )
+{
+    const size_t words = TAG_WORDS( p_list->dir_count );
+    size_t lit_len;
+    const char* const lit = search_literal( p_search, &lit_len );
+    int ret_val = WD_SUCCESS;
+    size_t word;
+
+    if( lit_len != 0 ) {
+        uint64_t* const found = (uint64_t*)calloc( words + 1U, sizeof( uint64_t ));
+
+        ret_val = ( found != NULL ) ?
+                      find_literal( p_list, lit, lit_len, found ) : WD_GENERIC_FAIL;
+        if( WD_SUCCEEDED( ret_val )) {
+            for( word = 0; word < words; word++ ) {
+                p_bits[ word ] &= found[ word ];
+            }
+        }
+        free( found );
+    }
+
+    for( word = 0; ( word < words ) && WD_SUCCEEDED( ret_val ); word++ ) {
+        uint64_t bits = p_bits[ word ];
+
+        while( bits != 0 ) {
+            const size_t entry = ( word * 64U ) + (size_t)__builtin_ctzll( bits );
+            const char* name;
+
+            if( entry >= p_list->dir_count ) {
+                break;
+            }
+            bits &= bits - 1U;
+
+            name = item_name( p_list, entry );
+            if( !search_match( p_search, item_dir( p_list, entry )) &&
+                (( name == NULL ) || !search_match( p_search, name ))) {
+                p_bits[ word ] &= ~( UINT64_C( 1 ) << ( entry % 64U ));
+            }
+        }
+    }
+
+    return( ret_val );
+}
+
+/** \returns A bitset over the entries of p_list as per match_tags(), with
+              the bits of those which have the tags & match the search in
+              p_cfg set.  NULL if the listing isn't filtered by either, or
+              (with *p_failed set) if there wasn't the memory */
+static uint64_t* select_entries( const dir_list_t p_list,
+                                 const config_container_t* const p_cfg,
+                                 int* const p_failed )
+{
+    uint64_t* ret_val = NULL;
+
+    *p_failed = 0;
+
+    if( p_cfg->wd_tags != NULL ) {
+        ret_val = match_tags( p_list, p_cfg->wd_tags );
+        *p_failed = ( ret_val == NULL );
+    } else if( p_cfg->wd_search != NULL ) {
+        const size_t words = TAG_WORDS( p_list->dir_count );
+
+        ret_val = (uint64_t*)malloc(( words + 1U ) * sizeof( uint64_t ));
+        if( ret_val != NULL ) {
+            memset( ret_val, 0xff, ( words + 1U ) * sizeof( uint64_t ));
+        }
+        *p_failed = ( ret_val == NULL );
+    }
+
+    if(( ret_val != NULL ) && ( p_cfg->wd_search != NULL ) &&
+       !WD_SUCCEEDED( match_search( p_list, p_cfg->wd_search, ret_val ))) {
+        free( ret_val );
+        ret_val = NULL;
+        *p_failed = 1;
+    }
+
+    return( ret_val );
+}
+
+/** As add_dir(), but an entity type of WD_ENTITY_UNKNOWN is only resolved
+    (by examining the filesystem) if p_resolve is non-zero */
+static int add_entry( dir_list_t p_list,
+                      const char* const p_dir,
+                      const char* const p_name,
+                      const time_t      p_t_added,
+                      const time_t      p_t_accessed,
+                      const wd_entity_t p_type,
+                      const int         p_resolve )
+{
+    /* TODO: Check that item is of type p_list->cfg->wd_entity_type? */
+    int ret_val = WD_GENERIC_FAIL;
+    const size_t idx = p_list->dir_count;
+
+    if( idx == p_list->dir_size )
+    {
+        DEBUG_OUT("list does not have space, increasing allocation"); 
+        increase_dir_alloc( p_list );
+        DEBUG_OUT("increased allocation"); 
+    }
+
+    DEBUG_OUT("Adding dir entry " PFFST,idx);
+
+    /* Check to see if there's space now - it's possible that an attempt to
+       increase the allocation (above) actually failed */
+    if( idx < p_list->dir_size )
+    {
+        const size_t pool_mark = p_list->pool_used;
+        const uint32_t dir_off = pool_add( p_list, p_dir );
+
+        DEBUG_OUT("Destination length: " PFFST,strlen( p_dir ));
+        if( dir_off != NO_STRING ) {
+            p_list->dir_off[ idx ] = dir_off;
+
+            if( p_name != NULL )
+            {
+                DEBUG_OUT("Name length: " PFFST,strlen( p_name ));
+                p_list->name_off[ idx ] = pool_add( p_list, p_name );
+                if( p_list->name_off[ idx ] != NO_STRING ) {
+                    ret_val = WD_SUCCESS;
+                } else {
+                    fprintf(stderr,"MALLOC FAILED\n");
+                    p_list->pool_used = pool_mark;
+                }
+            } else {
+                p_list->name_off[ idx ] = NO_STRING;
+                ret_val = WD_SUCCESS;
+            }
+
+            if( WD_SUCCEEDED( ret_val )) {
+                fit_times( p_list, p_t_added, p_t_accessed );
+                p_list->time_added[ idx ] = encode_time( p_list, p_t_added );
+                p_list->time_accessed[ idx ] = encode_time( p_list, p_t_accessed );
+                p_list->hits[ idx ] = 0;
+                if(( p_type == WD_ENTITY_UNKNOWN ) && p_resolve ) {
+                    p_list->type[ idx ] = (uint8_t)get_type( p_dir );
+                } else {
+                    p_list->type[ idx ] = (uint8_t)p_type;
+                }
+
+                p_list->dir_count++;
+            }
+        }
+        else
+        {
+            fprintf(stderr,"MALLOC FAILED\n");
+        }
+    }
+    else
+    {
+        fprintf(stderr,"DIRLIST not big enough\n");
+    }
+
+    return( ret_val );
+}
+
+int add_dir( dir_list_t p_list,
+             const char* const p_dir,
+             const char* const p_name,
+             const time_t      p_t_added,
+             const time_t      p_t_accessed,
+             const wd_entity_t p_type )
+{
+    const int ret_val = add_entry( p_list, p_dir, p_name, p_t_added,
+                                   p_t_accessed, p_type, 1 );
+    size_t removed;
+
+    /* The path is no longer removed */
+    if( WD_SUCCEEDED( ret_val ) && ( p_list->removed != NULL ) &&
+        find_dir_location( p_list->removed, p_dir, &removed )) {
+        remove_from_list( p_list->removed, removed );
+    }
+
+    return( ret_val );
+}
+
+int dir_list_add_removed( dir_list_t p_list, const char* const p_dir,
+                          const time_t p_t_removed )
+{
+    int ret_val = WD_GENERIC_FAIL;
+
+    if( WD_SUCCEEDED( dir_list_record_removals( p_list ))) {
+        ret_val = add_entry( p_list->removed, p_dir, NULL, -1, p_t_removed,
+                             WD_ENTITY_UNKNOWN, 0 );
+    }
+
+    return( ret_val );
+}
+
+int dir_list_record_removals( dir_list_t p_list )
+{
+    if( p_list->removed == NULL ) {
+        p_list->removed = new_dir_list();
+    }
+
+    return(( p_list->removed != NULL ) ? WD_SUCCESS : WD_GENERIC_FAIL );
+}
+
+dir_list_t dir_list_get_removed( const dir_list_t p_list )
+{
+    return( p_list->removed );
+}
+
+void dir_list_swap( dir_list_t p_a, dir_list_t p_b )
+{
+    struct dir_list_s tmp = *p_a;
+
+    *p_a = *p_b;
+    *p_b = tmp;
+    /* Each keeps its own configuration */
+    p_b->cfg = p_a->cfg;
+    p_a->cfg = tmp.cfg;
+}
+
+dir_list_t new_dir_list( void )
+{
+    dir_list_t ret_val = (dir_list_t)malloc( sizeof( struct dir_list_s ) );
+
+    TIMINGS_COUNT( WD_COUNTER_ALLOCS, 1U );
+    if( ret_val != NULL ) {
+        memset( ret_val, 0, sizeof( *ret_val ));
+        ret_val->cfg = NULL;
+
+        /* Allocate some initial memory for the directory list - this saves us
+           having to deal with the columns being NULL in the general case */
+        increase_dir_alloc( ret_val );
+    }
+
+    return( ret_val );
+}
+
+static void free_tags( dir_list_t p_list )
+{
+    size_t loop;
+
+    for( loop = 0; loop < p_list->tag_count; loop++ ) {
+        free( p_list->tag_name[ loop ] );
+        free( p_list->tag_bits[ loop ] );
+    }
+    free( p_list->tag_name );
+    free( p_list->tag_bits );
+}
+
+void free_dir_list( dir_list_t p_list )
+{
+    if( p_list != NULL ) {
+        free( p_list->type );
+        free( p_list->dir_off );
+        free( p_list->name_off );
+        free( p_list->time_added );
+        free( p_list->time_accessed );
+        free( p_list->hits );
+        free( p_list->pool );
+        free_tags( p_list );
+        free_dir_list( p_list->removed );
+        free( p_list );
+    }
+}
+
+void dir_list_set_config( dir_list_t p_list, const config_container_t* const p_config )
+{
+    p_list->cfg = p_config;
+}
+
+/** Days in the year preceding the first of each month (in a non-leap
+    year) */
+static const int days_before_month[] = {
+    0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+};
+
+static time_t sscan_time( const char* const p_str )
+{
+    time_t ret_val;
+    struct tm tm;
+    tm.tm_isdst = -1;
+    tm.tm_yday = -1;
+    tm.tm_wday = -1;
+    sscanf(p_str, TIME_SSCAN_STRING,
+                  &tm.tm_year,
+                  &tm.tm_mon,
+                  &tm.tm_mday,
+                  &tm.tm_hour,
+                  &tm.tm_min,
+                  &tm.tm_sec);
+
+    /* tm's year is baselined at 1900 */
+    tm.tm_year -= 1900;
+    /* tm's month is the count of months since Jan */
+    tm.tm_mon -= 1;
+
+    /* Day of the year.  Calculated directly rather than using mktime(), which
+       would treat tm as local time (shifting times which fall in a daylight
+       saving gap) and serialises concurrent loads on the time zone lock */
+    if(( tm.tm_mon >= 0 ) && ( tm.tm_mon < 12 )) {
+        const int year = tm.tm_year + 1900;
+        const int leap = (( year % 4 ) == 0 ) &&
+                         ((( year % 100 ) != 0 ) || (( year % 400 ) == 0 ));
+        tm.tm_yday = days_before_month[ tm.tm_mon ] + tm.tm_mday - 1 +
+                     (( leap && ( tm.tm_mon > 1 )) ? 1 : 0 );
+    } else {
+        mktime( &tm );
+    }
+
+    /* The time in the file is already UTC, so using
+       mktime is the wrong thing to do, as this assumes that
+       the contents of tm is in local time
+       see http://pubs.opengroup.org/onlinepubs/007904975/basedefs/xbd_chap04.html#tag_04_14 */
+    ret_val = tm.tm_sec +
+              tm.tm_min*60 +
+              tm.tm_hour*3600 +
+              tm.tm_yday*86400 +
+              (tm.tm_year-70)*31536000 +
+              ((tm.tm_year-69)/4)*86400 -
+              ((tm.tm_year-1)/100)*86400 +
+              ((tm.tm_year+299)/400)*86400;
+
+    return ret_val;
+}
+
+dir_list_t load_dir_list( const config_container_t* const p_config, const char* const p_fn )
+{
+    dir_list_t ret_val = NULL;
+#if defined WIN32
+    if( 0 == strcmp( p_fn, USE_FAVOURITES_FILE_STR )) {
+        ret_val = load_dir_list_from_favourites( p_config, p_fn );
+    } else {
+#endif
+        ret_val = load_dir_list_from_file( p_config, p_fn );
+#if defined WIN32
+    }
+#endif
+    return ret_val;
+}
+
+#if defined WIN32
+#include "shrtcut.h"
+#include <shlobj.h>
+#include <dirent.h>
+static dir_list_t load_dir_list_from_favourites( const config_container_t* const p_config, const char* const p_fn )
+{
+    dir_list_t ret_val = NULL;
+    TCHAR path[MAX_PATH];
+    HRESULT hr = SHGetFolderPath(0, CSIDL_FAVORITES, 0, 0, path);
+ 
+    if (WD_SUCCEEDED(hr)) {
+        DIR* FD;
+        DEBUG_OUT("got favourites drectory: %s", path);
+        /* TODO: recurse sub-directories */
+
+        CoInitialize( NULL );
+
+        if (NULL != (FD = opendir (path))) 
+        {
+            struct dirent* in_file;
+            DEBUG_OUT("opened favourites drectory: %s", path);
+            ret_val = new_dir_list();
+            ret_val->cfg = p_config;
+            while ((in_file = readdir(FD))) 
+            {
+                if((0 != strcmp (in_file->d_name, ".")) &&
+                   (0 != strcmp (in_file->d_name, "..")))
+                {
+                    size_t len = strlen( in_file->d_name );
+                    if(( len > 4 ) &&
+                       ( 0 == stricmp( &(in_file->d_name[len-4]), ".lnk" ))) {
+                        char shortcut_full[ MAXPATHLEN ];
+                        char dest_path[ MAXPATHLEN ];
+                        char name[ MAXPATHLEN ];
+                        time_t added;
+                        time_t accessed;
+                        wd_entity_t ent_type;
+                        struct stat s;
+                        int err;
+
+                        DEBUG_OUT("found file: %s",in_file->d_name);
+
+                        /* TODO */
+                        dest_path[0] = 0;
+                        accessed = -1;
+                        added = -1;
+                        ent_type = WD_ENTITY_UNKNOWN;
+
+
+                        strcpy( shortcut_full, path );
+                        strcat( shortcut_full, "\\" );
+                        strcat( shortcut_full, in_file->d_name );
+
+                        err = stat( shortcut_full, &s);
+                        if( err == -1 ) {
+                            /* TODO */
+                        } else {
+                            /* TODO: Are these really the appropriate attributes
+                               to use? */
+                            added = s.st_ctime;
+                            accessed = s.st_atime;
+                            ResolveIt( NULL, shortcut_full, dest_path,
+                                    MAXPATHLEN );
+                        }
+
+                        strncpy( name, in_file->d_name, len-4 );
+                        name[len-4] = 0;
+
+
+ 
+                        add_dir( ret_val, dest_path, name, added, accessed,
+                                 ent_type );
+
+                        DEBUG_OUT("created new bookmark");
+                    }
+                }
+            }
+        }
+        
+        CoUninitialize();
+    }
+    return ret_val;
+}
+#endif
+
+/** Attributes of the bookmark being read from a list file */
+struct load_state
+{
+    dir_list_t    list;
+    char          path[ MAXPATHLEN ];
+    char          name[ MAXPATHLEN ];
+    /** Tags of the bookmark, separated by TAG_SEPARATOR */
+    char          tags[ MAXPATHLEN ];
+    time_t        added;
+    time_t        accessed;
+    unsigned long hits;
+    wd_entity_t   ent_type;
+    /** Whether or not entities of unknown type should be examined as they're
+        loaded */
+    int           resolve_types;
+    /** Set if a bookmark couldn't be added, for want of memory */
+    int           failed;
+    /** Path of a removal which has been read, but may yet be continued */
+    char          removed[ MAXPATHLEN ];
+    time_t        removed_time;
+    /** Field which a following continuation line ('+') adds to, if any */
+    char*         cont;
+};
+
+/** Count p_ns spent reading & parsing, less any time spent in stat() since
+    p_stat_mark (the WD_COUNTER_STAT_NS counter when parsing started) while
+    resolving entity types, so that the two aren't counted twice */
+static void count_parse( const uint64_t p_ns, const uint64_t p_stat_mark )
+{
+    const uint64_t stat_ns = timings_counter( WD_COUNTER_STAT_NS ) - p_stat_mark;
+
+    timings_add( WD_COUNTER_PARSE_NS, ( p_ns > stat_ns ) ? ( p_ns - stat_ns ) : 0U );
+}
+
+static void load_reset( struct load_state* const p_state )
+{
+    p_state->path[0] = 0;
+    p_state->name[0] = 0;
+    p_state->tags[0] = 0;
+    p_state->added = -1;
+    p_state->accessed = -1;
+    p_state->hits = 0;
+    p_state->ent_type = WD_ENTITY_UNKNOWN;
+    p_state->removed[0] = 0;
+    p_state->cont = NULL;
+}
+
+/** Record the removal which has been read, now that it's complete */
+static void load_removal( struct load_state* const p_state )
+{
+    if( p_state->removed[0] != '\0' ) {
+        DEBUG_OUT("recording removal: %s",p_state->removed);
+        (void)dir_list_add_removed( p_state->list, p_state->removed,
+                                    p_state->removed_time );
+        p_state->removed[0] = 0;
+    }
+}
+
+/** Process a line read from a list file.  A line consisting of just ':'
+    completes the final bookmark.
+
+    Paths & names containing newlines are continued on the following lines,
+    each of which starts with '+'. */
+static void load_line( struct load_state* const p_state, char* const read )
+{
+    DEBUG_OUT("read from file: %s",read);
+
+    if( 0 == strncmp( read, FILE_HEADER_REMOVALS_STRING,
+                      sizeof( FILE_HEADER_REMOVALS_STRING ) - 1U )) {
+        (void)dir_list_record_removals( p_state->list );
+    }
+    /* Check that it wasn't a comment line */
+    else if( read[0] != '#' ) {
+        size_t len = strlen( read );
+
+        DEBUG_OUT("Content length: " PFFST,len);
+
+        /* Trim off line endings */
+        size_t trimmer;
+        for( trimmer = len - 1;
+             trimmer > 0;
+             trimmer-- ) {
+            if(( read[ trimmer ] == '\r' ) ||
+               ( read[ trimmer ] == '\n' )) {
+                read[ trimmer ] = 0;
+            } else {
+                break;
+            }
+        }
+
+        if( read[0] != '+' ) {
+            load_removal( p_state );
+            p_state->cont = NULL;
+        }
+
+        if( read[0] == '+' ) {
+            /* Continues the preceding path or name after a newline */
+            if(( p_state->cont != NULL ) &&
+               ( strlen( p_state->cont ) + strlen( read ) < MAXPATHLEN )) {
+                strcat( p_state->cont, "\n" );
+                strcat( p_state->cont, &(read[1]) );
+            } else {
+                fprintf(stderr,
+                        "Unrecognised content in bookmarks file: %s\n",
+                        read);
+            }
+        }
+        /* Is this the start of a new bookmark? */
+        else if( read[0] == ':' ) {
+            /* Already read some bookmark details? */
+            if ( p_state->path[0] != '\0' ) {
+
+                DEBUG_OUT("creating new bookmark: %s",p_state->path);
+
+                /* Create the new bookmark */
+                if( WD_SUCCEEDED( add_entry( p_state->list, p_state->path,
+                                             p_state->name,
+                                             p_state->added, p_state->accessed,
+                                             p_state->ent_type,
+                                             p_state->resolve_types ))) {
+                    TIMINGS_COUNT( WD_COUNTER_RECORDS, 1U );
+                    if( p_state->hits != 0 ) {
+                        dir_list_set_hits( p_state->list,
+                                           p_state->list->dir_count - 1U,
+                                           p_state->hits );
+                    }
+                    if(( p_state->tags[0] != '\0' ) &&
+                       !WD_SUCCEEDED( dir_list_set_tags( p_state->list,
+                                                         p_state->list->dir_count - 1U,
+                                                         p_state->tags ))) {
+                        p_state->failed = 1;
+                    }
+                } else {
+                    p_state->failed = 1;
+                }
+
+                DEBUG_OUT("created new bookmark");
+
+                /* Reset attributes */
+                load_reset( p_state );
+            }
+            strcpy( p_state->path, &(read[1]) );
+            p_state->cont = p_state->path;
+        } else if(( read[0] == 'N' ) &&
+                  ( read[1] == ':' )) {
+            strcpy( p_state->name, &(read[2]) );
+            p_state->cont = p_state->name;
+        } else if(( read[0] == 'A' ) &&
+                  ( read[1] == ':' )) {
+            p_state->added = sscan_time(&(read[2]));
+        } else if(( read[0] == 'C' ) &&
+                  ( read[1] == ':' )) {
+            p_state->accessed = sscan_time(&(read[2]));
+        } else if(( read[0] == 'H' ) &&
+                  ( read[1] == ':' )) {
+            p_state->hits = strtoul( &(read[2]), NULL, 10 );
+        } else if(( read[0] == 'G' ) &&
+                  ( read[1] == ':' )) {
+            strcpy( p_state->tags, &(read[2]) );
+        } else if(( read[0] == 'X' ) &&
+                  ( read[1] == ':' )) {
+            /* A record of a removal: X:<time><TAB><path> */
+            const char* const path = strchr( &(read[2]), '\t' );
+
+            if( path != NULL ) {
+                strcpy( p_state->removed, path + 1 );
+                p_state->removed_time = sscan_time(&(read[2]));
+                p_state->cont = p_state->removed;
+            }
+        } else if(( read[0] == 'T' ) &&
+                  ( read[1] == ':' )) {
+            switch(read[2]) {
+                case 'D':
+                    p_state->ent_type = WD_ENTITY_DIR;
+                    break;
+                case 'F':
+                    p_state->ent_type = WD_ENTITY_FILE;
+                    break;
+                default:
+                    p_state->ent_type = WD_ENTITY_UNKNOWN;
+                    break;
+            }
+        } else {
+            fprintf(stderr,
+                    "Unrecognised content in bookmarks file: %s\n",
+                    read);
+        }
+    }
+}
+
+#if !defined WIN32
+
+/** Lists smaller than this are always loaded serially, as starting threads
+    would cost more than it saves */
+#define PARALLEL_LOAD_MIN_SIZE ( 1024U * 1024U )
+/** Minimum amount of the file which is worth giving to a thread */
+#define PARALLEL_LOAD_CHUNK_SIZE ( 256U * 1024U )
+#define MAX_LOAD_THREADS 16U
+
+/** Part of a list file, starting at the beginning of a bookmark */
+struct load_chunk
+{
+    const char*               start;
+    const char*               end;
+    const config_container_t* cfg;
+    /** Bookmarks read from the chunk */
+    dir_list_t                list;
+    /** Time taken to parse the chunk, if timings are being collected */
+    uint64_t                  parse_ns;
+    pthread_t                 thread;
+};
+
+/** \returns Offset of the first bookmark at or after p_pos, or p_size if
+             there is none */
+static size_t next_record( const char* const p_data, const size_t p_size,
+                           size_t p_pos )
+{
+    while(( p_pos < p_size ) &&
+          !((( p_pos == 0 ) || ( p_data[ p_pos - 1U ] == '\n' )) &&
+            ( p_data[ p_pos ] == ':' ))) {
+        const char* const nl = (const char*)memchr( p_data + p_pos, '\n',
+                                                    p_size - p_pos );
+        p_pos = ( nl == NULL ) ? p_size : (size_t)( nl - p_data ) + 1U;
+    }
+
+    return( p_pos );
+}
+
+/** Parse a chunk of the list file into a list of its own */
+static void* load_chunk( void* p_arg )
+{
+    struct load_chunk* const chunk = (struct load_chunk*)p_arg;
+    TIMINGS_MARK( mark );
+    struct load_state* const state =
+        (struct load_state*)malloc( sizeof( struct load_state ));
+    dir_list_t list = new_dir_list();
+
+    if(( list != NULL ) && ( state != NULL )) {
+        const size_t size = (size_t)( chunk->end - chunk->start );
+        char read[ MAXPATHLEN ];
+        char last[] = ":";
+        size_t records = 0;
+        size_t pos;
+
+        list->cfg = chunk->cfg;
+
+        /* Make room for all of the chunk's bookmarks up-front */
+        for( pos = 0; ( pos = next_record( chunk->start, size, pos )) < size; pos++ ) {
+            records++;
+        }
+        (void)resize_dirs( list, records );
+
+        state->list = list;
+        state->resolve_types = 1;
+        load_reset( state );
+
+        for( pos = 0; pos < size; ) {
+            /* Lines are split as fgets() would for the serial loader */
+            const size_t max = (( size - pos ) < ( MAXPATHLEN - 1U )) ?
+                                   ( size - pos ) : ( MAXPATHLEN - 1U );
+            const char* const nl = (const char*)memchr( chunk->start + pos, '\n', max );
+            const size_t len = ( nl == NULL ) ? max :
+                                   (size_t)( nl - ( chunk->start + pos )) + 1U;
+
+            memcpy( read, chunk->start + pos, len );
+            read[ len ] = '\0';
+            pos += len;
+            load_line( state, read );
+        }
+        load_line( state, last );
+    } else {
+        free_dir_list( list );
+        list = NULL;
+    }
+
+    free( state );
+    chunk->list = list;
+    chunk->parse_ns = wd_timings_on ? ( timings_now() - mark ) : 0U;
+
+    return( NULL );
+}
+
+/** Give the entries of p_dest from p_base onwards the tags of the
+    corresponding entries of p_src */
+static int append_tags( dir_list_t p_dest, const dir_list_t p_src,
+                        const size_t p_base )
+{
+    int ret_val = WD_SUCCESS;
+    size_t tag;
+
+    for( tag = 0; WD_SUCCEEDED( ret_val ) && ( tag < p_src->tag_count ); tag++ ) {
+        const char* const name = p_src->tag_name[ tag ];
+        const size_t idx = get_tag( p_dest, name, strlen( name ));
+        size_t loop;
+
+        if( idx == p_dest->tag_count ) {
+            ret_val = WD_GENERIC_FAIL;
+        } else {
+            for( loop = 0; loop < p_src->dir_count; loop++ ) {
+                if( TAG_BIT( p_src->tag_bits[ tag ], loop )) {
+                    const size_t entry = p_base + loop;
+                    p_dest->tag_bits[ idx ][ entry / 64U ] |= UINT64_C( 1 ) << ( entry % 64U );
+                }
+            }
+        }
+    }
+
+    return( ret_val );
+}
+
+/** Append the bookmarks of p_src to p_dest */
+static int append_list( dir_list_t p_dest, const dir_list_t p_src )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    const size_t count = p_dest->dir_count;
+    const size_t pool_base = p_dest->pool_used;
+
+    if(( pool_base + p_src->pool_used <= NO_STRING ) &&
+       WD_SUCCEEDED( resize_dirs( p_dest, count + p_src->dir_count ))) {
+        char* new_pool = p_dest->pool;
+
+        if( pool_base + p_src->pool_used > p_dest->pool_size ) {
+            new_pool = (char*)realloc( p_dest->pool, pool_base + p_src->pool_used );
+            TIMINGS_COUNT( WD_COUNTER_ALLOCS, 1U );
+            if( new_pool != NULL ) {
+                p_dest->pool = new_pool;
+                p_dest->pool_size = pool_base + p_src->pool_used;
+            }
+        }
+
+        if( new_pool != NULL ) {
+            time_t min = -1;
+            time_t max = -1;
+            size_t loop;
+
+            /* Ensure that all of the timestamps can be represented */
+            for( loop = 0; loop < ( p_src->dir_count * 2U ); loop++ ) {
+                const time_t t = decode_time( p_src, ( loop & 1U ) ?
+                                              p_src->time_accessed[ loop / 2U ] :
+                                              p_src->time_added[ loop / 2U ] );
+                if( t != -1 ) {
+                    if(( min == -1 ) || ( t < min )) { min = t; }
+                    if(( max == -1 ) || ( t > max )) { max = t; }
+                }
+            }
+            fit_times( p_dest, min, max );
+
+            memcpy( p_dest->pool + pool_base, p_src->pool, p_src->pool_used );
+            memcpy( p_dest->type + count, p_src->type, p_src->dir_count * sizeof( uint8_t ));
+            memcpy( p_dest->hits + count, p_src->hits, p_src->dir_count * sizeof( uint32_t ));
+
+            for( loop = 0; loop < p_src->dir_count; loop++ ) {
+                p_dest->dir_off[ count + loop ] = p_src->dir_off[ loop ] + (uint32_t)pool_base;
+                p_dest->name_off[ count + loop ] = ( p_src->name_off[ loop ] == NO_STRING ) ?
+                    NO_STRING : ( p_src->name_off[ loop ] + (uint32_t)pool_base );
+                p_dest->time_added[ count + loop ] =
+                    encode_time( p_dest, decode_time( p_src, p_src->time_added[ loop ] ));
+                p_dest->time_accessed[ count + loop ] =
+                    encode_time( p_dest, decode_time( p_src, p_src->time_accessed[ loop ] ));
+            }
+
+            p_dest->pool_used += p_src->pool_used;
+            p_dest->pool_unused += p_src->pool_unused;
+            p_dest->dir_count += p_src->dir_count;
+            ret_val = append_tags( p_dest, p_src, count );
+        }
+    }
+
+    if( WD_SUCCEEDED( ret_val ) && ( p_src->removed != NULL )) {
+        if( p_dest->removed == NULL ) {
+            p_dest->removed = new_dir_list();
+        }
+        ret_val = ( p_dest->removed != NULL ) ?
+                      append_list( p_dest->removed, p_src->removed ) : WD_GENERIC_FAIL;
+    }
+
+    return( ret_val );
+}
+
+/** Load a large list file by splitting it at bookmark boundaries & parsing
+    the pieces on separate threads
+
+    \param[out] p_list The list loaded
+    \returns WD_SUCCESS if the file was loaded, or WD_GENERIC_FAIL if it
+             should be loaded serially instead */
+static int load_dir_list_parallel( const config_container_t* const p_config,
+                                   const char* const p_fn,
+                                   dir_list_t* const p_list )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    const long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+    struct stat s;
+    int fd;
+
+    if(( cpus > 1 ) &&
+       ( stat( p_fn, &s ) == 0 ) && S_ISREG( s.st_mode ) &&
+       ( s.st_size >= (off_t)PARALLEL_LOAD_MIN_SIZE ) &&
+       (( fd = open( p_fn, O_RDONLY )) >= 0 )) {
+        const size_t size = (size_t)s.st_size;
+        const char* const data = (const char*)mmap( NULL, size, PROT_READ,
+                                                    MAP_PRIVATE, fd, 0 );
+        size_t threads = size / PARALLEL_LOAD_CHUNK_SIZE;
+
+        if( threads > (size_t)cpus ) {
+            threads = (size_t)cpus;
+        }
+        if( threads > MAX_LOAD_THREADS ) {
+            threads = MAX_LOAD_THREADS;
+        }
+
+        if( data != MAP_FAILED ) {
+            struct load_chunk chunks[ MAX_LOAD_THREADS ];
+            const uint64_t stat_mark = wd_timings_on ?
+                timings_counter( WD_COUNTER_STAT_NS ) : 0U;
+            uint64_t parse_ns = 0;
+            size_t started;
+            size_t loop;
+            size_t pos = 0;
+
+            DEBUG_OUT("loading " PFFST " bytes using " PFFST " threads", size, threads);
+            TIMINGS_COUNT( WD_COUNTER_READ, size );
+
+            for( loop = 0; loop < threads; loop++ ) {
+                chunks[ loop ].start = data + pos;
+                pos = ( loop == ( threads - 1U )) ? size :
+                      next_record( data, size, ( size / threads ) * ( loop + 1U ));
+                chunks[ loop ].end = data + pos;
+                chunks[ loop ].cfg = p_config;
+                chunks[ loop ].list = NULL;
+            }
+
+            /* This thread parses the first chunk */
+            for( started = 1; started < threads; started++ ) {
+                if( pthread_create( &( chunks[ started ].thread ), NULL,
+                                    load_chunk, &( chunks[ started ] )) != 0 ) {
+                    break;
+                }
+            }
+            (void)load_chunk( &( chunks[ 0 ] ));
+            for( loop = 1; loop < threads; loop++ ) {
+                if( loop < started ) {
+                    pthread_join( chunks[ loop ].thread, NULL );
+                } else {
+                    (void)load_chunk( &( chunks[ loop ] ));
+                }
+            }
+
+            /* Parse time is the sum across the threads, as is stat time */
+            if( wd_timings_on ) {
+                for( loop = 0; loop < threads; loop++ ) {
+                    parse_ns += chunks[ loop ].parse_ns;
+                }
+                count_parse( parse_ns, stat_mark );
+            }
+
+            /* Concatenate in file order */
+            ret_val = ( chunks[ 0 ].list != NULL ) ? WD_SUCCESS : WD_GENERIC_FAIL;
+            for( loop = 1; loop < threads; loop++ ) {
+                if( WD_SUCCEEDED( ret_val ) && ( chunks[ loop ].list != NULL )) {
+                    ret_val = append_list( chunks[ 0 ].list, chunks[ loop ].list );
+                } else {
+                    ret_val = WD_GENERIC_FAIL;
+                }
+                free_dir_list( chunks[ loop ].list );
+            }
+
+            if( WD_SUCCEEDED( ret_val )) {
+                /* Allocation as it would be had the list been loaded
+                   serially */
+                *p_list = chunks[ 0 ].list;
+                (void)resize_dirs( *p_list, 0 );
+            } else {
+                free_dir_list( chunks[ 0 ].list );
+            }
+
+            munmap( (void*)data, size );
+        }
+        close( fd );
+    }
+
+    return( ret_val );
+}
+
+#endif
+
+static dir_list_t load_dir_list_from_file( const config_container_t* const p_config, const char* const p_fn )
+{
+    FILE* file;
+    dir_list_t ret_val = NULL;
+
+#if !defined WIN32
+    if( WD_SUCCEEDED( load_dir_list_parallel( p_config, p_fn, &ret_val ))) {
+        return( ret_val );
+    }
+#endif
+
+    file = fopen( p_fn, "rt" );
+
+    if( file != NULL ) {
+        DEBUG_OUT("opened bookmark file");
         ret_val = new_dir_list();
-        ret_val->cfg = p_config;
 
-        if( ret_val != NULL ) {
-            char path[ MAXPATHLEN ];
-            char read[ MAXPATHLEN ];
-            char name[ MAXPATHLEN ];
-            time_t added;
-            time_t accessed;
-            char* fstr;
-            int one_last_go = 1;
-            wd_entity_t ent_type;
-
-            path[0] = 0;
-            name[0] = 0;
-            added = -1;
-            accessed = -1;
-            ent_type = WD_ENTITY_UNKNOWN;
-            DEBUG_OUT("generated empty bookmark list");
-
-            while(( fstr = fgets( read, MAXPATHLEN, file ) ) ||
-                  one_last_go ) {
-                DEBUG_OUT("read from file: %s",read);
-                /* Didn't get anything from the file?  Set the read string to
-                   indicate that it's a new bookmark so that we flush out
-                   any previous bookmark data and flag that we don't need to go
-                   round again ( one_last_go ) */
-                if( fstr == NULL ) {
-                    read[0] = ':';
-                    read[1] = 0;
-                    one_last_go = 0;
-                }
+        if( ret_val != NULL ) {
+            struct load_state* const state =
+                (struct load_state*)malloc( sizeof( struct load_state ));
+            char read[ MAXPATHLEN ];
+
+            ret_val->cfg = p_config;
+
+            if( state != NULL ) {
+                TIMINGS_MARK( mark );
+                const uint64_t stat_mark = wd_timings_on ?
+                    timings_counter( WD_COUNTER_STAT_NS ) : 0U;
+
+                state->list = ret_val;
+                state->resolve_types = 1;
+                load_reset( state );
+                DEBUG_OUT("generated empty bookmark list");
+
+                while( fgets( read, MAXPATHLEN, file ) != NULL ) {
+                    TIMINGS_COUNT( WD_COUNTER_READ, strlen( read ));
+                    load_line( state, read );
+                }
+                /* Flush out the final bookmark */
+                read[0] = ':';
+                read[1] = 0;
+                load_line( state, read );
+
+                if( wd_timings_on ) {
+                    count_parse( timings_now() - mark, stat_mark );
+                }
+
+                free( state );
+            }
+        }
+        fclose( file );
+    }
+
+    return( ret_val );
+}
+
+int bookmark_in_list( dir_list_t p_list, const char* const p_name )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    size_t idx;
+
+    if( dir_list_find_name( p_list, p_name, &idx )) {
+        ret_val = 1;
+    }
+
+    return( ret_val );
+}
+
+/** Duplicate a column of p_count elements
+
+    \returns Copy, or NULL on failure */
+static void* copy_column( const void* const p_col, const size_t p_elem_size,
+                          const size_t p_count )
+{
+    void* ret_val = malloc( p_elem_size * p_count );
+
+    TIMINGS_COUNT( WD_COUNTER_ALLOCS, 1U );
+    if( ret_val != NULL ) {
+        memcpy( ret_val, p_col, p_elem_size * p_count );
+    }
+
+    return( ret_val );
+}
+
+dir_list_t copy_dir_list( const dir_list_t p_list )
+{
+    dir_list_t ret_val = (dir_list_t)malloc( sizeof( struct dir_list_s ) );
+
+    TIMINGS_COUNT( WD_COUNTER_ALLOCS, 1U );
+    if( ret_val != NULL ) {
+        const size_t size = p_list->dir_size;
+
+        *ret_val = *p_list;
+        ret_val->type = (uint8_t*)copy_column( p_list->type, sizeof( uint8_t ), size );
+        ret_val->dir_off = (uint32_t*)copy_column( p_list->dir_off, sizeof( uint32_t ), size );
+        ret_val->name_off = (uint32_t*)copy_column( p_list->name_off, sizeof( uint32_t ), size );
+        ret_val->time_added = (int32_t*)copy_column( p_list->time_added, sizeof( int32_t ), size );
+        ret_val->time_accessed = (int32_t*)copy_column( p_list->time_accessed, sizeof( int32_t ), size );
+        ret_val->hits = (uint32_t*)copy_column( p_list->hits, sizeof( uint32_t ), size );
+        ret_val->pool = (char*)copy_column( p_list->pool, 1U, p_list->pool_size );
+        ret_val->removed = ( p_list->removed != NULL ) ?
+                               copy_dir_list( p_list->removed ) : NULL;
+        ret_val->tag_name = NULL;
+        ret_val->tag_bits = NULL;
+        ret_val->tag_count = 0;
+
+        if(( ret_val->type == NULL ) || ( ret_val->dir_off == NULL ) ||
+           ( ret_val->name_off == NULL ) || ( ret_val->time_added == NULL ) ||
+           ( ret_val->time_accessed == NULL ) || ( ret_val->hits == NULL ) ||
+           (( ret_val->pool == NULL ) && ( p_list->pool_size != 0 )) ||
+           (( ret_val->removed == NULL ) && ( p_list->removed != NULL )) ||
+           !WD_SUCCEEDED( append_tags( ret_val, p_list, 0 ))) {
+            free_dir_list( ret_val );
+            ret_val = NULL;
+        }
+    }
+
+    return( ret_val );
+}
+
+static int find_dir_location( dir_list_t p_list, const char* const p_dir, size_t* p_loc )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    size_t dir_loop;
+
+    for( dir_loop = 0; dir_loop < p_list->dir_count; dir_loop++ )
+    {
+        if( 0 == strcmp( p_dir, item_dir( p_list, dir_loop ))) {
+            ret_val = 1;
+            if( p_loc != NULL ) {
+                *p_loc = dir_loop;
+            }
+            break;
+        }
+    }
+
+    return( ret_val );
+}
+
+/** Remove element p_idx from a column of p_count elements */
+static void remove_from_column( void* const p_col, const size_t p_elem_size,
+                                const size_t p_idx, const size_t p_count )
+{
+    char* const col = (char*)p_col;
+
+    /* Must use memmove here not memcpy as regions overlap */
+    memmove( col + ( p_idx * p_elem_size ),
+             col + (( p_idx + 1U ) * p_elem_size ),
+             ( p_count - p_idx - 1U ) * p_elem_size );
+}
+
+/** Remove the entry p_idx, without recording its removal */
+static void remove_from_list( dir_list_t p_list, const size_t p_idx )
+{
+    const size_t count = p_list->dir_count;
+
+    p_list->pool_unused += strlen( item_dir( p_list, p_idx )) + 1U;
+    if( item_name( p_list, p_idx ) != NULL ) {
+        p_list->pool_unused += strlen( item_name( p_list, p_idx )) + 1U;
+    }
+
+    remove_from_column( p_list->type, sizeof( uint8_t ), p_idx, count );
+    remove_from_column( p_list->dir_off, sizeof( uint32_t ), p_idx, count );
+    remove_from_column( p_list->name_off, sizeof( uint32_t ), p_idx, count );
+    remove_from_column( p_list->time_added, sizeof( int32_t ), p_idx, count );
+    remove_from_column( p_list->time_accessed, sizeof( int32_t ), p_idx, count );
+    remove_from_column( p_list->hits, sizeof( uint32_t ), p_idx, count );
+    remove_from_tags( p_list, p_idx );
+
+    p_list->dir_count--;
+
+    /* Only worth the effort once most of the pool is unused */
+    if( p_list->pool_unused > ( p_list->pool_used / 2U )) {
+        pool_compact( p_list );
+    }
+}
+
+int remove_dir_by_index( dir_list_t p_list, const size_t p_dir )
+{
+    int ret_val = WD_GENERIC_FAIL;
+
+    if( p_dir < p_list->dir_count ) {
+        const time_t now = ( p_list->cfg != NULL ) ? p_list->cfg->wd_now_time :
+                                                     time( NULL );
+        size_t removed;
+
+        /* Recorded so that the bookmark isn't restored by merging with a
+           copy of the list which still has it */
+        if( p_list->removed == NULL ) {
+            /* Not synchronised, so nothing to record */
+        } else if( find_dir_location( p_list->removed, item_dir( p_list, p_dir ),
+                                      &removed )) {
+            set_time_accessed( p_list->removed, removed, now );
+        } else {
+            (void)dir_list_add_removed( p_list, item_dir( p_list, p_dir ), now );
+        }
+
+        remove_from_list( p_list, p_dir );
+
+        ret_val = WD_SUCCESS;
+    }
+
+    return( ret_val );
+}
+
+int rename_dir( dir_list_t p_list, const size_t p_idx, const char* const p_name )
+{
+    int ret_val = WD_GENERIC_FAIL;
+
+    if( p_idx < p_list->dir_count ) {
+        const char* const old_name = item_name( p_list, p_idx );
+        uint32_t name_off = NO_STRING;
+
+        if(( p_name == NULL ) || ( p_name[0] == '\0' ) ||
+           (( name_off = pool_add( p_list, p_name )) != NO_STRING )) {
+            /* pool_add() may have moved the pool, so the old name is looked
+               up again */
+            if( old_name != NULL ) {
+                p_list->pool_unused += strlen( item_name( p_list, p_idx )) + 1U;
+            }
+            p_list->name_off[ p_idx ] = name_off;
+            ret_val = WD_SUCCESS;
+        }
+    }
+
+    return( ret_val );
+}
+
+int remove_dir( dir_list_t p_list, const char* const p_dir )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    size_t location;
+
+    if( find_dir_location( p_list, p_dir, &location )) {
+        ret_val = remove_dir_by_index( p_list, location );
+    }
+
+    return( ret_val );
+}
+
+int dir_in_list( dir_list_t p_list, const char* const p_dir )
+{
+    return( find_dir_location( p_list, p_dir, NULL ) );
+}
+
+#define CYGDRIVE_PREFIX "/cygdrive/"
+
+/** String length of CYGDRIVE_PREFIX, here as a constant to save repeated strlen
+    calls */
+#define CYGDRIVE_PREFIX_LEN 10U
+
+/** Upper bound on the length of a path after format_dir_to() */
+#define FORMATTED_DIR_MAX( _len ) ((( _len ) + CYGDRIVE_PREFIX_LEN + 2U ) * 3U )
+
+/** Store a character, preceded by escape characters if necessary
+
+    \returns Pointer to the location following the stored character(s) */
+static char* put_escaped( char* p_dest, const char p_char, const int p_escape )
+{
+    if( p_escape && (( p_char == ' ' ) || ( p_char == '\\' ))) {
+        *p_dest = '\\';
+        p_dest++;
+        if( p_escape > 1 ) {
+            *p_dest = '\\';
+            p_dest++;
+        }
+    }
+    *p_dest = p_char;
+    p_dest++;
+
+    return p_dest;
+}
+
+/** Copy p_len characters of p_src into p_dest, which must have room for 3
+    times as many, replacing p_from with p_to and escaping the result.  Runs of
+    characters which need neither are copied in bulk.
+
+    \returns Length of the result */
+static size_t convert_to( char* const p_dest, const char* p_src, size_t p_len,
+                          const char p_from, const char p_to, const int p_escape )
+{
+    char* dest = p_dest;
+
+    if( p_escape == 0 ) {
+        str_copy_replace( dest, p_src, p_len, p_from, p_to );
+        dest += p_len;
+    } else {
+        while( p_len > 0 ) {
+            const size_t span = str_span3( p_src, p_len, ' ', '\\', p_from );
+
+            memcpy( dest, p_src, span );
+            dest += span;
+
+            if( span < p_len ) {
+                dest = put_escaped( dest,
+                                    ( p_src[ span ] == p_from ) ? p_to : p_src[ span ],
+                                    p_escape );
+                p_len -= span + 1U;
+                p_src += span + 1U;
+            } else {
+                p_len = 0;
+            }
+        }
+    }
+
+    return( (size_t)( dest - p_dest ));
+}
+
+/** Escape p_str into p_dest, which must have room for 3 times the length of
+    p_str.  The result is not terminated.
+
+    \returns Length of the result */
+static size_t escape_string_to( char* const p_dest, const int p_escape, const char* p_str )
+{
+    return( convert_to( p_dest, p_str, strlen( p_str ), '\\', '\\', p_escape ));
+}
+
+/** Whether or not format_dir() will leave a path as-is */
+static int format_dir_is_identity( const wd_dir_format_t p_fmt, const int p_escape )
+{
+    return(( p_escape == 0 ) &&
+           ( p_fmt != WD_DIRFORM_CYGWIN ) &&
+           ( p_fmt != WD_DIRFORM_WINDOWS ));
+}
+
+/** Format p_dir into p_dest, which must have room for
+    FORMATTED_DIR_MAX( strlen( p_dir )) characters.  The result is not
+    terminated.
+
+    \returns Length of the result */
+static size_t format_dir_to( char* const p_dest, const wd_dir_format_t p_fmt,
+                             const int p_escape, const char* p_dir )
+{
+    char* dest = p_dest;
+    const char* src = p_dir;
+    size_t loop;
+
+    switch( p_fmt ) {
+        case WD_DIRFORM_CYGWIN:
+            if(((( src[0] >= 'a' ) && (src[0] <= 'z' )) ||
+                (( src[0] >= 'A' ) && (src[0] <= 'Z' ))) &&
+               ( src[1] == ':' ) &&
+               (( src[2] == '\\') ||
+                ( src[2] == '/' )))
+            {
+                for( loop = 0; loop < CYGDRIVE_PREFIX_LEN; loop++ ) {
+                    dest = put_escaped( dest, CYGDRIVE_PREFIX[ loop ], p_escape );
+                }
+                dest = put_escaped( dest, *src, p_escape );
+                src += 2;
+            }
+            dest += convert_to( dest, src, strlen( src ), '\\', '/', p_escape );
+            break;
+        case WD_DIRFORM_WINDOWS:
+            if(( strncmp( src, CYGDRIVE_PREFIX, CYGDRIVE_PREFIX_LEN ) == 0 ) &&
+               ( src[ CYGDRIVE_PREFIX_LEN ] != '\0' ))
+            {
+                src += CYGDRIVE_PREFIX_LEN;
+                dest = put_escaped( dest, *src, p_escape );
+                dest = put_escaped( dest, ':', p_escape );
+                src += 1;
+            }
+            dest += convert_to( dest, src, strlen( src ), '/', '\\', p_escape );
+            break;
+        default:
+            if( p_fmt != WD_DIRFORM_NONE ) {
+                fprintf(stderr,"Unhandled directory format\n");
+            }
+            dest += escape_string_to( dest, p_escape, src );
+            break;
+    }
+
+    return( (size_t)( dest - p_dest ));
+}
+
+char* format_dir( wd_dir_format_t p_fmt, int p_escape, char* const p_dir ) {
+    char* ret_val = p_dir;
+
+    if( !format_dir_is_identity( p_fmt, p_escape )) {
+        ret_val = (char*)malloc( FORMATTED_DIR_MAX( strlen( p_dir )) + 1 );
+        if( ret_val != NULL ) {
+            ret_val[ format_dir_to( ret_val, p_fmt, p_escape, p_dir ) ] = 0;
+        }
+    } else if( p_fmt != WD_DIRFORM_NONE ) {
+        fprintf(stderr,"Unhandled directory format\n");
+    }
+
+    return( ret_val );
+}
+
+/** Append a formatted path to an output buffer */
+static void format_dir_into( out_buf_t* const p_out, const wd_dir_format_t p_fmt,
+                             const int p_escape, const char* const p_dir )
+{
+    const size_t len = strlen( p_dir );
+
+    if( format_dir_is_identity( p_fmt, p_escape ) && ( p_fmt == WD_DIRFORM_NONE )) {
+        out_buf_append( p_out, p_dir, len );
+    } else {
+        char* dest = out_buf_reserve( p_out, FORMATTED_DIR_MAX( len ));
+
+        if( dest != NULL ) {
+            out_buf_commit( p_out, format_dir_to( dest, p_fmt, p_escape, p_dir ));
+        }
+    }
+}
+
+/** Append an escaped string to an output buffer */
+static void escape_string_into( out_buf_t* const p_out, const int p_escape,
+                                const char* const p_str )
+{
+    const size_t len = strlen( p_str );
+
+    if( p_escape == 0 ) {
+        out_buf_append( p_out, p_str, len );
+    } else {
+        char* dest = out_buf_reserve( p_out, len * 3U );
+
+        if( dest != NULL ) {
+            out_buf_commit( p_out, escape_string_to( dest, p_escape, p_str ));
+        }
+    }
+}
+
+/** Escaping to apply to output.  Records which aren't newline terminated are
+    for consumption by programs, so are never escaped */
+static int output_escape( const config_container_t* const p_cfg )
+{
+    return(( p_cfg->wd_record_form == WD_RECORD_LINE ) ?
+           p_cfg->wd_escape_output : 0 );
+}
+
+/** Size of the length field preceding each record in WD_RECORD_LENGTH form */
+#define RECORD_LENGTH_SIZE 4U
+
+/** Value returned by record_start() when there's no length field to fill in */
+#define RECORD_NO_LENGTH ((size_t)-1)
+
+/** Begin an output record of at most p_max_len bytes
+
+    \returns Offset of the record's length field within p_out, or
+             RECORD_NO_LENGTH */
+static size_t record_start( out_buf_t* const p_out,
+                            const config_container_t* const p_cfg,
+                            const size_t p_max_len )
+{
+    size_t ret_val = RECORD_NO_LENGTH;
+
+    /* Room for the whole record is made up-front so that it can't be flushed
+       before the length is known */
+    if(( p_cfg->wd_record_form == WD_RECORD_LENGTH ) &&
+       ( out_buf_reserve( p_out, RECORD_LENGTH_SIZE + p_max_len ) != NULL )) {
+        ret_val = p_out->used;
+        out_buf_commit( p_out, RECORD_LENGTH_SIZE );
+    }
+
+    return( ret_val );
+}
+
+/** Complete an output record started with record_start()
+
+    \param p_line_end Whether or not the record is newline terminated in
+                      WD_RECORD_LINE form */
+static void record_end( out_buf_t* const p_out,
+                        const config_container_t* const p_cfg,
+                        const size_t p_start,
+                        const int p_line_end )
+{
+    switch( p_cfg->wd_record_form ) {
+        case WD_RECORD_NUL:
+            out_buf_putc( p_out, '\0' );
+            break;
+        case WD_RECORD_LENGTH:
+            if( p_start != RECORD_NO_LENGTH ) {
+                const size_t len = p_out->used - p_start - RECORD_LENGTH_SIZE;
+                unsigned char* const hdr = (unsigned char*)( p_out->data + p_start );
+
+                hdr[0] = (unsigned char)( len >> 24 );
+                hdr[1] = (unsigned char)( len >> 16 );
+                hdr[2] = (unsigned char)( len >> 8 );
+                hdr[3] = (unsigned char)( len );
+            }
+            break;
+        default:
+            if( p_line_end ) {
+                out_buf_putc( p_out, '\n' );
+            }
+            break;
+    }
+}
+
+static void dump_dir( const dir_list_t p_list, const size_t p_idx )
+{
+    /* Precondition check */
+    assert( p_list != NULL );
+    assert( p_list->cfg != NULL );
+    assert( p_idx < p_list->dir_count );
+    /* !Precondition check */
+
+    const config_container_t* const cfg = p_list->cfg;
+    const char* const dir = item_dir( p_list, p_idx );
+    out_buf_t out;
+    size_t start;
+
+    out_buf_init( &out, stdout );
+    start = record_start( &out, cfg, FORMATTED_DIR_MAX( strlen( dir )));
+    format_dir_into( &out, cfg->wd_dir_form, output_escape( cfg ), dir );
+    record_end( &out, cfg, start, 0 );
+    out_buf_release( &out );
+
+    if( cfg->wd_store_access ) {
+        set_time_accessed( p_list, p_idx, cfg->wd_now_time );
+    }
+}
+
+int dump_dir_if_exists( const dir_list_t p_list, const char* const p_dir )
+{
+    size_t dir_loop;
+    int found = 0;
+
+    for( dir_loop = 0; dir_loop < p_list->dir_count; dir_loop++ )
+    {
+        /* TODO: Case insensitive on Windows?  Case insensitive switch? */
+        if(( p_list->name_off[ dir_loop ] != NO_STRING ) &&
+           ( 0 == strcmp( p_dir, item_dir( p_list, dir_loop )))) {
+
+            dump_dir( p_list, dir_loop );
+            found = 1;
+            break;
+        }
+    }
+    return( found );
+}
+
+int dump_dir_with_index( const dir_list_t p_list, const unsigned p_idx )
+{
+    int found = 0;
+
+    if( p_idx < p_list->dir_count ) {
+        dump_dir( p_list, p_idx );
+        found = 1;
+    }
+
+    return( found );
+}
+
+int dump_dir_with_name( const dir_list_t p_list, const char* const p_name )
+{
+    size_t idx;
+    int found = 0;
+
+    if( dir_list_find_name( p_list, p_name, &idx )) {
+        dump_dir( p_list, idx );
+        found = 1;
+    }
+
+    return( found );
+}
+
+static wd_entity_t get_type( const char* const p_path )
+{
+    wd_entity_t ret_val = WD_ENTITY_UNKNOWN;
+    struct stat s;
+    TIMINGS_MARK( mark );
+    int err = stat( p_path , &s);
+
+    TIMINGS_STAT( mark );
+
+    if( err == -1 )
+    {
+        if(ENOENT == errno) {
+            ret_val = WD_ENTITY_NONEXISTANT;
+        }
+    } else {
+        if( S_ISDIR(s.st_mode) ) {
+            ret_val = WD_ENTITY_DIR;
+        } else if( S_ISREG( s.st_mode )) {
+            ret_val = WD_ENTITY_FILE;
+        }
+    }
+
+    return ret_val;
+}
+
+/** Number of bytes of each string which are compared via sort keys, before
+    resorting to strcmp() */
+#define SORT_PREFIX_LEN 8U
+
+/** Bits of a timestamp sorted in each pass of radix_sort_times() */
+#define RADIX_BITS 8U
+#define RADIX_SIZE ( 1U << RADIX_BITS )
+
+/** Strings to be compared while sorting */
+struct sort_strings
+{
+    const char*     pool;
+    const uint32_t* off;
+    /** Leading bytes of each string, big-endian, so that comparing prefixes
+        orders strings as strcmp() would as far as the prefixes go */
+    uint64_t*       prefix;
+};
+
+static int compare_strings( const struct sort_strings* const p_str,
+                            const size_t p_a, const size_t p_b )
+{
+    int ret_val;
+
+    if( p_str->prefix[ p_a ] != p_str->prefix[ p_b ] ) {
+        ret_val = ( p_str->prefix[ p_a ] < p_str->prefix[ p_b ] ) ? -1 : 1;
+    } else {
+        ret_val = strcmp( p_str->pool + p_str->off[ p_a ],
+                          p_str->pool + p_str->off[ p_b ] );
+    }
+
+    return( ret_val );
+}
+
+/** Stable merge sort of p_count entry indices by string
+
+    \param p_tmp Scratch space for p_count indices */
+static void sort_by_string( const struct sort_strings* const p_str,
+                            size_t* p_order, size_t* p_tmp,
+                            const size_t p_count )
+{
+    size_t* const result = p_order;
+    size_t width;
+
+    for( width = 1; width < p_count; width *= 2U ) {
+        size_t start;
+
+        for( start = 0; start < p_count; start += 2U * width ) {
+            const size_t mid = (( start + width ) < p_count ) ? ( start + width ) : p_count;
+            const size_t end = (( mid + width ) < p_count ) ? ( mid + width ) : p_count;
+            size_t left = start;
+            size_t right = mid;
+            size_t out = start;
+
+            while(( left < mid ) && ( right < end )) {
+                if( compare_strings( p_str, p_order[ right ], p_order[ left ] ) < 0 ) {
+                    p_tmp[ out++ ] = p_order[ right++ ];
+                } else {
+                    p_tmp[ out++ ] = p_order[ left++ ];
+                }
+            }
+            while( left < mid ) {
+                p_tmp[ out++ ] = p_order[ left++ ];
+            }
+            while( right < end ) {
+                p_tmp[ out++ ] = p_order[ right++ ];
+            }
+        }
+
+        {
+            size_t* const swap = p_order;
+            p_order = p_tmp;
+            p_tmp = swap;
+        }
+    }
+
+    if( p_order != result ) {
+        memcpy( result, p_order, p_count * sizeof( size_t ));
+    }
+}
+
+/** Stable LSD radix sort of p_count entry indices by timestamp.  Unset times
+    sort last.
+
+    \param p_tmp Scratch space for p_count indices
+    \returns WD_SUCCESS or WD_GENERIC_FAIL if memory couldn't be allocated */
+static int radix_sort_times( const int32_t* const p_times,
+                             size_t* p_order, size_t* p_tmp,
+                             const size_t p_count )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    uint32_t* keys = (uint32_t*)malloc( p_count * sizeof( uint32_t ) * 2U );
+
+    if( keys != NULL ) {
+        size_t* const result = p_order;
+        uint32_t* tmp_keys = keys + p_count;
+        unsigned shift;
+        size_t loop;
+
+        /* Flipping the sign bit makes the keys' unsigned order match the
+           times' signed order, with NO_TIME moved from the first to the
+           last */
+        for( loop = 0; loop < p_count; loop++ ) {
+            keys[ loop ] = ( p_times[ loop ] == NO_TIME ) ? UINT32_MAX :
+                           ((uint32_t)p_times[ loop ] ^ 0x80000000UL );
+            p_order[ loop ] = loop;
+        }
+
+        for( shift = 0; shift < 32U; shift += RADIX_BITS ) {
+            size_t count[ RADIX_SIZE ];
+            size_t total = 0;
+
+            memset( count, 0, sizeof( count ));
+            for( loop = 0; loop < p_count; loop++ ) {
+                count[ ( keys[ loop ] >> shift ) & ( RADIX_SIZE - 1U ) ]++;
+            }
+
+            /* Nothing to do if every key has the same digit, which is
+               usually the case for the most significant */
+            if( count[ ( keys[ 0 ] >> shift ) & ( RADIX_SIZE - 1U ) ] != p_count ) {
+                for( loop = 0; loop < RADIX_SIZE; loop++ ) {
+                    const size_t this_count = count[ loop ];
+                    count[ loop ] = total;
+                    total += this_count;
+                }
+
+                for( loop = 0; loop < p_count; loop++ ) {
+                    const size_t dest = count[ ( keys[ loop ] >> shift ) & ( RADIX_SIZE - 1U ) ]++;
+                    tmp_keys[ dest ] = keys[ loop ];
+                    p_tmp[ dest ] = p_order[ loop ];
+                }
+
+                {
+                    uint32_t* const swap_keys = keys;
+                    size_t* const swap = p_order;
+                    keys = tmp_keys;
+                    tmp_keys = swap_keys;
+                    p_order = p_tmp;
+                    p_tmp = swap;
+                }
+            }
+        }
+
+        if( p_order != result ) {
+            memcpy( result, p_order, p_count * sizeof( size_t ));
+        }
+
+        /* The keys were allocated as a single block */
+        free(( keys < tmp_keys ) ? keys : tmp_keys );
+        ret_val = WD_SUCCESS;
+    }
+
+    return( ret_val );
+}
+
+/** Determine the order in which to output the entries of p_list.  The list
+    itself isn't re-ordered, so that indices remain valid.
+
+    \returns malloc()'d array of dir_count indices, or NULL if the stored
+             order should be used (including if memory couldn't be
+             allocated) */
+static size_t* sort_entries( const dir_list_t p_list, const wd_sort_t p_sort )
+{
+    const size_t count = p_list->dir_count;
+    size_t* ret_val = NULL;
+    size_t* tmp = NULL;
+    int ok = 0;
+
+    if(( p_sort != WD_SORT_NONE ) && ( count > 1 )) {
+        ret_val = (size_t*)malloc( count * sizeof( size_t ));
+        tmp = (size_t*)malloc( count * sizeof( size_t ));
+    }
+
+    if(( ret_val != NULL ) && ( tmp != NULL )) {
+        if(( p_sort == WD_SORT_ADDED ) || ( p_sort == WD_SORT_ACCESSED )) {
+            ok = WD_SUCCEEDED( radix_sort_times(
+                    ( p_sort == WD_SORT_ADDED ) ? p_list->time_added :
+                                                  p_list->time_accessed,
+                    ret_val, tmp, count ));
+        } else {
+            struct sort_strings str;
+
+            str.pool = p_list->pool;
+            str.off = ( p_sort == WD_SORT_NAME ) ? p_list->name_off :
+                                                   p_list->dir_off;
+            str.prefix = (uint64_t*)malloc( count * sizeof( uint64_t ));
+
+            if( str.prefix != NULL ) {
+                size_t named = 0;
+                size_t unnamed = 0;
+                size_t loop;
+
+                /* Bookmarks without a name go last, in stored order */
+                for( loop = 0; loop < count; loop++ ) {
+                    if(( str.off[ loop ] != NO_STRING ) &&
+                       ( str.pool[ str.off[ loop ] ] != '\0' )) {
+                        const unsigned char* c =
+                            (const unsigned char*)( str.pool + str.off[ loop ] );
+                        uint64_t prefix = 0;
+                        size_t byte;
+
+                        for( byte = 0; byte < SORT_PREFIX_LEN; byte++ ) {
+                            prefix <<= 8;
+                            if( *c != '\0' ) {
+                                prefix |= *c;
+                                c++;
+                            }
+                        }
+                        str.prefix[ loop ] = prefix;
+                        ret_val[ named++ ] = loop;
+                    } else {
+                        tmp[ unnamed++ ] = loop;
+                    }
+                }
+                memcpy( ret_val + named, tmp, unnamed * sizeof( size_t ));
+
+                sort_by_string( &str, ret_val, tmp, named );
+                free( str.prefix );
+                ok = 1;
+            }
+        }
+    }
+
+    if( !ok ) {
+        free( ret_val );
+        ret_val = NULL;
+    }
+    free( tmp );
+
+    return( ret_val );
+}
+
+/** Number of entries whose types are determined at a time when filtering a
+    listing */
+#define LIST_BLOCK_SIZE 256U
+
+/** Whether or not a listing depends on the current type of each entry */
+static int list_uses_type( const config_container_t* const p_cfg )
+{
+    return(( p_cfg->wd_entity_type != WD_ENTITY_ANY ) ||
+           ( 0 == p_cfg->wd_output_all ));
+}
+
+/** Determine which of p_count entries with the specified (current) types
+    should be listed.  Branch-free so that it can be vectorised. */
+static void filter_types( const uint8_t* const p_type,
+                          uint8_t* const p_keep,
+                          const size_t p_count,
+                          const config_container_t* const p_cfg )
+{
+    const uint8_t want = (uint8_t)p_cfg->wd_entity_type;
+    const uint8_t any = ( p_cfg->wd_entity_type == WD_ENTITY_ANY );
+    /* Unless all are wanted, anything other than a file or directory (i.e.
+       an invalid entity) is left out */
+    const uint8_t all = ( p_cfg->wd_output_all != 0 );
+    size_t loop;
+
+    for( loop = 0; loop < p_count; loop++ ) {
+        const uint8_t type = p_type[ loop ];
+        p_keep[ loop ] = (uint8_t)(( any | ( type == want )) &
+                                   ( all | ( type == WD_ENTITY_DIR ) |
+                                           ( type == WD_ENTITY_FILE )));
+    }
+}
+
+/** Determine which of p_count entries of p_list should be listed: those
+    at p_idx, or from p_first onwards if p_idx is NULL.  p_selected is NULL
+    if the listing isn't filtered by tags or a search, or as per
+    select_entries(). */
+static void filter_entries( const dir_list_t p_list,
+                            const size_t* const p_idx,
+                            const size_t p_first,
+                            const size_t p_count,
+                            const uint64_t* const p_selected,
+                            uint8_t* const p_keep,
+                            const config_container_t* const p_cfg )
+{
+    /* The types held in the list aren't updated, as it may be shared with
+       other threads */
+    uint8_t type[ LIST_BLOCK_SIZE ];
+    uint8_t selected[ LIST_BLOCK_SIZE ];
+    size_t loop;
+
+    for( loop = 0; loop < p_count; loop++ ) {
+        const size_t entry = ( p_idx != NULL ) ? p_idx[ loop ] : ( p_first + loop );
+        selected[ loop ] = ( p_selected != NULL ) ? (uint8_t)TAG_BIT( p_selected, entry ) : 1U;
+    }
+
+    if( list_uses_type( p_cfg )) {
+        /* Entries which aren't selected are dropped before their types are
+           determined, as that requires a stat() of each */
+        for( loop = 0; loop < p_count; loop++ ) {
+            const size_t entry = ( p_idx != NULL ) ? p_idx[ loop ] : ( p_first + loop );
+            type[ loop ] = selected[ loop ] ? (uint8_t)get_type( item_dir( p_list, entry )) :
+                                              (uint8_t)WD_ENTITY_UNKNOWN;
+        }
+        filter_types( type, p_keep, p_count, p_cfg );
+    } else {
+        memset( p_keep, 1, p_count );
+    }
+
+    for( loop = 0; loop < p_count; loop++ ) {
+        p_keep[ loop ] &= selected[ loop ];
+    }
+}
+
+/** Output a line of a listing.  The text of the line is either the formatted
+    p_dir, the escaped p_name or (if both are NULL) nothing.
+
+    If p_fn is NULL the line is written to p_out, otherwise it is passed to
+    p_fn, with p_out used to assemble the text */
+static void list_line( out_buf_t* const p_out,
+                       const config_container_t* const p_cfg,
+                       const size_t* const p_number,
+                       const char* const p_dir,
+                       const char* const p_name,
+                       dir_list_line_fn p_fn,
+                       void* p_ctx )
+{
+    const int has_text = ( p_dir != NULL ) || ( p_name != NULL );
+    const int escape = output_escape( p_cfg );
+    size_t start = RECORD_NO_LENGTH;
+    size_t mark;
+
+    if( p_fn == NULL ) {
+        /* Enough for the number, a space and the text */
+        start = record_start( p_out, p_cfg, 21U +
+                              (( p_name != NULL ) ? strlen( p_name ) :
+                               ( p_dir != NULL ) ? FORMATTED_DIR_MAX( strlen( p_dir )) :
+                               0 ));
+    }
+    mark = p_out->used;
+
+    if(( p_fn == NULL ) && ( p_number != NULL )) {
+        out_buf_put_size( p_out, *p_number );
+        if( has_text ) {
+            out_buf_putc( p_out, ' ' );
+        }
+    }
+
+    if( p_name != NULL ) {
+        escape_string_into( p_out, escape, p_name );
+    } else if( p_dir != NULL ) {
+        format_dir_into( p_out, p_cfg->wd_dir_form, escape, p_dir );
+    }
+
+    if( p_fn == NULL ) {
+        record_end( p_out, p_cfg, start, 1 );
+    } else if( out_buf_reserve( p_out, 1 ) != NULL ) {
+        p_out->data[ p_out->used ] = '\0';
+        p_fn( p_ctx, p_number, has_text ? ( p_out->data + mark ) : NULL );
+        p_out->used = mark;
+    } else {
+        /* TODO: What to do? */
+        p_out->used = mark;
+    }
+}
+
+/** List entry p_idx of p_list, numbered p_number (its index in the complete
+    list) */
+static void list_dir( const dir_list_t p_list,
+                      const size_t p_idx,
+                      const size_t p_number,
+                      const config_container_t* const p_cfg,
+                      out_buf_t* const p_out,
+                      dir_list_line_fn p_fn,
+                      void* p_ctx )
+{
+    const char* const dir = item_dir( p_list, p_idx );
+    const char* const name = item_name( p_list, p_idx );
+    /* Using the index here may mean that we get non-contiguous numbers on
+       the output, however this is preferable to having to iterate the
+       list to check for validity of each item when looking up the index
+       on a subsequent operation */
+    const size_t* const number =
+        IS_BIT_SET( p_cfg->wd_dir_list_opt, WD_DIRLIST_NUMBERED ) ?
+            &p_number : NULL;
+
+    if( IS_BIT_SET( p_cfg->wd_dir_list_opt, WD_DIRLIST_NUMBERED ) &&
+        !(IS_BIT_SET( p_cfg->wd_dir_list_opt, WD_DIRLIST_PATHS ) ||
+          IS_BIT_SET( p_cfg->wd_dir_list_opt, WD_DIRLIST_BOOKMARKS )) ) {
+        list_line( p_out, p_cfg, number, NULL, NULL, p_fn, p_ctx );
+    }
+    if( IS_BIT_SET( p_cfg->wd_dir_list_opt, WD_DIRLIST_PATHS )) {
+        list_line( p_out, p_cfg, number, dir, NULL, p_fn, p_ctx );
+    }
+    if( IS_BIT_SET( p_cfg->wd_dir_list_opt, WD_DIRLIST_BOOKMARKS ) &&
+        ( name != NULL )) {
+        /* Bookmarks without a name are listed using their path */
+        list_line( p_out, p_cfg, number, dir,
+                   ( name[0] == '\0' ) ? NULL : name,
+                   p_fn, p_ctx );
+    }
+}
+
+/** List to p_out (if p_fn is NULL) or p_fn */
+static void list_dirs_to( const dir_list_t p_list,
+                          const config_container_t* const p_cfg,
+                          out_buf_t* const p_out,
+                          dir_list_line_fn p_fn, void* p_ctx )
+{
+    size_t* const order = sort_entries( p_list, p_cfg->wd_sort_order );
+    int failed;
+    uint64_t* const selected = select_entries( p_list, p_cfg, &failed );
+    uint8_t keep[ LIST_BLOCK_SIZE ];
+    size_t block;
+
+    for( block = 0;
+         ( block < p_list->dir_count ) && !failed;
+         block += LIST_BLOCK_SIZE )
+    {
+        const size_t remaining = p_list->dir_count - block;
+        const size_t count = ( remaining < LIST_BLOCK_SIZE ) ? remaining :
+                                                               LIST_BLOCK_SIZE;
+
+        const size_t* const idx = ( order != NULL ) ? ( order + block ) : NULL;
+        size_t loop;
+
+        filter_entries( p_list, idx, block, count, selected, keep, p_cfg );
+
+        for( loop = 0; loop < count; loop++ ) {
+            if( keep[ loop ] ) {
+                const size_t entry = ( idx != NULL ) ? idx[ loop ] : ( block + loop );
+                list_dir( p_list, entry, entry, p_cfg, p_out, p_fn, p_ctx );
+            }
+        }
+    }
+
+    free( selected );
+    free( order );
+}
+
+void list_dirs_with_config( const dir_list_t p_list,
+                            const config_container_t* const p_cfg,
+                            dir_list_line_fn p_fn, void* p_ctx )
+{
+    out_buf_t scratch;
+
+    out_buf_init( &scratch, NULL );
+    list_dirs_to( p_list, p_cfg, &scratch, p_fn, p_ctx );
+    out_buf_release( &scratch );
+}
+
+void list_dirs_with( const dir_list_t p_list, dir_list_line_fn p_fn, void* p_ctx )
+{
+    list_dirs_with_config( p_list, p_list->cfg, p_fn, p_ctx );
+}
+
+void list_dirs( const dir_list_t p_list )
+{
+    if( p_list == NULL )
+    {
+        fprintf( stdout, "Empty dirlist structure\n" );
+    } else {
+        out_buf_t out;
+
+        out_buf_init( &out, stdout );
+        list_dirs_to( p_list, p_list->cfg, &out, NULL, NULL );
+        out_buf_release( &out );
+    }
+}
+
+#if !defined WIN32
+
+/** Number of batches which may be waiting between each pair of stages of a
+    streamed listing */
+#define STREAM_QUEUE_DEPTH 4U
+
+/** A run of consecutive entries from the list file, passed between the
+    stages of a streamed listing */
+struct list_batch
+{
+    dir_list_t list;
+    /** Index of the first entry within the complete list */
+    size_t     first;
+    uint8_t    keep[ LIST_BLOCK_SIZE ];
+    /** Formatted listing of the batch */
+    out_buf_t  out;
+};
+
+/** Bounded queue of batches between two stages */
+struct batch_queue
+{
+    struct list_batch* slot[ STREAM_QUEUE_DEPTH ];
+    size_t             head;
+    size_t             count;
+    /** Non-zero once the producing stage has finished */
+    int                closed;
+    pthread_mutex_t    lock;
+    pthread_cond_t     not_empty;
+    pthread_cond_t     not_full;
+};
 
-                /* Check that it wasn't a comment line */
-                if( read[0] != '#' ) {
-                    size_t len = strlen( read );
+struct list_stream
+{
+    const config_container_t* cfg;
+    struct batch_queue        to_classify;
+    struct batch_queue        to_format;
+    struct batch_queue        to_write;
+    out_buf_t                 out;
+    /** Set by the classify stage if a batch couldn't be filtered */
+    int                       failed;
+    /** Set by the write stage once any of the listing has been output */
+    int                       written;
+};
 
-                    DEBUG_OUT("Content length: " PFFST,len);
+static void queue_init( struct batch_queue* const p_queue )
+{
+    p_queue->head = 0;
+    p_queue->count = 0;
+    p_queue->closed = 0;
+    pthread_mutex_init( &( p_queue->lock ), NULL );
+    pthread_cond_init( &( p_queue->not_empty ), NULL );
+    pthread_cond_init( &( p_queue->not_full ), NULL );
+}
 
-                    /* Trim off line endings */
-                    size_t trimmer;
-                    for( trimmer = len - 1;
-                         trimmer > 0;
-                         trimmer-- ) {
-                        if(( read[ trimmer ] == '\r' ) ||
-                           ( read[ trimmer ] == '\n' )) {
-                            read[ trimmer ] = 0;
-                        } else {
-                            break;
-                        }
-                    }
+static void queue_destroy( struct batch_queue* const p_queue )
+{
+    pthread_mutex_destroy( &( p_queue->lock ));
+    pthread_cond_destroy( &( p_queue->not_empty ));
+    pthread_cond_destroy( &( p_queue->not_full ));
+}
 
-                    /* Is this the start of a new bookmark? */
-                    if( read[0] == ':' ) {
-                        /* Already read some bookmark details? */
-                        if ( path[0] != '\0' ) {
+/** Add a batch to the queue, waiting for space if necessary */
+static void queue_push( struct batch_queue* const p_queue,
+                        struct list_batch* const p_batch )
+{
+    pthread_mutex_lock( &( p_queue->lock ));
+    while( p_queue->count == STREAM_QUEUE_DEPTH ) {
+        pthread_cond_wait( &( p_queue->not_full ), &( p_queue->lock ));
+    }
+    p_queue->slot[ ( p_queue->head + p_queue->count ) % STREAM_QUEUE_DEPTH ] = p_batch;
+    p_queue->count++;
+    pthread_cond_signal( &( p_queue->not_empty ));
+    pthread_mutex_unlock( &( p_queue->lock ));
+}
 
-                            DEBUG_OUT("creating new bookmark: %s",path);
+/** Indicate that no more batches will be added to the queue */
+static void queue_close( struct batch_queue* const p_queue )
+{
+    pthread_mutex_lock( &( p_queue->lock ));
+    p_queue->closed = 1;
+    pthread_cond_broadcast( &( p_queue->not_empty ));
+    pthread_mutex_unlock( &( p_queue->lock ));
+}
 
-                            /* Create the new bookmark and reset attributes */
-                            add_dir( ret_val, path, name, added, accessed,
-                                     ent_type );
+/** Take the next batch from the queue, waiting for one if necessary
 
-                            DEBUG_OUT("created new bookmark");
+    \param[out] p_more Set to non-zero if further batches are already waiting
+    \returns The batch, or NULL once the queue is closed & empty */
+static struct list_batch* queue_pop( struct batch_queue* const p_queue,
+                                     int* const p_more )
+{
+    struct list_batch* ret_val = NULL;
 
-                            path[0] = 0;
-                            name[0] = 0;
-                            added = -1;
-                            accessed = -1;
-                            ent_type = WD_ENTITY_UNKNOWN;
-                        }
-                        strcpy( path, &(read[1]) );
-                    } else if(( read[0] == 'N' ) &&
-                              ( read[1] == ':' )) {
-                        strcpy( name, &(read[2]) );
-                    } else if(( read[0] == 'A' ) &&
-                              ( read[1] == ':' )) {
-                        added = sscan_time(&(read[2]));
-                    } else if(( read[0] == 'C' ) &&
-                              ( read[1] == ':' )) {
-                        accessed = sscan_time(&(read[2]));
-                    } else if(( read[0] == 'T' ) &&
-                              ( read[1] == ':' )) {
-                        switch(read[2]) {
-                            case 'D':
-                                ent_type = WD_ENTITY_DIR;
-                                break;
-                            case 'F':
-                                ent_type = WD_ENTITY_FILE;
-                                break;
-                            default:
-                                ent_type = WD_ENTITY_UNKNOWN;
-                                break;
-                        }
-                    } else {
-                        fprintf(stderr,
-                                "Unrecognised content in bookmarks file: %s\n",
-                                read);
-                    }
-                }
-            }
-        }
-        fclose( file );
+    pthread_mutex_lock( &( p_queue->lock ));
+    while(( p_queue->count == 0 ) && !p_queue->closed ) {
+        pthread_cond_wait( &( p_queue->not_empty ), &( p_queue->lock ));
     }
+    if( p_queue->count != 0 ) {
+        ret_val = p_queue->slot[ p_queue->head ];
+        p_queue->head = ( p_queue->head + 1U ) % STREAM_QUEUE_DEPTH;
+        p_queue->count--;
+        pthread_cond_signal( &( p_queue->not_full ));
+    }
+    *p_more = ( p_queue->count != 0 );
+    pthread_mutex_unlock( &( p_queue->lock ));
 
     return( ret_val );
 }
 
-int bookmark_in_list( dir_list_t p_list, const char* const p_name )
+static struct list_batch* new_batch( const config_container_t* const p_cfg,
+                                     const size_t p_first )
 {
-    int ret_val = WD_GENERIC_FAIL;
-    size_t dir_loop;
-    struct dir_list_item* current_item = p_list->dir_list;
+    struct list_batch* ret_val =
+        (struct list_batch*)malloc( sizeof( struct list_batch ));
 
-    for( dir_loop = 0; dir_loop < p_list->dir_count; dir_loop++, current_item++ )
-    {
-        if((current_item->bookmark_name != NULL ) &&
-           (0 == strcmp( p_name, current_item->bookmark_name ))) {
-            ret_val = 1;
-            break;
+    if( ret_val != NULL ) {
+        ret_val->list = new_dir_list();
+        if(( ret_val->list != NULL ) &&
+           WD_SUCCEEDED( resize_dirs( ret_val->list, LIST_BLOCK_SIZE ))) {
+            ret_val->list->cfg = p_cfg;
+            ret_val->first = p_first;
+            out_buf_init( &( ret_val->out ), NULL );
+        } else {
+            free_dir_list( ret_val->list );
+            free( ret_val );
+            ret_val = NULL;
         }
     }
 
     return( ret_val );
 }
 
-static int find_dir_location( dir_list_t p_list, const char* const p_dir, size_t* p_loc )
+static void free_batch( struct list_batch* const p_batch )
 {
-    int ret_val = WD_GENERIC_FAIL;
-    size_t dir_loop;
-    struct dir_list_item* current_item = p_list->dir_list;
+    free_dir_list( p_batch->list );
+    out_buf_release( &( p_batch->out ));
+    free( p_batch );
+}
 
-    for( dir_loop = 0; dir_loop < p_list->dir_count; dir_loop++, current_item++ )
-    {
-        if( 0 == strcmp( p_dir, current_item->dir_name )) {
-            ret_val = 1;
-            if( p_loc != NULL ) {
-                *p_loc = dir_loop;
-            }
-            break;
+/** Stage which determines which entries of each batch are to be listed */
+static void* stream_classify( void* p_arg )
+{
+    struct list_stream* const stream = (struct list_stream*)p_arg;
+    struct list_batch* batch;
+    int more;
+
+    while(( batch = queue_pop( &( stream->to_classify ), &more )) != NULL ) {
+        const size_t count = batch->list->dir_count;
+        int failed;
+        uint64_t* const selected = select_entries( batch->list, stream->cfg, &failed );
+
+        if( failed ) {
+            memset( batch->keep, 0, count );
+            stream->failed = 1;
+        } else {
+            filter_entries( batch->list, NULL, 0, count, selected, batch->keep,
+                            stream->cfg );
         }
+        free( selected );
+        queue_push( &( stream->to_format ), batch );
     }
+    queue_close( &( stream->to_format ));
 
-    return( ret_val );
+    return( NULL );
 }
 
-int remove_dir_by_index( dir_list_t p_list, const size_t p_dir )
+/** Stage which formats the entries of each batch which are to be listed */
+static void* stream_format( void* p_arg )
 {
-    int ret_val = WD_GENERIC_FAIL;
-
-    if( p_dir < p_list->dir_count ) {
-        p_list->dir_count--;
+    struct list_stream* const stream = (struct list_stream*)p_arg;
+    struct list_batch* batch;
+    int more;
 
-        /* Must use memmove here not memcpy as regions overlap */
-        memmove(&(p_list->dir_list[p_dir]), 
-                &(p_list->dir_list[p_dir+1]),
-                (p_list->dir_count - p_dir) * DLI_SIZE );
+    while(( batch = queue_pop( &( stream->to_format ), &more )) != NULL ) {
+        size_t loop;
 
-        ret_val = WD_SUCCESS;
+        for( loop = 0; loop < batch->list->dir_count; loop++ ) {
+            if( batch->keep[ loop ] ) {
+                list_dir( batch->list, loop, batch->first + loop, stream->cfg,
+                          &( batch->out ), NULL, NULL );
+            }
+        }
+        queue_push( &( stream->to_write ), batch );
     }
+    queue_close( &( stream->to_write ));
 
-    return( ret_val );
+    return( NULL );
 }
 
-int remove_dir( dir_list_t p_list, const char* const p_dir )
+/** Stage which outputs the formatted batches.  Output is only flushed when
+    there's nothing more ready to be written, so that the first results
+    appear promptly without small writes once the pipeline is full. */
+static void* stream_write( void* p_arg )
 {
-    int ret_val = WD_GENERIC_FAIL;
-    size_t location;
-
-    if( find_dir_location( p_list, p_dir, &location )) {
-        ret_val = remove_dir_by_index( p_list, location );
+    struct list_stream* const stream = (struct list_stream*)p_arg;
+    struct list_batch* batch;
+    int more;
+
+    while(( batch = queue_pop( &( stream->to_write ), &more )) != NULL ) {
+        out_buf_append( &( stream->out ), batch->out.data, batch->out.used );
+        stream->written |= ( batch->out.used != 0 );
+        free_batch( batch );
+        if( !more ) {
+            out_buf_flush( &( stream->out ));
+        }
     }
 
-    return( ret_val );
+    return( NULL );
 }
 
-int dir_in_list( dir_list_t p_list, const char* const p_dir )
+int list_dirs_streaming( const config_container_t* const p_config,
+                         const char* const p_fn )
 {
-    return( find_dir_location( p_list, p_dir, NULL ) );
-}
+    static void* (* const stages[])( void* ) = {
+        stream_classify, stream_format, stream_write };
+    int ret_val = WD_GENERIC_FAIL;
+    FILE* const file = fopen( p_fn, "rt" );
 
-#define CYGDRIVE_PREFIX "/cygdrive/"
+    /* Precondition check */
+    assert( p_config != NULL );
+    assert( p_fn != NULL );
+    /* !Precondition check */
 
-/** String length of CYGDRIVE_PREFIX, here as a constant to save repeated strlen
-    calls */
-#define CYGDRIVE_PREFIX_LEN 10U
+    if( file != NULL ) {
+        struct list_stream* const stream =
+            (struct list_stream*)malloc( sizeof( struct list_stream ));
+        struct load_state* const state =
+            (struct load_state*)malloc( sizeof( struct load_state ));
+        pthread_t threads[ sizeof( stages ) / sizeof( stages[0] ) ];
+        size_t started = 0;
+
+        if(( stream != NULL ) && ( state != NULL )) {
+            int failed = 0;
+
+            stream->cfg = p_config;
+            stream->failed = 0;
+            stream->written = 0;
+            queue_init( &( stream->to_classify ));
+            queue_init( &( stream->to_format ));
+            queue_init( &( stream->to_write ));
+            out_buf_init( &( stream->out ), stdout );
+
+            for( started = 0;
+                 started < ( sizeof( stages ) / sizeof( stages[0] ));
+                 started++ ) {
+                if( pthread_create( &( threads[ started ] ), NULL,
+                                    stages[ started ], stream ) != 0 ) {
+                    break;
+                }
+            }
 
-static char* escape_string( int p_escape, char* p_str )
-{
-    char* ret_val;
-    char* dest;
-    char* src = p_str;
+            if( started == ( sizeof( stages ) / sizeof( stages[0] ))) {
+                char read[ MAXPATHLEN ];
+                struct list_batch* batch = NULL;
+                size_t first = 0;
+                /* Excludes time spent waiting for the other stages */
+                uint64_t mark = wd_timings_on ? timings_now() : 0U;
 
-    if( p_escape == 0 ) {
-        ret_val = p_str;
-    } else {
-        ret_val = (char*)malloc( (strlen( p_str )*3) + 1 );
+                ret_val = WD_SUCCESS;
 
-        if( ret_val != NULL ) {
+                /* Types are determined by the classify stage only when the
+                   listing depends upon them */
+                state->resolve_types = 0;
+                state->failed = 0;
+                load_reset( state );
 
-            for( dest = ret_val;
-                 *src != '\0';
-                 dest++, src++ ) {
-                if(( *src == ' ' ) || 
-                   ( *src == '\\' )) {
-                    *dest = '\\';
-                    dest++;
-                    if( p_escape > 1 ) {
-                        *dest = '\\';
-                        dest++;
+                while( !failed ) {
+                    const int at_end = ( fgets( read, MAXPATHLEN, file ) == NULL );
+
+                    if( at_end ) {
+                        /* Flush out the final bookmark */
+                        read[0] = ':';
+                        read[1] = 0;
+                    } else {
+                        TIMINGS_COUNT( WD_COUNTER_READ, strlen( read ));
                     }
-                }
-                *dest = *src;
-            }
-            *dest = 0;
-        }
-    }
 
-    return ret_val;
-}
+                    if( batch == NULL ) {
+                        batch = new_batch( p_config, first );
+                        if( batch == NULL ) {
+                            failed = 1;
+                            break;
+                        }
+                        state->list = batch->list;
+                    }
 
-char* format_dir( wd_dir_format_t p_fmt, int p_escape, char* const p_dir ) {
-    char* ret_val = NULL;
+                    load_line( state, read );
+                    failed = state->failed;
 
-    switch( p_fmt ) {
-        case WD_DIRFORM_NONE:
-            ret_val = p_dir;
-            break;
-        case WD_DIRFORM_CYGWIN: {
-            char* dest;
-            char* src = p_dir;
-            ret_val = (char*)malloc( (strlen( p_dir )*2) + CYGDRIVE_PREFIX_LEN + 4 );
-            if( ret_val != NULL ) {
-                dest = ret_val;
-                if(((( src[0] >= 'a' ) && (src[0] <= 'z' )) ||
-                    (( src[0] >= 'A' ) && (src[0] <= 'Z' ))) &&
-                   ( src[1] == ':' ) &&
-                   (( src[2] == '\\') ||
-                    ( src[2] == '/' )))
-                {
-                    strcpy( ret_val, CYGDRIVE_PREFIX );
-                    dest += CYGDRIVE_PREFIX_LEN;
-                    *dest = *src;
-                    dest++;
-                    src += 2;
-                }
-                for( ;
-                     *src != '\0';
-                     dest++, src++ ) {
-                    if( *src == '\\' ) {
-                        *dest = '/';
-                    } else {
-                        *dest = *src;
+                    if( at_end || ( batch->list->dir_count == LIST_BLOCK_SIZE )) {
+                        first += batch->list->dir_count;
+                        TIMINGS_COUNT( WD_COUNTER_PARSE_NS, timings_now() - mark );
+                        queue_push( &( stream->to_classify ), batch );
+                        batch = NULL;
+                        mark = wd_timings_on ? timings_now() : 0U;
+                    }
+
+                    if( at_end ) {
+                        break;
                     }
                 }
-                *dest = 0;
-            }
-                                }
-            break;
-       case WD_DIRFORM_WINDOWS: {
-            char* dest;
-            char* src;
-            ret_val = (char*)malloc( (strlen( p_dir )*2) + 1 );
-            if( ret_val != NULL ) {
-                src = p_dir;
-                dest = ret_val;
-                if( strncmp( src, CYGDRIVE_PREFIX, CYGDRIVE_PREFIX_LEN ) == 0 )
-                {
-                    src += CYGDRIVE_PREFIX_LEN;
-                    *dest = *src;
-                    dest++;
-                    *dest = ':';
-                    dest++;
-                    src += 1;
+
+                if( batch != NULL ) {
+                    free_batch( batch );
                 }
-                for( ;
-                     *src != '\0';
-                     dest++, src++ ) {
-                    if( *src == '/' ) {
-                        *dest = '\\';
-                    } else {
-                        *dest = *src;
-                    }
+            } else {
+                failed = 1;
+            }
+
+            /* Stages which did start finish once they've drained the queue
+               feeding them */
+            queue_close( &( stream->to_classify ));
+            if( started < 2U ) {
+                queue_close( &( stream->to_format ));
+            }
+            if( started < 3U ) {
+                queue_close( &( stream->to_write ));
+            }
+            while( started > 0 ) {
+                started--;
+                pthread_join( threads[ started ], NULL );
+            }
+
+            out_buf_release( &( stream->out ));
+
+            if( failed || stream->failed ) {
+                if( stream->written ) {
+                    /* What has been output can't be taken back, so the
+                       listing can't be produced another way */
+                    fprintf( stderr, "Listing incomplete: not enough memory\n" );
+                } else {
+                    ret_val = WD_GENERIC_FAIL;
                 }
-                *dest = 0;
             }
-                                }
-            break;
 
-        default:
-            fprintf(stderr,"Unhandled directory format\n");
-            ret_val = p_dir;
-            break;
-    }
-    
-    if( p_escape && (ret_val != NULL )) {
-        char* src;
-        char* f = NULL;
-        if( ret_val == p_dir ) {
-            src = p_dir;
-        } else {
-            src = ret_val;
-            f = src;
-        }
-        ret_val = escape_string( p_escape, src );
-        if( f != NULL ) {
-            free( f );
+            queue_destroy( &( stream->to_classify ));
+            queue_destroy( &( stream->to_format ));
+            queue_destroy( &( stream->to_write ));
         }
 
+        free( state );
+        free( stream );
+        fclose( file );
     }
 
-
     return( ret_val );
 }
 
-static void dump_dir( const config_container_t* const p_cfg, struct dir_list_item* p_item )
-{
-    /* Precondition check */
-    assert( p_cfg != NULL );
-    assert( p_item != NULL );
-    /* !Precondition check */
-
-    char* dir_formatted = format_dir( p_cfg->wd_dir_form,
-                                      p_cfg->wd_escape_output,
-                                      p_item->dir_name );
-    if( dir_formatted != NULL ) {
-        fprintf( stdout, "%s", dir_formatted );
-
-        if( p_item->dir_name != dir_formatted ) {
-            free( dir_formatted );
-        }
-
-        if( p_cfg->wd_store_access ) {
-            p_item->time_accessed = p_cfg->wd_now_time;
-        }
-    } else {
-        /* TODO: What do do? */
-    }
+#endif
 
+const char* dir_list_get_dir( const dir_list_t p_list, const size_t p_idx )
+{
+    return( item_dir( p_list, p_idx ));
 }
 
-int dump_dir_if_exists( const dir_list_t p_list, const char* const p_dir )
+const char* dir_list_get_name( const dir_list_t p_list, const size_t p_idx )
 {
-    size_t dir_loop;
-    struct dir_list_item* current_item;
-    int found = 0;
-
-    for( dir_loop = 0, current_item = p_list->dir_list;
-         dir_loop < p_list->dir_count;
-         dir_loop++, current_item++ )
-    {
-        /* TODO: Case insensitive on Windows?  Case insensitive switch? */
-        if(( current_item->bookmark_name != NULL ) &&
-           ( 0 == strcmp( p_dir, current_item->dir_name ))) {
-
-            dump_dir( p_list->cfg, current_item );
-            found = 1;
-            break;
-        }
-    }
-    return( found );
+    return( item_name( p_list, p_idx ));
 }
 
-int dump_dir_with_index( const dir_list_t p_list, const unsigned p_idx )
+time_t dir_list_get_time_added( const dir_list_t p_list, const size_t p_idx )
 {
-    int found = 0;
-
-    if( p_idx < p_list->dir_count ) {
-        struct dir_list_item* current_item = &( p_list->dir_list[ p_idx ] );
-        dump_dir( p_list->cfg, current_item );
-        found = 1;
-    }
-
-    return( found );
+    return( decode_time( p_list, p_list->time_added[ p_idx ] ));
 }
 
-int dump_dir_with_name( const dir_list_t p_list, const char* const p_name )
+time_t dir_list_get_time_accessed( const dir_list_t p_list, const size_t p_idx )
 {
-    size_t dir_loop;
-    struct dir_list_item* current_item;
-    int found = 0;
-
-    for( dir_loop = 0, current_item = p_list->dir_list;
-         dir_loop < p_list->dir_count;
-         dir_loop++, current_item++ )
-    {
-        if(( current_item->bookmark_name != NULL ) &&
-           ( 0 == strcmp( p_name, current_item->bookmark_name ))) {
-
-            dump_dir( p_list->cfg, current_item );
-            found = 1;
-            break;
-        }
-    }
-
-    return( found );
+    return( decode_time( p_list, p_list->time_accessed[ p_idx ] ));
 }
 
-static wd_entity_t get_type( const char* const p_path )
+wd_entity_t dir_list_get_type( const dir_list_t p_list, const size_t p_idx )
 {
-    wd_entity_t ret_val = WD_ENTITY_UNKNOWN;
-    struct stat s;
-    int err = stat( p_path , &s);
-
-    if( err == -1 )
-    {
-        if(ENOENT == errno) {
-            ret_val = WD_ENTITY_NONEXISTANT;
-        }
-    } else {
-        if( S_ISDIR(s.st_mode) ) {
-            ret_val = WD_ENTITY_DIR;
-        } else if( S_ISREG( s.st_mode )) {
-            ret_val = WD_ENTITY_FILE;
-        }
-    }
-
-    return ret_val;
+    return( (wd_entity_t)p_list->type[ p_idx ] );
 }
 
-int dir_should_be_listed( const struct dir_list_item* p_dir_item,
-                           const config_container_t* p_cfg )
+void dir_list_set_type( dir_list_t p_list, const size_t p_idx,
+                        const wd_entity_t p_type )
 {
-    int valid = 1;
-    /* TODO: Update current_item->type here? */
-    wd_entity_t type = get_type( p_dir_item->dir_name );
+    p_list->type[ p_idx ] = (uint8_t)p_type;
+}
 
-    /* Check to see if this item matches the filter */
-    if((p_cfg->wd_entity_type != WD_ENTITY_ANY) &&
-        (p_cfg->wd_entity_type != type )) {
-        /* No, don't output */
-        valid = 0;
-    } else if( 0 == p_cfg->wd_output_all ) {
+unsigned long dir_list_get_hits( const dir_list_t p_list, const size_t p_idx )
+{
+    return( p_list->hits[ p_idx ] );
+}
 
-        /* Check to see if it's other than a file or directory (ie. an
-            invalid entity */
-        if(( type != WD_ENTITY_DIR ) &&
-            ( type != WD_ENTITY_FILE ))
-        {
-            valid = 0;
-        }
-    }
-    return valid; 
+void dir_list_set_hits( dir_list_t p_list, const size_t p_idx,
+                        const unsigned long p_hits )
+{
+    p_list->hits[ p_idx ] = ( p_hits > UINT32_MAX ) ? UINT32_MAX :
+                                                      (uint32_t)p_hits;
 }
 
-void list_dir(struct dir_list_item* p_dir_item,
-              const size_t p_count,
-              const config_container_t* const p_cfg )
+int dir_list_find_name( const dir_list_t p_list, const char* const p_name, size_t* const p_idx )
 {
+    int ret_val = WD_GENERIC_FAIL;
+    size_t dir_loop;
 
-    if( dir_should_be_listed( p_dir_item, p_cfg )) 
+    for( dir_loop = 0; dir_loop < p_list->dir_count; dir_loop++ )
     {
-        char* const dir = p_dir_item->dir_name;
-
-        char* dir_formatted = format_dir( p_cfg->wd_dir_form,
-                                            p_cfg->wd_escape_output,
-                                            dir );
-        if( dir_formatted != NULL ) {
-            if( IS_BIT_SET( p_cfg->wd_dir_list_opt, WD_DIRLIST_NUMBERED ) &&
-                !(IS_BIT_SET( p_cfg->wd_dir_list_opt, WD_DIRLIST_PATHS ) ||
-                  IS_BIT_SET( p_cfg->wd_dir_list_opt, WD_DIRLIST_BOOKMARKS )) ) {
-                fprintf( stdout, PFFST "\n", p_count );
-            }
-            if( IS_BIT_SET( p_cfg->wd_dir_list_opt, WD_DIRLIST_PATHS )) {
-                if( IS_BIT_SET( p_cfg->wd_dir_list_opt, WD_DIRLIST_NUMBERED )) {
-                    /* Using p_count here may mean that we get non-contiguous
-                        numbers on the output, however this is preferable to
-                        having to iterate the list to check for validity of each
-                        item when looking up the index on a subsequent operation
-                        */
-                    fprintf( stdout, PFFST " ", p_count );
-                }
-                fprintf( stdout, "%s\n", dir_formatted );
-            }
-            if( IS_BIT_SET( p_cfg->wd_dir_list_opt, WD_DIRLIST_BOOKMARKS ) &&
-                ( p_dir_item->bookmark_name != NULL )) {
-                char* name_escaped = escape_string( p_cfg->wd_escape_output,
-                        p_dir_item->bookmark_name );
+        const uint32_t off = p_list->name_off[ dir_loop ];
 
-                if( name_escaped != NULL  ) {
-                    if( IS_BIT_SET( p_cfg->wd_dir_list_opt, WD_DIRLIST_NUMBERED ) ) {
-                        fprintf( stdout, PFFST " ", p_count );
-                    }
-                    if( strlen( name_escaped ) == 0 )
-                    {
-                        dump_dir( p_cfg, p_dir_item );
-                    }
-                    else
-                    {
-                        fprintf( stdout, "%s", name_escaped );
-                    }
-                    fprintf( stdout, "\n" );
-                    if( name_escaped != p_dir_item->bookmark_name ) {
-                        free( name_escaped );
-                    }
-                } else {
-                    /* TODO: What to do? */
-                }
-            }
-            if( dir != dir_formatted ) {
-                free( dir_formatted );
-            }
+        if(( off != NO_STRING ) &&
+           ( 0 == strcmp( p_name, p_list->pool + off ))) {
+            *p_idx = dir_loop;
+            ret_val = 1;
+            break;
         }
     }
+
+    return( ret_val );
 }
 
-void list_dirs( const dir_list_t p_list )
+int dir_list_find_dir( const dir_list_t p_list, const char* const p_dir, size_t* const p_idx )
 {
-    if( p_list == NULL )
-    {
-        fprintf( stdout, "Empty dirlist structure\n" );
-    } else {
-        size_t dir_loop;
-        struct dir_list_item* current_item;
-
-        for( dir_loop = 0, current_item = p_list->dir_list;
-             dir_loop < p_list->dir_count;
-             dir_loop++, current_item++ )
-        {
-            list_dir( current_item, dir_loop, p_list->cfg);
-        }
-    }
+    return( find_dir_location( p_list, p_dir, p_idx ) );
 }
 
 int determine_if_term_is_ansi()
@@ -912,16 +3131,18 @@ WORD TextColour(WORD fontcolor)
 }
 #endif
 
-static void dump_time( const char* const p_header, const time_t* const p_time )
+static void dump_time( out_buf_t* const p_out, const char* const p_header,
+                       const time_t* const p_time )
 {
     char buffer[ TIME_STRING_BUFFER_SIZE ];
 
     strftime( buffer, sizeof( buffer ), "%c %Z",
               localtime( p_time ));
 
-    fprintf( stdout, "\n      - %s: %s",
-                     p_header,
-                     buffer );
+    out_buf_puts( p_out, "\n      - " );
+    out_buf_puts( p_out, p_header );
+    out_buf_puts( p_out, ": " );
+    out_buf_puts( p_out, buffer );
 }
 
 void dump_dir_list( const dir_list_t p_list )
@@ -930,34 +3151,42 @@ void dump_dir_list( const dir_list_t p_list )
     {
         fprintf( stdout, "Empty dirlist structure\n" );
     } else {
-        size_t dir_loop;
-        struct dir_list_item* current_item;
+        size_t* const order = sort_entries( p_list, p_list->cfg->wd_sort_order );
+        size_t pos;
         int term_is_ansi = determine_if_term_is_ansi();
+        const int converted = !format_dir_is_identity( p_list->cfg->wd_dir_form,
+                                                       p_list->cfg->wd_escape_output );
+        out_buf_t out;
 
-        fprintf( stdout, "Dirlist has " PFFST " entries of " PFFST " used\n",
-                 p_list->dir_count, p_list->dir_size );
+        out_buf_init( &out, stdout );
+        out_buf_printf( &out, "Dirlist has " PFFST " entries of " PFFST " used\n",
+                        p_list->dir_count, p_list->dir_size );
 
-        for( dir_loop = 0, current_item = p_list->dir_list;
-             dir_loop < p_list->dir_count;
-             dir_loop++, current_item++ )
+        for( pos = 0; pos < p_list->dir_count; pos++ )
         {
+            /* Numbered according to the stored order, whatever the output
+               order */
+            const size_t dir_loop = ( order != NULL ) ? order[ pos ] : pos;
 #if defined WIN32
             int wcol = -1;
             WORD wOldColorAttrs;
 #endif
             char* col = ANSI_COLOUR_RESET;
-            char* dir = current_item->dir_name;
-            char* dir_formatted;
-
-            current_item->type = get_type( dir );
-
-            if( current_item->type == WD_ENTITY_NONEXISTANT ) {
+            const char* const dir = item_dir( p_list, dir_loop );
+            const char* const name = item_name( p_list, dir_loop );
+            const time_t added = dir_list_get_time_added( p_list, dir_loop );
+            const time_t accessed = dir_list_get_time_accessed( p_list, dir_loop );
+            char* const tags = dir_list_get_tags( p_list, dir_loop );
+            /* Not stored in the list, as dumping doesn't modify it */
+            const wd_entity_t type = get_type( dir );
+
+            if( type == WD_ENTITY_NONEXISTANT ) {
 #if defined WIN32
                 wcol = FOREGROUND_INTENSITY;
 #endif
                 col = ANSI_COLOUR_GREY;
             } else if((p_list->cfg->wd_entity_type != WD_ENTITY_ANY) &&
-                      (p_list->cfg->wd_entity_type != current_item->type )) {
+                      (p_list->cfg->wd_entity_type != type )) {
 #if defined WIN32
                 wcol = FOREGROUND_RED;
 #endif
@@ -969,49 +3198,100 @@ void dump_dir_list( const dir_list_t p_list )
                 col = ANSI_COLOUR_GREEN;
             }
 
-            fprintf( stdout, "["PFF3ST"] ", dir_loop);
+            out_buf_printf( &out, "["PFF3ST"] ", dir_loop);
 #if defined WIN32
             if( wcol != -1 ) {
+                /* Console colour applies to output from this point on */
+                out_buf_flush( &out );
                 wOldColorAttrs = TextColour(wcol);
             }
 #endif
             if( term_is_ansi ) {
-                fprintf( stdout, "%s", col );
+                out_buf_puts( &out, col );
             }
 
-            dir_formatted = format_dir( p_list->cfg->wd_dir_form,
-                                        p_list->cfg->wd_escape_output,
-                                        dir );
-            fprintf( stdout, "%s", dir_formatted );
+            format_dir_into( &out, p_list->cfg->wd_dir_form,
+                             p_list->cfg->wd_escape_output, dir );
 
-            if( current_item->dir_name != dir_formatted ) {
-                fprintf( stdout, "\n      - Unconverted: %s",
-                         dir);
-                free( dir_formatted );
+            if( converted ) {
+                out_buf_puts( &out, "\n      - Unconverted: " );
+                out_buf_puts( &out, dir );
             }
 
-            if(( current_item->bookmark_name != NULL ) &&
-               ( current_item->bookmark_name[0] != 0 )) {
-                fprintf( stdout, "\n      - Shorthand: %s",
-                         current_item->bookmark_name);
+            if(( name != NULL ) &&
+               ( name[0] != 0 )) {
+                out_buf_puts( &out, "\n      - Shorthand: " );
+                out_buf_puts( &out, name );
+            }
+            if( added != -1 ) {
+                dump_time( &out, "Added", &added );
             }
-            if( current_item->time_added != -1 ) {
-                dump_time( "Added", &( current_item->time_added ) );
+            if( accessed != -1 ) {
+                dump_time( &out, "Accessed", &accessed );
             }
-            if( current_item->time_accessed != -1 ) {
-                dump_time( "Accessed", &( current_item->time_accessed ) );
+            if( p_list->hits[ dir_loop ] != 0 ) {
+                out_buf_printf( &out, "\n      - Uses: %lu",
+                                (unsigned long)p_list->hits[ dir_loop ] );
+            }
+            if( tags != NULL ) {
+                out_buf_puts( &out, "\n      - Tags: " );
+                out_buf_puts( &out, tags );
+                free( tags );
             }
 #if defined WIN32
             if( wcol != -1 ) {
+                out_buf_flush( &out );
                 TextColour(wOldColorAttrs);
             }
 #endif
             if( term_is_ansi ) {
-                fprintf( stdout, "%s", ANSI_COLOUR_RESET );
+                out_buf_puts( &out, ANSI_COLOUR_RESET );
             }
-            printf("\n");
+            out_buf_putc( &out, '\n' );
         }
+
+        out_buf_release( &out );
+        free( order );
+    }
+}
+
+/** \returns Non-zero if p_list has any details which are only written to
+             version 2 list files */
+static int needs_version_2( const dir_list_t p_list )
+{
+    int ret_val = ( p_list->removed != NULL );
+    const size_t words = TAG_WORDS( p_list->dir_count );
+    size_t loop;
+
+    for( loop = 0; ( loop < p_list->dir_count ) && !ret_val; loop++ ) {
+        const char* const name = item_name( p_list, loop );
+
+        ret_val = ( p_list->hits[ loop ] != 0 ) ||
+                  ( strchr( item_dir( p_list, loop ), '\n' ) != NULL ) ||
+                  (( name != NULL ) && ( strchr( name, '\n' ) != NULL ));
     }
+    /* Bits beyond dir_count are clear, so a whole word can be checked */
+    for( loop = 0; ( loop < ( p_list->tag_count * words )) && !ret_val; loop++ ) {
+        ret_val = ( p_list->tag_bits[ loop / words ][ loop % words ] != 0 );
+    }
+
+    return( ret_val );
+}
+
+/** Write a line consisting of p_prefix followed by p_value, continuing
+    p_value on a further line starting with '+' after each newline in it */
+static void save_field( FILE* const p_file, const char* const p_prefix,
+                        const char* p_value )
+{
+    const char* nl;
+
+    fputs( p_prefix, p_file );
+    while(( nl = strchr( p_value, '\n' )) != NULL ) {
+        fwrite( p_value, 1U, (size_t)( nl - p_value ), p_file );
+        fputs( "\n+", p_file );
+        p_value = nl + 1;
+    }
+    fprintf( p_file, "%s\n", p_value );
 }
 
 int save_dir_list( const dir_list_t p_list, const char* p_fn ) {
@@ -1029,44 +3309,59 @@ int save_dir_list( const dir_list_t p_list, const char* p_fn ) {
     if( file != NULL ) {
         size_t dir_loop;
         fprintf( file, "%s\n%s\n", FILE_HEADER_DESC_STRING,
-                                   FILE_HEADER_VER_STRING );
+                                   needs_version_2( p_list ) ?
+                                       FILE_HEADER_VER2_STRING :
+                                       FILE_HEADER_VER_STRING );
+        if( p_list->removed != NULL ) {
+            fprintf( file, "%s\n", FILE_HEADER_REMOVALS_STRING );
+        }
 
         for( dir_loop = 0; dir_loop < p_list->dir_count; dir_loop++ )
         {
-            struct dir_list_item* this_item = &(p_list->dir_list[ dir_loop ]);
+            const char* const dir = item_dir( p_list, dir_loop );
+            const char* const name = item_name( p_list, dir_loop );
+            const time_t added = dir_list_get_time_added( p_list, dir_loop );
+            const time_t accessed = dir_list_get_time_accessed( p_list, dir_loop );
+            const uint32_t hits = p_list->hits[ dir_loop ];
+            char* const tags = dir_list_get_tags( p_list, dir_loop );
             char*  type_string;
 
             DEBUG_OUT("saving bookmark " PFFST,dir_loop);
 
-            fprintf( file, ":%s\n",
-                           this_item->dir_name );
-            if(( this_item->bookmark_name != NULL ) &&
-               ( this_item->bookmark_name[0] != 0 )) {
-                fprintf( file, "N:%s\n",
-                               this_item->bookmark_name );
+            save_field( file, ":", dir );
+            if(( name != NULL ) &&
+               ( name[0] != 0 )) {
+                save_field( file, "N:", name );
             }
-            if( this_item->time_added != -1 ) {
+            if( added != -1 ) {
                 char buff[ TIME_STRING_BUFFER_SIZE ];
 
                 if (strftime(buff, sizeof( buff ), TIME_FORMAT_STRING, 
-                             gmtime( &(this_item->time_added) ))) {
+                             gmtime( &added ))) {
                     fprintf( file, "A:%s\n",buff);
                 }
             }
-            if( this_item->time_accessed != -1 ) {
+            if( accessed != -1 ) {
                 char buff[ TIME_STRING_BUFFER_SIZE ];
 
                 if (strftime(buff, sizeof( buff ), TIME_FORMAT_STRING, 
-                             gmtime( &(this_item->time_accessed) ))) {
+                             gmtime( &accessed ))) {
                     fprintf( file, "C:%s\n",buff);
                 }
             }
+            if( hits != 0 ) {
+                fprintf( file, "H:%lu\n", (unsigned long)hits );
+            }
+            if( tags != NULL ) {
+                fprintf( file, "G:%s\n", tags );
+                free( tags );
+            }
             
             /* Refresh the type.
                TODO: This may be over-zealous if it has already been done */
-            this_item->type = get_type( this_item->dir_name );
+            p_list->type[ dir_loop ] = (uint8_t)get_type( dir );
 
-            switch( this_item->type )
+            switch( p_list->type[ dir_loop ] )
             {
                 case WD_ENTITY_DIR:
                     type_string = "D";
@@ -1082,6 +3377,24 @@ int save_dir_list( const dir_list_t p_list, const char* p_fn ) {
             fprintf( file, "T:%s\n",type_string);
         }
 
+        /* Each removal is a single line which older versions report as
+           unrecognised & skip, rather than reading it as a bookmark */
+        for( dir_loop = 0;
+             ( p_list->removed != NULL ) && ( dir_loop < p_list->removed->dir_count );
+             dir_loop++ )
+        {
+            const time_t removed = dir_list_get_time_accessed( p_list->removed, dir_loop );
+            char buff[ TIME_STRING_BUFFER_SIZE ];
+
+            if( strftime( buff, sizeof( buff ), TIME_FORMAT_STRING,
+                          gmtime( &removed ))) {
+                fprintf( file, "X:%s\t", buff );
+                save_field( file, "", item_dir( p_list->removed, dir_loop ));
+            }
+        }
+
+        TIMINGS_COUNT( WD_COUNTER_WRITTEN, (uint64_t)ftell( file ));
+        TIMINGS_COUNT( WD_COUNTER_SAVES, 1U );
         fclose( file );
         ret_val = WD_SUCCESS;
     }
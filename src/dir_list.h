@@ -33,6 +33,21 @@
 */
 typedef struct dir_list_s* dir_list_t;
 
+/**
+    Function which receives the lines of a listing produced by
+    list_dirs_with()
+
+    \param[in] p_ctx    Context pointer passed to list_dirs_with()
+    \param[in] p_number Index of the bookmark in the case that the listing is
+                        numbered, otherwise NULL
+    \param[in] p_text   Content of the line (already formatted & escaped), or
+                        NULL in the case that the line consists only of the
+                        number
+*/
+typedef void (*dir_list_line_fn)( void* p_ctx,
+                                  const size_t* const p_number,
+                                  const char* const p_text );
+
 /**
     Load a set of bookmarks from the specified file
 
@@ -57,6 +72,33 @@ dir_list_t load_dir_list( const config_container_t* const p_config, const char*
               failed
 */
 extern dir_list_t new_dir_list( void );
+
+/**
+    Create a deep copy of a directory list structure
+
+    \param[in] p_list The list to copy
+    \returns Pointer to the newly created structure or NULL if allocation
+              failed
+*/
+dir_list_t copy_dir_list( const dir_list_t p_list );
+
+/**
+    Release a directory list structure along with all of the bookmarks which it
+    contains
+
+    \param[in] p_list The list to release.  May be NULL
+*/
+void       free_dir_list( dir_list_t p_list );
+
+/**
+    Change the configuration associated with a directory list.  Used when a
+    list outlives the invocation which loaded it (e.g. when cached by the
+    daemon)
+
+    \param[in] p_list   The list to update
+    \param[in] p_config Configuration options to associate with the dir list
+*/
+void       dir_list_set_config( dir_list_t p_list, const config_container_t* const p_config );
 int        add_dir( dir_list_t p_list,
                     const char* const p_dir,
                     const char* const p_name,
@@ -64,6 +106,9 @@ int        add_dir( dir_list_t p_list,
                     const time_t      p_t_accessed,
                     const wd_entity_t p_type );
 int        remove_dir( dir_list_t p_list, const char* const p_dir );
+/* Set the name of the bookmark with index p_idx, removing the name if p_name
+   is NULL or empty */
+int        rename_dir( dir_list_t p_list, const size_t p_idx, const char* const p_name );
 /* \param p_idx 0-based index of the directory to dump */
 int        dump_dir_with_index( const dir_list_t p_list, const unsigned p_idx );
 int        dump_dir_with_name( const dir_list_t p_list, const char* const p_name );
@@ -74,7 +119,135 @@ int        bookmark_in_list( dir_list_t p_list, const char* const p_name );
 int        save_dir_list( const dir_list_t p_list, const char* p_fn );
 void       dump_dir_list( const dir_list_t p_list );
 void       list_dirs( const dir_list_t p_list );
+
+/**
+    Produce the same listing as list_dirs(), passing each line to a function
+    rather than outputting it
+
+    \param[in] p_list The list to iterate
+    \param[in] p_fn   Function to call with each line
+    \param[in] p_ctx  Context to pass to p_fn
+*/
+void       list_dirs_with( const dir_list_t p_list, dir_list_line_fn p_fn, void* p_ctx );
+
+/**
+    As list_dirs_with(), but using the specified configuration rather than
+    the one associated with the list.  The list is not modified, so this may
+    be called concurrently on a shared list.
+*/
+void       list_dirs_with_config( const dir_list_t p_list,
+                                  const config_container_t* const p_cfg,
+                                  dir_list_line_fn p_fn, void* p_ctx );
+
+#if !defined WIN32
+/**
+    Produce the same listing as list_dirs() would for the list loaded from
+    p_fn, in storage order, without first loading the whole list.  Entries are
+    parsed, filtered, formatted & written by a pipeline of threads, so output
+    starts as soon as the first entries have been read.
+
+    \returns WD_SUCCESS if the listing was produced, otherwise WD_GENERIC_FAIL
+             in which case nothing has been output (e.g. the file could not be
+             opened, or memory ran out before any of the listing was written)
+             and the listing can be produced another way.  If memory runs out
+             once output has started, an error is reported and WD_SUCCESS is
+             returned, as the listing can't then be repeated.
+*/
+int        list_dirs_streaming( const config_container_t* const p_config,
+                                const char* const p_fn );
+#endif
+
+/**
+    Format a path as specified by the output options
+
+    \param[in] p_fmt    Path format
+    \param[in] p_escape Escape level (see config_container_t::wd_escape_output)
+    \param[in] p_dir    Path to format
+    \returns The formatted path.  If this differs from p_dir, it has been
+             allocated using malloc() and must be released by the caller.  NULL
+             if allocation failed.
+*/
+char*      format_dir( wd_dir_format_t p_fmt, int p_escape, char* const p_dir );
+
+/* \param p_idx 0-based index of the bookmark.  Must be less than
+   dir_list_get_count()
+   \returns The path, which remains valid until the list is next modified */
+const char* dir_list_get_dir( const dir_list_t p_list, const size_t p_idx );
+/* \returns The name of the bookmark or NULL/empty string if it has none */
+const char* dir_list_get_name( const dir_list_t p_list, const size_t p_idx );
+/* \returns The time or -1 if not known */
+time_t     dir_list_get_time_added( const dir_list_t p_list, const size_t p_idx );
+time_t     dir_list_get_time_accessed( const dir_list_t p_list, const size_t p_idx );
+wd_entity_t dir_list_get_type( const dir_list_t p_list, const size_t p_idx );
+void       dir_list_set_type( dir_list_t p_list, const size_t p_idx,
+                              const wd_entity_t p_type );
+/* \returns Number of times the bookmark has been used, or 0 if not known */
+unsigned long dir_list_get_hits( const dir_list_t p_list, const size_t p_idx );
+void       dir_list_set_hits( dir_list_t p_list, const size_t p_idx,
+                              const unsigned long p_hits );
+/* \returns Non-zero with *p_idx populated in the case that a bookmark was
+             found */
+int        dir_list_find_name( const dir_list_t p_list, const char* const p_name, size_t* const p_idx );
+int        dir_list_find_dir( const dir_list_t p_list, const char* const p_dir, size_t* const p_idx );
 size_t     dir_list_get_count( const dir_list_t p_list );
 
+/**
+    Replace the tags of bookmark p_idx with those in p_tags, which are
+    separated by commas.  Tags are held as a bitset over the bookmarks for
+    each tag, so that listings can be filtered by them (see --tag) without
+    examining each bookmark's tags.
+
+    \param p_tags Tags to give the bookmark, or NULL for none
+    \returns WD_SUCCESS if the tags were set.  They can't contain newlines.
+*/
+int        dir_list_set_tags( dir_list_t p_list, const size_t p_idx,
+                              const char* const p_tags );
+
+/**
+    \returns malloc()'d string of the tags of bookmark p_idx, sorted and
+             separated by commas, or NULL if it has none
+*/
+char*      dir_list_get_tags( const dir_list_t p_list, const size_t p_idx );
+
+/**
+    Give bookmark p_dest_idx of p_dest the same tags as bookmark p_src_idx
+    of p_src
+*/
+int        dir_list_copy_tags( dir_list_t p_dest, const size_t p_dest_idx,
+                               const dir_list_t p_src, const size_t p_src_idx );
+
+/**
+    Start recording the removal of bookmarks from p_list, as is needed once
+    it's synchronised with another copy.  The records are saved with the
+    list, so this persists.
+
+    \returns WD_SUCCESS if removals are recorded
+*/
+int        dir_list_record_removals( dir_list_t p_list );
+
+/**
+    Record that p_dir was removed from the list at p_t_removed, e.g. as read
+    from another copy of the list.  Once removals are recorded (see
+    dir_list_record_removals()), removing a bookmark records its removal
+    automatically, and adding it again discards the record.
+
+    \returns WD_SUCCESS if the removal was recorded
+*/
+int        dir_list_add_removed( dir_list_t p_list, const char* const p_dir,
+                                 const time_t p_t_removed );
+
+/**
+    \returns A list of the paths which have been removed from p_list, each
+             with the time of its removal as its time accessed, or NULL if
+             removals aren't recorded.  It remains owned by p_list.
+*/
+dir_list_t dir_list_get_removed( const dir_list_t p_list );
+
+/**
+    Exchange the bookmarks & removals held by two lists.  Each keeps its own
+    configuration.
+*/
+void       dir_list_swap( dir_list_t p_a, dir_list_t p_b );
+
 
 #endif
@@ -0,0 +1,496 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "wd.h"
+#include "import.h"
+#include "os_if.h"
+#include "str_table.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#if !defined WIN32
+#include <unistd.h>
+#endif
+
+/** Longest line which will be read from an imported file */
+#define MAX_LINE_LEN ( MAXPATHLEN + 64U )
+
+/** Outcome of parsing a line of an imported file */
+typedef enum {
+    IMPORT_LINE_OK,
+    IMPORT_LINE_BLANK,     /**< Blank or a comment */
+    IMPORT_LINE_BAD
+} import_line_t;
+
+#if !defined WIN32
+
+/** Limit on the number of symbolic links followed to resolve a single link,
+    to cope with loops */
+#define MAX_LINK_DEPTH 40U
+
+/* Each path examined while canonicalising is memoised as a value made up
+   of the type of the entity, whether or not the path could be examined and,
+   for symbolic links, the canonical form of the target */
+#define CANON_TYPE_MASK  0xFU
+/** The path couldn't be examined, so no attempt is made to resolve anything
+    below it */
+#define CANON_FAILED     0x10U
+#define CANON_LINK_SHIFT 5U
+
+/** Memoised canonicalisation of paths.  Imported paths tend to share most of
+    their components, so each distinct prefix is only examined once. */
+struct canon_ctx
+{
+    /** Map from a path (whose parent is canonical) to its information */
+    str_table_t memo;
+    /** Canonical targets of symbolic links, referred to by offset */
+    char*       targets;
+    size_t      targets_used;
+    size_t      targets_size;
+    char        cwd[ MAXPATHLEN ];
+    /** Number of paths examined, for debugging */
+    unsigned long examined;
+};
+
+static int canon_path( struct canon_ctx* const p_ctx, const char* p_path,
+                       char* const p_out, const unsigned p_depth,
+                       wd_entity_t* const p_type );
+
+/** Store the canonical target of a link
+
+    \returns Offset plus 1, or 0 if memory couldn't be allocated */
+static size_t store_target( struct canon_ctx* const p_ctx, const char* const p_target )
+{
+    size_t ret_val = 0;
+    const size_t len = strlen( p_target ) + 1U;
+
+    if( p_ctx->targets_used + len > p_ctx->targets_size ) {
+        size_t new_size = ( p_ctx->targets_size * 2U ) + len;
+        char* new_mem = (char*)realloc( p_ctx->targets, new_size );
+
+        if( new_mem != NULL ) {
+            p_ctx->targets = new_mem;
+            p_ctx->targets_size = new_size;
+        }
+    }
+
+    if( p_ctx->targets_used + len <= p_ctx->targets_size ) {
+        memcpy( p_ctx->targets + p_ctx->targets_used, p_target, len );
+        ret_val = p_ctx->targets_used + 1U;
+        p_ctx->targets_used += len;
+    }
+
+    return( ret_val );
+}
+
+/** Examine a path whose parent is canonical
+
+    \returns Information to be memoised for the path */
+static size_t canon_examine( struct canon_ctx* const p_ctx,
+                             const char* const p_path,
+                             const unsigned p_depth )
+{
+    size_t ret_val;
+    struct stat s;
+
+    p_ctx->examined++;
+
+    if( lstat( p_path, &s ) != 0 ) {
+        ret_val = CANON_FAILED |
+                  ((( errno == ENOENT ) || ( errno == ENOTDIR )) ?
+                       WD_ENTITY_NONEXISTANT : WD_ENTITY_UNKNOWN );
+    } else if( S_ISLNK( s.st_mode )) {
+        char target[ MAXPATHLEN ];
+        char full[ MAXPATHLEN ];
+        char canon[ MAXPATHLEN ];
+        const ssize_t len = readlink( p_path, target, sizeof( target ) - 1U );
+        wd_entity_t type;
+        size_t off;
+
+        ret_val = CANON_FAILED | WD_ENTITY_UNKNOWN;
+
+        if(( len >= 0 ) && ( p_depth < MAX_LINK_DEPTH )) {
+            target[ len ] = '\0';
+
+            if( target[0] == '/' ) {
+                strcpy( full, target );
+            } else {
+                /* Relative to the directory containing the link */
+                const size_t dir_len = (size_t)( strrchr( p_path, '/' ) - p_path );
+                if( dir_len + 1U + (size_t)len < sizeof( full )) {
+                    memcpy( full, p_path, dir_len + 1U );
+                    strcpy( full + dir_len + 1U, target );
+                } else {
+                    full[0] = '\0';
+                }
+            }
+
+            if(( full[0] != '\0' ) &&
+               WD_SUCCEEDED( canon_path( p_ctx, full, canon, p_depth + 1U, &type )) &&
+               (( off = store_target( p_ctx, canon )) != 0 )) {
+                ret_val = ( off << CANON_LINK_SHIFT ) | type |
+                          (( type == WD_ENTITY_NONEXISTANT ) ? CANON_FAILED : 0 );
+            }
+        }
+    } else if( S_ISDIR( s.st_mode )) {
+        ret_val = WD_ENTITY_DIR;
+    } else if( S_ISREG( s.st_mode )) {
+        ret_val = WD_ENTITY_FILE;
+    } else {
+        ret_val = WD_ENTITY_UNKNOWN;
+    }
+
+    return( ret_val );
+}
+
+/** Make p_path absolute, resolving "." & ".." components and symbolic links
+    as realpath() would.  Components which don't exist are kept as they are.
+
+    \param[out] p_out  Buffer of MAXPATHLEN characters for the result
+    \param[out] p_type Type of the entity the path refers to
+    \returns WD_SUCCESS or WD_GENERIC_FAIL if the result is too long */
+static int canon_path( struct canon_ctx* const p_ctx, const char* p_path,
+                       char* const p_out, const unsigned p_depth,
+                       wd_entity_t* const p_type )
+{
+    int ret_val = WD_SUCCESS;
+    size_t len = 0;
+    int resolving = 1;
+    wd_entity_t type = WD_ENTITY_DIR;
+
+    if( *p_path != '/' ) {
+        len = strlen( p_ctx->cwd );
+        memcpy( p_out, p_ctx->cwd, len );
+        /* Root is represented by the empty string while building the path */
+        if(( len == 1 ) && ( p_out[0] == '/' )) {
+            len = 0;
+        }
+    }
+    p_out[ len ] = '\0';
+
+    while(( *p_path != '\0' ) && WD_SUCCEEDED( ret_val )) {
+        const char* comp;
+        size_t comp_len;
+
+        while( *p_path == '/' ) {
+            p_path++;
+        }
+        comp = p_path;
+        while(( *p_path != '/' ) && ( *p_path != '\0' )) {
+            p_path++;
+        }
+        comp_len = (size_t)( p_path - comp );
+
+        if(( comp_len == 0 ) || (( comp_len == 1 ) && ( comp[0] == '.' ))) {
+            /* Nothing to do */
+        } else if(( comp_len == 2 ) && ( comp[0] == '.' ) && ( comp[1] == '.' )) {
+            /* The path so far is canonical, so its parent can be found
+               lexically */
+            while(( len > 0 ) && ( p_out[ len - 1U ] != '/' )) {
+                len--;
+            }
+            if( len > 0 ) {
+                len--;
+            }
+            p_out[ len ] = '\0';
+            if( resolving ) {
+                type = WD_ENTITY_DIR;
+            }
+        } else if( len + 1U + comp_len >= MAXPATHLEN ) {
+            ret_val = WD_GENERIC_FAIL;
+        } else {
+            p_out[ len++ ] = '/';
+            memcpy( p_out + len, comp, comp_len );
+            len += comp_len;
+            p_out[ len ] = '\0';
+
+            if( resolving ) {
+                const size_t* const found = str_table_find( p_ctx->memo, p_out );
+                size_t info;
+
+                if( found != NULL ) {
+                    info = *found;
+                } else {
+                    info = canon_examine( p_ctx, p_out, p_depth );
+                    /* Not being able to memoise just means examining it
+                       again next time */
+                    (void)str_table_add( p_ctx->memo, p_out, info );
+                }
+
+                type = (wd_entity_t)( info & CANON_TYPE_MASK );
+                resolving = !( info & CANON_FAILED );
+
+                if(( info >> CANON_LINK_SHIFT ) != 0 ) {
+                    strcpy( p_out, p_ctx->targets + ( info >> CANON_LINK_SHIFT ) - 1U );
+                    len = strlen( p_out );
+                    if(( len == 1 ) && ( p_out[0] == '/' )) {
+                        len = 0;
+                    }
+                }
+            } else {
+                type = WD_ENTITY_NONEXISTANT;
+            }
+        }
+    }
+
+    if( len == 0 ) {
+        strcpy( p_out, "/" );
+    }
+    *p_type = type;
+
+    return( ret_val );
+}
+
+#endif
+
+/** Split a line into its fields according to the format.  The line is
+    modified in order to terminate the fields. */
+static import_line_t parse_line( const wd_import_fmt_t p_fmt, char* const p_line,
+                                 const char** const p_path,
+                                 const char** const p_name,
+                                 unsigned long* const p_hits,
+                                 time_t* const p_accessed )
+{
+    import_line_t ret_val = IMPORT_LINE_BAD;
+    char* sep;
+    char* end;
+    double weight = 0;
+
+    *p_path = NULL;
+    *p_name = NULL;
+    *p_hits = 0;
+    *p_accessed = -1;
+
+    if(( p_line[0] == '\0' ) || ( p_line[0] == '#' )) {
+        ret_val = IMPORT_LINE_BLANK;
+    } else switch( p_fmt ) {
+        case WD_IMPORT_Z:
+            /* path|rank|time - the path may itself contain '|' */
+            sep = strrchr( p_line, '|' );
+            if( sep != NULL ) {
+                *sep = '\0';
+                *p_accessed = (time_t)strtol( sep + 1, &end, 10 );
+                sep = strrchr( p_line, '|' );
+                if(( *end == '\0' ) && ( sep != NULL )) {
+                    *sep = '\0';
+                    weight = strtod( sep + 1, &end );
+                    if( *end == '\0' ) {
+                        *p_path = p_line;
+                    }
+                }
+            }
+            break;
+        case WD_IMPORT_AUTOJUMP:
+            /* weight<TAB>path */
+            sep = strchr( p_line, '\t' );
+            if( sep != NULL ) {
+                *sep = '\0';
+                weight = strtod( p_line, &end );
+                if( *end == '\0' ) {
+                    *p_path = sep + 1;
+                }
+            }
+            break;
+        case WD_IMPORT_CDARGS:
+            /* name path */
+            sep = strchr( p_line, ' ' );
+            if(( sep != NULL ) && ( sep != p_line )) {
+                *sep = '\0';
+                *p_name = p_line;
+                *p_path = sep + 1;
+            }
+            break;
+        default:
+            *p_path = p_line;
+            break;
+    }
+
+    if(( *p_path != NULL ) && ( **p_path != '\0' )) {
+        ret_val = IMPORT_LINE_OK;
+        if( weight > 0 ) {
+            *p_hits = ( weight >= (double)UINT32_MAX ) ? UINT32_MAX :
+                                                       (unsigned long)( weight + 0.5 );
+        }
+    }
+
+    return( ret_val );
+}
+
+/** Index the paths and names already in the list */
+static int index_list( const dir_list_t p_list, str_table_t p_paths,
+                       str_table_t p_names )
+{
+    int ret_val = WD_SUCCESS;
+    const size_t count = dir_list_get_count( p_list );
+    size_t loop;
+
+    for( loop = 0; ( loop < count ) && WD_SUCCEEDED( ret_val ); loop++ ) {
+        const char* const dir = dir_list_get_dir( p_list, loop );
+        const char* const name = dir_list_get_name( p_list, loop );
+
+        if( str_table_find( p_paths, dir ) == NULL ) {
+            ret_val = str_table_add( p_paths, dir, loop );
+        }
+        if( WD_SUCCEEDED( ret_val ) &&
+            ( name != NULL ) && ( name[0] != '\0' ) &&
+            ( str_table_find( p_names, name ) == NULL )) {
+            ret_val = str_table_add( p_names, name, loop );
+        }
+    }
+
+    return( ret_val );
+}
+
+int import_dirs( const config_container_t* const p_config,
+                 const char* const p_cmd,
+                 dir_list_t p_list )
+{
+    int ret_val = 0;
+    const int use_stdin = ( 0 == strcmp( p_config->wd_import_fn, "-" ));
+    FILE* const in = use_stdin ? stdin : fopen( p_config->wd_import_fn, "rt" );
+    str_table_t paths = str_table_new();
+    str_table_t names = str_table_new();
+#if !defined WIN32
+    struct canon_ctx canon;
+
+    canon.memo = str_table_new();
+    canon.targets = NULL;
+    canon.targets_used = 0;
+    canon.targets_size = 0;
+    canon.examined = 0;
+    if( getcwd( canon.cwd, sizeof( canon.cwd )) == NULL ) {
+        strcpy( canon.cwd, "/" );
+    }
+#endif
+
+    /* Precondition check */
+    assert( p_config != NULL );
+    assert( p_config->wd_import_fn != NULL );
+    assert( p_list != NULL );
+    /* !Precondition check */
+
+    if( in == NULL ) {
+        fprintf( stderr, "%s: Error: Unable to open '%s' for import\n",
+                 p_cmd, p_config->wd_import_fn );
+    } else if(( paths == NULL ) || ( names == NULL ) ||
+#if !defined WIN32
+              ( canon.memo == NULL ) ||
+#endif
+              !WD_SUCCEEDED( index_list( p_list, paths, names ))) {
+        fprintf( stderr, "%s: Error: Out of memory\n", p_cmd );
+    } else {
+        char line[ MAX_LINE_LEN ];
+        char dir[ MAXPATHLEN ];
+        unsigned long line_no = 0;
+        unsigned long added = 0;
+        unsigned long present = 0;
+
+        while( fgets( line, sizeof( line ), in ) != NULL ) {
+            size_t len = strlen( line );
+            const char* path;
+            const char* name;
+            unsigned long hits;
+            time_t accessed;
+            wd_entity_t type = WD_ENTITY_UNKNOWN;
+
+            line_no++;
+
+            if(( len > 0 ) && ( line[ len - 1U ] != '\n' ) && !feof( in )) {
+                int c;
+                fprintf( stderr, "%s: Warning: Line %lu of '%s' is too long\n",
+                         p_cmd, line_no, p_config->wd_import_fn );
+                do {
+                    c = fgetc( in );
+                } while(( c != '\n' ) && ( c != EOF ));
+                continue;
+            }
+
+            while(( len > 0 ) && (( line[ len - 1U ] == '\n' ) ||
+                                  ( line[ len - 1U ] == '\r' ))) {
+                line[ --len ] = '\0';
+            }
+
+            switch( parse_line( p_config->wd_import_format, line,
+                                &path, &name, &hits, &accessed )) {
+                case IMPORT_LINE_BAD:
+                    fprintf( stderr, "%s: Warning: Unrecognised content on line %lu of '%s'\n",
+                             p_cmd, line_no, p_config->wd_import_fn );
+                    break;
+                case IMPORT_LINE_OK:
+#if defined WIN32
+                    canonicalize_dir( path, dir );
+#else
+                    if( !WD_SUCCEEDED( canon_path( &canon, path, dir, 0, &type ))) {
+                        fprintf( stderr, "%s: Warning: Path on line %lu of '%s' is too long\n",
+                                 p_cmd, line_no, p_config->wd_import_fn );
+                        break;
+                    }
+#endif
+                    if( str_table_find( paths, dir ) != NULL ) {
+                        present++;
+                    } else if(( name != NULL ) &&
+                              ( str_table_find( names, name ) != NULL )) {
+                        fprintf( stderr,
+                                 "%s: Warning: Bookmark name already in list: '%s'\n",
+                                 p_cmd, name );
+                    } else if( WD_SUCCEEDED( add_dir( p_list, dir, name,
+                                                      p_config->wd_now_time,
+                                                      accessed, type ))) {
+                        const size_t idx = dir_list_get_count( p_list ) - 1U;
+
+                        dir_list_set_hits( p_list, idx, hits );
+                        /* Failing to index just means that duplicates in the
+                           input won't be spotted */
+                        (void)str_table_add( paths, dir, idx );
+                        if( name != NULL ) {
+                            (void)str_table_add( names, name, idx );
+                        }
+                        added++;
+                    } else {
+                        fprintf( stderr,
+                                 "%s: Error: Failed to add bookmark to: '%s'\n",
+                                 p_cmd, dir );
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        DEBUG_OUT("import examined %lu paths", canon.examined);
+
+        fprintf( stdout, "Imported %lu bookmark(s), %lu already in list\n",
+                 added, present );
+        ret_val = ( added > 0 );
+    }
+
+    if(( in != NULL ) && !use_stdin ) {
+        fclose( in );
+    }
+    str_table_free( paths );
+    str_table_free( names );
+#if !defined WIN32
+    str_table_free( canon.memo );
+    free( canon.targets );
+#endif
+
+    return( ret_val );
+}
@@ -0,0 +1,44 @@
+/**
+   \file
+   \brief The import module adds bookmarks in bulk from the databases of other
+          directory-jumping tools and from plain lists of paths
+
+   \copyright Copyright 2018 John Bailey
+
+   \section LICENSE
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if !defined( IMPORT_H )
+#define       IMPORT_H
+
+#include "cmdln.h"
+#include "dir_list.h"
+
+/**
+    Add a bookmark for each path in p_config->wd_import_fn (in the format
+    p_config->wd_import_format) which isn't already in the list.  Paths are
+    canonicalised as for `wd -a`.  Use counts and access times are carried
+    over where the format records them.
+
+    \param p_config Program settings
+    \param p_cmd    String referencing the executing program
+    \param p_list   List to add the bookmarks to
+    \returns Non-zero if the list has been modified and needs saving
+*/
+int import_dirs( const config_container_t* const p_config,
+                 const char* const p_cmd,
+                 dir_list_t p_list );
+
+#endif
@@ -0,0 +1,215 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "wd.h"
+#include "layers.h"
+#include "str_table.h"
+#if !defined WIN32
+#include "shm_cache.h"
+#include "snapshot.h"
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int layers_apply( const config_container_t* const p_config )
+{
+    return(( p_config->wd_layer_count != 0 ) &&
+           (( p_config->wd_oper == WD_OPER_GET ) ||
+            ( p_config->wd_oper == WD_OPER_GET_BY_BM_NAME ) ||
+            ( p_config->wd_oper == WD_OPER_LIST ) ||
+            ( p_config->wd_oper == WD_OPER_DUMP )));
+}
+
+/** \returns Non-zero if the target of the operation is in p_list, in which
+             case no further layers are needed.  Listings need them all. */
+static int has_target( const config_container_t* const p_config,
+                       const dir_list_t p_list )
+{
+    int ret_val = 0;
+    size_t idx;
+
+    if( p_config->wd_oper == WD_OPER_GET_BY_BM_NAME ) {
+        ret_val = dir_list_find_name( p_list, p_config->wd_bookmark_name, &idx );
+    } else if( p_config->wd_oper == WD_OPER_GET ) {
+        /* As per do_get(): an index, a name or the path of a named entry */
+        if( sscanf( p_config->wd_bookmark_name, PFFST, &idx ) == 1 ) {
+            ret_val = ( idx < dir_list_get_count( p_list ));
+        } else {
+            ret_val = dir_list_find_name( p_list, p_config->wd_bookmark_name, &idx ) ||
+                      ( dir_list_find_dir( p_list, p_config->wd_bookmark_name, &idx ) &&
+                        ( dir_list_get_name( p_list, idx ) != NULL ) &&
+                        ( dir_list_get_name( p_list, idx )[0] != '\0' ));
+        }
+    }
+
+    return( ret_val );
+}
+
+/** \returns The list held in p_fn, or NULL if it couldn't be loaded.  Each
+             file is shared via its own shared memory cache, if enabled */
+static dir_list_t load_file( const config_container_t* const p_config,
+                             const char* const p_fn )
+{
+#if !defined WIN32
+    if( p_config->wd_shm_cache ) {
+        file_sig_t sig;
+        return( shm_cache_load( p_config, p_fn, &sig ));
+    }
+#endif
+    return( load_dir_list( p_config, p_fn ));
+}
+
+/** \returns The list held in p_fn, read from its local copy if enabled, or
+             NULL if it couldn't be loaded */
+static dir_list_t load_layer( const config_container_t* const p_config,
+                              const char* const p_fn )
+{
+    dir_list_t ret_val = NULL;
+#if !defined WIN32
+    char* const snap_fn = p_config->wd_snapshot ? snapshot_get( p_config, p_fn ) : NULL;
+
+    if( snap_fn != NULL ) {
+        ret_val = load_file( p_config, snap_fn );
+        free( snap_fn );
+    }
+    if( ret_val == NULL )
+#endif
+    {
+        ret_val = load_file( p_config, p_fn );
+    }
+
+    return( ret_val );
+}
+
+/** Add the paths & names of entries from p_first onwards to the index */
+static int index_entries( const dir_list_t p_list, const size_t p_first,
+                          str_table_t p_paths, str_table_t p_names )
+{
+    int ret_val = WD_SUCCESS;
+    const size_t count = dir_list_get_count( p_list );
+    size_t loop;
+
+    for( loop = p_first; ( loop < count ) && WD_SUCCEEDED( ret_val ); loop++ ) {
+        const char* const dir = dir_list_get_dir( p_list, loop );
+        const char* const name = dir_list_get_name( p_list, loop );
+
+        if( str_table_find( p_paths, dir ) == NULL ) {
+            ret_val = str_table_add( p_paths, dir, loop );
+        }
+        if( WD_SUCCEEDED( ret_val ) &&
+            ( name != NULL ) && ( name[0] != '\0' ) &&
+            ( str_table_find( p_names, name ) == NULL )) {
+            ret_val = str_table_add( p_names, name, loop );
+        }
+    }
+
+    return( ret_val );
+}
+
+/** Append the entries of p_layer which aren't hidden by those already in
+    p_view */
+static int merge_layer( dir_list_t p_view, const dir_list_t p_layer,
+                        str_table_t p_paths, str_table_t p_names )
+{
+    int ret_val = WD_SUCCESS;
+    const size_t first = dir_list_get_count( p_view );
+    const size_t count = dir_list_get_count( p_layer );
+    size_t loop;
+
+    for( loop = 0; ( loop < count ) && WD_SUCCEEDED( ret_val ); loop++ ) {
+        const char* const dir = dir_list_get_dir( p_layer, loop );
+        const char* name = dir_list_get_name( p_layer, loop );
+
+        if( str_table_find( p_paths, dir ) == NULL ) {
+            /* Listed by path, as a bookmark loaded without a name would be */
+            if(( name != NULL ) && ( str_table_find( p_names, name ) != NULL )) {
+                name = "";
+            }
+            ret_val = add_dir( p_view, dir, name,
+                               dir_list_get_time_added( p_layer, loop ),
+                               dir_list_get_time_accessed( p_layer, loop ),
+                               dir_list_get_type( p_layer, loop ));
+            if( WD_SUCCEEDED( ret_val )) {
+                dir_list_set_hits( p_view, dir_list_get_count( p_view ) - 1U,
+                                   dir_list_get_hits( p_layer, loop ));
+                /* So that listings of layers can be filtered by tag */
+                ret_val = dir_list_copy_tags( p_view, dir_list_get_count( p_view ) - 1U,
+                                              p_layer, loop );
+            }
+        }
+    }
+
+    /* Entries within a layer hide later ones in the same way */
+    if( WD_SUCCEEDED( ret_val )) {
+        ret_val = index_entries( p_view, first, p_paths, p_names );
+    }
+
+    return( ret_val );
+}
+
+dir_list_t layers_resolve( const config_container_t* const p_config,
+                           const dir_list_t p_top )
+{
+    dir_list_t ret_val = NULL;
+
+    /* Precondition check */
+    assert( p_config != NULL );
+    assert( p_top != NULL );
+    /* !Precondition check */
+
+    if( layers_apply( p_config ) && !has_target( p_config, p_top )) {
+        str_table_t paths = str_table_new();
+        str_table_t names = str_table_new();
+        int ok = ( paths != NULL ) && ( names != NULL );
+        size_t layer;
+
+        ret_val = ok ? copy_dir_list( p_top ) : NULL;
+        ok = ( ret_val != NULL ) &&
+             WD_SUCCEEDED( index_entries( ret_val, 0, paths, names ));
+
+        for( layer = 0; ok && ( layer < p_config->wd_layer_count ); layer++ ) {
+            const char* const fn = p_config->wd_layers[ layer ];
+            dir_list_t list = load_layer( p_config, fn );
+
+            if( list == NULL ) {
+                /* e.g. a system-wide list which hasn't been set up */
+                DEBUG_OUT("layer %s not loaded", fn);
+            } else {
+                DEBUG_OUT("merging layer %s", fn);
+                ok = WD_SUCCEEDED( merge_layer( ret_val, list, paths, names ));
+                free_dir_list( list );
+
+                if( has_target( p_config, ret_val )) {
+                    break;
+                }
+            }
+        }
+
+        if( !ok ) {
+            fprintf( stderr, "MALLOC FAILED\n" );
+            /* Carry on without the layers */
+            free_dir_list( ret_val );
+            ret_val = NULL;
+        }
+
+        str_table_free( paths );
+        str_table_free( names );
+    }
+
+    return( ret_val );
+}
@@ -0,0 +1,61 @@
+/**
+   \file
+   \brief The layers module presents the user's bookmark list merged with
+          read-only lists shared by a team or system (see --layer)
+
+   Layers are searched after the user's list, in the order in which they were
+   given.  An entry in a layer is hidden by an entry for the same path in the
+   user's list or an earlier layer, and loses its name if that name is used by
+   such an entry.  Layers are only loaded when the user's list (and any
+   earlier layers) can't satisfy the operation, so a bookmark found in the
+   user's list never causes a shared file to be opened.
+
+   Only the user's list is ever modified or saved.  Bookmarks which are
+   retrieved from a layer therefore don't have their access recorded.
+
+   \copyright Copyright 2018 John Bailey
+
+   \section LICENSE
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if !defined( LAYERS_H )
+#define       LAYERS_H
+
+#include "cmdln.h"
+#include "dir_list.h"
+
+/**
+    Determine whether the operation requested by p_config involves layers.
+    Such operations can't be served from caches of the user's list alone.
+
+    \param[in] p_config Program settings
+    \returns Non-zero if layers are in use and the operation reads them
+*/
+int        layers_apply( const config_container_t* const p_config );
+
+/**
+    Merge as many layers into the user's list as the operation requested by
+    p_config needs
+
+    \param[in] p_config Program settings
+    \param[in] p_top    The user's list
+    \returns NULL if the operation can be carried out using p_top alone,
+             otherwise a merged list to use in its place, which must not be
+             saved and is to be released using free_dir_list()
+*/
+dir_list_t layers_resolve( const config_container_t* const p_config,
+                           const dir_list_t p_top );
+
+#endif
@@ -0,0 +1,421 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "wd.h"
+#include "libwd.h"
+#include "dir_list.h"
+#include "list_cache.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct wd_snapshot_s
+{
+    /** Number of references held on this snapshot, including the handle's
+        reference while it is current */
+    unsigned long refs;
+    /** Signature of the file from which the list was loaded */
+    file_sig_t    sig;
+    /** The list itself.  Never modified once the snapshot is published */
+    dir_list_t    list;
+};
+
+struct wd_handle_s
+{
+    char*                 fn;
+    /** Configuration associated with loaded lists.  Only used for loading
+        and saving - all output options are passed per call */
+    config_container_t    cfg;
+    /** Current snapshot, replaced atomically by writers */
+    wd_snapshot_t*        current;
+    /** Count of readers between loading current and taking a reference on
+        it.  Writers wait for this to drain before dropping the handle's
+        reference on a snapshot they have replaced (a grace period) */
+    unsigned long         acquiring;
+    /** Serialises writers.  Readers never take this */
+    pthread_mutex_t       write_lock;
+};
+
+/** Accumulates a listing into the caller's buffer */
+struct list_ctx
+{
+    char*  buf;
+    size_t len;
+    size_t used;
+};
+
+void wd_options_init( wd_options_t* const p_opts )
+{
+    p_opts->dir_form    = WD_DIRFORM_NONE;
+    p_opts->escape      = 0;
+    p_opts->list_opt    = WD_DIRLIST_PATHS;
+    p_opts->entity_type = WD_ENTITY_ANY;
+    p_opts->output_all  = 1;
+    p_opts->sort_order  = WD_SORT_NONE;
+}
+
+/** Populate a config with the output options from p_opts */
+static void options_to_config( const wd_options_t* const p_opts,
+                               config_container_t* const p_cfg )
+{
+    memset( p_cfg, 0, sizeof( *p_cfg ));
+    p_cfg->wd_oper          = WD_OPER_NONE;
+    p_cfg->wd_dir_form      = p_opts->dir_form;
+    p_cfg->wd_escape_output = p_opts->escape;
+    p_cfg->wd_dir_list_opt  = p_opts->list_opt;
+    p_cfg->wd_entity_type   = p_opts->entity_type;
+    p_cfg->wd_output_all    = p_opts->output_all;
+    p_cfg->wd_sort_order    = p_opts->sort_order;
+    p_cfg->wd_now_time      = -1;
+}
+
+/** Copy a string into a caller's buffer, snprintf() style */
+static size_t copy_out( char* const p_buf, const size_t p_len,
+                        const char* const p_str )
+{
+    size_t str_len = strlen( p_str );
+
+    if(( p_buf != NULL ) && ( p_len > 0 )) {
+        size_t copy = ( str_len < p_len ) ? str_len : ( p_len - 1U );
+        memcpy( p_buf, p_str, copy );
+        p_buf[ copy ] = '\0';
+    }
+
+    return( str_len );
+}
+
+static wd_snapshot_t* new_snapshot( dir_list_t p_list, const file_sig_t* const p_sig )
+{
+    wd_snapshot_t* ret_val = (wd_snapshot_t*)malloc( sizeof( wd_snapshot_t ));
+
+    if( ret_val != NULL ) {
+        ret_val->refs = 1;
+        ret_val->sig  = *p_sig;
+        ret_val->list = p_list;
+    } else {
+        free_dir_list( p_list );
+    }
+
+    return( ret_val );
+}
+
+/** Load the file associated with the handle into a new snapshot */
+static wd_snapshot_t* load_snapshot( wd_handle_t* const p_handle )
+{
+    file_sig_t sig;
+    dir_list_t list;
+
+    file_sig_get( p_handle->fn, &sig );
+    list = load_dir_list( &( p_handle->cfg ), p_handle->fn );
+
+    if( list == NULL ) {
+        /* Treat unreadable/non-existent files as empty */
+        list = new_dir_list();
+        if( list != NULL ) {
+            dir_list_set_config( list, &( p_handle->cfg ));
+        }
+    }
+
+    return(( list != NULL ) ? new_snapshot( list, &sig ) : NULL );
+}
+
+/** Replace the current snapshot.  Caller must hold the write lock. */
+static void publish( wd_handle_t* const p_handle, wd_snapshot_t* const p_snap )
+{
+    wd_snapshot_t* old = __atomic_exchange_n( &( p_handle->current ), p_snap,
+                                              __ATOMIC_SEQ_CST );
+
+    /* Any reader which might have picked up the old pointer will have taken
+       its reference by the time that the count drains */
+    while( __atomic_load_n( &( p_handle->acquiring ), __ATOMIC_SEQ_CST ) != 0 ) {
+        sched_yield();
+    }
+
+    wd_snapshot_release( old );
+}
+
+wd_handle_t* wd_open( const char* const p_fn )
+{
+    wd_handle_t* ret_val = (wd_handle_t*)malloc( sizeof( wd_handle_t ));
+
+    /* Precondition check */
+    assert( p_fn != NULL );
+    /* !Precondition check */
+
+    if( ret_val != NULL ) {
+        memset( &( ret_val->cfg ), 0, sizeof( ret_val->cfg ));
+        ret_val->cfg.wd_entity_type = WD_ENTITY_ANY;
+        ret_val->cfg.wd_output_all = 1;
+        ret_val->acquiring = 0;
+        ret_val->fn = strdup( p_fn );
+        ret_val->current = NULL;
+
+        if(( ret_val->fn != NULL ) &&
+           ( 0 == pthread_mutex_init( &( ret_val->write_lock ), NULL ))) {
+            ret_val->cfg.list_fn = ret_val->fn;
+            ret_val->current = load_snapshot( ret_val );
+            if( ret_val->current == NULL ) {
+                pthread_mutex_destroy( &( ret_val->write_lock ));
+            }
+        }
+
+        if( ret_val->current == NULL ) {
+            free( ret_val->fn );
+            free( ret_val );
+            ret_val = NULL;
+        }
+    }
+
+    return( ret_val );
+}
+
+void wd_close( wd_handle_t* p_handle )
+{
+    if( p_handle != NULL ) {
+        wd_snapshot_release( p_handle->current );
+        pthread_mutex_destroy( &( p_handle->write_lock ));
+        free( p_handle->fn );
+        free( p_handle );
+    }
+}
+
+int wd_refresh( wd_handle_t* p_handle )
+{
+    int ret_val = WD_SUCCESS;
+    file_sig_t sig;
+
+    pthread_mutex_lock( &( p_handle->write_lock ));
+
+    file_sig_get( p_handle->fn, &sig );
+    if( !file_sig_equal( &sig, &( p_handle->current->sig ))) {
+        wd_snapshot_t* snap = load_snapshot( p_handle );
+
+        if( snap != NULL ) {
+            publish( p_handle, snap );
+        } else {
+            ret_val = WD_GENERIC_FAIL;
+        }
+    }
+
+    pthread_mutex_unlock( &( p_handle->write_lock ));
+
+    return( ret_val );
+}
+
+/** Function to apply a change to a private copy of the list */
+typedef int (*modify_fn)( dir_list_t p_list, const char* const p_dir,
+                          const char* const p_name, const time_t p_now );
+
+static int modify_add( dir_list_t p_list, const char* const p_dir,
+                       const char* const p_name, const time_t p_now )
+{
+    int ret_val = WD_GENERIC_FAIL;
+
+    if( !dir_in_list( p_list, p_dir ) &&
+        (( p_name == NULL ) || !bookmark_in_list( p_list, p_name ))) {
+        ret_val = add_dir( p_list, p_dir, p_name, p_now, -1,
+                           WD_ENTITY_UNKNOWN );
+    }
+
+    return( ret_val );
+}
+
+static int modify_remove( dir_list_t p_list, const char* const p_dir,
+                          const char* const p_name, const time_t p_now )
+{
+    return( remove_dir( p_list, p_dir ));
+}
+
+/** Copy the current list, apply a change to it, save it and publish it */
+static int modify( wd_handle_t* p_handle, modify_fn p_fn,
+                   const char* const p_dir, const char* const p_name,
+                   const time_t p_now )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    dir_list_t list;
+
+    pthread_mutex_lock( &( p_handle->write_lock ));
+
+    list = copy_dir_list( p_handle->current->list );
+
+    if( list != NULL ) {
+        dir_list_set_config( list, &( p_handle->cfg ));
+
+        if( WD_SUCCEEDED( p_fn( list, p_dir, p_name, p_now )) &&
+            WD_SUCCEEDED( save_dir_list( list, p_handle->fn ))) {
+            file_sig_t sig;
+            wd_snapshot_t* snap;
+
+            file_sig_get( p_handle->fn, &sig );
+            snap = new_snapshot( list, &sig );
+            if( snap != NULL ) {
+                publish( p_handle, snap );
+                ret_val = WD_SUCCESS;
+            }
+        } else {
+            free_dir_list( list );
+        }
+    }
+
+    pthread_mutex_unlock( &( p_handle->write_lock ));
+
+    return( ret_val );
+}
+
+int wd_add( wd_handle_t* p_handle, const char* const p_dir,
+            const char* const p_name, const time_t p_now )
+{
+    return( modify( p_handle, modify_add, p_dir, p_name, p_now ));
+}
+
+int wd_remove( wd_handle_t* p_handle, const char* const p_dir )
+{
+    return( modify( p_handle, modify_remove, p_dir, NULL, -1 ));
+}
+
+wd_snapshot_t* wd_snapshot_acquire( wd_handle_t* p_handle )
+{
+    wd_snapshot_t* ret_val;
+
+    __atomic_add_fetch( &( p_handle->acquiring ), 1, __ATOMIC_SEQ_CST );
+    ret_val = __atomic_load_n( &( p_handle->current ), __ATOMIC_SEQ_CST );
+    __atomic_add_fetch( &( ret_val->refs ), 1, __ATOMIC_SEQ_CST );
+    __atomic_sub_fetch( &( p_handle->acquiring ), 1, __ATOMIC_SEQ_CST );
+
+    return( ret_val );
+}
+
+void wd_snapshot_release( wd_snapshot_t* p_snap )
+{
+    if(( p_snap != NULL ) &&
+       ( __atomic_sub_fetch( &( p_snap->refs ), 1, __ATOMIC_SEQ_CST ) == 0 )) {
+        free_dir_list( p_snap->list );
+        free( p_snap );
+    }
+}
+
+size_t wd_count( const wd_snapshot_t* const p_snap )
+{
+    return( dir_list_get_count( p_snap->list ));
+}
+
+/** Format the path of the specified bookmark into the caller's buffer */
+static long format_entry( const wd_snapshot_t* const p_snap, const size_t p_idx,
+                          const wd_options_t* const p_opts,
+                          char* const p_buf, const size_t p_len )
+{
+    long ret_val = -1;
+    char* dir = (char*)dir_list_get_dir( p_snap->list, p_idx );
+    char* formatted = format_dir( p_opts->dir_form, p_opts->escape, dir );
+
+    if( formatted != NULL ) {
+        ret_val = (long)copy_out( p_buf, p_len, formatted );
+        if( formatted != dir ) {
+            free( formatted );
+        }
+    }
+
+    return( ret_val );
+}
+
+long wd_entry( const wd_snapshot_t* const p_snap, const size_t p_idx,
+               const wd_options_t* const p_opts,
+               char* const p_dir_buf, const size_t p_dir_len,
+               char* const p_name_buf, const size_t p_name_len )
+{
+    long ret_val = -1;
+
+    if( p_idx < dir_list_get_count( p_snap->list )) {
+        const char* name = dir_list_get_name( p_snap->list, p_idx );
+
+        ret_val = format_entry( p_snap, p_idx, p_opts, p_dir_buf, p_dir_len );
+        (void)copy_out( p_name_buf, p_name_len, ( name != NULL ) ? name : "" );
+    }
+
+    return( ret_val );
+}
+
+long wd_lookup( const wd_snapshot_t* const p_snap,
+                const char* const p_id,
+                const wd_options_t* const p_opts,
+                char* const p_buf, const size_t p_len )
+{
+    long ret_val = -1;
+    size_t idx;
+    int found;
+
+    if( sscanf( p_id, PFFST, &idx ) == 1 ) {
+        found = ( idx < dir_list_get_count( p_snap->list ));
+    } else {
+        found = dir_list_find_name( p_snap->list, p_id, &idx ) ||
+                dir_list_find_dir( p_snap->list, p_id, &idx );
+    }
+
+    if( found ) {
+        ret_val = format_entry( p_snap, idx, p_opts, p_buf, p_len );
+    }
+
+    return( ret_val );
+}
+
+static void list_line( void* p_ctx,
+                       const size_t* const p_number,
+                       const char* const p_text )
+{
+    struct list_ctx* ctx = (struct list_ctx*)p_ctx;
+    char number[ 32 ];
+    size_t room;
+
+    number[0] = '\0';
+    if( p_number != NULL ) {
+        snprintf( number, sizeof( number ),
+                  ( p_text != NULL ) ? PFFST " " : PFFST, *p_number );
+    }
+
+    room = ( ctx->used < ctx->len ) ? ( ctx->len - ctx->used ) : 0;
+    ctx->used += copy_out( ctx->buf + ( ctx->len - room ), room, number );
+    room = ( ctx->used < ctx->len ) ? ( ctx->len - ctx->used ) : 0;
+    ctx->used += copy_out( ctx->buf + ( ctx->len - room ), room,
+                           ( p_text != NULL ) ? p_text : "" );
+    room = ( ctx->used < ctx->len ) ? ( ctx->len - ctx->used ) : 0;
+    ctx->used += copy_out( ctx->buf + ( ctx->len - room ), room, "\n" );
+}
+
+size_t wd_list( const wd_snapshot_t* const p_snap,
+                const wd_options_t* const p_opts,
+                char* const p_buf, const size_t p_len )
+{
+    config_container_t cfg;
+    struct list_ctx ctx;
+
+    options_to_config( p_opts, &cfg );
+
+    ctx.buf  = p_buf;
+    ctx.len  = ( p_buf != NULL ) ? p_len : 0;
+    ctx.used = 0;
+
+    if(( p_buf != NULL ) && ( p_len > 0 )) {
+        p_buf[0] = '\0';
+    }
+
+    list_dirs_with_config( p_snap->list, &cfg, list_line, &ctx );
+
+    return( ctx.used );
+}
@@ -0,0 +1,169 @@
+/**
+   \file
+   \brief libwd allows wd's bookmark lists to be used from other programs
+          (e.g. editor plugins).
+
+   A list is opened via a handle.  Readers acquire an immutable snapshot of
+   the list from the handle, perform as many look-ups as they like without
+   any locking and then release it.  Writers (wd_refresh(), wd_add(),
+   wd_remove()) prepare a new version of the list and publish it via the
+   handle - readers holding an older snapshot are unaffected and the older
+   version is released once the last of them has finished with it.
+
+   All functions may be called concurrently from multiple threads.  Results
+   are returned in buffers supplied by the caller, following the snprintf()
+   convention: the return value is the length of the complete result and the
+   output is truncated (but always NUL terminated) if the buffer is too small.
+
+   \copyright Copyright 2018 John Bailey
+
+   \section LICENSE
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if !defined( LIBWD_H )
+#define       LIBWD_H
+
+#include "cmdln.h"
+
+#include <stddef.h>
+#include <time.h>
+
+/** Handle on a bookmark file */
+typedef struct wd_handle_s wd_handle_t;
+
+/** Immutable snapshot of the contents of a bookmark file */
+typedef struct wd_snapshot_s wd_snapshot_t;
+
+/** Options controlling the output of look-ups & listings */
+typedef struct {
+    /** Format in which file paths should be output */
+    wd_dir_format_t   dir_form;
+    /** 0 (no escape), 1 (single escape) or 2 (double-escape) */
+    int               escape;
+    /** Format of listings */
+    wd_dir_list_opt_t list_opt;
+    /** Which types of entity should be included in listings */
+    wd_entity_t       entity_type;
+    /** Whether or not to list items which don't seem to exist */
+    int               output_all;
+    /** Order of listings.  Indices passed to the callback still refer to the
+        stored order */
+    wd_sort_t         sort_order;
+} wd_options_t;
+
+/**
+    Initialise options to the same defaults as the wd command line
+
+    \param[out] p_opts Options to initialise
+*/
+void           wd_options_init( wd_options_t* const p_opts );
+
+/**
+    Open a bookmark file and load its initial contents.  A file which does not
+    exist is treated as an empty list.
+
+    \param[in] p_fn Filename of the bookmark list
+    \returns The handle or NULL in the case that memory could not be allocated
+*/
+wd_handle_t*   wd_open( const char* const p_fn );
+
+/**
+    Close a handle.  All snapshots acquired from it must have been released
+    and no other calls may be in progress on it.
+*/
+void           wd_close( wd_handle_t* p_handle );
+
+/**
+    Re-load the bookmark file if it has changed since the current snapshot
+    was loaded
+
+    \returns WD_SUCCESS in the case that the handle reflects the file
+             WD_GENERIC_FAIL in the case that re-loading failed
+*/
+int            wd_refresh( wd_handle_t* p_handle );
+
+/**
+    Add a bookmark, saving the file and publishing the updated list
+
+    \param[in] p_handle Handle of the list to update
+    \param[in] p_dir    Directory to bookmark (should already be canonical)
+    \param[in] p_name   Name of the bookmark, may be NULL
+    \param[in] p_now    Time to record as the time the bookmark was added
+    \returns WD_SUCCESS in the case that the bookmark was added
+             WD_GENERIC_FAIL if the directory or name is already in use or
+             the file could not be saved
+*/
+int            wd_add( wd_handle_t* p_handle, const char* const p_dir,
+                       const char* const p_name, const time_t p_now );
+
+/**
+    Remove a bookmark, saving the file and publishing the updated list
+
+    \returns WD_SUCCESS in the case that the bookmark was removed
+             WD_GENERIC_FAIL if it wasn't in the list or the file could not be
+             saved
+*/
+int            wd_remove( wd_handle_t* p_handle, const char* const p_dir );
+
+/**
+    Acquire the current snapshot of the list.  This never blocks.  The
+    snapshot must be released using wd_snapshot_release().
+*/
+wd_snapshot_t* wd_snapshot_acquire( wd_handle_t* p_handle );
+
+/**
+    Release a snapshot acquired using wd_snapshot_acquire()
+*/
+void           wd_snapshot_release( wd_snapshot_t* p_snap );
+
+/**
+    \returns The number of bookmarks in the snapshot
+*/
+size_t         wd_count( const wd_snapshot_t* const p_snap );
+
+/**
+    Retrieve the (formatted) path and name of the bookmark with the specified
+    index.  Either buffer may be NULL if that part is not required.
+
+    \returns The length of the formatted path or -1 in the case that the
+             index is out of range
+*/
+long           wd_entry( const wd_snapshot_t* const p_snap, const size_t p_idx,
+                         const wd_options_t* const p_opts,
+                         char* const p_dir_buf, const size_t p_dir_len,
+                         char* const p_name_buf, const size_t p_name_len );
+
+/**
+    Look up a bookmark in the same manner as 'wd -g': p_id may be an index,
+    a bookmark name or a bookmarked path
+
+    \returns The length of the formatted path or -1 in the case that no
+             bookmark was found
+*/
+long           wd_lookup( const wd_snapshot_t* const p_snap,
+                          const char* const p_id,
+                          const wd_options_t* const p_opts,
+                          char* const p_buf, const size_t p_len );
+
+/**
+    Produce the same listing as 'wd -l', one entry per line
+
+    \returns The length of the complete listing
+*/
+size_t         wd_list( const wd_snapshot_t* const p_snap,
+                        const wd_options_t* const p_opts,
+                        char* const p_buf, const size_t p_len );
+
+#endif
@@ -0,0 +1,173 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "wd.h"
+#include "list_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined __APPLE__
+#define ST_MTIME_NSEC( _s ) ((_s).st_mtimespec.tv_nsec)
+#elif defined WIN32
+#define ST_MTIME_NSEC( _s ) (0)
+#else
+#define ST_MTIME_NSEC( _s ) ((_s).st_mtim.tv_nsec)
+#endif
+
+struct list_cache_entry
+{
+    char*                    fn;
+    file_sig_t               sig;
+    dir_list_t               list;
+    struct list_cache_entry* next;
+};
+
+struct list_cache_s
+{
+    struct list_cache_entry* entries;
+};
+
+void file_sig_get( const char* const p_fn, file_sig_t* const p_sig )
+{
+    struct stat s;
+
+    memset( p_sig, 0, sizeof( *p_sig ) );
+
+    if( stat( p_fn, &s ) == 0 ) {
+        p_sig->valid      = 1;
+        p_sig->dev        = (unsigned long long)s.st_dev;
+        p_sig->ino        = (unsigned long long)s.st_ino;
+        p_sig->size       = (unsigned long long)s.st_size;
+        p_sig->mtime_sec  = (long long)s.st_mtime;
+        p_sig->mtime_nsec = (long)ST_MTIME_NSEC( s );
+    }
+}
+
+int file_sig_equal( const file_sig_t* const p_a, const file_sig_t* const p_b )
+{
+    return( p_a->valid && p_b->valid &&
+            ( p_a->dev        == p_b->dev ) &&
+            ( p_a->ino        == p_b->ino ) &&
+            ( p_a->size       == p_b->size ) &&
+            ( p_a->mtime_sec  == p_b->mtime_sec ) &&
+            ( p_a->mtime_nsec == p_b->mtime_nsec ));
+}
+
+list_cache_t new_list_cache( void )
+{
+    list_cache_t ret_val = (list_cache_t)malloc( sizeof( struct list_cache_s ) );
+
+    if( ret_val != NULL ) {
+        ret_val->entries = NULL;
+    }
+
+    return( ret_val );
+}
+
+void free_list_cache( list_cache_t p_cache )
+{
+    if( p_cache != NULL ) {
+        struct list_cache_entry* entry = p_cache->entries;
+
+        while( entry != NULL ) {
+            struct list_cache_entry* next = entry->next;
+            free_dir_list( entry->list );
+            free( entry->fn );
+            free( entry );
+            entry = next;
+        }
+        free( p_cache );
+    }
+}
+
+static struct list_cache_entry* find_entry( list_cache_t p_cache,
+                                            const char* const p_fn )
+{
+    struct list_cache_entry* entry;
+
+    for( entry = p_cache->entries; entry != NULL; entry = entry->next ) {
+        if( 0 == strcmp( entry->fn, p_fn )) {
+            break;
+        }
+    }
+
+    return( entry );
+}
+
+dir_list_t list_cache_get( list_cache_t p_cache,
+                           const config_container_t* const p_config,
+                           const char* const p_fn )
+{
+    struct list_cache_entry* entry = find_entry( p_cache, p_fn );
+    dir_list_t ret_val = NULL;
+    file_sig_t sig;
+
+    file_sig_get( p_fn, &sig );
+
+    if( entry == NULL ) {
+        entry = (struct list_cache_entry*)malloc( sizeof( struct list_cache_entry ));
+        if( entry != NULL ) {
+            entry->fn = strdup( p_fn );
+            if( entry->fn != NULL ) {
+                entry->list = NULL;
+                entry->sig.valid = 0;
+                entry->next = p_cache->entries;
+                p_cache->entries = entry;
+            } else {
+                free( entry );
+                entry = NULL;
+            }
+        }
+    }
+
+    if( entry != NULL ) {
+        if(( entry->list == NULL ) ||
+           !file_sig_equal( &sig, &( entry->sig ))) {
+            DEBUG_OUT("list cache miss for %s",p_fn);
+            free_dir_list( entry->list );
+            entry->list = load_dir_list( p_config, p_fn );
+            entry->sig = sig;
+        } else {
+            dir_list_set_config( entry->list, p_config );
+        }
+        ret_val = entry->list;
+    }
+
+    return( ret_val );
+}
+
+void list_cache_sync( list_cache_t p_cache, const char* const p_fn )
+{
+    struct list_cache_entry* entry = find_entry( p_cache, p_fn );
+
+    if( entry != NULL ) {
+        file_sig_get( p_fn, &( entry->sig ));
+    }
+}
+
+void list_cache_invalidate( list_cache_t p_cache, const char* const p_fn )
+{
+    struct list_cache_entry* entry = find_entry( p_cache, p_fn );
+
+    if( entry != NULL ) {
+        free_dir_list( entry->list );
+        entry->list = NULL;
+        entry->sig.valid = 0;
+    }
+}
@@ -0,0 +1,108 @@
+/**
+   \file
+   \brief The list_cache module keeps loaded bookmark lists in memory for
+          long-running hosts (e.g. the daemon), re-validating them against the
+          file on disk before each use
+
+   \copyright Copyright 2018 John Bailey
+
+   \section LICENSE
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if !defined( LIST_CACHE_H )
+#define       LIST_CACHE_H
+
+#include "cmdln.h"
+#include "dir_list.h"
+
+/**
+    Structure to represent a set of cached bookmark lists, keyed on filename
+*/
+typedef struct list_cache_s* list_cache_t;
+
+/**
+    Signature of a file, used to determine whether or not its contents have
+    changed since it was last loaded
+*/
+typedef struct {
+    /** Non-zero if the file could be stat'd */
+    int                valid;
+    unsigned long long dev;
+    unsigned long long ino;
+    unsigned long long size;
+    long long          mtime_sec;
+    long               mtime_nsec;
+} file_sig_t;
+
+/**
+    Retrieve the signature of the specified file
+
+    \param[in]  p_fn  Filename to examine
+    \param[out] p_sig Signature of the file.  valid will be 0 in the case that
+                      the file could not be examined
+*/
+void file_sig_get( const char* const p_fn, file_sig_t* const p_sig );
+
+/**
+    Compare two file signatures
+
+    \returns Non-zero if both signatures are valid and identical
+*/
+int  file_sig_equal( const file_sig_t* const p_a, const file_sig_t* const p_b );
+
+/**
+    Create a new, empty, cache
+
+    \returns Pointer to the newly created cache or NULL if allocation failed
+*/
+list_cache_t new_list_cache( void );
+
+/**
+    Release a cache and all of the lists held within it
+*/
+void         free_list_cache( list_cache_t p_cache );
+
+/**
+    Retrieve the bookmark list for the specified file.  The cached copy is
+    returned if the file has not changed since it was loaded, otherwise the
+    file is (re-)loaded.
+
+    The returned list remains owned by the cache and must not be freed by the
+    caller.  It is only valid until the next call into the cache.
+
+    \param[in] p_cache  Cache to search
+    \param[in] p_config Configuration options to associate with the dir list
+    \param[in] p_fn     The filename to load the bookmarks from
+    \returns The bookmark list or NULL in the case that the file could not be
+             loaded
+*/
+dir_list_t   list_cache_get( list_cache_t p_cache,
+                             const config_container_t* const p_config,
+                             const char* const p_fn );
+
+/**
+    Inform the cache that the in-memory copy of a list has been written back
+    to the file, so that the file's new signature should be associated with
+    it
+*/
+void         list_cache_sync( list_cache_t p_cache, const char* const p_fn );
+
+/**
+    Discard any cached copy of the specified file, forcing a re-load next time
+    that it is requested
+*/
+void         list_cache_invalidate( list_cache_t p_cache, const char* const p_fn );
+
+#endif
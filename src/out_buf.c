@@ -0,0 +1,208 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "out_buf.h"
+#include "timings.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+/** Size of buffer to allocate once the inline storage is full.  Output is
+    written in blocks of (at least) this size */
+#define OUT_BUF_SIZE (64U * 1024U)
+
+void out_buf_init( out_buf_t* const p_buf, FILE* const p_stream )
+{
+    /* Precondition check */
+    assert( p_buf != NULL );
+    /* !Precondition check */
+
+    p_buf->used = 0;
+    p_buf->fd = -1;
+
+    if( p_stream != NULL ) {
+        (void)fflush( p_stream );
+        p_buf->fd = fileno( p_stream );
+    }
+
+    p_buf->data = p_buf->inline_data;
+    p_buf->size = sizeof( p_buf->inline_data );
+    p_buf->allocated = 0;
+}
+
+void out_buf_release( out_buf_t* const p_buf )
+{
+    out_buf_flush( p_buf );
+
+    if( p_buf->allocated ) {
+        free( p_buf->data );
+    }
+    p_buf->data = NULL;
+    p_buf->size = 0;
+}
+
+void out_buf_flush( out_buf_t* const p_buf )
+{
+    if( p_buf->fd != -1 ) {
+        size_t done = 0;
+
+        TIMINGS_COUNT( WD_COUNTER_WRITTEN, p_buf->used );
+
+        while( done < p_buf->used ) {
+            int written = write( p_buf->fd, p_buf->data + done,
+                                 (unsigned)( p_buf->used - done ));
+            if( written > 0 ) {
+                done += (size_t)written;
+            } else if(( written < 0 ) && ( errno == EINTR )) {
+                /* Try again */
+            } else {
+                /* Nothing more can be done, drop the output as stdio would */
+                break;
+            }
+        }
+        p_buf->used = 0;
+    }
+}
+
+char* out_buf_reserve( out_buf_t* const p_buf, const size_t p_len )
+{
+    char* ret_val = NULL;
+
+    /* Move to an allocated buffer before resorting to flushing, so that
+       writes are large */
+    if((( p_buf->size - p_buf->used ) < p_len ) && p_buf->allocated ) {
+        out_buf_flush( p_buf );
+    }
+
+    if(( p_buf->size - p_buf->used ) < p_len ) {
+        size_t size = p_buf->allocated ? ( p_buf->size * 2 ) : OUT_BUF_SIZE;
+        char* data;
+
+        if( size < p_buf->used + p_len ) {
+            size = p_buf->used + p_len;
+        }
+
+        TIMINGS_COUNT( WD_COUNTER_ALLOCS, 1U );
+        if( p_buf->allocated ) {
+            data = (char*)realloc( p_buf->data, size );
+        } else {
+            data = (char*)malloc( size );
+            if( data != NULL ) {
+                memcpy( data, p_buf->data, p_buf->used );
+                p_buf->allocated = 1;
+            }
+        }
+
+        if( data != NULL ) {
+            p_buf->data = data;
+            p_buf->size = size;
+        } else {
+            /* Make what room we can */
+            out_buf_flush( p_buf );
+        }
+    }
+
+    if(( p_buf->size - p_buf->used ) >= p_len ) {
+        ret_val = p_buf->data + p_buf->used;
+    }
+
+    return( ret_val );
+}
+
+void out_buf_commit( out_buf_t* const p_buf, const size_t p_len )
+{
+    /* Precondition check */
+    assert( p_buf->used + p_len <= p_buf->size );
+    /* !Precondition check */
+
+    p_buf->used += p_len;
+}
+
+void out_buf_append( out_buf_t* const p_buf, const char* const p_data, const size_t p_len )
+{
+    char* dest = out_buf_reserve( p_buf, p_len );
+
+    if( dest != NULL ) {
+        memcpy( dest, p_data, p_len );
+        p_buf->used += p_len;
+    }
+}
+
+void out_buf_puts( out_buf_t* const p_buf, const char* const p_str )
+{
+    out_buf_append( p_buf, p_str, strlen( p_str ));
+}
+
+void out_buf_putc( out_buf_t* const p_buf, const char p_char )
+{
+    char* dest = out_buf_reserve( p_buf, 1 );
+
+    if( dest != NULL ) {
+        *dest = p_char;
+        p_buf->used++;
+    }
+}
+
+void out_buf_put_size( out_buf_t* const p_buf, size_t p_val )
+{
+    /* Enough for a 64-bit value */
+    char digits[ 20 ];
+    size_t count = sizeof( digits );
+
+    do {
+        digits[ --count ] = (char)( '0' + ( p_val % 10U ));
+        p_val /= 10U;
+    } while(( p_val != 0 ) && ( count > 0 ));
+
+    out_buf_append( p_buf, &( digits[ count ] ), sizeof( digits ) - count );
+}
+
+void out_buf_printf( out_buf_t* const p_buf, const char* const p_fmt, ... )
+{
+    va_list args;
+    size_t avail = p_buf->size - p_buf->used;
+    int len;
+
+    /* Try to format straight into the space which is already available; only
+       if that isn't enough do we need to make room and format again */
+    va_start( args, p_fmt );
+    len = vsnprintf( p_buf->data + p_buf->used, avail, p_fmt, args );
+    va_end( args );
+
+    if(( len >= 0 ) && ((size_t)len >= avail )) {
+        char* dest = out_buf_reserve( p_buf, (size_t)len + 1 );
+
+        if( dest != NULL ) {
+            va_start( args, p_fmt );
+            len = vsnprintf( dest, (size_t)len + 1, p_fmt, args );
+            va_end( args );
+        } else {
+            len = -1;
+        }
+    }
+
+    if( len > 0 ) {
+        p_buf->used += (size_t)len;
+    }
+}
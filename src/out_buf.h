@@ -0,0 +1,94 @@
+/**
+   \file
+   \brief The out_buf module provides an output buffer which text can be
+          formatted directly into, flushed to a file descriptor with large
+          write() calls
+
+   Small amounts of output are held within the out_buf_t itself; a larger
+   buffer is only allocated once that fills.  A buffer which isn't associated
+   with a stream acts as a scratch area: it grows as required rather than being
+   flushed, so that a string can be assembled in it.
+
+   As the buffer may point into itself, an out_buf_t must not be copied.
+
+   \copyright Copyright 2018 John Bailey
+
+   \section LICENSE
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if !defined( OUT_BUF_H )
+#define       OUT_BUF_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/** Size of the storage within out_buf_t, used until more is needed */
+#define OUT_BUF_INLINE_SIZE 256U
+
+typedef struct {
+    char*  data;
+    size_t used;
+    size_t size;
+    /** File descriptor to flush to, or -1 for a scratch buffer */
+    int    fd;
+    /** Non-zero if data has been allocated (rather than being inline_data) */
+    int    allocated;
+    char   inline_data[ OUT_BUF_INLINE_SIZE ];
+} out_buf_t;
+
+/**
+    Initialise a buffer
+
+    \param[out] p_buf    Buffer to initialise
+    \param[in]  p_stream Stream to output to, or NULL for a scratch buffer.
+                         Any data buffered within the stream is flushed first
+                         so that output appears in the correct order.
+*/
+void  out_buf_init( out_buf_t* const p_buf, FILE* const p_stream );
+
+/**
+    Flush any buffered output and release the buffer
+*/
+void  out_buf_release( out_buf_t* const p_buf );
+
+/**
+    Write buffered output to the file descriptor.  Does nothing for scratch
+    buffers.
+*/
+void  out_buf_flush( out_buf_t* const p_buf );
+
+/**
+    Ensure that there is space for at least p_len bytes to be written
+    directly to the buffer.  Follow with out_buf_commit().
+
+    \returns Pointer to the space or NULL in the case that it couldn't be
+             made available
+*/
+char* out_buf_reserve( out_buf_t* const p_buf, const size_t p_len );
+
+/**
+    Mark p_len bytes written to space returned by out_buf_reserve() as used
+*/
+void  out_buf_commit( out_buf_t* const p_buf, const size_t p_len );
+
+void  out_buf_append( out_buf_t* const p_buf, const char* const p_data, const size_t p_len );
+void  out_buf_puts( out_buf_t* const p_buf, const char* const p_str );
+void  out_buf_putc( out_buf_t* const p_buf, const char p_char );
+/** Append a number in decimal */
+void  out_buf_put_size( out_buf_t* const p_buf, size_t p_val );
+/** Append the output of snprintf() */
+void  out_buf_printf( out_buf_t* const p_buf, const char* const p_fmt, ... );
+
+#endif
@@ -0,0 +1,404 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if defined __linux__
+/* For copy_file_range() */
+#define _GNU_SOURCE
+#endif
+
+#include "wd.h"
+#include "render_cache.h"
+#include "os_if.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#if defined __linux__
+#include <sys/sendfile.h>
+#endif
+
+/** Used to check that cache files were created by a compatible wd */
+#define RENDER_MAGIC   0x77645243UL
+/** Bump this whenever the file layout changes */
+#define RENDER_VERSION 4U
+
+#define RENDER_DIR     "wd"
+#define RENDER_DIR_FALLBACK ".cache"
+
+/** The settings which affect the content of a listing */
+struct render_key
+{
+    int32_t list_opt;
+    int32_t dir_form;
+    int32_t escape;
+    int32_t entity;
+    int32_t output_all;
+    int32_t sort_order;
+    /** Non-zero if search is of a regular expression rather than a glob */
+    int32_t search_re;
+    /** Hash of the tags which listed entries must have, or 0 for all */
+    uint64_t tags;
+    /** Hash of the pattern which listed entries must match, or 0 for all */
+    uint64_t search;
+};
+
+/** Header of a cache file.  It is followed by the path of the bookmark file
+    and then the listing itself */
+struct render_hdr
+{
+    uint32_t          magic;
+    uint32_t          version;
+    struct render_key key;
+    /** Signature of the bookmark file which was rendered */
+    file_sig_t        sig;
+    int64_t           rendered_at;
+    uint32_t          path_len;
+    uint32_t          reserved;
+    uint64_t          length;
+};
+
+/** Buffer into which a listing is rendered */
+struct render_buf
+{
+    char*  data;
+    size_t used;
+    size_t size;
+    int    failed;
+};
+
+/** FNV-1a, used to derive cache file names */
+static uint64_t render_hash( const void* const p_data, const size_t p_len,
+                             uint64_t p_hash )
+{
+    const unsigned char* data = (const unsigned char*)p_data;
+    size_t loop;
+
+    for( loop = 0; loop < p_len; loop++ ) {
+        p_hash ^= data[ loop ];
+        p_hash *= 0x100000001b3ULL;
+    }
+
+    return( p_hash );
+}
+
+static void make_key( const config_container_t* const p_config,
+                      struct render_key* const p_key )
+{
+    memset( p_key, 0, sizeof( *p_key ));
+    p_key->list_opt   = (int32_t)p_config->wd_dir_list_opt;
+    p_key->dir_form   = (int32_t)p_config->wd_dir_form;
+    p_key->escape     = (int32_t)p_config->wd_escape_output;
+    p_key->entity     = (int32_t)p_config->wd_entity_type;
+    p_key->output_all = (int32_t)p_config->wd_output_all;
+    p_key->sort_order = (int32_t)p_config->wd_sort_order;
+    p_key->tags       = ( p_config->wd_tags != NULL ) ?
+                            render_hash( p_config->wd_tags, strlen( p_config->wd_tags ) + 1,
+                                         0xcbf29ce484222325ULL ) : 0;
+    if( p_config->wd_search != NULL ) {
+        int regex;
+        const char* const pattern = search_pattern( p_config->wd_search, &regex );
+
+        p_key->search_re = regex;
+        p_key->search    = render_hash( pattern, strlen( pattern ) + 1,
+                                        0xcbf29ce484222325ULL );
+    }
+}
+
+/** Whether or not the listing depends on the state of the filesystem as well
+    as the contents of the bookmark file */
+static int key_uses_filesystem( const struct render_key* const p_key )
+{
+    return(( p_key->entity != WD_ENTITY_ANY ) || ( p_key->output_all == 0 ));
+}
+
+/** Determine the name of the cache file for a listing, creating the cache
+    directory if necessary
+
+    \returns malloc()'d filename or NULL */
+static char* cache_fn( const char* const p_list_fn,
+                       const struct render_key* const p_key,
+                       const int p_create )
+{
+    char* ret_val = NULL;
+    const char* xdg = getenv( "XDG_CACHE_HOME" );
+    char* home = NULL;
+    const char* base = xdg;
+    const char* sub = "";
+    size_t len;
+
+    if(( xdg == NULL ) || ( xdg[0] == '\0' )) {
+        home = get_home_dir();
+        base = home;
+        sub = "/" RENDER_DIR_FALLBACK;
+    }
+
+    if( base != NULL ) {
+        /* base + sub + "/wd/render-<16 hex digits>" */
+        len = strlen( base ) + strlen( sub ) + strlen( RENDER_DIR ) + 32;
+        ret_val = (char*)malloc( len );
+
+        if( ret_val != NULL ) {
+            uint64_t hash = render_hash( p_list_fn, strlen( p_list_fn ) + 1,
+                                         0xcbf29ce484222325ULL );
+            hash = render_hash( p_key, sizeof( *p_key ), hash );
+
+            if( p_create ) {
+                snprintf( ret_val, len, "%s%s", base, sub );
+                (void)mkdir( ret_val, S_IRWXU );
+                snprintf( ret_val, len, "%s%s/%s", base, sub, RENDER_DIR );
+                (void)mkdir( ret_val, S_IRWXU );
+            }
+            snprintf( ret_val, len, "%s%s/%s/render-%016llx",
+                      base, sub, RENDER_DIR, (unsigned long long)hash );
+        }
+    }
+
+    if( home != NULL ) {
+        release_home_dir( home );
+    }
+
+    return( ret_val );
+}
+
+/** Copy p_len bytes from p_fd, starting at p_off, to stdout
+
+    \returns WD_SUCCESS if any output was produced (in which case the caller
+             can't fall back to rendering the listing itself) */
+static int copy_to_stdout( const int p_fd, off_t p_off, size_t p_len )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    ssize_t done = 0;
+    const int out = fileno( stdout );
+
+    (void)fflush( stdout );
+
+    if( p_len == 0 ) {
+        ret_val = WD_SUCCESS;
+    }
+
+#if defined __linux__
+    {
+        struct stat s;
+        int to_file = ( fstat( out, &s ) == 0 ) && S_ISREG( s.st_mode );
+
+        while( p_len > 0 ) {
+            done = to_file ? copy_file_range( p_fd, &p_off, out, NULL, p_len, 0 )
+                           : sendfile( out, p_fd, &p_off, p_len );
+            if( done <= 0 ) {
+                break;
+            }
+            p_len -= (size_t)done;
+            ret_val = WD_SUCCESS;
+        }
+    }
+#endif
+
+    /* Fall back to copying via a buffer (e.g. if the kernel doesn't support
+       the above for this type of stdout) */
+    if( p_len > 0 ) {
+        char buf[ 65536 ];
+
+        while( p_len > 0 ) {
+            done = pread( p_fd, buf, ( p_len < sizeof( buf )) ? p_len : sizeof( buf ), p_off );
+            if(( done <= 0 ) || ( write( out, buf, (size_t)done ) != done )) {
+                break;
+            }
+            p_off += done;
+            p_len -= (size_t)done;
+            ret_val = WD_SUCCESS;
+        }
+    }
+
+    return( ret_val );
+}
+
+int render_cache_serve( const config_container_t* const p_config,
+                        file_sig_t* const p_sig )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    struct render_key key;
+    char* fn;
+
+    /* Precondition check */
+    assert( p_config != NULL );
+    assert( p_config->list_fn != NULL );
+    /* !Precondition check */
+
+    make_key( p_config, &key );
+    file_sig_get( p_config->list_fn, p_sig );
+    fn = cache_fn( p_config->list_fn, &key, 0 );
+
+    if(( fn != NULL ) && p_sig->valid ) {
+        int fd = open( fn, O_RDONLY );
+
+        if( fd != -1 ) {
+            struct render_hdr hdr;
+            struct stat s;
+            size_t path_len = strlen( p_config->list_fn );
+            char* path = (char*)malloc( path_len + 1 );
+
+            if(( path != NULL ) &&
+               ( fstat( fd, &s ) == 0 ) &&
+               ( pread( fd, &hdr, sizeof( hdr ), 0 ) == sizeof( hdr )) &&
+               ( hdr.magic == RENDER_MAGIC ) &&
+               ( hdr.version == RENDER_VERSION ) &&
+               ( 0 == memcmp( &( hdr.key ), &key, sizeof( key ))) &&
+               file_sig_equal( &( hdr.sig ), p_sig ) &&
+               ( hdr.path_len == path_len ) &&
+               ((uint64_t)s.st_size == sizeof( hdr ) + path_len + hdr.length ) &&
+               ( pread( fd, path, path_len, sizeof( hdr )) == (ssize_t)path_len ) &&
+               ( 0 == memcmp( path, p_config->list_fn, path_len )) &&
+               ( !key_uses_filesystem( &key ) ||
+                 (( p_config->wd_now_time >= (time_t)hdr.rendered_at ) &&
+                  ( p_config->wd_now_time - (time_t)hdr.rendered_at <= p_config->wd_render_ttl )))) {
+                DEBUG_OUT("render cache hit for %s", p_config->list_fn);
+                ret_val = copy_to_stdout( fd, (off_t)( sizeof( hdr ) + path_len ),
+                                          (size_t)hdr.length );
+            }
+            free( path );
+            close( fd );
+        }
+    }
+
+    free( fn );
+
+    return( ret_val );
+}
+
+static void render_line( void* p_ctx,
+                         const size_t* const p_number,
+                         const char* const p_text )
+{
+    struct render_buf* buf = (struct render_buf*)p_ctx;
+    char number[ 32 ];
+    size_t text_len = ( p_text != NULL ) ? strlen( p_text ) : 0;
+    size_t number_len = 0;
+
+    if( p_number != NULL ) {
+        number_len = (size_t)snprintf( number, sizeof( number ),
+                                       ( p_text != NULL ) ? PFFST " " : PFFST,
+                                       *p_number );
+    }
+
+    if( buf->used + number_len + text_len + 1 > buf->size ) {
+        size_t size = ( buf->size * 2 ) + number_len + text_len + 1;
+        char* data = (char*)realloc( buf->data, size );
+
+        if( data == NULL ) {
+            buf->failed = 1;
+        } else {
+            buf->data = data;
+            buf->size = size;
+        }
+    }
+
+    if( !buf->failed ) {
+        memcpy( buf->data + buf->used, number, number_len );
+        buf->used += number_len;
+        if( p_text != NULL ) {
+            memcpy( buf->data + buf->used, p_text, text_len );
+            buf->used += text_len;
+        }
+        buf->data[ buf->used++ ] = '\n';
+    }
+}
+
+/** Store a rendered listing.  The file is written under a temporary name and
+    then renamed, so that concurrent readers see either the old or the new
+    entry in its entirety. */
+static void store( const config_container_t* const p_config,
+                   const struct render_key* const p_key,
+                   const file_sig_t* const p_sig,
+                   const struct render_buf* const p_buf )
+{
+    char* fn = cache_fn( p_config->list_fn, p_key, 1 );
+    char* tmp_fn = ( fn != NULL ) ? (char*)malloc( strlen( fn ) + 32 ) : NULL;
+
+    if( tmp_fn != NULL ) {
+        FILE* fp;
+
+        sprintf( tmp_fn, "%s.%lu", fn, (unsigned long)getpid() );
+        fp = fopen( tmp_fn, "wb" );
+
+        if( fp != NULL ) {
+            struct render_hdr hdr;
+            int ok;
+
+            memset( &hdr, 0, sizeof( hdr ));
+            hdr.magic       = RENDER_MAGIC;
+            hdr.version     = RENDER_VERSION;
+            hdr.key         = *p_key;
+            hdr.sig         = *p_sig;
+            hdr.rendered_at = (int64_t)p_config->wd_now_time;
+            hdr.path_len    = (uint32_t)strlen( p_config->list_fn );
+            hdr.length      = p_buf->used;
+
+            ok = ( fwrite( &hdr, sizeof( hdr ), 1, fp ) == 1 ) &&
+                 ( fwrite( p_config->list_fn, 1, hdr.path_len, fp ) == hdr.path_len ) &&
+                 ( fwrite( p_buf->data, 1, p_buf->used, fp ) == p_buf->used );
+            ok = ( fclose( fp ) == 0 ) && ok;
+
+            if( !ok || ( rename( tmp_fn, fn ) != 0 )) {
+                (void)remove( tmp_fn );
+            }
+        }
+    }
+
+    free( tmp_fn );
+    free( fn );
+}
+
+void render_cache_list( const config_container_t* const p_config,
+                        const dir_list_t p_list,
+                        const file_sig_t* const p_sig )
+{
+    struct render_buf buf;
+    struct render_key key;
+
+    /* Precondition check */
+    assert( p_config != NULL );
+    assert( p_list != NULL );
+    /* !Precondition check */
+
+    buf.data = NULL;
+    buf.used = 0;
+    buf.size = 0;
+    buf.failed = 0;
+
+    list_dirs_with( p_list, render_line, &buf );
+
+    if( buf.failed ) {
+        /* Not enough memory to render into a buffer - output directly */
+        list_dirs( p_list );
+    } else {
+        (void)fwrite( buf.data, 1, buf.used, stdout );
+
+        /* Only listings of an existing file can be validated later */
+        if( p_sig->valid ) {
+            make_key( p_config, &key );
+            store( p_config, &key, p_sig, &buf );
+        }
+    }
+
+    free( buf.data );
+}
@@ -0,0 +1,68 @@
+/**
+   \file
+   \brief The render_cache module stores the output of listings (-l) so that
+          repeated requests for the same listing can be served by copying a
+          file to stdout rather than loading the bookmark list and
+          formatting each entry
+
+   Each variant of the listing (list options, path format, escaping, entity
+   filter) is cached in its own file under $XDG_CACHE_HOME/wd (or
+   ~/.cache/wd).  An entry is only used if the bookmark file's signature
+   (its generation) matches the one recorded when the entry was rendered.
+   Listings which depend on the state of the filesystem (i.e. filtered by
+   entity type or excluding non-existent entries) additionally expire after
+   config_container_t::wd_render_ttl seconds.
+
+   \copyright Copyright 2018 John Bailey
+
+   \section LICENSE
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if !defined( RENDER_CACHE_H )
+#define       RENDER_CACHE_H
+
+#include "cmdln.h"
+#include "dir_list.h"
+#include "list_cache.h"
+
+/**
+    Output the listing requested by p_config from the cache, if there is a
+    valid entry for it
+
+    \param[in]  p_config Program settings
+    \param[out] p_sig    Signature of the bookmark file at the time of the
+                         check, to be passed to render_cache_list()
+    \returns WD_SUCCESS in the case that the listing was output,
+             WD_GENERIC_FAIL if there was no valid entry, in which case the
+             caller should load the list and call render_cache_list()
+*/
+int  render_cache_serve( const config_container_t* const p_config,
+                         file_sig_t* const p_sig );
+
+/**
+    Output the listing requested by p_config (as per list_dirs()) and store
+    it in the cache
+
+    \param[in] p_config Program settings
+    \param[in] p_list   The bookmark list, as loaded from
+                        config_container_t::list_fn
+    \param[in] p_sig    Signature from render_cache_serve(), taken before the
+                        list was loaded
+*/
+void render_cache_list( const config_container_t* const p_config,
+                        const dir_list_t p_list,
+                        const file_sig_t* const p_sig );
+
+#endif
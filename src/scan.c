@@ -0,0 +1,587 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "wd.h"
+#include "scan.h"
+#include "os_if.h"
+#include "str_table.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined __linux__
+#include <sys/syscall.h>
+#endif
+
+/** Upper limit on the number of threads crawling */
+#define MAX_SCAN_THREADS 64U
+
+/** Size of the buffer into which directory entries are read */
+#define DENTS_BUFFER_SIZE 32768U
+
+/** Initial allocation of each worker's queue */
+#define MIN_QUEUE_SIZE 64U
+
+/** Directories which are never descended into, as they're rarely of interest
+    and often large */
+static const char* const default_prune[] = { ".git", ".hg", ".svn", "node_modules" };
+
+static const char* const default_marker = ".git";
+
+#if defined __linux__
+/** Layout of the records returned by getdents64 */
+struct linux_dirent64
+{
+    uint64_t       d_ino;
+    int64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+#endif
+
+/** Double-ended queue of paths awaiting crawling.  The owning worker pushes
+    and pops at the tail, so that it works depth-first on the directories it
+    has most recently seen, while other workers steal from the head, taking
+    the directories nearest the root & so (generally) the most work. */
+typedef struct
+{
+    pthread_mutex_t lock;
+    char**          items;
+    size_t          head;
+    size_t          tail;
+    size_t          size;
+} scan_queue_t;
+
+struct scan_ctx;
+
+typedef struct
+{
+    struct scan_ctx* ctx;
+    size_t           id;
+    pthread_t        thread;
+    scan_queue_t     queue;
+    /** Matching directories found by this worker */
+    char**           found;
+    size_t           found_count;
+    size_t           found_size;
+    /** Names of the subdirectories of the directory being crawled, each NUL
+        terminated */
+    char*            names;
+    size_t           names_size;
+    /** Number of directories crawled, for reporting */
+    unsigned long    dirs;
+} scan_worker_t;
+
+typedef struct scan_ctx
+{
+    const config_container_t* cfg;
+    const char* const*        markers;
+    size_t                    marker_count;
+    scan_worker_t*            workers;
+    size_t                    worker_count;
+    /** Number of paths queued or being crawled.  Once this reaches zero there
+        can be no more work. */
+    size_t                    pending;
+    /** Set if memory couldn't be allocated, meaning that some of the tree
+        may not have been crawled */
+    int                       failed;
+} scan_ctx_t;
+
+static int queue_push( scan_queue_t* const p_queue, char* const p_path )
+{
+    int ret_val = WD_SUCCESS;
+
+    pthread_mutex_lock( &( p_queue->lock ));
+
+    if( p_queue->tail == p_queue->size ) {
+        if( p_queue->head > ( p_queue->size / 2U )) {
+            /* Mostly stolen from - reuse the space at the head */
+            memmove( p_queue->items, p_queue->items + p_queue->head,
+                     ( p_queue->tail - p_queue->head ) * sizeof( char* ));
+            p_queue->tail -= p_queue->head;
+            p_queue->head = 0;
+        } else {
+            const size_t new_size = ( p_queue->size == 0 ) ? MIN_QUEUE_SIZE :
+                                                             ( p_queue->size * 2U );
+            char** const new_items = (char**)realloc( p_queue->items,
+                                                      new_size * sizeof( char* ));
+            if( new_items != NULL ) {
+                p_queue->items = new_items;
+                p_queue->size = new_size;
+            } else {
+                ret_val = WD_GENERIC_FAIL;
+            }
+        }
+    }
+
+    if( WD_SUCCEEDED( ret_val )) {
+        p_queue->items[ p_queue->tail++ ] = p_path;
+    }
+
+    pthread_mutex_unlock( &( p_queue->lock ));
+
+    return( ret_val );
+}
+
+/** Take a path from the queue, from the tail if p_steal is zero or the head
+    otherwise
+
+    \returns The path or NULL if the queue is empty */
+static char* queue_take( scan_queue_t* const p_queue, const int p_steal )
+{
+    char* ret_val = NULL;
+
+    pthread_mutex_lock( &( p_queue->lock ));
+
+    if( p_queue->tail > p_queue->head ) {
+        if( p_steal ) {
+            ret_val = p_queue->items[ p_queue->head++ ];
+        } else {
+            ret_val = p_queue->items[ --p_queue->tail ];
+        }
+        if( p_queue->head == p_queue->tail ) {
+            p_queue->head = 0;
+            p_queue->tail = 0;
+        }
+    }
+
+    pthread_mutex_unlock( &( p_queue->lock ));
+
+    return( ret_val );
+}
+
+/** Add a path to the worker's queue, taking ownership of it */
+static void queue_dir( scan_worker_t* const p_worker, char* const p_path )
+{
+    __atomic_add_fetch( &( p_worker->ctx->pending ), 1U, __ATOMIC_RELAXED );
+
+    if( !WD_SUCCEEDED( queue_push( &( p_worker->queue ), p_path ))) {
+        __atomic_sub_fetch( &( p_worker->ctx->pending ), 1U, __ATOMIC_RELAXED );
+        __atomic_store_n( &( p_worker->ctx->failed ), 1, __ATOMIC_RELAXED );
+        free( p_path );
+    }
+}
+
+/** Record a matching directory, taking ownership of the path */
+static void add_found( scan_worker_t* const p_worker, char* const p_path )
+{
+    if( p_worker->found_count == p_worker->found_size ) {
+        const size_t new_size = ( p_worker->found_size * 2U ) + MIN_QUEUE_SIZE;
+        char** const new_found = (char**)realloc( p_worker->found,
+                                                  new_size * sizeof( char* ));
+        if( new_found != NULL ) {
+            p_worker->found = new_found;
+            p_worker->found_size = new_size;
+        }
+    }
+
+    if( p_worker->found_count < p_worker->found_size ) {
+        p_worker->found[ p_worker->found_count++ ] = p_path;
+    } else {
+        __atomic_store_n( &( p_worker->ctx->failed ), 1, __ATOMIC_RELAXED );
+        free( p_path );
+    }
+}
+
+static int is_pruned( const config_container_t* const p_cfg, const char* const p_name )
+{
+    int ret_val = 0;
+    size_t loop;
+
+    for( loop = 0; ( loop < sizeof( default_prune ) / sizeof( default_prune[0] )) && !ret_val; loop++ ) {
+        ret_val = ( 0 == strcmp( p_name, default_prune[ loop ] ));
+    }
+    for( loop = 0; ( loop < p_cfg->wd_scan_prune_count ) && !ret_val; loop++ ) {
+        ret_val = ( 0 == strcmp( p_name, p_cfg->wd_scan_prune[ loop ] ));
+    }
+
+    return( ret_val );
+}
+
+/** Deal with an entry of the directory being crawled
+
+    \param p_fd      Descriptor of the directory being crawled
+    \param p_is_dir  Whether or not the entry is a directory, or -1 if not
+                     known
+    \param p_used    Space used in the worker's list of subdirectory names
+    \returns Non-zero if the entry marks the directory as a match */
+static int crawl_entry( scan_worker_t* const p_worker, const int p_fd,
+                        const char* const p_name, int p_is_dir,
+                        size_t* const p_used )
+{
+    const scan_ctx_t* const ctx = p_worker->ctx;
+    int ret_val = 0;
+    size_t loop;
+
+    if(( p_name[0] == '.' ) &&
+       (( p_name[1] == '\0' ) || (( p_name[1] == '.' ) && ( p_name[2] == '\0' )))) {
+        return( 0 );
+    }
+
+    for( loop = 0; ( loop < ctx->marker_count ) && !ret_val; loop++ ) {
+        ret_val = ( 0 == strcmp( p_name, ctx->markers[ loop ] ));
+    }
+
+    if( !ret_val && !is_pruned( ctx->cfg, p_name )) {
+        if( p_is_dir < 0 ) {
+            struct stat s;
+            p_is_dir = ( fstatat( p_fd, p_name, &s, AT_SYMLINK_NOFOLLOW ) == 0 ) &&
+                       S_ISDIR( s.st_mode );
+        }
+
+        if( p_is_dir ) {
+            const size_t len = strlen( p_name ) + 1U;
+
+            if( *p_used + len > p_worker->names_size ) {
+                const size_t new_size = ( p_worker->names_size * 2U ) + len;
+                char* const new_names = (char*)realloc( p_worker->names, new_size );
+                if( new_names != NULL ) {
+                    p_worker->names = new_names;
+                    p_worker->names_size = new_size;
+                }
+            }
+            if( *p_used + len <= p_worker->names_size ) {
+                memcpy( p_worker->names + *p_used, p_name, len );
+                *p_used += len;
+            } else {
+                __atomic_store_n( &( p_worker->ctx->failed ), 1, __ATOMIC_RELAXED );
+            }
+        }
+    }
+
+    return( ret_val );
+}
+
+/** Read the entries of a directory, recording it if it's a match or
+    queueing its subdirectories otherwise.  Takes ownership of p_path. */
+static void crawl_dir( scan_worker_t* const p_worker, char* const p_path )
+{
+    const int fd = open( p_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+    size_t used = 0;
+    int matched = 0;
+
+    if( fd < 0 ) {
+        free( p_path );
+        return;
+    }
+
+    p_worker->dirs++;
+
+#if defined __linux__
+    {
+        /* Entries are read in bulk & their types used directly, so that only
+           entries of unknown type need a stat */
+        char buf[ DENTS_BUFFER_SIZE ];
+        long got;
+
+        while( !matched &&
+               (( got = syscall( SYS_getdents64, fd, buf, sizeof( buf ))) > 0 )) {
+            long off;
+
+            for( off = 0; ( off < got ) && !matched; ) {
+                const struct linux_dirent64* const ent =
+                    (const struct linux_dirent64*)( buf + off );
+                const int is_dir = ( ent->d_type == DT_UNKNOWN ) ? -1 :
+                                   ( ent->d_type == DT_DIR );
+
+                matched = crawl_entry( p_worker, fd, ent->d_name, is_dir, &used );
+                off += ent->d_reclen;
+            }
+        }
+        close( fd );
+    }
+#else
+    {
+        DIR* const dir = fdopendir( fd );
+
+        if( dir != NULL ) {
+            const struct dirent* ent;
+
+            while( !matched && (( ent = readdir( dir )) != NULL )) {
+#if defined DT_DIR
+                const int is_dir = ( ent->d_type == DT_UNKNOWN ) ? -1 :
+                                   ( ent->d_type == DT_DIR );
+#else
+                const int is_dir = -1;
+#endif
+                matched = crawl_entry( p_worker, fd, ent->d_name, is_dir, &used );
+            }
+            closedir( dir );
+        } else {
+            close( fd );
+        }
+    }
+#endif
+
+    if( matched ) {
+        add_found( p_worker, p_path );
+    } else {
+        const size_t path_len = strlen( p_path );
+        /* Avoid doubling the separator when crawling the root */
+        const size_t sep_len = ( p_path[ path_len - 1U ] == '/' ) ? 0 : 1U;
+        size_t pos = 0;
+
+        while( pos < used ) {
+            const char* const name = p_worker->names + pos;
+            const size_t name_len = strlen( name );
+            const size_t child_len = path_len + sep_len + name_len;
+
+            if( child_len < MAXPATHLEN ) {
+                char* const child = (char*)malloc( child_len + 1U );
+
+                if( child != NULL ) {
+                    memcpy( child, p_path, path_len );
+                    child[ path_len ] = '/';
+                    memcpy( child + path_len + sep_len, name, name_len + 1U );
+                    queue_dir( p_worker, child );
+                } else {
+                    __atomic_store_n( &( p_worker->ctx->failed ), 1, __ATOMIC_RELAXED );
+                }
+            }
+            pos += name_len + 1U;
+        }
+
+        free( p_path );
+    }
+}
+
+static void* scan_worker( void* p_arg )
+{
+    scan_worker_t* const worker = (scan_worker_t*)p_arg;
+    scan_ctx_t* const ctx = worker->ctx;
+
+    for( ;; ) {
+        char* path = queue_take( &( worker->queue ), 0 );
+        size_t loop;
+
+        for( loop = 1; ( path == NULL ) && ( loop < ctx->worker_count ); loop++ ) {
+            path = queue_take( &( ctx->workers[ ( worker->id + loop ) % ctx->worker_count ].queue ), 1 );
+        }
+
+        if( path != NULL ) {
+            crawl_dir( worker, path );
+            /* Only once any subdirectories have been queued */
+            __atomic_sub_fetch( &( ctx->pending ), 1U, __ATOMIC_RELEASE );
+        } else if( __atomic_load_n( &( ctx->pending ), __ATOMIC_ACQUIRE ) == 0 ) {
+            break;
+        } else {
+            /* Other workers are still crawling & may queue more */
+            sched_yield();
+        }
+    }
+
+    return( NULL );
+}
+
+static int compare_paths( const void* p_a, const void* p_b )
+{
+    return( strcmp( *(char* const*)p_a, *(char* const*)p_b ));
+}
+
+/** Add bookmarks for the matching directories, which are sorted so that
+    the order of the list doesn't depend on the order in which they were
+    found
+
+    \returns Non-zero if the list was modified */
+static int add_found_dirs( const config_container_t* const p_config,
+                           const char* const p_cmd,
+                           dir_list_t p_list,
+                           char** const p_found, const size_t p_count,
+                           const unsigned long p_dirs )
+{
+    int ret_val = 0;
+    str_table_t paths = str_table_new();
+    unsigned long added = 0;
+    unsigned long matched = 0;
+    size_t loop;
+
+    qsort( p_found, p_count, sizeof( char* ), compare_paths );
+
+    for( loop = 0; ( loop < dir_list_get_count( p_list )) && ( paths != NULL ); loop++ ) {
+        if( !WD_SUCCEEDED( str_table_add( paths, dir_list_get_dir( p_list, loop ), loop ))) {
+            str_table_free( paths );
+            paths = NULL;
+        }
+    }
+
+    if( paths == NULL ) {
+        fprintf( stderr, "%s: Error: Out of memory\n", p_cmd );
+    } else {
+        for( loop = 0; loop < p_count; loop++ ) {
+            const size_t* idx;
+
+            /* Roots may overlap */
+            if(( loop > 0 ) && ( 0 == strcmp( p_found[ loop ], p_found[ loop - 1U ] ))) {
+                continue;
+            }
+            matched++;
+
+            idx = str_table_find( paths, p_found[ loop ] );
+            if( idx != NULL ) {
+                /* Already bookmarked - refresh what's known about it */
+                if( dir_list_get_type( p_list, *idx ) != WD_ENTITY_DIR ) {
+                    dir_list_set_type( p_list, *idx, WD_ENTITY_DIR );
+                    ret_val = 1;
+                }
+            } else if( WD_SUCCEEDED( add_dir( p_list, p_found[ loop ], NULL,
+                                              p_config->wd_now_time, -1,
+                                              WD_ENTITY_DIR ))) {
+                added++;
+                ret_val = 1;
+            } else {
+                fprintf( stderr, "%s: Error: Failed to add bookmark to: '%s'\n",
+                         p_cmd, p_found[ loop ] );
+            }
+        }
+
+        fprintf( stdout, "Found %lu matching directories (%lu new) in %lu scanned\n",
+                 matched, added, p_dirs );
+        str_table_free( paths );
+    }
+
+    return( ret_val );
+}
+
+int scan_dirs( const config_container_t* const p_config,
+               const char* const p_cmd,
+               dir_list_t p_list )
+{
+    int ret_val = 0;
+    scan_ctx_t ctx;
+    long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+    size_t loop;
+
+    /* Precondition check */
+    assert( p_config != NULL );
+    assert( p_cmd != NULL );
+    assert( p_list != NULL );
+    /* !Precondition check */
+
+    ctx.cfg = p_config;
+    if( p_config->wd_scan_marker_count > 0 ) {
+        ctx.markers = p_config->wd_scan_markers;
+        ctx.marker_count = p_config->wd_scan_marker_count;
+    } else {
+        ctx.markers = &default_marker;
+        ctx.marker_count = 1;
+    }
+    ctx.worker_count = ( cpus < 1 ) ? 1U :
+                       ( (size_t)cpus > MAX_SCAN_THREADS ) ? MAX_SCAN_THREADS :
+                                                             (size_t)cpus;
+    ctx.pending = 0;
+    ctx.failed = 0;
+    ctx.workers = (scan_worker_t*)calloc( ctx.worker_count, sizeof( scan_worker_t ));
+
+    if( ctx.workers == NULL ) {
+        fprintf( stderr, "%s: Error: Out of memory\n", p_cmd );
+    } else {
+        char** found = NULL;
+        size_t found_count = 0;
+        unsigned long dirs = 0;
+        size_t started;
+
+        for( loop = 0; loop < ctx.worker_count; loop++ ) {
+            ctx.workers[ loop ].ctx = &ctx;
+            ctx.workers[ loop ].id = loop;
+            pthread_mutex_init( &( ctx.workers[ loop ].queue.lock ), NULL );
+        }
+
+        /* Spread the roots over the workers, though they'll be stolen as
+           necessary anyway */
+        for( loop = 0; loop < p_config->wd_scan_root_count; loop++ ) {
+            char root[ MAXPATHLEN ];
+            struct stat s;
+
+            canonicalize_dir( p_config->wd_scan_roots[ loop ], root );
+            if(( stat( p_config->wd_scan_roots[ loop ], &s ) != 0 ) ||
+               !S_ISDIR( s.st_mode )) {
+                fprintf( stderr, "%s: Warning: Unable to scan '%s'\n",
+                         p_cmd, p_config->wd_scan_roots[ loop ] );
+            } else {
+                char* const path = strdup( root );
+                if( path != NULL ) {
+                    queue_dir( &( ctx.workers[ loop % ctx.worker_count ] ), path );
+                }
+            }
+        }
+
+        /* This thread acts as the first worker */
+        for( started = 1; started < ctx.worker_count; started++ ) {
+            if( pthread_create( &( ctx.workers[ started ].thread ), NULL,
+                                scan_worker, &( ctx.workers[ started ] )) != 0 ) {
+                break;
+            }
+        }
+        /* Any workers which couldn't be started still have their queues
+           stolen from */
+        (void)scan_worker( &( ctx.workers[ 0 ] ));
+        for( loop = 1; loop < started; loop++ ) {
+            pthread_join( ctx.workers[ loop ].thread, NULL );
+        }
+
+        if( __atomic_load_n( &ctx.failed, __ATOMIC_RELAXED )) {
+            fprintf( stderr, "%s: Warning: Out of memory, scan may be incomplete\n",
+                     p_cmd );
+        }
+
+        for( loop = 0; loop < ctx.worker_count; loop++ ) {
+            found_count += ctx.workers[ loop ].found_count;
+            dirs += ctx.workers[ loop ].dirs;
+        }
+        DEBUG_OUT("scan crawled %lu directories using " PFFST " threads",
+                  dirs, ctx.worker_count);
+
+        found = (char**)malloc(( found_count + 1U ) * sizeof( char* ));
+        if( found != NULL ) {
+            found_count = 0;
+            for( loop = 0; loop < ctx.worker_count; loop++ ) {
+                memcpy( found + found_count, ctx.workers[ loop ].found,
+                        ctx.workers[ loop ].found_count * sizeof( char* ));
+                found_count += ctx.workers[ loop ].found_count;
+            }
+            ret_val = add_found_dirs( p_config, p_cmd, p_list,
+                                      found, found_count, dirs );
+            free( found );
+        } else {
+            fprintf( stderr, "%s: Error: Out of memory\n", p_cmd );
+        }
+
+        for( loop = 0; loop < ctx.worker_count; loop++ ) {
+            scan_worker_t* const worker = &( ctx.workers[ loop ] );
+            size_t item;
+
+            for( item = 0; item < worker->found_count; item++ ) {
+                free( worker->found[ item ] );
+            }
+            free( worker->found );
+            free( worker->names );
+            free( worker->queue.items );
+            pthread_mutex_destroy( &( worker->queue.lock ));
+        }
+        free( ctx.workers );
+    }
+
+    return( ret_val );
+}
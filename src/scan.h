@@ -0,0 +1,47 @@
+/**
+   \file
+   \brief The scan module crawls directory trees in parallel, adding
+          bookmarks for the directories which contain a marker (e.g. the
+          roots of git checkouts)
+
+   \copyright Copyright 2018 John Bailey
+
+   \section LICENSE
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if !defined( SCAN_H )
+#define       SCAN_H
+
+#include "cmdln.h"
+#include "dir_list.h"
+
+/**
+    Crawl each of p_config->wd_scan_roots for directories containing an
+    entry named as one of p_config->wd_scan_markers (.git if none), adding a
+    bookmark for each which isn't already in the list.  Bookmarks which are
+    already present are refreshed.  Symbolic links aren't followed and the
+    crawl doesn't descend into matching directories or those named in
+    p_config->wd_scan_prune.
+
+    \param p_config Program settings
+    \param p_cmd    String referencing the executing program
+    \param p_list   List to add the bookmarks to
+    \returns Non-zero if the list has been modified and needs saving
+*/
+int scan_dirs( const config_container_t* const p_config,
+               const char* const p_cmd,
+               dir_list_t p_list );
+
+#endif
@@ -0,0 +1,398 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "search.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#if !defined WIN32
+#include <sys/types.h>
+#include <regex.h>
+#endif
+
+struct search_s
+{
+    char*   pattern;
+    int     regex;
+    /** String which every match contains, of length literal_len */
+    char*   literal;
+    size_t  literal_len;
+#if !defined WIN32
+    regex_t re;
+#endif
+};
+
+/** Match p_c against the glob bracket expression starting at p_pat (just
+    after the '[').  *p_end is set to just after the closing ']', or to NULL
+    if there is none, in which case the '[' is an ordinary character.
+
+    \returns Non-zero if p_c is in the set */
+static int match_bracket( const char* const p_pat, const char p_c,
+                          const char** const p_end )
+{
+    const char* pos = p_pat;
+    int negate = 0;
+    int matched = 0;
+    int first = 1;
+
+    if(( *pos == '!' ) || ( *pos == '^' )) {
+        negate = 1;
+        pos++;
+    }
+
+    /* A ']' straight after the '[' is part of the set */
+    while( first || ( *pos != ']' )) {
+        unsigned char lo;
+        unsigned char hi;
+
+        first = 0;
+        if( *pos == '\0' ) {
+            *p_end = NULL;
+            return( 0 );
+        }
+        if(( *pos == '\\' ) && ( pos[ 1 ] != '\0' )) {
+            pos++;
+        }
+        lo = (unsigned char)*( pos++ );
+        hi = lo;
+        if(( *pos == '-' ) && ( pos[ 1 ] != ']' ) && ( pos[ 1 ] != '\0' )) {
+            pos++;
+            if(( *pos == '\\' ) && ( pos[ 1 ] != '\0' )) {
+                pos++;
+            }
+            hi = (unsigned char)*( pos++ );
+        }
+        if(( (unsigned char)p_c >= lo ) && ( (unsigned char)p_c <= hi )) {
+            matched = 1;
+        }
+    }
+    *p_end = pos + 1;
+
+    return( matched != negate );
+}
+
+/** \returns Non-zero if the whole of p_str matches the glob p_pat.  '*' may
+             match '/', as patterns are usually looking for something
+             anywhere beneath a directory */
+static int glob_match( const char* p_pat, const char* p_str )
+{
+    /* Where to resume if what follows the most recent '*' fails to match */
+    const char* star_pat = NULL;
+    const char* star_str = NULL;
+
+    while( *p_str != '\0' ) {
+        const char* next = p_pat + 1;
+        const char* bracket_end = NULL;
+        int in_bracket = 0;
+        int ok;
+
+        if( *p_pat == '[' ) {
+            in_bracket = match_bracket( p_pat + 1, *p_str, &bracket_end );
+        }
+
+        if( *p_pat == '*' ) {
+            star_pat = ++p_pat;
+            star_str = p_str;
+            continue;
+        } else if( *p_pat == '?' ) {
+            ok = 1;
+        } else if( bracket_end != NULL ) {
+            ok = in_bracket;
+            next = bracket_end;
+        } else {
+            const char* const lit = (( *p_pat == '\\' ) && ( p_pat[ 1 ] != '\0' )) ?
+                                        ( p_pat + 1 ) : p_pat;
+            ok = ( *lit != '\0' ) && ( *lit == *p_str );
+            next = lit + 1;
+        }
+
+        if( ok ) {
+            p_pat = next;
+            p_str++;
+        } else if( star_pat != NULL ) {
+            /* Let the '*' swallow one more character */
+            p_pat = star_pat;
+            p_str = ++star_str;
+        } else {
+            return( 0 );
+        }
+    }
+
+    while( *p_pat == '*' ) {
+        p_pat++;
+    }
+
+    return( *p_pat == '\0' );
+}
+
+/** Keep the run of p_run_len characters at p_run if it's the longest so far,
+    then start a new run */
+static void end_run( char* const p_best, size_t* const p_best_len,
+                     const char* const p_run, size_t* const p_run_len )
+{
+    if( *p_run_len > *p_best_len ) {
+        memcpy( p_best, p_run, *p_run_len );
+        *p_best_len = *p_run_len;
+    }
+    *p_run_len = 0;
+}
+
+/** \returns The length of the longest run of ordinary characters in the glob
+             p_pat, which is copied to p_best */
+static size_t glob_literal( const char* const p_pat, char* const p_best,
+                            char* const p_run )
+{
+    const char* pos = p_pat;
+    size_t best = 0;
+    size_t run = 0;
+
+    while( *pos != '\0' ) {
+        const char* end = NULL;
+
+        if( *pos == '[' ) {
+            (void)match_bracket( pos + 1, '\0', &end );
+        }
+
+        if(( *pos == '*' ) || ( *pos == '?' )) {
+            end_run( p_best, &best, p_run, &run );
+            pos++;
+        } else if( end != NULL ) {
+            end_run( p_best, &best, p_run, &run );
+            pos = end;
+        } else {
+            if(( *pos == '\\' ) && ( pos[ 1 ] != '\0' )) {
+                pos++;
+            }
+            p_run[ run++ ] = *( pos++ );
+        }
+    }
+    end_run( p_best, &best, p_run, &run );
+
+    return( best );
+}
+
+#if !defined WIN32
+
+/** \returns The position just after the bracket expression starting at
+             p_pos (just after the '[') of a regular expression */
+static const char* skip_bracket( const char* p_pos )
+{
+    if( *p_pos == '^' ) {
+        p_pos++;
+    }
+    /* A ']' straight after the '[' is part of the set */
+    if( *p_pos == ']' ) {
+        p_pos++;
+    }
+    while(( *p_pos != '\0' ) && ( *p_pos != ']' )) {
+        if(( *p_pos == '[' ) &&
+           (( p_pos[ 1 ] == ':' ) || ( p_pos[ 1 ] == '=' ) || ( p_pos[ 1 ] == '.' ))) {
+            /* Character class, equivalence class or collating symbol */
+            const char delim = p_pos[ 1 ];
+
+            p_pos += 2;
+            while(( *p_pos != '\0' ) && !(( *p_pos == delim ) && ( p_pos[ 1 ] == ']' ))) {
+                p_pos++;
+            }
+            if( *p_pos != '\0' ) {
+                p_pos += 2;
+            }
+        } else {
+            p_pos++;
+        }
+    }
+
+    return(( *p_pos == ']' ) ? ( p_pos + 1 ) : p_pos );
+}
+
+/** \returns The position just after the group starting at p_pos (just after
+             the '(') of a regular expression */
+static const char* skip_group( const char* p_pos )
+{
+    size_t depth = 1;
+
+    while(( *p_pos != '\0' ) && ( depth != 0 )) {
+        const char c = *( p_pos++ );
+
+        if(( c == '\\' ) && ( *p_pos != '\0' )) {
+            p_pos++;
+        } else if( c == '[' ) {
+            p_pos = skip_bracket( p_pos );
+        } else if( c == '(' ) {
+            depth++;
+        } else if( c == ')' ) {
+            depth--;
+        }
+    }
+
+    return( p_pos );
+}
+
+/** \returns The length of a string which every match of the extended regular
+             expression p_pat contains, which is copied to p_best.  This is
+             conservative: nothing is found if the expression has alternatives,
+             and groups are skipped. */
+static size_t regex_literal( const char* const p_pat, char* const p_best,
+                             char* const p_run )
+{
+    const char* pos = p_pat;
+    size_t best = 0;
+    size_t run = 0;
+
+    if( strchr( p_pat, '|' ) != NULL ) {
+        return( 0 );
+    }
+
+    while( *pos != '\0' ) {
+        const char c = *( pos++ );
+
+        if(( c == '*' ) || ( c == '?' ) || ( c == '{' )) {
+            /* The preceding character needn't appear */
+            if( run != 0 ) {
+                run--;
+            }
+            end_run( p_best, &best, p_run, &run );
+            if( c == '{' ) {
+                while(( *pos != '\0' ) && ( *( pos++ ) != '}' )) {
+                }
+            }
+        } else if( c == '+' ) {
+            /* The preceding character appears, but may be repeated */
+            end_run( p_best, &best, p_run, &run );
+        } else if(( c == '\\' ) && ( *pos != '\0' ) &&
+                  !isalnum( (unsigned char)*pos )) {
+            p_run[ run++ ] = *( pos++ );
+        } else if( c == '\\' ) {
+            /* Classes such as \w & back-references */
+            end_run( p_best, &best, p_run, &run );
+            if( *pos != '\0' ) {
+                pos++;
+            }
+        } else if( c == '(' ) {
+            end_run( p_best, &best, p_run, &run );
+            pos = skip_group( pos );
+        } else if( c == '[' ) {
+            end_run( p_best, &best, p_run, &run );
+            pos = skip_bracket( pos );
+        } else if(( c == '.' ) || ( c == '^' ) || ( c == '$' ) || ( c == ')' )) {
+            end_run( p_best, &best, p_run, &run );
+        } else {
+            p_run[ run++ ] = c;
+        }
+    }
+    end_run( p_best, &best, p_run, &run );
+
+    return( best );
+}
+
+#endif
+
+search_t search_compile( const char* const p_pattern, const int p_regex )
+{
+    search_t ret_val = (search_t)calloc( 1, sizeof( struct search_s ));
+    size_t len;
+    char* run;
+
+    /* Precondition check */
+    assert( p_pattern != NULL );
+
+    len = strlen( p_pattern );
+    run = (char*)malloc( len + 1U );
+
+    if( ret_val != NULL ) {
+        ret_val->regex = p_regex;
+        ret_val->pattern = (char*)malloc( len + 1U );
+        ret_val->literal = (char*)malloc( len + 1U );
+
+        if(( run == NULL ) || ( ret_val->pattern == NULL ) || ( ret_val->literal == NULL )) {
+            free( ret_val->pattern );
+            free( ret_val->literal );
+            free( ret_val );
+            ret_val = NULL;
+        } else {
+            memcpy( ret_val->pattern, p_pattern, len + 1U );
+
+            if( !p_regex ) {
+                ret_val->literal_len = glob_literal( p_pattern, ret_val->literal, run );
+            } else {
+#if !defined WIN32
+                if( 0 == regcomp( &( ret_val->re ), p_pattern, REG_EXTENDED | REG_NOSUB )) {
+                    ret_val->literal_len = regex_literal( p_pattern, ret_val->literal, run );
+                } else
+#endif
+                {
+                    free( ret_val->pattern );
+                    free( ret_val->literal );
+                    free( ret_val );
+                    ret_val = NULL;
+                }
+            }
+        }
+    }
+    free( run );
+
+    return( ret_val );
+}
+
+void search_free( search_t p_search )
+{
+    if( p_search != NULL ) {
+#if !defined WIN32
+        if( p_search->regex ) {
+            regfree( &( p_search->re ));
+        }
+#endif
+        free( p_search->pattern );
+        free( p_search->literal );
+        free( p_search );
+    }
+}
+
+const char* search_literal( const search_t p_search, size_t* const p_len )
+{
+    /* Precondition check */
+    assert( p_search != NULL );
+
+    *p_len = p_search->literal_len;
+
+    return( p_search->literal );
+}
+
+int search_match( const search_t p_search, const char* const p_str )
+{
+    /* Precondition check */
+    assert( p_search != NULL );
+
+#if !defined WIN32
+    if( p_search->regex ) {
+        return( 0 == regexec( &( p_search->re ), p_str, 0, NULL, 0 ));
+    }
+#endif
+
+    return( glob_match( p_search->pattern, p_str ));
+}
+
+const char* search_pattern( const search_t p_search, int* const p_regex )
+{
+    /* Precondition check */
+    assert( p_search != NULL );
+
+    *p_regex = p_search->regex;
+
+    return( p_search->pattern );
+}
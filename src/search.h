@@ -0,0 +1,71 @@
+/**
+   \file
+   \brief The search module matches bookmark paths & names against a glob or
+          regular expression (see --search)
+
+   Patterns are compiled once, when the command line is processed.  Each
+   also yields the longest string which anything it matches must contain,
+   so that a list can be searched by scanning its strings for that (which
+   is cheap) and only matching the pattern against those that contain it.
+
+   \copyright Copyright 2018 John Bailey
+
+   \section LICENSE
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if !defined( SEARCH_H )
+#define       SEARCH_H
+
+#include <stddef.h>
+
+/** A compiled pattern */
+typedef struct search_s* search_t;
+
+/**
+    Compile a pattern.  A glob (supporting *, ?, [...] & \ escapes) must match
+    the whole of a string, whereas a regular expression (POSIX extended
+    syntax) may match any part of it.  Regular expressions aren't supported
+    on Windows.
+
+    \param p_pattern The pattern
+    \param p_regex   Non-zero if p_pattern is a regular expression, rather
+                     than a glob
+    \returns The compiled pattern, or NULL if it isn't valid or there wasn't
+             the memory
+*/
+search_t search_compile( const char* const p_pattern, const int p_regex );
+
+/** Free a pattern returned by search_compile().  p_search may be NULL */
+void search_free( search_t p_search );
+
+/**
+    \param p_search The compiled pattern
+    \param[out] p_len Set to the length of the string
+    \returns A string (not NUL terminated) which every string matching
+             p_search contains.  *p_len is 0 if there is no such string.
+*/
+const char* search_literal( const search_t p_search, size_t* const p_len );
+
+/** \returns Non-zero if p_str matches p_search */
+int search_match( const search_t p_search, const char* const p_str );
+
+/**
+    \param p_search The compiled pattern
+    \param[out] p_regex Set to non-zero if it's a regular expression
+    \returns The pattern which p_search was compiled from
+*/
+const char* search_pattern( const search_t p_search, int* const p_regex );
+
+#endif
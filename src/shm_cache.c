@@ -0,0 +1,531 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "wd.h"
+#include "shm_cache.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/** Used to check that segments were created by a compatible wd */
+#define SHM_MAGIC      0x77645348UL
+/** Bump this whenever the segment layouts change */
+#define SHM_VERSION    4U
+
+#define SHM_NAME_LEN   64
+/** Bookmark has no name */
+#define SHM_NO_NAME    UINT32_MAX
+/** Number of times a reader re-reads the index if a writer is updating it */
+#define SHM_READ_TRIES 16
+
+/** Index segment, one per bookmark file */
+struct shm_index
+{
+    uint32_t   magic;
+    uint32_t   version;
+    /** Odd while a writer is updating the fields below */
+    uint32_t   seq;
+    /** Process updating the index, so that the update can be abandoned if it
+        died part-way through */
+    int32_t    writer_pid;
+    file_sig_t sig;
+    /** Name of the segment holding the list, empty if none */
+    char       list_name[ SHM_NAME_LEN ];
+};
+
+/** Header of a list segment.  It is followed by an array of shm_entry (the
+    bookmarks, then records of removals) and then the string pool.  All
+    string references are offsets into the pool, so the layout doesn't
+    depend on where the segment is mapped. */
+struct shm_list_hdr
+{
+    uint32_t   magic;
+    uint32_t   version;
+    /** Set once the segment has been completely written */
+    uint32_t   complete;
+    uint32_t   count;
+    /** Number of records of removals, which have the time of removal as
+        their time accessed */
+    uint32_t   removed_count;
+    /** Non-zero if the list records removals, even if there are none */
+    uint32_t   records_removals;
+    file_sig_t sig;
+    uint64_t   total_size;
+    uint32_t   pool_size;
+    /** Offset in the pool of the path of the bookmark file */
+    uint32_t   path_off;
+};
+
+struct shm_entry
+{
+    uint32_t dir_off;
+    /** SHM_NO_NAME if the bookmark has no name */
+    uint32_t name_off;
+    int64_t  time_added;
+    int64_t  time_accessed;
+    int32_t  type;
+    uint32_t hits;
+    /** Comma-separated tags, SHM_NO_NAME if the bookmark has none */
+    uint32_t tags_off;
+    uint32_t reserved;
+};
+
+/** FNV-1a, used to derive segment names */
+static uint64_t shm_hash( const void* const p_data, const size_t p_len,
+                          uint64_t p_hash )
+{
+    const unsigned char* data = (const unsigned char*)p_data;
+    size_t loop;
+
+    for( loop = 0; loop < p_len; loop++ ) {
+        p_hash ^= data[ loop ];
+        p_hash *= 0x100000001b3ULL;
+    }
+
+    return( p_hash );
+}
+
+#define SHM_HASH_INIT 0xcbf29ce484222325ULL
+
+static void index_name( const char* const p_fn, char* const p_name )
+{
+    snprintf( p_name, SHM_NAME_LEN, "/wd-%lu-%016llx",
+              (unsigned long)getuid(),
+              (unsigned long long)shm_hash( p_fn, strlen( p_fn ), SHM_HASH_INIT ));
+}
+
+static void list_name( const char* const p_fn, const file_sig_t* const p_sig,
+                       char* const p_name )
+{
+    snprintf( p_name, SHM_NAME_LEN, "/wd-%lu-%016llx-%016llx",
+              (unsigned long)getuid(),
+              (unsigned long long)shm_hash( p_fn, strlen( p_fn ), SHM_HASH_INIT ),
+              (unsigned long long)shm_hash( p_sig, sizeof( *p_sig ), SHM_HASH_INIT ));
+}
+
+/** Map a shared memory segment
+
+    \param[in]  p_name  Name of the segment
+    \param[in]  p_write Non-zero to create (if necessary) & map read/write
+    \param[in]  p_size  Size required.  Segments which are smaller are
+                        extended if p_write is set, otherwise rejected
+    \param[out] p_len   Size of the mapping
+    \returns The mapping or NULL */
+static void* shm_map( const char* const p_name, const int p_write,
+                      const size_t p_size, size_t* const p_len )
+{
+    void* ret_val = NULL;
+    int fd = shm_open( p_name, p_write ? ( O_RDWR | O_CREAT ) : O_RDONLY,
+                       S_IRUSR | S_IWUSR );
+
+    if( fd != -1 ) {
+        struct stat s;
+
+        if(( fstat( fd, &s ) == 0 ) &&
+           ( s.st_uid == getuid() ) &&
+           ((( size_t )s.st_size >= p_size ) ||
+            ( p_write && ( ftruncate( fd, p_size ) == 0 )))) {
+            *p_len = (( size_t )s.st_size >= p_size ) ? ( size_t )s.st_size : p_size;
+            ret_val = mmap( NULL, *p_len,
+                            p_write ? ( PROT_READ | PROT_WRITE ) : PROT_READ,
+                            MAP_SHARED, fd, 0 );
+            if( ret_val == MAP_FAILED ) {
+                ret_val = NULL;
+            }
+        }
+        close( fd );
+    }
+
+    return( ret_val );
+}
+
+/** Retrieve a consistent copy of the index for the specified file */
+static int read_index( const char* const p_fn, struct shm_index* const p_copy )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    char name[ SHM_NAME_LEN ];
+    size_t len;
+    struct shm_index* idx;
+
+    index_name( p_fn, name );
+    idx = (struct shm_index*)shm_map( name, 0, sizeof( struct shm_index ), &len );
+
+    if( idx != NULL ) {
+        int tries;
+
+        for( tries = 0; tries < SHM_READ_TRIES; tries++ ) {
+            uint32_t seq = __atomic_load_n( &( idx->seq ), __ATOMIC_ACQUIRE );
+
+            if(( seq & 1U ) == 0 ) {
+                memcpy( p_copy, idx, sizeof( *p_copy ));
+                __atomic_thread_fence( __ATOMIC_ACQUIRE );
+                if( seq == __atomic_load_n( &( idx->seq ), __ATOMIC_RELAXED )) {
+                    ret_val = WD_SUCCESS;
+                    break;
+                }
+            }
+        }
+        munmap( idx, len );
+    }
+
+    if( WD_SUCCEEDED( ret_val ) &&
+        (( p_copy->magic != SHM_MAGIC ) ||
+         ( p_copy->version != SHM_VERSION ) ||
+         ( p_copy->list_name[0] == '\0' ) ||
+         ( memchr( p_copy->list_name, '\0', SHM_NAME_LEN ) == NULL ))) {
+        ret_val = WD_GENERIC_FAIL;
+    }
+
+    return( ret_val );
+}
+
+/** Convert a list segment back into a dir list.  The segment is checked
+    thoroughly, as it is outside of this process' control. */
+static dir_list_t attach_list( const config_container_t* const p_config,
+                               const char* const p_fn,
+                               const file_sig_t* const p_sig,
+                               const char* const p_name )
+{
+    dir_list_t ret_val = NULL;
+    size_t len;
+    const struct shm_list_hdr* hdr =
+        (const struct shm_list_hdr*)shm_map( p_name, 0,
+                                             sizeof( struct shm_list_hdr ),
+                                             &len );
+
+    if( hdr != NULL ) {
+        const struct shm_entry* entries = (const struct shm_entry*)( hdr + 1 );
+        const size_t total_count = (size_t)hdr->count + hdr->removed_count;
+        const char* pool = (const char*)( entries + total_count );
+
+        if(( hdr->magic == SHM_MAGIC ) &&
+           ( hdr->version == SHM_VERSION ) &&
+           __atomic_load_n( &( hdr->complete ), __ATOMIC_ACQUIRE ) &&
+           ( hdr->total_size == len ) &&
+           ( file_sig_equal( &( hdr->sig ), p_sig )) &&
+           ( total_count <= ( len - sizeof( *hdr )) / sizeof( *entries )) &&
+           ( hdr->pool_size == len - (( size_t )( pool - (const char*)hdr ))) &&
+           ( hdr->pool_size > 0 ) &&
+           ( pool[ hdr->pool_size - 1 ] == '\0' ) &&
+           ( hdr->path_off < hdr->pool_size ) &&
+           ( 0 == strcmp( pool + hdr->path_off, p_fn ))) {
+            ret_val = new_dir_list();
+        }
+
+        if( ret_val != NULL ) {
+            size_t loop;
+
+            dir_list_set_config( ret_val, p_config );
+            if( hdr->records_removals &&
+                !WD_SUCCEEDED( dir_list_record_removals( ret_val ))) {
+                free_dir_list( ret_val );
+                ret_val = NULL;
+            }
+
+            for( loop = 0; ( ret_val != NULL ) && ( loop < total_count ); loop++ ) {
+                const struct shm_entry* e = &( entries[ loop ] );
+                const int removal = ( loop >= hdr->count );
+
+                if(( e->dir_off >= hdr->pool_size ) ||
+                   (( e->name_off != SHM_NO_NAME ) &&
+                    ( e->name_off >= hdr->pool_size )) ||
+                   (( e->tags_off != SHM_NO_NAME ) &&
+                    ( e->tags_off >= hdr->pool_size )) ||
+                   !WD_SUCCEEDED( removal ?
+                                  dir_list_add_removed( ret_val, pool + e->dir_off,
+                                                        (time_t)e->time_accessed ) :
+                                  add_dir( ret_val, pool + e->dir_off,
+                                           ( e->name_off == SHM_NO_NAME ) ? NULL :
+                                                             pool + e->name_off,
+                                           (time_t)e->time_added,
+                                           (time_t)e->time_accessed,
+                                           (wd_entity_t)e->type ))) {
+                    free_dir_list( ret_val );
+                    ret_val = NULL;
+                    break;
+                }
+                if( !removal ) {
+                    dir_list_set_hits( ret_val, loop, e->hits );
+                    if(( e->tags_off != SHM_NO_NAME ) &&
+                       !WD_SUCCEEDED( dir_list_set_tags( ret_val, loop,
+                                                         pool + e->tags_off ))) {
+                        free_dir_list( ret_val );
+                        ret_val = NULL;
+                    }
+                }
+            }
+        }
+        munmap( (void*)hdr, len );
+    }
+
+    return( ret_val );
+}
+
+/** Write a list into a new segment
+
+    \returns WD_SUCCESS if the segment exists (whether created by this or
+             another process) */
+static int write_list( const dir_list_t p_list, const char* const p_fn,
+                       const file_sig_t* const p_sig,
+                       const char* const p_name )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    const dir_list_t removed = dir_list_get_removed( p_list );
+    size_t count = dir_list_get_count( p_list );
+    size_t removed_count = ( removed != NULL ) ? dir_list_get_count( removed ) : 0;
+    size_t pool_size = strlen( p_fn ) + 1;
+    size_t total;
+    size_t loop;
+    int fd;
+
+    for( loop = 0; loop < count; loop++ ) {
+        const char* name = dir_list_get_name( p_list, loop );
+        char* const tags = dir_list_get_tags( p_list, loop );
+
+        pool_size += strlen( dir_list_get_dir( p_list, loop )) + 1;
+        if( name != NULL ) {
+            pool_size += strlen( name ) + 1;
+        }
+        if( tags != NULL ) {
+            pool_size += strlen( tags ) + 1;
+            free( tags );
+        }
+    }
+    for( loop = 0; loop < removed_count; loop++ ) {
+        pool_size += strlen( dir_list_get_dir( removed, loop )) + 1;
+    }
+    total = sizeof( struct shm_list_hdr ) +
+            (( count + removed_count ) * sizeof( struct shm_entry )) + pool_size;
+
+    if(( pool_size >= SHM_NO_NAME ) || ( count > UINT32_MAX ) ||
+       ( removed_count > UINT32_MAX )) {
+        /* Too large to represent */
+    } else if(( fd = shm_open( p_name, O_RDWR | O_CREAT | O_EXCL,
+                               S_IRUSR | S_IWUSR )) == -1 ) {
+        /* Already published by another process */
+        ret_val = ( errno == EEXIST ) ? WD_SUCCESS : WD_GENERIC_FAIL;
+    } else {
+        void* seg = MAP_FAILED;
+
+        if( ftruncate( fd, total ) == 0 ) {
+            seg = mmap( NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+        }
+
+        if( seg != MAP_FAILED ) {
+            struct shm_list_hdr* hdr = (struct shm_list_hdr*)seg;
+            struct shm_entry* entries = (struct shm_entry*)( hdr + 1 );
+            char* pool = (char*)( entries + count + removed_count );
+            uint32_t used = 0;
+
+            hdr->magic      = SHM_MAGIC;
+            hdr->version    = SHM_VERSION;
+            hdr->count      = (uint32_t)count;
+            hdr->removed_count = (uint32_t)removed_count;
+            hdr->records_removals = ( removed != NULL );
+            hdr->sig        = *p_sig;
+            hdr->total_size = total;
+            hdr->pool_size  = (uint32_t)pool_size;
+            hdr->path_off   = used;
+            strcpy( pool + used, p_fn );
+            used += strlen( p_fn ) + 1;
+
+            for( loop = 0; loop < count; loop++ ) {
+                const char* name = dir_list_get_name( p_list, loop );
+                char* const tags = dir_list_get_tags( p_list, loop );
+
+                entries[ loop ].dir_off = used;
+                strcpy( pool + used, dir_list_get_dir( p_list, loop ));
+                used += strlen( pool + used ) + 1;
+
+                if( name != NULL ) {
+                    entries[ loop ].name_off = used;
+                    strcpy( pool + used, name );
+                    used += strlen( name ) + 1;
+                } else {
+                    entries[ loop ].name_off = SHM_NO_NAME;
+                }
+                entries[ loop ].time_added    = (int64_t)dir_list_get_time_added( p_list, loop );
+                entries[ loop ].time_accessed = (int64_t)dir_list_get_time_accessed( p_list, loop );
+                entries[ loop ].type          = (int32_t)dir_list_get_type( p_list, loop );
+                entries[ loop ].hits          = (uint32_t)dir_list_get_hits( p_list, loop );
+                entries[ loop ].reserved      = 0;
+
+                if( tags != NULL ) {
+                    entries[ loop ].tags_off = used;
+                    strcpy( pool + used, tags );
+                    used += strlen( tags ) + 1;
+                    free( tags );
+                } else {
+                    entries[ loop ].tags_off = SHM_NO_NAME;
+                }
+            }
+
+            for( loop = 0; loop < removed_count; loop++ ) {
+                struct shm_entry* const e = &( entries[ count + loop ] );
+
+                e->dir_off = used;
+                strcpy( pool + used, dir_list_get_dir( removed, loop ));
+                used += strlen( pool + used ) + 1;
+                e->name_off      = SHM_NO_NAME;
+                e->time_added    = -1;
+                e->time_accessed = (int64_t)dir_list_get_time_accessed( removed, loop );
+                e->type          = (int32_t)WD_ENTITY_UNKNOWN;
+                e->hits          = 0;
+                e->tags_off      = SHM_NO_NAME;
+                e->reserved      = 0;
+            }
+
+            __atomic_store_n( &( hdr->complete ), 1U, __ATOMIC_RELEASE );
+            munmap( seg, total );
+            ret_val = WD_SUCCESS;
+        } else {
+            shm_unlink( p_name );
+        }
+        close( fd );
+    }
+
+    return( ret_val );
+}
+
+/** Point the index at a newly written list segment.  Gives up rather than
+    waiting if another process is updating the index. */
+static void publish_list( const char* const p_fn, const file_sig_t* const p_sig,
+                          const char* const p_name )
+{
+    char name[ SHM_NAME_LEN ];
+    char old_name[ SHM_NAME_LEN ];
+    size_t len;
+    struct shm_index* idx;
+
+    old_name[0] = '\0';
+    index_name( p_fn, name );
+    idx = (struct shm_index*)shm_map( name, 1, sizeof( struct shm_index ), &len );
+
+    if( idx != NULL ) {
+        uint32_t seq = __atomic_load_n( &( idx->seq ), __ATOMIC_ACQUIRE );
+
+        /* A writer which died mid-update would otherwise lock everyone out */
+        if(( seq & 1U ) &&
+           ( kill( (pid_t)__atomic_load_n( &( idx->writer_pid ), __ATOMIC_RELAXED ), 0 ) == -1 ) &&
+           ( errno == ESRCH ) &&
+           __atomic_compare_exchange_n( &( idx->seq ), &seq, seq + 1U, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE )) {
+            seq++;
+        }
+
+        if((( seq & 1U ) == 0 ) &&
+           __atomic_compare_exchange_n( &( idx->seq ), &seq, seq + 1U, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE )) {
+            __atomic_store_n( &( idx->writer_pid ), (int32_t)getpid(), __ATOMIC_RELAXED );
+
+            if(( idx->magic == SHM_MAGIC ) &&
+               ( memchr( idx->list_name, '\0', SHM_NAME_LEN ) != NULL ) &&
+               ( 0 != strcmp( idx->list_name, p_name ))) {
+                strcpy( old_name, idx->list_name );
+            }
+            idx->magic   = SHM_MAGIC;
+            idx->version = SHM_VERSION;
+            idx->sig     = *p_sig;
+            strcpy( idx->list_name, p_name );
+
+            __atomic_store_n( &( idx->seq ), seq + 2U, __ATOMIC_RELEASE );
+        }
+        munmap( idx, len );
+    }
+
+    /* Processes which already have the old generation mapped are unaffected;
+       any which are about to open it will fall back to loading the file */
+    if( old_name[0] != '\0' ) {
+        shm_unlink( old_name );
+    }
+}
+
+static void publish( const dir_list_t p_list, const char* const p_fn,
+                     const file_sig_t* const p_sig )
+{
+    char name[ SHM_NAME_LEN ];
+
+    list_name( p_fn, p_sig, name );
+
+    if( WD_SUCCEEDED( write_list( p_list, p_fn, p_sig, name ))) {
+        publish_list( p_fn, p_sig, name );
+        DEBUG_OUT("published %s as %s", p_fn, name);
+    }
+}
+
+dir_list_t shm_cache_load( const config_container_t* const p_config,
+                           const char* const p_fn,
+                           file_sig_t* const p_sig )
+{
+    dir_list_t ret_val = NULL;
+    struct shm_index idx;
+
+    /* Precondition check */
+    assert( p_fn != NULL );
+    assert( p_sig != NULL );
+    /* !Precondition check */
+
+    file_sig_get( p_fn, p_sig );
+
+    if( p_sig->valid &&
+        WD_SUCCEEDED( read_index( p_fn, &idx )) &&
+        file_sig_equal( &( idx.sig ), p_sig )) {
+        ret_val = attach_list( p_config, p_fn, p_sig, idx.list_name );
+        DEBUG_OUT("shared memory cache %s for %s", ( ret_val == NULL ) ? "miss" : "hit", p_fn );
+    }
+
+    if( ret_val == NULL ) {
+        ret_val = load_dir_list( p_config, p_fn );
+
+        if( ret_val != NULL ) {
+            file_sig_t after;
+
+            /* Only publish if the file wasn't modified while being read */
+            file_sig_get( p_fn, &after );
+            if( file_sig_equal( p_sig, &after )) {
+                publish( ret_val, p_fn, p_sig );
+            } else {
+                *p_sig = after;
+            }
+        }
+    }
+
+    return( ret_val );
+}
+
+void shm_cache_update( const dir_list_t p_list,
+                       const char* const p_fn,
+                       file_sig_t* const p_sig )
+{
+    file_sig_t now;
+
+    file_sig_get( p_fn, &now );
+
+    if( now.valid && !file_sig_equal( &now, p_sig )) {
+        *p_sig = now;
+        publish( p_list, p_fn, p_sig );
+    }
+}
@@ -0,0 +1,69 @@
+/**
+   \file
+   \brief The shm_cache module allows a parsed bookmark list to be shared
+          between wd processes via POSIX shared memory, so that only the
+          first invocation after the file changes needs to parse it
+
+   Each bookmark file has a small index segment, named after a hash of the
+   file's path, which records the generation (see file_sig_t) of the most
+   recently published list and the name of the segment holding it.  List
+   segments are named after both the path and the generation and are never
+   modified once published, so readers only need to validate the index.  The
+   index is updated under a sequence counter: readers retry (or give up and
+   load the file) if it changes under them, and writers never wait for
+   readers or for each other.
+
+   \copyright Copyright 2018 John Bailey
+
+   \section LICENSE
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if !defined( SHM_CACHE_H )
+#define       SHM_CACHE_H
+
+#include "cmdln.h"
+#include "dir_list.h"
+#include "list_cache.h"
+
+/**
+    Retrieve the bookmark list for the specified file from shared memory if
+    the current generation of the file has been published, otherwise load it
+    from the file and publish it.
+
+    \param[in]  p_config Configuration options to associate with the dir list
+    \param[in]  p_fn     The filename to load the bookmarks from
+    \param[out] p_sig    Signature of the file which the list reflects
+    \returns The bookmark list (to be released using free_dir_list()) or NULL
+             in the case that the file could not be loaded
+*/
+dir_list_t shm_cache_load( const config_container_t* const p_config,
+                           const char* const p_fn,
+                           file_sig_t* const p_sig );
+
+/**
+    Publish a list which may have been modified & saved since it was
+    retrieved via shm_cache_load().  Nothing is done if the file has not
+    changed.
+
+    \param[in]     p_list The bookmark list
+    \param[in]     p_fn   The filename of the bookmark list
+    \param[in,out] p_sig  Signature returned by shm_cache_load(), updated to
+                          reflect the file as it is now
+*/
+void       shm_cache_update( const dir_list_t p_list,
+                             const char* const p_fn,
+                             file_sig_t* const p_sig );
+
+#endif
@@ -0,0 +1,397 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "wd.h"
+#include "snapshot.h"
+#include "list_cache.h"
+#include "os_if.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/** Used to check that signature files were created by a compatible wd */
+#define SNAPSHOT_MAGIC   0x77645350UL
+/** Bump this whenever the file layout changes */
+#define SNAPSHOT_VERSION 1U
+
+#define SNAPSHOT_DIR     "wd"
+#define SNAPSHOT_DIR_FALLBACK ".cache"
+
+/** Header of a signature file.  It is followed by the path of the list */
+struct snapshot_hdr
+{
+    uint32_t   magic;
+    uint32_t   version;
+    /** Signature of the list at the time that it was copied */
+    file_sig_t sig;
+    uint32_t   path_len;
+    uint32_t   reserved;
+};
+
+/** Names of the files kept for a list, each malloc()'d */
+struct snapshot_names
+{
+    char* copy;
+    char* sig;
+    char* lock;
+    char* temp;
+};
+
+/** FNV-1a, used to derive file names */
+static uint64_t snapshot_hash( const char* const p_fn )
+{
+    const unsigned char* data = (const unsigned char*)p_fn;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    while( *data != '\0' ) {
+        hash ^= *( data++ );
+        hash *= 0x100000001b3ULL;
+    }
+
+    return( hash );
+}
+
+static void names_free( struct snapshot_names* const p_names )
+{
+    free( p_names->copy );
+    free( p_names->sig );
+    free( p_names->lock );
+    free( p_names->temp );
+}
+
+/** Determine the names of the files kept for p_fn, creating the cache
+    directory if necessary
+
+    \returns WD_SUCCESS if all of the names could be determined */
+static int names_init( struct snapshot_names* const p_names,
+                       const char* const p_fn, const int p_create )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    const char* xdg = getenv( "XDG_CACHE_HOME" );
+    char* home = NULL;
+    const char* base = xdg;
+    const char* sub = "";
+
+    memset( p_names, 0, sizeof( *p_names ));
+
+    if(( xdg == NULL ) || ( xdg[0] == '\0' )) {
+        home = get_home_dir();
+        base = home;
+        sub = "/" SNAPSHOT_DIR_FALLBACK;
+    }
+
+    if( base != NULL ) {
+        /* base + sub + "/wd/snapshot-<16 hex digits>.<suffix>" */
+        const size_t len = strlen( base ) + strlen( sub ) +
+                           strlen( SNAPSHOT_DIR ) + 40;
+        const unsigned long long hash = (unsigned long long)snapshot_hash( p_fn );
+
+        p_names->copy = (char*)malloc( len );
+        p_names->sig  = (char*)malloc( len );
+        p_names->lock = (char*)malloc( len );
+        p_names->temp = (char*)malloc( len );
+
+        if(( p_names->copy != NULL ) && ( p_names->sig != NULL ) &&
+           ( p_names->lock != NULL ) && ( p_names->temp != NULL )) {
+            if( p_create ) {
+                snprintf( p_names->copy, len, "%s%s", base, sub );
+                (void)mkdir( p_names->copy, S_IRWXU );
+                snprintf( p_names->copy, len, "%s%s/%s", base, sub, SNAPSHOT_DIR );
+                (void)mkdir( p_names->copy, S_IRWXU );
+            }
+            snprintf( p_names->copy, len, "%s%s/%s/snapshot-%016llx",
+                      base, sub, SNAPSHOT_DIR, hash );
+            snprintf( p_names->sig, len, "%s.sig", p_names->copy );
+            snprintf( p_names->lock, len, "%s.lock", p_names->copy );
+            snprintf( p_names->temp, len, "%s.tmp", p_names->copy );
+            ret_val = WD_SUCCESS;
+        } else {
+            names_free( p_names );
+        }
+    }
+
+    if( home != NULL ) {
+        release_home_dir( home );
+    }
+
+    return( ret_val );
+}
+
+/** Wait for an exclusive lock on p_fd.  Closing the file releases it */
+static int lock_file( const int p_fd )
+{
+    struct flock fl;
+    int res;
+
+    memset( &fl, 0, sizeof( fl ));
+    fl.l_type   = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+
+    do {
+        res = fcntl( p_fd, F_SETLKW, &fl );
+    } while(( res != 0 ) && ( errno == EINTR ));
+
+    return(( res == 0 ) ? WD_SUCCESS : WD_GENERIC_FAIL );
+}
+
+/** Read the signature recorded in the signature file open as p_fd
+
+    \returns WD_SUCCESS if the file is valid and was written for p_fn */
+static int read_sig( const int p_fd, const char* const p_fn,
+                     file_sig_t* const p_sig )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    const size_t len = strlen( p_fn );
+    struct snapshot_hdr hdr;
+
+    if(( pread( p_fd, &hdr, sizeof( hdr ), 0 ) == (ssize_t)sizeof( hdr )) &&
+       ( hdr.magic == SNAPSHOT_MAGIC ) &&
+       ( hdr.version == SNAPSHOT_VERSION ) &&
+       ( hdr.path_len == len )) {
+        char* const path = (char*)malloc( len + 1 );
+
+        /* Guard against two lists' names having the same hash */
+        if(( path != NULL ) &&
+           ( pread( p_fd, path, len, sizeof( hdr )) == (ssize_t)len ) &&
+           ( memcmp( path, p_fn, len ) == 0 )) {
+            *p_sig = hdr.sig;
+            ret_val = WD_SUCCESS;
+        }
+        free( path );
+    }
+
+    return( ret_val );
+}
+
+/** Write the signature file for p_fn via p_names->temp, so that it appears
+    complete */
+static int write_sig( const struct snapshot_names* const p_names,
+                      const char* const p_fn, const file_sig_t* const p_sig )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    const size_t len = strlen( p_fn );
+    const int fd = open( p_names->temp, O_WRONLY | O_CREAT | O_TRUNC,
+                         S_IRUSR | S_IWUSR );
+    struct snapshot_hdr hdr;
+
+    if( fd != -1 ) {
+        memset( &hdr, 0, sizeof( hdr ));
+        hdr.magic    = SNAPSHOT_MAGIC;
+        hdr.version  = SNAPSHOT_VERSION;
+        hdr.sig      = *p_sig;
+        hdr.path_len = (uint32_t)len;
+
+        if(( write( fd, &hdr, sizeof( hdr )) == (ssize_t)sizeof( hdr )) &&
+           ( write( fd, p_fn, len ) == (ssize_t)len )) {
+            ret_val = WD_SUCCESS;
+        }
+        close( fd );
+
+        if( WD_SUCCEEDED( ret_val ) && ( rename( p_names->temp, p_names->sig ) != 0 )) {
+            ret_val = WD_GENERIC_FAIL;
+        }
+        if( !WD_SUCCEEDED( ret_val )) {
+            (void)unlink( p_names->temp );
+        }
+    }
+
+    return( ret_val );
+}
+
+/** Copy p_fn into place as p_names->copy.  p_seen is the signature of p_fn
+    before it was opened, which must still be current once it has been read
+    for the copy to be used */
+static int copy_list( const struct snapshot_names* const p_names,
+                      const char* const p_fn, const file_sig_t* const p_seen )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    const int src = open( p_fn, O_RDONLY );
+    int dst = -1;
+
+    if( src != -1 ) {
+        dst = open( p_names->temp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR );
+    }
+
+    if( dst != -1 ) {
+        char buf[ 65536 ];
+        unsigned long long copied = 0;
+        ssize_t got;
+        file_sig_t after;
+
+        while((( got = read( src, buf, sizeof( buf ))) > 0 ) &&
+              ( write( dst, buf, (size_t)got ) == got )) {
+            copied += (unsigned long long)got;
+        }
+
+        /* The list is rewritten in place by some tools, so it mustn't have
+           changed while it was being read */
+        file_sig_get( p_fn, &after );
+        if(( got == 0 ) && ( copied == p_seen->size ) &&
+           file_sig_equal( p_seen, &after ) &&
+           ( fsync( dst ) == 0 )) {
+            ret_val = WD_SUCCESS;
+        }
+        close( dst );
+
+        if( WD_SUCCEEDED( ret_val ) && ( rename( p_names->temp, p_names->copy ) != 0 )) {
+            ret_val = WD_GENERIC_FAIL;
+        }
+        if( !WD_SUCCEEDED( ret_val )) {
+            (void)unlink( p_names->temp );
+        }
+    }
+
+    if( src != -1 ) {
+        close( src );
+    }
+
+    return( ret_val );
+}
+
+/** Bring the copy of p_fn up to date with p_seen, the signature which it
+    was just found to have */
+static int refresh( const struct snapshot_names* const p_names,
+                    const char* const p_fn, const file_sig_t* const p_seen )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    const int lock_fd = open( p_names->lock, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR );
+
+    if(( lock_fd != -1 ) && WD_SUCCEEDED( lock_file( lock_fd ))) {
+        const int sig_fd = open( p_names->sig, O_RDONLY );
+        file_sig_t cached;
+
+        /* Another invocation may have copied it while this one waited */
+        if(( sig_fd != -1 ) &&
+           WD_SUCCEEDED( read_sig( sig_fd, p_fn, &cached )) &&
+           file_sig_equal( &cached, p_seen )) {
+            DEBUG_OUT("snapshot of %s refreshed elsewhere", p_fn);
+            ret_val = WD_SUCCESS;
+        } else {
+            DEBUG_OUT("copying %s to %s", p_fn, p_names->copy);
+            /* Replace the signature last, so that it never describes an
+               older copy */
+            (void)unlink( p_names->sig );
+            ret_val = copy_list( p_names, p_fn, p_seen );
+            if( WD_SUCCEEDED( ret_val )) {
+                ret_val = write_sig( p_names, p_fn, p_seen );
+            }
+        }
+
+        if( sig_fd != -1 ) {
+            close( sig_fd );
+        }
+    }
+
+    if( lock_fd != -1 ) {
+        /* Closing the file releases the lock */
+        close( lock_fd );
+    }
+
+    return( ret_val );
+}
+
+char* snapshot_get( const config_container_t* const p_config,
+                    const char* const p_fn )
+{
+    char* ret_val = NULL;
+    struct snapshot_names names;
+
+    /* Precondition check */
+    assert( p_config != NULL );
+    assert( p_fn != NULL );
+    /* !Precondition check */
+
+    if( WD_SUCCEEDED( names_init( &names, p_fn, 1 ))) {
+        const int sig_fd = open( names.sig, O_RDONLY );
+        int valid = 0;
+        int fresh = 0;
+        file_sig_t cached;
+        file_sig_t seen;
+        struct stat s;
+
+        /* Also guards against a copy which was lost or cut short */
+        if(( sig_fd != -1 ) &&
+           WD_SUCCEEDED( read_sig( sig_fd, p_fn, &cached )) &&
+           ( stat( names.copy, &s ) == 0 ) &&
+           ((unsigned long long)s.st_size == cached.size )) {
+            valid = 1;
+
+            /* Within the staleness bound, the list itself isn't examined.  The
+               signature file was last modified when the copy was validated */
+            fresh = ( p_config->wd_snapshot_ttl > 0 ) &&
+                    ( fstat( sig_fd, &s ) == 0 ) &&
+                    ( p_config->wd_now_time >= s.st_mtime ) &&
+                    ( p_config->wd_now_time - s.st_mtime <= p_config->wd_snapshot_ttl );
+        }
+
+        if( !fresh ) {
+            file_sig_get( p_fn, &seen );
+            fresh = valid && file_sig_equal( &cached, &seen );
+
+            if( fresh ) {
+                if( p_config->wd_snapshot_ttl > 0 ) {
+                    /* Restart the staleness bound */
+                    (void)futimens( sig_fd, NULL );
+                }
+            } else if( seen.valid ) {
+                fresh = WD_SUCCEEDED( refresh( &names, p_fn, &seen ));
+            }
+        }
+
+        if( sig_fd != -1 ) {
+            close( sig_fd );
+        }
+
+        if( fresh ) {
+            ret_val = names.copy;
+            names.copy = NULL;
+        }
+        names_free( &names );
+    }
+
+    return( ret_val );
+}
+
+void snapshot_invalidate( const char* const p_fn )
+{
+    struct snapshot_names names;
+
+    /* Precondition check */
+    assert( p_fn != NULL );
+    /* !Precondition check */
+
+    if( WD_SUCCEEDED( names_init( &names, p_fn, 0 ))) {
+        /* There's nothing to do for lists which have never been copied */
+        const int lock_fd = open( names.lock, O_RDWR );
+
+        if( lock_fd != -1 ) {
+            /* Any copy in progress may have been made before the save */
+            if( WD_SUCCEEDED( lock_file( lock_fd ))) {
+                (void)unlink( names.sig );
+            }
+            close( lock_fd );
+        }
+        names_free( &names );
+    }
+}
@@ -0,0 +1,62 @@
+/**
+   \file
+   \brief The snapshot module keeps a local copy of bookmark lists held on
+          network filesystems, so that invocations read the list from local
+          disk rather than over the network (see --snapshot)
+
+   Each list's copy is kept under $XDG_CACHE_HOME/wd (or ~/.cache/wd),
+   alongside a small file recording the signature (see file_sig_t) of the
+   list it was copied from.  The copy is revalidated with a single stat() of
+   the list, or, if config_container_t::wd_snapshot_ttl is set, only once that
+   many seconds have passed since it was last validated.  Changes are always
+   saved to the list itself, after which its copy is invalidated.
+
+   Copies are made under an fcntl() lock, and each is in place before the
+   signature which describes it, so a reader never pairs a signature with an
+   older copy.
+
+   \copyright Copyright 2018 John Bailey
+
+   \section LICENSE
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if !defined( SNAPSHOT_H )
+#define       SNAPSHOT_H
+
+#include "cmdln.h"
+
+/**
+    Determine the file from which the list p_fn should be read, refreshing
+    the local copy if it's out of date
+
+    \param[in] p_config Program settings
+    \param[in] p_fn     Name of the list file
+    \returns malloc()'d name of the local copy, or NULL if there isn't a
+             valid one (e.g. p_fn doesn't exist), in which case p_fn should
+             be read directly
+*/
+char* snapshot_get( const config_container_t* const p_config,
+                    const char* const p_fn );
+
+/**
+    Discard the local copy of p_fn, if there is one.  To be called once
+    p_fn has been saved, so that the change is seen by the next invocation
+    even if it would otherwise not revalidate the copy
+
+    \param[in] p_fn Name of the list file
+*/
+void  snapshot_invalidate( const char* const p_fn );
+
+#endif
@@ -0,0 +1,344 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "wd.h"
+#include "stats.h"
+#include "os_if.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/** Used to check that the stats file was created by a compatible wd */
+#define STATS_MAGIC   0x77645354UL
+/** Bump this whenever the file layout changes */
+#define STATS_VERSION 1U
+
+#define STATS_DIR          "wd"
+#define STATS_DIR_FALLBACK ".cache"
+#define STATS_FILE         "stats"
+
+/** Values (in microseconds) below this each have a bucket of their own */
+#define STATS_LINEAR     32U
+/** log2 of the number of buckets per power of two above STATS_LINEAR.  16
+    buckets keeps the error of any percentile within 6.25% */
+#define STATS_SUB_BITS   4U
+/** log2 of STATS_LINEAR */
+#define STATS_MIN_EXP    5U
+/** Values of 2^(STATS_MAX_EXP+1) microseconds (~71 minutes) or more are
+    counted in the final bucket */
+#define STATS_MAX_EXP    31U
+#define STATS_BUCKETS    ( STATS_LINEAR + (( STATS_MAX_EXP - STATS_MIN_EXP + 1U ) << STATS_SUB_BITS ))
+
+/** Operations are indexed by wd_oper_t */
+#define STATS_MAX_OPS    16U
+
+/** Counts of values falling into each bucket */
+struct stats_hist
+{
+    uint64_t bucket[ STATS_BUCKETS ];
+};
+
+/** Accumulated invocations of a single operation */
+struct stats_op
+{
+    uint64_t          count;
+    uint64_t          total_ns;
+    uint64_t          stat_ns;
+    uint64_t          parse_ns;
+    struct stats_hist total;
+    struct stats_hist stat;
+    struct stats_hist parse;
+};
+
+/** Layout of the stats file.  A new file is all zeros (i.e. empty
+    histograms) apart from the magic number, which is set by the first
+    invocation to map it */
+struct stats_file
+{
+    uint64_t        magic;
+    uint64_t        reserved;
+    struct stats_op op[ STATS_MAX_OPS ];
+};
+
+#define STATS_FILE_MAGIC ((((uint64_t)STATS_MAGIC ) << 32U ) | STATS_VERSION )
+
+/** Names of the operations, as output by --stats, indexed by wd_oper_t.
+    NULL for those which aren't recorded */
+static const char* const op_names[ STATS_MAX_OPS ] = {
+    NULL, "add", "remove", "dump", "list", "get-name", "get", NULL,
+    "import", "batch", "scan", NULL, "sync"
+};
+
+/** Determine the name of the stats file, creating its directory if
+    necessary
+
+    \returns malloc()'d filename or NULL */
+static char* stats_fn( const int p_create )
+{
+    char* ret_val = NULL;
+    const char* xdg = getenv( "XDG_CACHE_HOME" );
+    char* home = NULL;
+    const char* base = xdg;
+    const char* sub = "";
+
+    if(( xdg == NULL ) || ( xdg[0] == '\0' )) {
+        home = get_home_dir();
+        base = home;
+        sub = "/" STATS_DIR_FALLBACK;
+    }
+
+    if( base != NULL ) {
+        const size_t len = strlen( base ) + strlen( sub ) + strlen( STATS_DIR ) +
+                           strlen( STATS_FILE ) + 3;
+        ret_val = (char*)malloc( len );
+
+        if( ret_val != NULL ) {
+            if( p_create ) {
+                snprintf( ret_val, len, "%s%s", base, sub );
+                (void)mkdir( ret_val, S_IRWXU );
+                snprintf( ret_val, len, "%s%s/%s", base, sub, STATS_DIR );
+                (void)mkdir( ret_val, S_IRWXU );
+            }
+            snprintf( ret_val, len, "%s%s/%s/%s", base, sub, STATS_DIR, STATS_FILE );
+        }
+    }
+
+    if( home != NULL ) {
+        release_home_dir( home );
+    }
+
+    return( ret_val );
+}
+
+/** \returns The bucket counting p_us microseconds */
+static size_t bucket_of( const uint64_t p_us )
+{
+    size_t ret_val;
+
+    if( p_us < STATS_LINEAR ) {
+        ret_val = (size_t)p_us;
+    } else {
+        const unsigned exp = 63U - (unsigned)__builtin_clzll( p_us );
+
+        if( exp > STATS_MAX_EXP ) {
+            ret_val = STATS_BUCKETS - 1U;
+        } else {
+            ret_val = STATS_LINEAR +
+                      (( exp - STATS_MIN_EXP ) << STATS_SUB_BITS ) +
+                      (size_t)(( p_us >> ( exp - STATS_SUB_BITS )) &
+                               (( 1U << STATS_SUB_BITS ) - 1U ));
+        }
+    }
+
+    return( ret_val );
+}
+
+/** \returns The smallest value, in microseconds, counted by p_bucket */
+static uint64_t bucket_low( const size_t p_bucket )
+{
+    uint64_t ret_val;
+
+    if( p_bucket < STATS_LINEAR ) {
+        ret_val = p_bucket;
+    } else {
+        const size_t offset = p_bucket - STATS_LINEAR;
+        const unsigned exp = STATS_MIN_EXP + (unsigned)( offset >> STATS_SUB_BITS );
+        const uint64_t sub = offset & (( 1U << STATS_SUB_BITS ) - 1U );
+
+        ret_val = (( 1U << STATS_SUB_BITS ) + sub ) << ( exp - STATS_SUB_BITS );
+    }
+
+    return( ret_val );
+}
+
+static void hist_add( struct stats_hist* const p_hist, const uint64_t p_ns )
+{
+    __atomic_fetch_add( &( p_hist->bucket[ bucket_of( p_ns / 1000U ) ] ), 1U,
+                        __ATOMIC_RELAXED );
+}
+
+/** \returns The upper bound, in milliseconds, of the value below which
+             p_fraction of the values in p_hist fall */
+static double hist_percentile( const struct stats_hist* const p_hist,
+                               const uint64_t p_count,
+                               const double p_fraction )
+{
+    uint64_t rank = (uint64_t)(( p_fraction * (double)p_count ) + 0.999999 );
+    uint64_t seen = 0;
+    size_t loop;
+
+    if( rank == 0 ) {
+        rank = 1;
+    }
+
+    for( loop = 0; loop < ( STATS_BUCKETS - 1U ); loop++ ) {
+        seen += p_hist->bucket[ loop ];
+        if( seen >= rank ) {
+            break;
+        }
+    }
+
+    return( bucket_low( loop + 1U ) / 1000.0 );
+}
+
+/** \returns The number of values in p_hist */
+static uint64_t hist_count( const struct stats_hist* const p_hist )
+{
+    uint64_t ret_val = 0;
+    size_t loop;
+
+    for( loop = 0; loop < STATS_BUCKETS; loop++ ) {
+        ret_val += p_hist->bucket[ loop ];
+    }
+
+    return( ret_val );
+}
+
+void stats_record( const wd_oper_t p_oper,
+                   const uint64_t p_total_ns,
+                   const uint64_t p_stat_ns,
+                   const uint64_t p_parse_ns )
+{
+    char* const fn = (( p_oper < STATS_MAX_OPS ) && ( op_names[ p_oper ] != NULL )) ?
+                         stats_fn( 1 ) : NULL;
+    const int fd = ( fn != NULL ) ? open( fn, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR ) : -1;
+
+    if( fd != -1 ) {
+        struct stat s;
+
+        /* Any number of invocations may extend a new file at once, as they
+           all extend it to the same size */
+        if(( fstat( fd, &s ) == 0 ) &&
+           (( (size_t)s.st_size >= sizeof( struct stats_file )) ||
+            ( ftruncate( fd, (off_t)sizeof( struct stats_file )) == 0 ))) {
+            struct stats_file* const file =
+                (struct stats_file*)mmap( NULL, sizeof( struct stats_file ),
+                                          PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+
+            if( file != MAP_FAILED ) {
+                uint64_t magic = 0;
+
+                /* Claim a new file, or check that an existing one is
+                   compatible */
+                if( __atomic_compare_exchange_n( &( file->magic ), &magic,
+                                                 STATS_FILE_MAGIC, 0,
+                                                 __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ||
+                    ( magic == STATS_FILE_MAGIC )) {
+                    struct stats_op* const op = &( file->op[ p_oper ] );
+
+                    hist_add( &( op->total ), p_total_ns );
+                    hist_add( &( op->stat ), p_stat_ns );
+                    hist_add( &( op->parse ), p_parse_ns );
+                    __atomic_fetch_add( &( op->total_ns ), p_total_ns, __ATOMIC_RELAXED );
+                    __atomic_fetch_add( &( op->stat_ns ), p_stat_ns, __ATOMIC_RELAXED );
+                    __atomic_fetch_add( &( op->parse_ns ), p_parse_ns, __ATOMIC_RELAXED );
+                    __atomic_fetch_add( &( op->count ), 1U, __ATOMIC_RELAXED );
+                } else {
+                    DEBUG_OUT("stats file %s is incompatible", fn);
+                }
+
+                munmap( file, sizeof( struct stats_file ));
+            }
+        }
+        close( fd );
+    }
+
+    free( fn );
+}
+
+/** Output one row of the summary of an operation */
+static void show_row( const char* const p_name,
+                      const uint64_t p_count,
+                      const char* const p_time,
+                      const struct stats_hist* const p_hist,
+                      const uint64_t p_sum_ns,
+                      const uint64_t p_total_ns )
+{
+    const uint64_t count = hist_count( p_hist );
+
+    if( p_name != NULL ) {
+        fprintf( stdout, "%-10s %8llu ", p_name, (unsigned long long)p_count );
+    } else {
+        fprintf( stdout, "%-10s %8s ", "", "" );
+    }
+    fprintf( stdout, "%-6s %10.3f %10.3f %10.3f %10.3f %6.1f%%\n", p_time,
+             hist_percentile( p_hist, count, 0.5 ),
+             hist_percentile( p_hist, count, 0.99 ),
+             hist_percentile( p_hist, count, 0.999 ),
+             ( p_count != 0 ) ? ( p_sum_ns / 1e6 ) / (double)p_count : 0.0,
+             ( p_total_ns != 0 ) ? ( 100.0 * (double)p_sum_ns ) / (double)p_total_ns : 0.0 );
+}
+
+int stats_show( const char* const p_cmd )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    char* const fn = stats_fn( 0 );
+    const int fd = ( fn != NULL ) ? open( fn, O_RDONLY ) : -1;
+    struct stat s;
+
+    if(( fd != -1 ) &&
+       ( fstat( fd, &s ) == 0 ) &&
+       ( (size_t)s.st_size >= sizeof( struct stats_file ))) {
+        const struct stats_file* const file =
+            (const struct stats_file*)mmap( NULL, sizeof( struct stats_file ),
+                                            PROT_READ, MAP_SHARED, fd, 0 );
+
+        if( file == MAP_FAILED ) {
+            fprintf( stderr, "%s: Error: Unable to read %s\n", p_cmd, fn );
+        } else if( file->magic != STATS_FILE_MAGIC ) {
+            fprintf( stderr, "%s: Error: %s was written by an incompatible version\n",
+                     p_cmd, fn );
+            munmap( (void*)file, sizeof( struct stats_file ));
+        } else {
+            size_t loop;
+
+            fprintf( stdout, "%-10s %8s %-6s %10s %10s %10s %10s %7s\n",
+                     "operation", "count", "time", "p50 ms", "p99 ms", "p999 ms",
+                     "mean ms", "share" );
+
+            for( loop = 0; loop < STATS_MAX_OPS; loop++ ) {
+                const struct stats_op* const op = &( file->op[ loop ] );
+
+                if(( op_names[ loop ] != NULL ) && ( op->count != 0 )) {
+                    show_row( op_names[ loop ], op->count, "total", &( op->total ),
+                              op->total_ns, op->total_ns );
+                    show_row( NULL, op->count, "stat", &( op->stat ),
+                              op->stat_ns, op->total_ns );
+                    show_row( NULL, op->count, "parse", &( op->parse ),
+                              op->parse_ns, op->total_ns );
+                }
+            }
+
+            munmap( (void*)file, sizeof( struct stats_file ));
+            ret_val = WD_SUCCESS;
+        }
+    } else if( fn != NULL ) {
+        fprintf( stderr, "%s: Error: No stats recorded (see --record-stats)\n", p_cmd );
+    }
+
+    if( fd != -1 ) {
+        close( fd );
+    }
+    free( fn );
+
+    return( ret_val );
+}
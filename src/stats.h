@@ -0,0 +1,62 @@
+/**
+   \file
+   \brief The stats module accumulates the latency of invocations across
+          runs, so that the behaviour of wd over many uses can be examined
+          (see --record-stats and --stats)
+
+   Each recorded invocation adds its total time, the time spent in stat()
+   and the time spent reading & parsing list files to per-operation
+   histograms in $XDG_CACHE_HOME/wd/stats (or ~/.cache/wd/stats).  The
+   histograms have fixed log-linear buckets, so the file has a fixed size
+   and is updated in place, via a shared mapping, using atomic additions.
+   Concurrent invocations therefore never need to lock it or re-write it.
+
+   \copyright Copyright 2018 John Bailey
+
+   \section LICENSE
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if !defined( STATS_H )
+#define       STATS_H
+
+#include "cmdln.h"
+
+#include <stdint.h>
+
+/**
+    Add an invocation to the stats file.  Failures are silently ignored, as
+    they shouldn't affect the operation which was performed.
+
+    \param[in] p_oper     The operation performed
+    \param[in] p_total_ns Time taken by the invocation
+    \param[in] p_stat_ns  Time spent in stat()
+    \param[in] p_parse_ns Time spent reading & parsing list files
+*/
+void stats_record( const wd_oper_t p_oper,
+                   const uint64_t p_total_ns,
+                   const uint64_t p_stat_ns,
+                   const uint64_t p_parse_ns );
+
+/**
+    Output a summary of the stats file to stdout: the number of invocations
+    of each operation, their p50/p99/p999 latencies and how much of their
+    time was spent in stat() & parsing
+
+    \param[in] p_cmd Name of the executable, for error messages
+    \returns WD_SUCCESS if the summary was output
+*/
+int  stats_show( const char* const p_cmd );
+
+#endif
@@ -0,0 +1,300 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "str_kernel.h"
+
+#include <string.h>
+
+/* The vectorised kernels are compiled using per-function target attributes,
+   so the rest of the program doesn't need to be built for a particular
+   instruction set.  Which of them are used is decided at run time. */
+#if ( defined __x86_64__ || defined __i386__ ) && defined __GNUC__
+#define STR_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+static size_t span3_scalar( const char* const p_str, const size_t p_len,
+                            const char p_a, const char p_b, const char p_c )
+{
+    size_t loop;
+
+    for( loop = 0; loop < p_len; loop++ ) {
+        const char c = p_str[ loop ];
+        if(( c == p_a ) || ( c == p_b ) || ( c == p_c )) {
+            break;
+        }
+    }
+
+    return( loop );
+}
+
+static void copy_replace_scalar( char* const p_dest, const char* const p_src,
+                                 const size_t p_len,
+                                 const char p_from, const char p_to )
+{
+    size_t loop;
+
+    for( loop = 0; loop < p_len; loop++ ) {
+        p_dest[ loop ] = ( p_src[ loop ] == p_from ) ? p_to : p_src[ loop ];
+    }
+}
+
+static size_t find_scalar( const char* const p_str, const size_t p_len,
+                           const char* const p_needle, const size_t p_needle_len )
+{
+    size_t pos;
+
+    if( p_needle_len == 0 ) {
+        return( 0 );
+    }
+
+    for( pos = 0; ( pos + p_needle_len ) <= p_len; pos++ ) {
+        if(( p_str[ pos ] == p_needle[ 0 ] ) &&
+           ( 0 == memcmp( p_str + pos + 1, p_needle + 1, p_needle_len - 1U ))) {
+            return( pos );
+        }
+    }
+
+    return( p_len );
+}
+
+#if defined STR_KERNEL_X86
+
+__attribute__(( target( "sse2" )))
+static size_t span3_sse2( const char* const p_str, const size_t p_len,
+                          const char p_a, const char p_b, const char p_c )
+{
+    const __m128i a = _mm_set1_epi8( p_a );
+    const __m128i b = _mm_set1_epi8( p_b );
+    const __m128i c = _mm_set1_epi8( p_c );
+    size_t pos;
+
+    for( pos = 0; ( pos + 16U ) <= p_len; pos += 16U ) {
+        const __m128i v = _mm_loadu_si128( (const __m128i*)( p_str + pos ));
+        const int mask = _mm_movemask_epi8(
+            _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8( v, a ),
+                                        _mm_cmpeq_epi8( v, b )),
+                          _mm_cmpeq_epi8( v, c )));
+        if( mask != 0 ) {
+            return( pos + (size_t)__builtin_ctz( (unsigned)mask ));
+        }
+    }
+
+    return( pos + span3_scalar( p_str + pos, p_len - pos, p_a, p_b, p_c ));
+}
+
+__attribute__(( target( "sse2" )))
+static void copy_replace_sse2( char* const p_dest, const char* const p_src,
+                               const size_t p_len,
+                               const char p_from, const char p_to )
+{
+    const __m128i from = _mm_set1_epi8( p_from );
+    const __m128i to = _mm_set1_epi8( p_to );
+    size_t pos;
+
+    for( pos = 0; ( pos + 16U ) <= p_len; pos += 16U ) {
+        const __m128i v = _mm_loadu_si128( (const __m128i*)( p_src + pos ));
+        const __m128i match = _mm_cmpeq_epi8( v, from );
+        _mm_storeu_si128( (__m128i*)( p_dest + pos ),
+                          _mm_or_si128( _mm_andnot_si128( match, v ),
+                                        _mm_and_si128( match, to )));
+    }
+
+    copy_replace_scalar( p_dest + pos, p_src + pos, p_len - pos, p_from, p_to );
+}
+
+/* The vectorised finds compare the first & last characters of the needle
+   against a block of candidate positions at once, so that the rest of the
+   needle need only be compared where both match */
+__attribute__(( target( "sse2" )))
+static size_t find_sse2( const char* const p_str, const size_t p_len,
+                         const char* const p_needle, const size_t p_needle_len )
+{
+    size_t pos = 0;
+
+    if( p_needle_len != 0 ) {
+        const size_t last_off = p_needle_len - 1U;
+        const __m128i first = _mm_set1_epi8( p_needle[ 0 ] );
+        const __m128i last = _mm_set1_epi8( p_needle[ last_off ] );
+
+        for( ; ( pos + last_off + 16U ) <= p_len; pos += 16U ) {
+            const __m128i f = _mm_loadu_si128( (const __m128i*)( p_str + pos ));
+            const __m128i l = _mm_loadu_si128( (const __m128i*)( p_str + pos + last_off ));
+            unsigned mask = (unsigned)_mm_movemask_epi8(
+                _mm_and_si128( _mm_cmpeq_epi8( f, first ),
+                               _mm_cmpeq_epi8( l, last )));
+
+            while( mask != 0 ) {
+                const size_t cand = pos + (size_t)__builtin_ctz( mask );
+                if( 0 == memcmp( p_str + cand + 1, p_needle + 1, last_off )) {
+                    return( cand );
+                }
+                mask &= mask - 1U;
+            }
+        }
+    }
+
+    return( pos + find_scalar( p_str + pos, p_len - pos, p_needle, p_needle_len ));
+}
+
+__attribute__(( target( "avx2" )))
+static size_t span3_avx2( const char* const p_str, const size_t p_len,
+                          const char p_a, const char p_b, const char p_c )
+{
+    const __m256i a = _mm256_set1_epi8( p_a );
+    const __m256i b = _mm256_set1_epi8( p_b );
+    const __m256i c = _mm256_set1_epi8( p_c );
+    size_t pos;
+
+    for( pos = 0; ( pos + 32U ) <= p_len; pos += 32U ) {
+        const __m256i v = _mm256_loadu_si256( (const __m256i*)( p_str + pos ));
+        const unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8( v, a ),
+                                              _mm256_cmpeq_epi8( v, b )),
+                             _mm256_cmpeq_epi8( v, c )));
+        if( mask != 0 ) {
+            return( pos + (size_t)__builtin_ctz( mask ));
+        }
+    }
+
+    return( pos + span3_sse2( p_str + pos, p_len - pos, p_a, p_b, p_c ));
+}
+
+__attribute__(( target( "avx2" )))
+static void copy_replace_avx2( char* const p_dest, const char* const p_src,
+                               const size_t p_len,
+                               const char p_from, const char p_to )
+{
+    const __m256i from = _mm256_set1_epi8( p_from );
+    const __m256i to = _mm256_set1_epi8( p_to );
+    size_t pos;
+
+    for( pos = 0; ( pos + 32U ) <= p_len; pos += 32U ) {
+        const __m256i v = _mm256_loadu_si256( (const __m256i*)( p_src + pos ));
+        _mm256_storeu_si256( (__m256i*)( p_dest + pos ),
+                             _mm256_blendv_epi8( v, to, _mm256_cmpeq_epi8( v, from )));
+    }
+
+    copy_replace_sse2( p_dest + pos, p_src + pos, p_len - pos, p_from, p_to );
+}
+
+__attribute__(( target( "avx2" )))
+static size_t find_avx2( const char* const p_str, const size_t p_len,
+                         const char* const p_needle, const size_t p_needle_len )
+{
+    size_t pos = 0;
+
+    if( p_needle_len != 0 ) {
+        const size_t last_off = p_needle_len - 1U;
+        const __m256i first = _mm256_set1_epi8( p_needle[ 0 ] );
+        const __m256i last = _mm256_set1_epi8( p_needle[ last_off ] );
+
+        for( ; ( pos + last_off + 32U ) <= p_len; pos += 32U ) {
+            const __m256i f = _mm256_loadu_si256( (const __m256i*)( p_str + pos ));
+            const __m256i l = _mm256_loadu_si256( (const __m256i*)( p_str + pos + last_off ));
+            unsigned mask = (unsigned)_mm256_movemask_epi8(
+                _mm256_and_si256( _mm256_cmpeq_epi8( f, first ),
+                                  _mm256_cmpeq_epi8( l, last )));
+
+            while( mask != 0 ) {
+                const size_t cand = pos + (size_t)__builtin_ctz( mask );
+                if( 0 == memcmp( p_str + cand + 1, p_needle + 1, last_off )) {
+                    return( cand );
+                }
+                mask &= mask - 1U;
+            }
+        }
+    }
+
+    return( pos + find_sse2( p_str + pos, p_len - pos, p_needle, p_needle_len ));
+}
+
+#endif
+
+static const str_kernel_impl_t impls[] = {
+    { "scalar", span3_scalar, copy_replace_scalar, find_scalar },
+#if defined STR_KERNEL_X86
+    { "sse2",   span3_sse2,   copy_replace_sse2,   find_sse2 },
+    { "avx2",   span3_avx2,   copy_replace_avx2,   find_avx2 },
+#endif
+};
+
+/** Number of entries at the start of impls which the CPU supports, 0 until
+    determined */
+static size_t impl_count = 0;
+
+size_t str_kernel_impls( const str_kernel_impl_t** const p_impls )
+{
+    size_t count = __atomic_load_n( &impl_count, __ATOMIC_RELAXED );
+
+    if( count == 0 ) {
+        count = 1;
+#if defined STR_KERNEL_X86
+        __builtin_cpu_init();
+        if( __builtin_cpu_supports( "sse2" )) {
+            count++;
+            if( __builtin_cpu_supports( "avx2" )) {
+                count++;
+            }
+        }
+#endif
+        /* Any threads racing to get here will all reach the same result */
+        __atomic_store_n( &impl_count, count, __ATOMIC_RELAXED );
+    }
+
+    if( p_impls != NULL ) {
+        *p_impls = impls;
+    }
+
+    return( count );
+}
+
+size_t str_span3( const char* const p_str, const size_t p_len,
+                  const char p_a, const char p_b, const char p_c )
+{
+    size_t count = __atomic_load_n( &impl_count, __ATOMIC_RELAXED );
+
+    if( count == 0 ) {
+        count = str_kernel_impls( NULL );
+    }
+
+    return( impls[ count - 1 ].span3( p_str, p_len, p_a, p_b, p_c ));
+}
+
+void str_copy_replace( char* const p_dest, const char* const p_src,
+                       const size_t p_len,
+                       const char p_from, const char p_to )
+{
+    size_t count = __atomic_load_n( &impl_count, __ATOMIC_RELAXED );
+
+    if( count == 0 ) {
+        count = str_kernel_impls( NULL );
+    }
+
+    impls[ count - 1 ].copy_replace( p_dest, p_src, p_len, p_from, p_to );
+}
+
+size_t str_find( const char* const p_str, const size_t p_len,
+                 const char* const p_needle, const size_t p_needle_len )
+{
+    size_t count = __atomic_load_n( &impl_count, __ATOMIC_RELAXED );
+
+    if( count == 0 ) {
+        count = str_kernel_impls( NULL );
+    }
+
+    return( impls[ count - 1 ].find( p_str, p_len, p_needle, p_needle_len ));
+}
@@ -0,0 +1,88 @@
+/**
+   \file
+   \brief The str_kernel module provides the inner loops used when formatting
+          & escaping paths, with vectorised implementations selected at run
+          time according to the capabilities of the CPU
+
+   \copyright Copyright 2018 John Bailey
+
+   \section LICENSE
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if !defined( STR_KERNEL_H )
+#define       STR_KERNEL_H
+
+#include <stddef.h>
+
+/** Length of the initial segment of p_str (of length p_len) which contains
+    none of p_a, p_b or p_c */
+typedef size_t (*str_span3_fn)( const char* const p_str, const size_t p_len,
+                                const char p_a, const char p_b, const char p_c );
+
+/** Copy p_len characters from p_src to p_dest, replacing p_from with p_to */
+typedef void   (*str_copy_replace_fn)( char* const p_dest, const char* const p_src,
+                                       const size_t p_len,
+                                       const char p_from, const char p_to );
+
+/** Offset of the first occurrence of p_needle (of length p_needle_len) in
+    p_str (of length p_len), or p_len if there is none */
+typedef size_t (*str_find_fn)( const char* const p_str, const size_t p_len,
+                               const char* const p_needle,
+                               const size_t p_needle_len );
+
+/** A set of kernels targeting a particular instruction set */
+typedef struct {
+    const char*         name;
+    str_span3_fn        span3;
+    str_copy_replace_fn copy_replace;
+    str_find_fn         find;
+} str_kernel_impl_t;
+
+/**
+    \returns Length of the initial segment of p_str (of length p_len) which
+             contains none of the specified characters.  Pass the same
+             character more than once to search for fewer.
+*/
+size_t str_span3( const char* const p_str, const size_t p_len,
+                  const char p_a, const char p_b, const char p_c );
+
+/**
+    Copy p_len characters from p_src to p_dest, replacing p_from with p_to.
+    The areas must not overlap.
+*/
+void   str_copy_replace( char* const p_dest, const char* const p_src,
+                         const size_t p_len,
+                         const char p_from, const char p_to );
+
+/**
+    \returns Offset of the first occurrence of p_needle (of length
+             p_needle_len) in p_str (of length p_len), or p_len if there is
+             none.  Either may contain NULs.  An empty needle is found at 0.
+*/
+size_t str_find( const char* const p_str, const size_t p_len,
+                 const char* const p_needle, const size_t p_needle_len );
+
+/**
+    Retrieve all of the implementations which the CPU supports, for testing
+    & benchmarking.  The first is always the portable implementation and the
+    last is the one used by str_span3(), str_copy_replace() and
+    str_find().
+
+    \param[out] p_impls Set to point to the array of implementations
+    \returns Number of implementations
+*/
+size_t str_kernel_impls( const str_kernel_impl_t** const p_impls );
+
+#endif
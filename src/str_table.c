@@ -0,0 +1,207 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "wd.h"
+#include "str_table.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Initial number of slots.  Always a power of 2 */
+#define MIN_SLOTS      64U
+/** Initial size of the storage for keys */
+#define MIN_KEYS_SIZE  4096U
+
+struct str_table_slot
+{
+    /** Offset of the key within keys plus 1, or 0 for an empty slot */
+    size_t   key;
+    /** Hash of the key, so that most mismatches don't need a strcmp() */
+    uint64_t hash;
+    size_t   value;
+};
+
+struct str_table_s
+{
+    struct str_table_slot* slots;
+    size_t                 slot_count;
+    size_t                 count;
+    /** NUL terminated keys, referred to by offset so that they can be
+        re-allocated */
+    char*                  keys;
+    size_t                 keys_used;
+    size_t                 keys_size;
+};
+
+/** FNV-1a */
+static uint64_t str_hash( const char* p_str, size_t* const p_len )
+{
+    const char* const start = p_str;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    while( *p_str != '\0' ) {
+        hash ^= (unsigned char)*p_str;
+        hash *= 0x100000001b3ULL;
+        p_str++;
+    }
+
+    *p_len = (size_t)( p_str - start );
+    return( hash );
+}
+
+/** Find the slot which holds p_key, or the empty slot where it would go */
+static struct str_table_slot* find_slot( const str_table_t p_table,
+                                         const char* const p_key,
+                                         const uint64_t p_hash )
+{
+    const size_t mask = p_table->slot_count - 1U;
+    size_t idx = (size_t)p_hash & mask;
+    struct str_table_slot* slot = &( p_table->slots[ idx ] );
+
+    while(( slot->key != 0 ) &&
+          (( slot->hash != p_hash ) ||
+           ( 0 != strcmp( p_table->keys + slot->key - 1U, p_key )))) {
+        idx = ( idx + 1U ) & mask;
+        slot = &( p_table->slots[ idx ] );
+    }
+
+    return( slot );
+}
+
+/** Double the number of slots */
+static int grow( str_table_t p_table )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    const size_t old_count = p_table->slot_count;
+    struct str_table_slot* const old_slots = p_table->slots;
+    struct str_table_slot* new_slots =
+        (struct str_table_slot*)calloc( old_count * 2U, sizeof( *new_slots ));
+
+    if( new_slots != NULL ) {
+        size_t loop;
+
+        p_table->slots = new_slots;
+        p_table->slot_count = old_count * 2U;
+
+        for( loop = 0; loop < old_count; loop++ ) {
+            if( old_slots[ loop ].key != 0 ) {
+                const size_t mask = p_table->slot_count - 1U;
+                size_t idx = (size_t)old_slots[ loop ].hash & mask;
+
+                while( new_slots[ idx ].key != 0 ) {
+                    idx = ( idx + 1U ) & mask;
+                }
+                new_slots[ idx ] = old_slots[ loop ];
+            }
+        }
+
+        free( old_slots );
+        ret_val = WD_SUCCESS;
+    }
+
+    return( ret_val );
+}
+
+str_table_t str_table_new( void )
+{
+    str_table_t ret_val = (str_table_t)malloc( sizeof( struct str_table_s ));
+
+    if( ret_val != NULL ) {
+        ret_val->slot_count = MIN_SLOTS;
+        ret_val->count = 0;
+        ret_val->slots = (struct str_table_slot*)calloc( MIN_SLOTS,
+                                                         sizeof( struct str_table_slot ));
+        ret_val->keys_used = 0;
+        ret_val->keys_size = MIN_KEYS_SIZE;
+        ret_val->keys = (char*)malloc( MIN_KEYS_SIZE );
+
+        if(( ret_val->slots == NULL ) || ( ret_val->keys == NULL )) {
+            str_table_free( ret_val );
+            ret_val = NULL;
+        }
+    }
+
+    return( ret_val );
+}
+
+void str_table_free( str_table_t p_table )
+{
+    if( p_table != NULL ) {
+        free( p_table->slots );
+        free( p_table->keys );
+        free( p_table );
+    }
+}
+
+size_t* str_table_find( str_table_t p_table, const char* const p_key )
+{
+    size_t len;
+    struct str_table_slot* const slot =
+        find_slot( p_table, p_key, str_hash( p_key, &len ));
+
+    return(( slot->key != 0 ) ? &( slot->value ) : NULL );
+}
+
+int str_table_add( str_table_t p_table, const char* const p_key,
+                   const size_t p_value )
+{
+    int ret_val = WD_SUCCESS;
+    size_t len;
+    const uint64_t hash = str_hash( p_key, &len );
+
+    /* Keep at most half of the slots in use, so that probe sequences stay
+       short */
+    if((( p_table->count + 1U ) * 2U ) > p_table->slot_count ) {
+        ret_val = grow( p_table );
+    }
+
+    if( WD_SUCCEEDED( ret_val ) &&
+        ( p_table->keys_used + len + 1U > p_table->keys_size )) {
+        size_t new_size = p_table->keys_size * 2U;
+        char* new_keys;
+
+        if( new_size < p_table->keys_used + len + 1U ) {
+            new_size = p_table->keys_used + len + 1U;
+        }
+
+        new_keys = (char*)realloc( p_table->keys, new_size );
+        if( new_keys != NULL ) {
+            p_table->keys = new_keys;
+            p_table->keys_size = new_size;
+        } else {
+            ret_val = WD_GENERIC_FAIL;
+        }
+    }
+
+    if( WD_SUCCEEDED( ret_val )) {
+        struct str_table_slot* const slot = find_slot( p_table, p_key, hash );
+
+        memcpy( p_table->keys + p_table->keys_used, p_key, len + 1U );
+        slot->key = p_table->keys_used + 1U;
+        slot->hash = hash;
+        slot->value = p_value;
+        p_table->keys_used += len + 1U;
+        p_table->count++;
+    }
+
+    return( ret_val );
+}
+
+size_t str_table_count( const str_table_t p_table )
+{
+    return( p_table->count );
+}
@@ -0,0 +1,55 @@
+/**
+   \file
+   \brief The str_table module provides a hash table mapping strings to
+          values, used to look up paths & names without scanning a list
+
+   \copyright Copyright 2018 John Bailey
+
+   \section LICENSE
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if !defined( STR_TABLE_H )
+#define       STR_TABLE_H
+
+#include <stddef.h>
+
+typedef struct str_table_s* str_table_t;
+
+/**
+    \returns An empty table or NULL if memory couldn't be allocated
+*/
+str_table_t str_table_new( void );
+
+void        str_table_free( str_table_t p_table );
+
+/**
+    \returns Pointer to the value associated with p_key, which may be
+             modified, or NULL if the key isn't in the table.  Only valid
+             until the table is next added to.
+*/
+size_t*     str_table_find( str_table_t p_table, const char* const p_key );
+
+/**
+    Add a key (which must not already be present).  The key is copied.
+
+    \returns WD_SUCCESS or WD_GENERIC_FAIL if memory couldn't be allocated
+*/
+int         str_table_add( str_table_t p_table, const char* const p_key,
+                           const size_t p_value );
+
+/** \returns Number of keys in the table */
+size_t      str_table_count( const str_table_t p_table );
+
+#endif
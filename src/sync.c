@@ -0,0 +1,536 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "wd.h"
+#include "sync.h"
+#include "list_cache.h"
+#include "str_table.h"
+#if !defined WIN32
+#include "snapshot.h"
+#include "write_behind.h"
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/** The two lists being merged */
+typedef enum {
+    SYNC_LOCAL,   /**< The user's list */
+    SYNC_OTHER,   /**< The list named by --sync */
+    SYNC_SIDES
+} sync_side_t;
+
+#define SYNC_NONE ((size_t)-1)
+
+/** An entry of a list, in path order */
+struct sync_rec
+{
+    const char* path;
+    size_t      idx;
+};
+
+/** The entries (or removals) of a list, sorted by path */
+struct sync_seq
+{
+    dir_list_t       list;
+    struct sync_rec* recs;
+    size_t           count;
+    size_t           pos;
+};
+
+/** A bookmark in the merged list */
+struct sync_entry
+{
+    /** Index of the path's first bookmark in each list, or SYNC_NONE */
+    size_t        at[ SYNC_SIDES ];
+    const char*   path;
+    const char*   name;
+    time_t        added;
+    time_t        accessed;
+    unsigned long hits;
+    wd_entity_t   type;
+    /** Bookmark from which the name, type & tags are taken */
+    dir_list_t    from;
+    size_t        from_idx;
+};
+
+/** A removal in the merged list */
+struct sync_removal
+{
+    const char* path;
+    time_t      removed;
+};
+
+struct sync_state
+{
+    struct sync_seq      live[ SYNC_SIDES ];
+    struct sync_seq      removed[ SYNC_SIDES ];
+    /** For each list, the merged entry represented by each of its bookmarks
+        (at most one per path), or NULL */
+    struct sync_entry**  kept[ SYNC_SIDES ];
+    struct sync_entry*   entries;
+    size_t               entry_count;
+    struct sync_removal* removals;
+    size_t               removal_count;
+    /** Non-zero if the merged list differs from each list */
+    int                  changed[ SYNC_SIDES ];
+    /** Bookmarks each list gains & the number of bookmarks removed */
+    unsigned long        gained[ SYNC_SIDES ];
+    unsigned long        lost;
+};
+
+static int rec_compare( const void* p_a, const void* p_b )
+{
+    const struct sync_rec* const a = (const struct sync_rec*)p_a;
+    const struct sync_rec* const b = (const struct sync_rec*)p_b;
+    const int ret_val = strcmp( a->path, b->path );
+
+    /* Ties are kept in list order, so the first bookmark for a path is the
+       one retained */
+    if( ret_val != 0 ) {
+        return( ret_val );
+    }
+    return(( a->idx < b->idx ) ? -1 : ( a->idx > b->idx ));
+}
+
+/** Sort the entries of p_list (which may be NULL) by path */
+static int seq_init( struct sync_seq* const p_seq, const dir_list_t p_list )
+{
+    const size_t count = ( p_list != NULL ) ? dir_list_get_count( p_list ) : 0;
+    size_t loop;
+
+    p_seq->list = p_list;
+    p_seq->count = count;
+    p_seq->pos = 0;
+    p_seq->recs = (struct sync_rec*)malloc(( count + 1U ) * sizeof( struct sync_rec ));
+
+    if( p_seq->recs != NULL ) {
+        for( loop = 0; loop < count; loop++ ) {
+            p_seq->recs[ loop ].path = dir_list_get_dir( p_list, loop );
+            p_seq->recs[ loop ].idx = loop;
+        }
+        qsort( p_seq->recs, count, sizeof( struct sync_rec ), rec_compare );
+    }
+
+    return(( p_seq->recs != NULL ) ? WD_SUCCESS : WD_GENERIC_FAIL );
+}
+
+/** \returns Path of the next entry of p_seq, or NULL if there are no more */
+static const char* seq_head( const struct sync_seq* const p_seq )
+{
+    return(( p_seq->pos < p_seq->count ) ? p_seq->recs[ p_seq->pos ].path : NULL );
+}
+
+/** \returns Non-zero if the names (or tags) are the same, an empty string
+             being the same as none */
+static int name_equal( const char* const p_a, const char* const p_b )
+{
+    const char* const a = (( p_a == NULL ) || ( p_a[0] == '\0' )) ? "" : p_a;
+    const char* const b = (( p_b == NULL ) || ( p_b[0] == '\0' )) ? "" : p_b;
+
+    return( 0 == strcmp( a, b ));
+}
+
+/** \returns The most recent time that the bookmark was added or accessed */
+static time_t last_write( const dir_list_t p_list, const size_t p_idx )
+{
+    const time_t added = dir_list_get_time_added( p_list, p_idx );
+    const time_t accessed = dir_list_get_time_accessed( p_list, p_idx );
+
+    return(( added > accessed ) ? added : accessed );
+}
+
+/** Merge the bookmarks & removals of p_path, which is at the head of at
+    least one of the sequences */
+static void merge_path( struct sync_state* const p_state, const char* const p_path )
+{
+    struct sync_entry* const entry = &( p_state->entries[ p_state->entry_count ] );
+    time_t removed[ SYNC_SIDES ];
+    time_t removed_at = -1;
+    time_t newest = -1;
+    size_t dups[ SYNC_SIDES ];
+    size_t removals[ SYNC_SIDES ];
+    int have = 0;
+    int side;
+
+    entry->path = p_path;
+    entry->name = NULL;
+    entry->added = -1;
+    entry->accessed = -1;
+    entry->hits = 0;
+    entry->type = WD_ENTITY_UNKNOWN;
+    entry->from = NULL;
+    entry->from_idx = 0;
+
+    for( side = 0; side < SYNC_SIDES; side++ ) {
+        struct sync_seq* const live = &( p_state->live[ side ] );
+        struct sync_seq* const gone = &( p_state->removed[ side ] );
+
+        entry->at[ side ] = SYNC_NONE;
+        dups[ side ] = 0;
+
+        for( ; ( seq_head( live ) != NULL ) && ( 0 == strcmp( seq_head( live ), p_path ));
+             live->pos++ ) {
+            const size_t idx = live->recs[ live->pos ].idx;
+            const time_t added = dir_list_get_time_added( live->list, idx );
+            const time_t accessed = dir_list_get_time_accessed( live->list, idx );
+            const unsigned long hits = dir_list_get_hits( live->list, idx );
+            const time_t written = last_write( live->list, idx );
+
+            if( entry->at[ side ] == SYNC_NONE ) {
+                entry->at[ side ] = idx;
+            } else {
+                dups[ side ]++;
+            }
+
+            /* The name & tags are those of the most recently written copy,
+               the first seen (i.e. the user's) winning a tie */
+            if( !have || ( written > newest )) {
+                entry->name = dir_list_get_name( live->list, idx );
+                entry->type = dir_list_get_type( live->list, idx );
+                entry->from = live->list;
+                entry->from_idx = idx;
+                newest = written;
+            }
+            if(( added != -1 ) && (( entry->added == -1 ) || ( added < entry->added ))) {
+                entry->added = added;
+            }
+            if( accessed > entry->accessed ) {
+                entry->accessed = accessed;
+            }
+            if( hits > entry->hits ) {
+                entry->hits = hits;
+            }
+            have = 1;
+        }
+
+        removed[ side ] = -1;
+        removals[ side ] = 0;
+        for( ; ( seq_head( gone ) != NULL ) && ( 0 == strcmp( seq_head( gone ), p_path ));
+             gone->pos++ ) {
+            const time_t t = dir_list_get_time_accessed( gone->list,
+                                                         gone->recs[ gone->pos ].idx );
+            if( t > removed[ side ] ) {
+                removed[ side ] = t;
+            }
+            removals[ side ]++;
+        }
+        if( removed[ side ] > removed_at ) {
+            removed_at = removed[ side ];
+        }
+    }
+
+    /* A removal at the same time as the bookmark was last written wins, e.g.
+       for a bookmark added & removed within the same second */
+    if( have && (( removed_at == -1 ) || ( newest > removed_at ))) {
+        const sync_side_t keeper = ( entry->at[ SYNC_LOCAL ] != SYNC_NONE ) ?
+                                       SYNC_LOCAL : SYNC_OTHER;
+
+        p_state->kept[ keeper ][ entry->at[ keeper ]] = entry;
+        p_state->entry_count++;
+
+        for( side = 0; side < SYNC_SIDES; side++ ) {
+            /* Whether the bookmark itself differs is determined once it's
+               known whether it keeps its name */
+            if(( dups[ side ] > 0 ) || ( removals[ side ] > 0 )) {
+                p_state->changed[ side ] = 1;
+            }
+        }
+    } else {
+        struct sync_removal* const removal = &( p_state->removals[ p_state->removal_count++ ] );
+
+        removal->path = p_path;
+        removal->removed = removed_at;
+
+        if( have ) {
+            p_state->lost++;
+        }
+        for( side = 0; side < SYNC_SIDES; side++ ) {
+            /* Only one removal is needed */
+            if(( entry->at[ side ] != SYNC_NONE ) || ( removed[ side ] != removed_at ) ||
+               ( removals[ side ] > 1 )) {
+                p_state->changed[ side ] = 1;
+            }
+        }
+    }
+}
+
+/** Add a merged bookmark to p_merged, noting how it differs from each list */
+static int emit_entry( struct sync_state* const p_state, const char* const p_cmd,
+                       dir_list_t p_merged, str_table_t p_names,
+                       const struct sync_entry* const p_entry )
+{
+    int ret_val;
+    const char* name = p_entry->name;
+    char* tags = NULL;
+    int side;
+
+    if(( name != NULL ) && ( name[0] != '\0' )) {
+        if( str_table_find( p_names, name ) != NULL ) {
+            fprintf( stderr, "%s: Warning: Bookmark name already in list: '%s', "
+                             "keeping '%s' without a name\n",
+                     p_cmd, name, p_entry->path );
+            name = NULL;
+        } else {
+            /* Failing to index just means that a clash won't be spotted */
+            (void)str_table_add( p_names, name, dir_list_get_count( p_merged ));
+        }
+    }
+
+    ret_val = add_dir( p_merged, p_entry->path, name, p_entry->added,
+                       p_entry->accessed, p_entry->type );
+
+    if( WD_SUCCEEDED( ret_val )) {
+        const size_t merged_idx = dir_list_get_count( p_merged ) - 1U;
+
+        dir_list_set_hits( p_merged, merged_idx, p_entry->hits );
+        ret_val = dir_list_copy_tags( p_merged, merged_idx,
+                                      p_entry->from, p_entry->from_idx );
+        tags = dir_list_get_tags( p_merged, merged_idx );
+    }
+
+    for( side = 0; WD_SUCCEEDED( ret_val ) && ( side < SYNC_SIDES ); side++ ) {
+        const dir_list_t list = p_state->live[ side ].list;
+        const size_t idx = p_entry->at[ side ];
+
+        if( idx == SYNC_NONE ) {
+            p_state->changed[ side ] = 1;
+            p_state->gained[ side ]++;
+        } else {
+            /* Tags are compared in their sorted form, as the lists may
+               hold them in different orders */
+            char* const list_tags = dir_list_get_tags( list, idx );
+
+            if( !name_equal( name, dir_list_get_name( list, idx )) ||
+                !name_equal( tags, list_tags ) ||
+                ( p_entry->added != dir_list_get_time_added( list, idx )) ||
+                ( p_entry->accessed != dir_list_get_time_accessed( list, idx )) ||
+                ( p_entry->hits != dir_list_get_hits( list, idx ))) {
+                p_state->changed[ side ] = 1;
+            }
+            free( list_tags );
+        }
+    }
+    free( tags );
+
+    return( ret_val );
+}
+
+/** Build the merged list, with the user's bookmarks in their existing order
+    followed by those from the other list */
+static dir_list_t build_merged( struct sync_state* const p_state,
+                                const config_container_t* const p_config,
+                                const char* const p_cmd )
+{
+    dir_list_t ret_val = new_dir_list();
+    str_table_t names = str_table_new();
+    int ok = ( ret_val != NULL ) && ( names != NULL );
+    size_t loop;
+    int side;
+
+    if( ret_val != NULL ) {
+        dir_list_set_config( ret_val, p_config );
+        ok = ok && WD_SUCCEEDED( dir_list_record_removals( ret_val ));
+    }
+
+    for( side = 0; ok && ( side < SYNC_SIDES ); side++ ) {
+        for( loop = 0; ok && ( loop < p_state->live[ side ].count ); loop++ ) {
+            if( p_state->kept[ side ][ loop ] != NULL ) {
+                ok = WD_SUCCEEDED( emit_entry( p_state, p_cmd, ret_val, names,
+                                               p_state->kept[ side ][ loop ] ));
+            }
+        }
+    }
+
+    /* Added last, as adding a bookmark discards any removal of its path */
+    for( loop = 0; ok && ( loop < p_state->removal_count ); loop++ ) {
+        ok = WD_SUCCEEDED( dir_list_add_removed( ret_val, p_state->removals[ loop ].path,
+                                                 p_state->removals[ loop ].removed ));
+    }
+
+    if( !ok ) {
+        free_dir_list( ret_val );
+        ret_val = NULL;
+    }
+    str_table_free( names );
+
+    return( ret_val );
+}
+
+/** Merge p_local & p_other.  The entries of both lists are sorted by path,
+    then merged in a single pass
+
+    \returns The merged list or NULL if memory ran out */
+static dir_list_t merge_lists( struct sync_state* const p_state,
+                               const config_container_t* const p_config,
+                               const char* const p_cmd,
+                               const dir_list_t p_local, const dir_list_t p_other )
+{
+    dir_list_t ret_val = NULL;
+    const dir_list_t lists[ SYNC_SIDES ] = { p_local, p_other };
+    size_t total = 0;
+    int ok = 1;
+    int side;
+
+    memset( p_state, 0, sizeof( *p_state ));
+
+    for( side = 0; side < SYNC_SIDES; side++ ) {
+        const size_t count = dir_list_get_count( lists[ side ] );
+
+        ok = ok && WD_SUCCEEDED( seq_init( &( p_state->live[ side ] ), lists[ side ] )) &&
+                   WD_SUCCEEDED( seq_init( &( p_state->removed[ side ] ),
+                                           dir_list_get_removed( lists[ side ] )));
+        p_state->kept[ side ] = (struct sync_entry**)calloc( count + 1U,
+                                                             sizeof( struct sync_entry* ));
+        ok = ok && ( p_state->kept[ side ] != NULL );
+        total += count + p_state->removed[ side ].count;
+
+        /* Removals need to be recorded from now on */
+        if( dir_list_get_removed( lists[ side ] ) == NULL ) {
+            p_state->changed[ side ] = 1;
+        }
+    }
+
+    /* Each path becomes at most one entry or removal */
+    p_state->entries = (struct sync_entry*)malloc(( total + 1U ) * sizeof( struct sync_entry ));
+    p_state->removals = (struct sync_removal*)malloc(( total + 1U ) * sizeof( struct sync_removal ));
+
+    if( ok && ( p_state->entries != NULL ) && ( p_state->removals != NULL )) {
+        for( ;; ) {
+            const char* path = NULL;
+
+            for( side = 0; side < SYNC_SIDES; side++ ) {
+                const char* const live = seq_head( &( p_state->live[ side ] ));
+                const char* const gone = seq_head( &( p_state->removed[ side ] ));
+
+                if(( live != NULL ) && (( path == NULL ) || ( strcmp( live, path ) < 0 ))) {
+                    path = live;
+                }
+                if(( gone != NULL ) && (( path == NULL ) || ( strcmp( gone, path ) < 0 ))) {
+                    path = gone;
+                }
+            }
+
+            if( path == NULL ) {
+                break;
+            }
+            merge_path( p_state, path );
+        }
+
+        ret_val = build_merged( p_state, p_config, p_cmd );
+    }
+
+    for( side = 0; side < SYNC_SIDES; side++ ) {
+        free( p_state->live[ side ].recs );
+        free( p_state->removed[ side ].recs );
+        free( p_state->kept[ side ] );
+    }
+    free( p_state->entries );
+    free( p_state->removals );
+
+    return( ret_val );
+}
+
+int sync_lists( const config_container_t* const p_config,
+                const char* const p_cmd,
+                dir_list_t p_list )
+{
+    int ret_val = 0;
+    const char* const fn = p_config->wd_sync_fn;
+    dir_list_t other = NULL;
+    dir_list_t merged = NULL;
+    struct sync_state state;
+    file_sig_t local_sig;
+    file_sig_t other_sig;
+    struct stat s;
+#if !defined WIN32
+    int lock;
+#endif
+
+    /* Precondition check */
+    assert( p_config != NULL );
+    assert( p_config->wd_sync_fn != NULL );
+    assert( p_list != NULL );
+    /* !Precondition check */
+
+    file_sig_get( p_config->list_fn, &local_sig );
+    file_sig_get( fn, &other_sig );
+    if( file_sig_equal( &local_sig, &other_sig )) {
+        fprintf( stderr, "%s: Error: '%s' is the list being synchronised\n",
+                 p_cmd, fn );
+        return( 0 );
+    }
+
+#if !defined WIN32
+    /* As for the user's list, don't read the other while it's being saved */
+    lock = write_behind_lock( fn, 0 );
+#endif
+
+    if(( stat( fn, &s ) != 0 ) && ( errno == ENOENT )) {
+        /* First synchronisation with a new copy */
+        other = new_dir_list();
+        if( other != NULL ) {
+            dir_list_set_config( other, p_config );
+        }
+    } else {
+        other = load_dir_list( p_config, fn );
+        if( other == NULL ) {
+            fprintf( stderr, "%s: Error: Unable to load list file '%s'\n",
+                     p_cmd, fn );
+        }
+    }
+
+    if( other != NULL ) {
+        merged = merge_lists( &state, p_config, p_cmd, p_list, other );
+        if( merged == NULL ) {
+            fprintf( stderr, "%s: Error: Out of memory\n", p_cmd );
+        }
+    }
+
+    if( merged != NULL ) {
+        if( state.changed[ SYNC_OTHER ] &&
+            !WD_SUCCEEDED( save_dir_list( merged, fn ))) {
+            /* The user's list is left as it is, so nothing is lost */
+            fprintf( stderr, "%s: Error: Unable to save list file '%s'\n",
+                     p_cmd, fn );
+        } else {
+#if !defined WIN32
+            if( state.changed[ SYNC_OTHER ] ) {
+                snapshot_invalidate( fn );
+            }
+#endif
+            fprintf( stdout, "Synchronised with '%s': %lu bookmark(s) added here, "
+                             "%lu added there, %lu removed\n",
+                     fn, state.gained[ SYNC_LOCAL ], state.gained[ SYNC_OTHER ],
+                     state.lost );
+
+            dir_list_swap( p_list, merged );
+            ret_val = state.changed[ SYNC_LOCAL ];
+        }
+    }
+
+#if !defined WIN32
+    write_behind_unlock( lock );
+#endif
+    free_dir_list( merged );
+    free_dir_list( other );
+
+    return( ret_val );
+}
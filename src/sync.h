@@ -0,0 +1,56 @@
+/**
+   \file
+   \brief The sync module merges two copies of a bookmark list, e.g. those
+          kept on different hosts, so that both end up the same (see --sync)
+
+   Both lists are sorted by path and merged in a single pass.  Where both
+   have a bookmark for the same path, each field is resolved separately:
+     - The time added is the earlier of the two
+     - The time accessed & use count are the greater of the two
+     - The name & tags are those of whichever copy was added or accessed
+       most recently (the list being synchronised wins a tie)
+   A bookmark which was removed from either list stays removed unless it was
+   added or accessed more recently than it was removed.  Lists only record
+   removals once they've been synchronised (see dir_list_record_removals()),
+   so lists which aren't don't grow.
+
+   Merging is idempotent, so lists can be synchronised repeatedly (e.g. from
+   cron).  Files are only rewritten if their content changes.
+
+   \copyright Copyright 2018 John Bailey
+
+   \section LICENSE
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if !defined( SYNC_H )
+#define       SYNC_H
+
+#include "cmdln.h"
+#include "dir_list.h"
+
+/**
+    Merge p_list with the list in p_config->wd_sync_fn, saving the result to
+    that file (which is created if it doesn't exist) and leaving it in p_list
+
+    \param p_config Program settings
+    \param p_cmd    String referencing the executing program
+    \param p_list   The user's list
+    \returns Non-zero if p_list has been modified and needs saving
+*/
+int sync_lists( const config_container_t* const p_config,
+                const char* const p_cmd,
+                dir_list_t p_list );
+
+#endif
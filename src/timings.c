@@ -0,0 +1,142 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "timings.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define TIMINGS_OPTION "--timings"
+#define RECORD_STATS_OPTION "--record-stats"
+
+int wd_timings_on = 0;
+
+static int      report = 0;
+static uint64_t start_time;
+static uint64_t phase_ns[ WD_PHASE_COUNT ];
+static uint64_t counters[ WD_COUNTER_COUNT ];
+
+static const char* const phase_names[ WD_PHASE_COUNT ] = {
+    "environment", "command line", "load", "operation", "save"
+};
+
+uint64_t timings_now( void )
+{
+#if defined WIN32
+    LARGE_INTEGER count;
+    LARGE_INTEGER freq;
+    QueryPerformanceCounter( &count );
+    QueryPerformanceFrequency( &freq );
+    return( (uint64_t)(( count.QuadPart * 1000000000.0 ) / freq.QuadPart ));
+#else
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return(( (uint64_t)ts.tv_sec * 1000000000U ) + (uint64_t)ts.tv_nsec );
+#endif
+}
+
+void timings_init( const int argc, char* const argv[] )
+{
+    /* Same variable as read by process_env().  Looking for the option within
+       it (rather than splitting it up) may give a false positive for a
+       quoted argument, but that only means timings are collected. */
+    const char* const opts = getenv( "WD_OPTS" );
+    int loop;
+
+    if( opts != NULL ) {
+        if( strstr( opts, TIMINGS_OPTION ) != NULL ) {
+            timings_enable( 1 );
+        } else if( strstr( opts, RECORD_STATS_OPTION ) != NULL ) {
+            timings_enable( 0 );
+        }
+    }
+
+    for( loop = 1; loop < argc; loop++ ) {
+        if( 0 == strcmp( argv[ loop ], TIMINGS_OPTION )) {
+            timings_enable( 1 );
+        } else if( 0 == strcmp( argv[ loop ], RECORD_STATS_OPTION )) {
+            timings_enable( 0 );
+        }
+    }
+}
+
+void timings_enable( const int p_report )
+{
+    if( !wd_timings_on ) {
+        start_time = timings_now();
+        wd_timings_on = 1;
+    }
+    report |= p_report;
+}
+
+uint64_t timings_elapsed( void )
+{
+    return( timings_now() - start_time );
+}
+
+uint64_t timings_counter( const wd_counter_t p_counter )
+{
+    return( __atomic_load_n( &counters[ p_counter ], __ATOMIC_RELAXED ));
+}
+
+void timings_add_phase( const wd_phase_t p_phase, const uint64_t p_mark )
+{
+    phase_ns[ p_phase ] += timings_now() - p_mark;
+}
+
+void timings_add( const wd_counter_t p_counter, const uint64_t p_val )
+{
+    __atomic_fetch_add( &counters[ p_counter ], p_val, __ATOMIC_RELAXED );
+}
+
+void timings_report( const char* const p_cmd )
+{
+    const uint64_t total = timings_now() - start_time;
+    size_t loop;
+
+    if( !report ) {
+        return;
+    }
+
+    fprintf( stderr, "%s: Timings (ms):\n", p_cmd );
+    for( loop = 0; loop < WD_PHASE_COUNT; loop++ ) {
+        fprintf( stderr, "  %-16s %10.3f\n", phase_names[ loop ], phase_ns[ loop ] / 1e6 );
+    }
+    fprintf( stderr, "  %-16s %10.3f\n", "total", total / 1e6 );
+
+    fprintf( stderr, "%s: Counters:\n", p_cmd );
+    fprintf( stderr, "  %-16s %10llu (%.3f ms)\n", "records parsed",
+             (unsigned long long)counters[ WD_COUNTER_RECORDS ],
+             counters[ WD_COUNTER_PARSE_NS ] / 1e6 );
+    fprintf( stderr, "  %-16s %10llu (%.3f ms)\n", "stats issued",
+             (unsigned long long)counters[ WD_COUNTER_STATS ],
+             counters[ WD_COUNTER_STAT_NS ] / 1e6 );
+    fprintf( stderr, "  %-16s %10llu\n", "bytes read",
+             (unsigned long long)counters[ WD_COUNTER_READ ] );
+    fprintf( stderr, "  %-16s %10llu\n", "bytes written",
+             (unsigned long long)counters[ WD_COUNTER_WRITTEN ] );
+    fprintf( stderr, "  %-16s %10llu\n", "allocations",
+             (unsigned long long)counters[ WD_COUNTER_ALLOCS ] );
+    fprintf( stderr, "  %-16s %10s\n", "saved",
+             ( counters[ WD_COUNTER_SAVES ] != 0 ) ? "yes" : "no" );
+}
@@ -0,0 +1,108 @@
+/**
+   \file
+   \brief The timings module measures how long each phase of an invocation
+          takes and counts the work done, for diagnosing slow invocations
+          (see --timings)
+
+   \copyright Copyright 2018 John Bailey
+
+   \section LICENSE
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if !defined( TIMINGS_H )
+#define       TIMINGS_H
+
+#include <stdint.h>
+
+/** Phases of an invocation which are timed */
+typedef enum {
+    WD_PHASE_ENV,          /**< Processing WD_OPTS */
+    WD_PHASE_CMDLINE,      /**< Processing the command line */
+    WD_PHASE_LOAD,         /**< Loading the bookmark list */
+    WD_PHASE_OPERATION,    /**< Carrying out the operation, including output */
+    WD_PHASE_SAVE,         /**< Saving the bookmark list */
+    WD_PHASE_COUNT
+} wd_phase_t;
+
+/** Counts of the work done during an invocation */
+typedef enum {
+    WD_COUNTER_RECORDS,    /**< Bookmarks parsed from list files */
+    WD_COUNTER_PARSE_NS,   /**< Total time spent reading & parsing list files */
+    WD_COUNTER_STATS,      /**< Calls to stat() */
+    WD_COUNTER_STAT_NS,    /**< Total time spent in stat() */
+    WD_COUNTER_READ,       /**< Bytes read from list files */
+    WD_COUNTER_WRITTEN,    /**< Bytes of output & saved list files written */
+    WD_COUNTER_ALLOCS,     /**< Allocations made for lists & output buffers */
+    WD_COUNTER_SAVES,      /**< List files saved */
+    WD_COUNTER_COUNT
+} wd_counter_t;
+
+/** Non-zero if timings are being collected.  Tested before any other work is
+    done, so that collection costs nothing more than this when off. */
+extern int wd_timings_on;
+
+/** Current value of a monotonic clock, in nanoseconds */
+uint64_t timings_now( void );
+
+/**
+    Enable collection if --timings or --record-stats is given on the command
+    line or in WD_OPTS.  Called before either is processed, so that the time
+    taken to process them can be included.
+*/
+void     timings_init( const int argc, char* const argv[] );
+
+/**
+    Enable collection
+
+    \param[in] p_report Non-zero if the results should be reported by
+                        timings_report(), otherwise they're only collected
+*/
+void     timings_enable( const int p_report );
+
+/** Time since collection was enabled, in nanoseconds */
+uint64_t timings_elapsed( void );
+
+/** Current value of a counter */
+uint64_t timings_counter( const wd_counter_t p_counter );
+
+/** Add the time since p_mark (a value from timings_now()) to a phase */
+void     timings_add_phase( const wd_phase_t p_phase, const uint64_t p_mark );
+
+/** Add to a counter.  Safe to call from multiple threads. */
+void     timings_add( const wd_counter_t p_counter, const uint64_t p_val );
+
+/** Print the timings & counters to stderr, prefixed with p_cmd, if they
+    were requested */
+void     timings_report( const char* const p_cmd );
+
+/** Declare _mark, holding the current time if timings are being collected */
+#define TIMINGS_MARK( _mark ) \
+    const uint64_t _mark = wd_timings_on ? timings_now() : 0U
+
+/** Add the time since TIMINGS_MARK( _mark ) to a phase */
+#define TIMINGS_PHASE( _phase, _mark ) \
+    do { if( wd_timings_on ) { timings_add_phase( _phase, _mark ); } } while( 0 )
+
+/** Add to a counter.  _val is only evaluated if timings are being collected */
+#define TIMINGS_COUNT( _counter, _val ) \
+    do { if( wd_timings_on ) { timings_add( _counter, ( _val )); } } while( 0 )
+
+/** Count a stat() call which started at TIMINGS_MARK( _mark ) */
+#define TIMINGS_STAT( _mark ) \
+    do { if( wd_timings_on ) { \
+        timings_add( WD_COUNTER_STAT_NS, timings_now() - ( _mark )); \
+        timings_add( WD_COUNTER_STATS, 1U ); } } while( 0 )
+
+#endif
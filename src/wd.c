@@ -17,11 +17,29 @@
 #include "wd.h"
 #include "cmdln.h"
 #include "dir_list.h"
+#include "import.h"
+#include "layers.h"
+#include "list_cache.h"
+#include "sync.h"
+#include "timings.h"
 #include "os_if.h"
+#if !defined WIN32
+#include "daemon.h"
+#include "shm_cache.h"
+#include "render_cache.h"
+#include "scan.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "write_behind.h"
+#endif
 
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#if !defined WIN32
+#include <unistd.h>
+#endif
 /* Just for the define values */
 #include <errno.h>
 
@@ -141,14 +159,18 @@ static int do_remove( const config_container_t* const p_config,
  *  @param  p_config   Program settings.  
  *  @param  p_cmd      String referencing the executing program (e.g. c:\something\wd.exe)
  *  @param  p_dir_list The directory list to search                
+ *  @param  p_found    Set to indicate whether or not an entry was found.  May
+ *                     be NULL.
  *  @return WD_SUCCESS in the case that the directory list has been modified
  *          WD_GENERIC_FAIL otherwise
  */
 static int do_get( const config_container_t* const p_config, 
-                   const char* cmd, dir_list_t p_dir_list )
+                   const char* cmd, dir_list_t p_dir_list,
+                   int* const p_found )
 {
     size_t idx;
     int dir_list_needs_save = 0;
+    int found = 0;
 
     /* Precondition check */
     assert( cmd != NULL );
@@ -163,8 +185,8 @@ static int do_get( const config_container_t* const p_config,
         /* Bounds check */
         if( dir_list_get_count( p_dir_list ) > idx )
         {
-            dir_list_needs_save = dump_dir_with_index( p_dir_list, idx ) && 
-                                  p_config->wd_store_access;
+            found = dump_dir_with_index( p_dir_list, idx );
+            dir_list_needs_save = found && p_config->wd_store_access;
         } 
         else 
         {
@@ -175,6 +197,7 @@ static int do_get( const config_container_t* const p_config,
     else if( dump_dir_with_name( p_dir_list, p_config->wd_bookmark_name ) ||
              dump_dir_if_exists( p_dir_list, p_config->wd_bookmark_name ) ) 
     {
+        found = 1;
         if( p_config->wd_store_access )
         {
             /* We're updating access times, so flag that the list needs
@@ -189,6 +212,11 @@ static int do_get( const config_container_t* const p_config,
                 cmd, p_config->wd_bookmark_name);
     }
 
+    if( p_found != NULL )
+    {
+        *p_found = found;
+    }
+
     return dir_list_needs_save;
 }
 
@@ -248,7 +276,15 @@ static int do_add( const config_container_t* const p_config,
 
     /* TODO: Consider allowing directory to be added twice with
        different bookmark name? */
-    if( dir_in_list( p_dir_list, p_config->wd_oper_dir )) 
+    /* Tags are stored on a single line of the list file */
+    if(( p_config->wd_tags != NULL ) &&
+       ( strchr( p_config->wd_tags, '\n' ) != NULL ))
+    {
+        fprintf(stderr,
+                "%s: Error: Tags can't contain newlines\n",
+                cmd);
+    }
+    else if( dir_in_list( p_dir_list, p_config->wd_oper_dir )) 
     {
         fprintf(stderr,
                 "%s: Warning: Directory already in list: '%s'\n",
@@ -275,6 +311,15 @@ static int do_add( const config_container_t* const p_config,
                                    a_time,
                                    WD_ENTITY_UNKNOWN ) ))
         {
+            if(( p_config->wd_tags != NULL ) &&
+               !WD_SUCCEEDED( dir_list_set_tags( p_dir_list,
+                                                 dir_list_get_count( p_dir_list ) - 1U,
+                                                 p_config->wd_tags )))
+            {
+                fprintf(stderr,
+                        "%s: Warning: Failed to tag bookmark: '%s'\n",
+                        cmd, p_config->wd_oper_dir);
+            }
             dir_list_needs_save = 1;
         } 
         else 
@@ -288,6 +333,370 @@ static int do_add( const config_container_t* const p_config,
     return dir_list_needs_save;
 }
 
+/** Size of the buffer used to read batch commands, which limits the length
+    of a single command */
+#define BATCH_BUFFER_SIZE ( 2U * MAXPATHLEN + 64U )
+
+/** Commands being read from stdin by do_batch() */
+typedef struct
+{
+    char   buffer[ BATCH_BUFFER_SIZE ];
+    /** Offset of the first unprocessed character */
+    size_t start;
+    /** Offset following the last character read */
+    size_t end;
+    int    eof;
+} batch_input_t;
+
+/** Read the next command, terminated by p_delim or the end of the input.
+ *  Output is flushed before waiting for more input, so that a process
+ *  driving the batch over a pipe sees each result before sending the next
+ *  command.
+ *
+ *  @param  p_in    Input state
+ *  @param  p_delim Character terminating each command
+ *  @param  p_cmd   Set to point to the NUL-terminated command, or NULL if it
+ *                  was too long to fit in the buffer
+ *  @return WD_SUCCESS if a command was read, WD_GENERIC_FAIL at the end of
+ *          the input
+ */
+static int batch_read( batch_input_t* const p_in, const char p_delim,
+                       char** const p_cmd )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    int discarding = 0;
+    size_t scanned = p_in->start;
+
+    *p_cmd = NULL;
+
+    for( ;; )
+    {
+        char* const delim = (char*)memchr( p_in->buffer + scanned, p_delim,
+                                           p_in->end - scanned );
+        if( delim != NULL )
+        {
+            *delim = '\0';
+            if( !discarding )
+            {
+                *p_cmd = p_in->buffer + p_in->start;
+            }
+            p_in->start = (size_t)( delim - p_in->buffer ) + 1U;
+            ret_val = WD_SUCCESS;
+            break;
+        }
+        else if( p_in->eof )
+        {
+            /* Final command may be unterminated */
+            if(( p_in->start != p_in->end ) || discarding )
+            {
+                p_in->buffer[ p_in->end ] = '\0';
+                if( !discarding )
+                {
+                    *p_cmd = p_in->buffer + p_in->start;
+                }
+                p_in->start = p_in->end;
+                ret_val = WD_SUCCESS;
+            }
+            break;
+        }
+        else
+        {
+            ssize_t got;
+
+            /* Make room for more, leaving space for a terminator */
+            if(( p_in->start == 0 ) && ( p_in->end == ( sizeof( p_in->buffer ) - 1U )))
+            {
+                /* Command doesn't fit - skip to the end of it */
+                discarding = 1;
+                p_in->end = 0;
+            }
+            else if( p_in->start != 0 )
+            {
+                memmove( p_in->buffer, p_in->buffer + p_in->start,
+                         p_in->end - p_in->start );
+                p_in->end -= p_in->start;
+                p_in->start = 0;
+            }
+            scanned = p_in->end;
+
+            (void)fflush( stdout );
+            got = read( 0, p_in->buffer + p_in->end,
+                        sizeof( p_in->buffer ) - 1U - p_in->end );
+            if( got > 0 )
+            {
+                p_in->end += (size_t)got;
+            }
+            else if(( got == 0 ) || ( errno != EINTR ))
+            {
+                p_in->eof = 1;
+            }
+        }
+    }
+
+    return ret_val;
+}
+
+/** Write the status of a batch command as a single output record
+ *
+ *  @param p_config Program settings, determining the record form
+ *  @param p_status Status text
+ */
+static void batch_status( const config_container_t* const p_config,
+                          const char* const p_status )
+{
+    const size_t len = strlen( p_status );
+
+    switch( p_config->wd_record_form )
+    {
+        case WD_RECORD_NUL:
+            fwrite( p_status, 1, len + 1U, stdout );
+            break;
+        case WD_RECORD_LENGTH:
+            fputc(( len >> 24 ) & 0xFFU, stdout );
+            fputc(( len >> 16 ) & 0xFFU, stdout );
+            fputc(( len >> 8 ) & 0xFFU, stdout );
+            fputc( len & 0xFFU, stdout );
+            fwrite( p_status, 1, len, stdout );
+            break;
+        default:
+            fputs( p_status, stdout );
+            fputc( '\n', stdout );
+            break;
+    }
+}
+
+/** Find a bookmark by index, name or path
+ *
+ *  @return Non-zero with *p_idx populated if the bookmark was found
+ */
+static int batch_find( const dir_list_t p_dir_list, const char* const p_id,
+                       size_t* const p_idx )
+{
+    char dir[ MAXPATHLEN ];
+    char extra;
+    int found;
+
+    if( sscanf( p_id, PFFST "%c", p_idx, &extra ) == 1 )
+    {
+        found = ( *p_idx < dir_list_get_count( p_dir_list ));
+    }
+    else if( dir_list_find_name( p_dir_list, p_id, p_idx ))
+    {
+        found = 1;
+    }
+    else
+    {
+        canonicalize_dir( p_id, dir );
+        found = dir_list_find_dir( p_dir_list, dir, p_idx );
+    }
+
+    return found;
+}
+
+/** Perform a single batch command
+ *
+ *  @param  p_config   Settings for the command, which may be updated
+ *  @param  p_cmd      String referencing the executing program
+ *  @param  p_line     The command, which will be modified while splitting
+ *                     it into arguments
+ *  @param  p_dir_list The directory list to operate on
+ *  @param  p_changed  Set non-zero if the list was modified
+ *  @return Non-zero if the command succeeded
+ */
+static int batch_command( config_container_t* const p_config,
+                          const char* const p_cmd, char* const p_line,
+                          dir_list_t p_dir_list, int* const p_changed )
+{
+    int ok = 0;
+    /* Command is separated from its arguments by a space or tab; the
+       arguments are separated from each other by tabs, so that paths may
+       contain spaces */
+    const size_t cmd_len = strcspn( p_line, " \t" );
+    char* arg = ( p_line[ cmd_len ] != '\0' ) ? ( p_line + cmd_len + 1 ) : NULL;
+    char* arg2 = NULL;
+    size_t idx;
+
+    p_line[ cmd_len ] = '\0';
+    if( arg != NULL )
+    {
+        arg2 = strchr( arg, '\t' );
+        if( arg2 != NULL )
+        {
+            *( arg2++ ) = '\0';
+        }
+        if( arg[0] == '\0' )
+        {
+            arg = NULL;
+        }
+    }
+
+    p_config->wd_bookmark_name = NULL;
+
+    if( p_line[0] == '\0' )
+    {
+        /* Blank lines are ignored but still answered, keeping results in
+           step with commands */
+        ok = 1;
+    }
+    else if( 0 == strcmp( p_line, "add" ))
+    {
+        if( arg != NULL )
+        {
+            canonicalize_dir( arg, p_config->wd_oper_dir );
+        }
+        else
+        {
+            (void)getcwd( p_config->wd_oper_dir, MAXPATHLEN );
+        }
+        if(( arg2 != NULL ) && ( arg2[0] != '\0' ))
+        {
+            p_config->wd_bookmark_name = arg2;
+        }
+        ok = do_add( p_config, p_cmd, p_dir_list );
+        *p_changed |= ok;
+    }
+    else if(( 0 == strcmp( p_line, "remove" )) && ( arg != NULL ))
+    {
+        canonicalize_dir( arg, p_config->wd_oper_dir );
+        if( dir_in_list( p_dir_list, p_config->wd_oper_dir ) ||
+            !dir_list_find_name( p_dir_list, arg, &idx ))
+        {
+            ok = WD_SUCCEEDED( do_remove( p_config, p_cmd, p_dir_list ));
+        }
+        else
+        {
+            ok = WD_SUCCEEDED( remove_dir_by_index( p_dir_list, idx ));
+        }
+        *p_changed |= ok;
+    }
+    else if(( 0 == strcmp( p_line, "get" )) && ( arg != NULL ))
+    {
+        p_config->wd_bookmark_name = arg;
+        *p_changed |= do_get( p_config, p_cmd, p_dir_list, &ok );
+        /* Paths are otherwise left unterminated for use in $() */
+        if( ok && ( p_config->wd_record_form == WD_RECORD_LINE ))
+        {
+            fputc( '\n', stdout );
+        }
+    }
+    else if( 0 == strcmp( p_line, "list" ))
+    {
+        list_dirs( p_dir_list );
+        ok = 1;
+    }
+    else if(( 0 == strcmp( p_line, "rename" )) && ( arg != NULL ) &&
+            ( arg2 != NULL ))
+    {
+        if( !batch_find( p_dir_list, arg, &idx ))
+        {
+            fprintf(stderr, "%s: Error: Couldn't find an appropriate entry for '%s'\n",
+                    p_cmd, arg);
+        }
+        else if(( arg2[0] != '\0' ) &&
+                bookmark_in_list( p_dir_list, arg2 ))
+        {
+            fprintf(stderr,
+                    "%s: Warning: Bookmark name already in list: '%s'\n",
+                    p_cmd, arg2);
+        }
+        else
+        {
+            ok = WD_SUCCEEDED( rename_dir( p_dir_list, idx, arg2 ));
+            *p_changed |= ok;
+        }
+    }
+    else if(( 0 == strcmp( p_line, "tag" )) && ( arg != NULL ))
+    {
+        if( !batch_find( p_dir_list, arg, &idx ))
+        {
+            fprintf(stderr, "%s: Error: Couldn't find an appropriate entry for '%s'\n",
+                    p_cmd, arg);
+        }
+        else
+        {
+            /* No tags clears them */
+            ok = WD_SUCCEEDED( dir_list_set_tags( p_dir_list, idx, arg2 ));
+            *p_changed |= ok;
+        }
+    }
+    else
+    {
+        fprintf(stderr, "%s: Error: Unrecognised batch command: '%s'\n",
+                p_cmd, p_line);
+    }
+
+    return ok;
+}
+
+/** Perform each of the commands read from stdin against the list, writing
+ *  any output from each followed by a status record ("ok" or "error").
+ *  Modifications are only saved once all of the commands have been
+ *  performed.
+ *
+ *  @param  p_config   Program settings.  
+ *  @param  p_cmd      String referencing the executing program
+ *  @param  p_dir_list The directory list to operate on
+ *  @return Non-zero in the case that the directory list has been modified
+ */
+static int do_batch( const config_container_t* const p_config,
+                     const char* const p_cmd, dir_list_t p_dir_list )
+{
+    int dir_list_needs_save = 0;
+    const char delim = ( p_config->wd_record_form == WD_RECORD_NUL ) ? '\0' : '\n';
+    /* Large, so not on the stack */
+    batch_input_t* const in = (batch_input_t*)malloc( sizeof( batch_input_t ));
+    config_container_t* const cmd_cfg =
+        (config_container_t*)malloc( sizeof( config_container_t ));
+
+    /* Precondition check */
+    assert( p_config != NULL );
+    assert( p_cmd != NULL );
+    assert( p_dir_list != NULL );
+    /* !Precondition check */
+
+    if(( in == NULL ) || ( cmd_cfg == NULL ))
+    {
+        fprintf(stderr, "%s: Error: Out of memory\n", p_cmd);
+    }
+    else
+    {
+        char* line;
+
+        in->start = 0;
+        in->end = 0;
+        in->eof = 0;
+        *cmd_cfg = *p_config;
+        cmd_cfg->wd_prompt = 0;
+
+        while( WD_SUCCEEDED( batch_read( in, delim, &line )))
+        {
+            int ok = 0;
+
+            if( line == NULL )
+            {
+                fprintf(stderr, "%s: Error: Batch command too long\n", p_cmd);
+            }
+            else
+            {
+                if(( delim == '\n' ) && ( line[0] != '\0' ) &&
+                   ( line[ strlen( line ) - 1U ] == '\r' ))
+                {
+                    line[ strlen( line ) - 1U ] = '\0';
+                }
+                ok = batch_command( cmd_cfg, p_cmd, line, p_dir_list,
+                                    &dir_list_needs_save );
+            }
+
+            batch_status( p_config, ok ? "ok" : "error" );
+        }
+    }
+
+    free( in );
+    free( cmd_cfg );
+
+    return dir_list_needs_save;
+}
+
 /** Display an error based on the parameters
  *
  * @param p_err    Error code, using errno value representations
@@ -327,12 +736,17 @@ static void display_err( const int p_err,
  *                      to
  *  @param  argc       Command line argument count
  *  @param  argv       Command line argument strings
+ *  @return WD_SUCCESS in the case that the dirlist in memory still matches
+ *          the file (either it was not modified or was saved successfully)
+ *          WD_GENERIC_FAIL otherwise
  */
-static void perform_op( const config_container_t* cfg, 
+static int perform_op( const config_container_t* cfg, 
                         dir_list_t dir_list,
                         /*@unused@*/ int argc, char* argv[] )
 {
     int dir_list_needs_save = 0;
+    int ret_val = WD_SUCCESS;
+    TIMINGS_MARK( op_mark );
 
     /* Precondition check */
     assert( cfg != NULL );
@@ -347,7 +761,7 @@ static void perform_op( const config_container_t* cfg,
             break;
         case WD_OPER_GET:
             DEBUG_OUT("WD_OPER_GET: %s",cfg->wd_bookmark_name);
-            dir_list_needs_save = do_get( cfg, argv[0], dir_list );
+            dir_list_needs_save = do_get( cfg, argv[0], dir_list, NULL );
             break;
         case WD_OPER_GET_BY_BM_NAME:
             DEBUG_OUT("WD_OPER_GET_BY_BM_NAME: %s",cfg->wd_bookmark_name);
@@ -357,6 +771,28 @@ static void perform_op( const config_container_t* cfg,
             DEBUG_OUT("WD_OPER_ADD: %s",cfg->wd_bookmark_name);
             dir_list_needs_save = do_add( cfg, argv[0], dir_list );
             break;
+        case WD_OPER_IMPORT:
+            DEBUG_OUT("WD_OPER_IMPORT: %s",cfg->wd_import_fn);
+            dir_list_needs_save = import_dirs( cfg, argv[0], dir_list );
+            break;
+        case WD_OPER_SYNC:
+            DEBUG_OUT("WD_OPER_SYNC: %s",cfg->wd_sync_fn);
+            dir_list_needs_save = sync_lists( cfg, argv[0], dir_list );
+            break;
+        case WD_OPER_BATCH:
+            DEBUG_OUT("WD_OPER_BATCH");
+#if defined WIN32
+            _setmode(0,_O_BINARY);
+            _setmode(1,_O_BINARY);
+#endif
+            dir_list_needs_save = do_batch( cfg, argv[0], dir_list );
+            break;
+#if !defined WIN32
+        case WD_OPER_SCAN:
+            DEBUG_OUT("WD_OPER_SCAN");
+            dir_list_needs_save = scan_dirs( cfg, argv[0], dir_list );
+            break;
+#endif
         case WD_OPER_DUMP:
             dump_dir_list( dir_list );
             break;
@@ -375,13 +811,42 @@ static void perform_op( const config_container_t* cfg,
             break;
     }
 
+    TIMINGS_PHASE( WD_PHASE_OPERATION, op_mark );
+
     if( dir_list_needs_save ) {
+        TIMINGS_MARK( save_mark );
+
+#if !defined WIN32
+        /* The outcome of a batch is reported once it has been saved, so
+           batches are always saved directly */
+        if( cfg->wd_write_behind && ( cfg->wd_oper != WD_OPER_BATCH ) &&
+            WD_SUCCEEDED( write_behind_save( dir_list, cfg->list_fn )))
+        {
+            DEBUG_OUT("save handed over");
+        }
+        else
+#endif
         if( !WD_SUCCEEDED( save_dir_list( dir_list, cfg->list_fn ) ) )
         {
             fprintf(stderr,"Error saving dir list\n");
             /* TODO: Be a little bit more verbose regarding why? */
+            ret_val = WD_GENERIC_FAIL;
+        }
+#if !defined WIN32
+        else
+        {
+            snapshot_invalidate( cfg->list_fn );
         }
+#endif
+        TIMINGS_PHASE( WD_PHASE_SAVE, save_mark );
+    }
+
+    /* Results of the batch's commands only stand once they're saved */
+    if( cfg->wd_oper == WD_OPER_BATCH ) {
+        batch_status( cfg, WD_SUCCEEDED( ret_val ) ? "commit ok" : "commit error" );
     }
+
+    return ret_val;
 }
 
 /** Check to see if a dirlist operation is required and in the case that it is,
@@ -391,39 +856,208 @@ static void perform_op( const config_container_t* cfg,
  *  @param  p_config   Program settings.  
  *  @param  argc       Command line argument count
  *  @param  argv       Command line argument strings
+ *  @param  p_cache    Cache of previously loaded dirlists to use in place of
+ *                     loading the list from file.  May be NULL.
  */
 static void handle_op( const config_container_t* p_config, 
-                       /*@unused@*/ int argc, char* argv[] )
+                       /*@unused@*/ int argc, char* argv[],
+                       list_cache_t p_cache )
 {
+#if !defined WIN32
+    /* Rendered listings are held as text lines, so other record forms are
+       always listed directly.  Nor are listings which include layers
+       cached, as they depend on more than one file */
+    const int render = ( p_config->wd_oper == WD_OPER_LIST ) &&
+                       ( p_config->wd_record_form == WD_RECORD_LINE ) &&
+                       p_config->wd_render_cache && !layers_apply( p_config );
+    /* Interactive operations need the terminal & imports, batches and scans
+       may read stdin or relative paths, so these are never passed to the
+       daemon.  Nor are operations involving tags or searches, as the daemon
+       isn't given them. */
+    const int to_daemon = ( p_config->wd_oper != WD_OPER_NONE ) &&
+                          ( p_config->wd_oper != WD_OPER_DAEMON ) &&
+                          ( p_config->wd_oper != WD_OPER_IMPORT ) &&
+                          ( p_config->wd_oper != WD_OPER_BATCH ) &&
+                          ( p_config->wd_oper != WD_OPER_SCAN ) &&
+                          ( p_config->wd_oper != WD_OPER_SYNC ) &&
+                          ( p_config->wd_tags == NULL ) &&
+                          ( p_config->wd_search == NULL ) &&
+                          p_config->wd_use_daemon && !p_config->wd_prompt &&
+                          !layers_apply( p_config );
+    file_sig_t render_sig;
+    int save_lock = -1;
+    int by_daemon = 0;
+    config_container_t snap_cfg;
+    char* snap_fn = NULL;
+#endif
+    /* Settings with which the list is read, which differ from p_config if
+       it's read from a local copy.  Changes are always saved to the list */
+    const config_container_t* reader = p_config;
+    /* Operations which don't involve loading the list are timed as a whole */
+    TIMINGS_MARK( op_mark );
+
     /* Precondition check */
     assert( p_config != NULL );
     assert( argv != NULL );
     /* !Precondition check */
 
+#if !defined WIN32
+    /* The daemon waits for earlier invocations' saves itself, so the lock
+       isn't held while waiting on it - a save waiting for this invocation
+       would otherwise hold up the daemon, which is waiting for the save */
+    if( to_daemon && WD_SUCCEEDED( daemon_client_op( p_config, argv[0] )))
+    {
+        by_daemon = 1;
+    }
+
+    /* The list mustn't be read while an earlier invocation is still saving
+       it, whether or not this invocation saves in the same way */
+    if(( p_config->wd_oper != WD_OPER_NONE ) && !by_daemon )
+    {
+        save_lock = write_behind_lock( p_config->list_fn,
+                                       p_config->wd_write_behind );
+    }
+
+    /* The daemon holds the list in memory, so doesn't need the copy */
+    if(( p_config->wd_oper != WD_OPER_NONE ) && p_config->wd_snapshot &&
+       !to_daemon )
+    {
+        snap_fn = snapshot_get( p_config, p_config->list_fn );
+        if( snap_fn != NULL )
+        {
+            snap_cfg = *p_config;
+            snap_cfg.list_fn = snap_fn;
+            reader = &snap_cfg;
+        }
+    }
+
+    if( by_daemon )
+    {
+        DEBUG_OUT("operation handled by daemon");
+        TIMINGS_PHASE( WD_PHASE_OPERATION, op_mark );
+    }
+    else if( render &&
+             WD_SUCCEEDED( render_cache_serve( reader, &render_sig )))
+    {
+        DEBUG_OUT("listing served from render cache");
+        TIMINGS_PHASE( WD_PHASE_OPERATION, op_mark );
+    }
+    /* Unsorted listings of lists which aren't held in memory can be produced
+       while the file is being read */
+    else if(( p_config->wd_oper == WD_OPER_LIST ) && !render &&
+            ( p_cache == NULL ) && !p_config->wd_shm_cache &&
+            ( p_config->wd_sort_order == WD_SORT_NONE ) &&
+            !layers_apply( p_config ) &&
+            WD_SUCCEEDED( list_dirs_streaming( p_config, reader->list_fn )))
+    {
+        DEBUG_OUT("listing streamed from file");
+        TIMINGS_PHASE( WD_PHASE_OPERATION, op_mark );
+    }
+    else
+#endif
     /* Anything to actually do?  Might not be in the case, for
      * example, that command line was invalid or just requesting the
      * 'help' output */
     if( p_config->wd_oper != WD_OPER_NONE ) 
     {
         dir_list_t dir_list = NULL;
+        dir_list_t layered;
+        int owned = 1;
+#if !defined WIN32
+        file_sig_t sig;
+        int shared = 0;
+#endif
+        TIMINGS_MARK( load_mark );
 
         DEBUG_OUT("loading bookmark file %s", p_config->list_fn);
 
-        dir_list = load_dir_list( p_config, p_config->list_fn );
+        if( p_cache != NULL )
+        {
+            dir_list = list_cache_get( p_cache, p_config, p_config->list_fn );
+            owned = ( dir_list == NULL );
+        }
+#if !defined WIN32
+        else if( p_config->wd_shm_cache )
+        {
+            dir_list = shm_cache_load( p_config, reader->list_fn, &sig );
+            shared = ( dir_list != NULL );
+        }
+#endif
+        else
+        {
+            dir_list = load_dir_list( p_config, reader->list_fn );
+        }
+
+#if !defined WIN32
+        if(( dir_list == NULL ) && ( reader != p_config ))
+        {
+            /* The copy may have been removed since it was validated */
+            DEBUG_OUT("snapshot unreadable, loading bookmark file");
+            dir_list = load_dir_list( p_config, p_config->list_fn );
+            shared = 0;
+        }
+#endif
 
         if( dir_list == NULL ) 
         {
             fprintf(stderr,"%s: Warning: Unable to load list file '%s'\nCreating empty list\n",
                     argv[0], p_config->list_fn);
             dir_list = new_dir_list();
+            dir_list_set_config( dir_list, p_config );
         }
 
         DEBUG_OUT("loaded bookmark file");
+        layered = layers_resolve( p_config, dir_list );
+        TIMINGS_PHASE( WD_PHASE_LOAD, load_mark );
 
-        perform_op( p_config, dir_list, argc, argv );
+#if !defined WIN32
+        if( render )
+        {
+            TIMINGS_MARK( render_mark );
+            render_cache_list( reader, dir_list, &render_sig );
+            TIMINGS_PHASE( WD_PHASE_OPERATION, render_mark );
+        }
+        else
+#endif
+        if( layered != NULL )
+        {
+            /* Only the user's list is saved, so accesses to bookmarks from
+               layers aren't recorded */
+            config_container_t layered_cfg = *p_config;
 
-        free( dir_list );
+            layered_cfg.wd_store_access = 0;
+            (void)perform_op( &layered_cfg, layered, argc, argv );
+            free_dir_list( layered );
+        }
+        else if( WD_SUCCEEDED( perform_op( p_config, dir_list, argc, argv )))
+        {
+            if( p_cache != NULL )
+            {
+                list_cache_sync( p_cache, p_config->list_fn );
+            }
+#if !defined WIN32
+            if( shared )
+            {
+                shm_cache_update( dir_list, reader->list_fn, &sig );
+            }
+#endif
+        }
+        else if( p_cache != NULL )
+        {
+            /* In-memory copy no longer reflects the file */
+            list_cache_invalidate( p_cache, p_config->list_fn );
+        }
+
+        if( owned )
+        {
+            free_dir_list( dir_list );
+        }
     }
+
+#if !defined WIN32
+    write_behind_unlock( save_lock );
+    free( snap_fn );
+#endif
 }
 
 /** main() function for wd.  Reads the parameters from the command line &
@@ -435,7 +1069,7 @@ static void handle_op( const config_container_t* p_config,
  */
 int main( int argc, char* argv[] )
 {
-    int ret_code = 0;
+    int ret_code = EXIT_SUCCESS;
     int fn_result = 0;
 
     config_container_t cfg;
@@ -445,26 +1079,54 @@ int main( int argc, char* argv[] )
 
     platform_init();
 
+    /* Before either is processed, so that processing can be timed */
+    timings_init( argc, argv );
+
     if( WD_SUCCEEDED( fn_result )) 
     {
+        TIMINGS_MARK( env_mark );
+
         /* Process settings from environment variable(s) */
         fn_result = process_env( &cfg );
+        TIMINGS_PHASE( WD_PHASE_ENV, env_mark );
 
         if( WD_SUCCEEDED( fn_result )) 
         {
+            TIMINGS_MARK( cmdln_mark );
+
             /* Process settings from the command-line, potentially overriding
              * those from the environment */
             fn_result = process_cmdln( &cfg, argc, argv );
+            TIMINGS_PHASE( WD_PHASE_CMDLINE, cmdln_mark );
 
             if( WD_SUCCEEDED( fn_result )) 
             {
                 DEBUG_OUT("command line processed");
 
-                handle_op( &cfg, argc, argv );
+#if !defined WIN32
+                if( cfg.wd_oper == WD_OPER_DAEMON )
+                {
+                    if( !WD_SUCCEEDED( daemon_run( &cfg, argv[0], handle_op )))
+                    {
+                        ret_code = EXIT_FAILURE;
+                    }
+                }
+                else if( cfg.wd_oper == WD_OPER_STATS )
+                {
+                    if( !WD_SUCCEEDED( stats_show( argv[0] )))
+                    {
+                        ret_code = EXIT_FAILURE;
+                    }
+                }
+                else
+#endif
+                {
+                    /* TODO: be more selective about setting the return code -
+                     * it's possible that the processing of the operation will
+                     * fail */
+                    handle_op( &cfg, argc, argv, NULL );
+                }
 
-                /* TODO: be more selective about setting this - it's possible
-                 * that the processing of the operation will fail */
-                ret_code = EXIT_SUCCESS;
             } 
             else 
             {
@@ -485,6 +1147,19 @@ int main( int argc, char* argv[] )
         ret_code = EXIT_FAILURE;
     }
 
+    if( wd_timings_on && ( cfg.wd_oper != WD_OPER_DAEMON ))
+    {
+        timings_report( argv[0] );
+#if !defined WIN32
+        if( cfg.wd_record_stats && ( ret_code == EXIT_SUCCESS ))
+        {
+            stats_record( cfg.wd_oper, timings_elapsed(),
+                          timings_counter( WD_COUNTER_STAT_NS ),
+                          timings_counter( WD_COUNTER_PARSE_NS ));
+        }
+#endif
+    }
+
     DEBUG_OUT("all done");
     return ret_code;
 }
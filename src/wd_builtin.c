@@ -0,0 +1,291 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/* wd as a BASH loadable builtin, allowing tab completion and bookmark look-ups
+   to be performed without spawning a process:
+
+     enable -f /path/to/wd.so wd
+
+   Two forms of invocation are handled in-process:
+
+     wd --complete <word> [options] -l <f>
+         Fill COMPREPLY with the lines of the listing which start with <word>
+     wd --reply [options] -g <id> | -n <name>
+         Set WD_REPLY to the path of the bookmark
+
+   The parsed bookmark list is cached between calls and only re-loaded when the
+   file changes.  Any other invocation is passed on to the wd executable found
+   on the PATH. */
+
+#include <config.h>
+
+#if defined (HAVE_UNISTD_H)
+#  include <unistd.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+
+#include "builtins.h"
+#include "shell.h"
+#include "variables.h"
+#include "arrayfunc.h"
+#include "findcmd.h"
+#include "common.h"
+
+#include "wd.h"
+#include "cmdln.h"
+#include "dir_list.h"
+#include "list_cache.h"
+
+#define BUILTIN_NAME     "wd"
+#define COMPLETE_OPT     "--complete"
+#define REPLY_OPT        "--reply"
+#define COMPLETE_VAR     "COMPREPLY"
+#define REPLY_VAR        "WD_REPLY"
+
+/** Lists loaded by previous invocations */
+static list_cache_t wd_cache = NULL;
+
+/** State used while filling COMPREPLY */
+struct complete_ctx
+{
+    SHELL_VAR*  var;
+    arrayind_t  count;
+    const char* word;
+    size_t      word_len;
+};
+
+static void complete_line( void* p_ctx,
+                           const size_t* const p_number,
+                           const char* const p_text )
+{
+    struct complete_ctx* ctx = (struct complete_ctx*)p_ctx;
+    char number[ 32 ];
+    char* line;
+    size_t len = 0;
+
+    number[0] = '\0';
+    if( p_number != NULL ) {
+        snprintf( number, sizeof( number ),
+                  ( p_text != NULL ) ? PFFST " " : PFFST, *p_number );
+    }
+
+    line = (char*)xmalloc( strlen( number ) +
+                           (( p_text != NULL ) ? strlen( p_text ) : 0 ) + 1 );
+    strcpy( line, number );
+    if( p_text != NULL ) {
+        strcat( line, p_text );
+    }
+    len = strlen( line );
+
+    /* Equivalent of compgen -W "<list>" -- "<word>" */
+    if(( len >= ctx->word_len ) &&
+       ( 0 == strncmp( line, ctx->word, ctx->word_len ))) {
+        bind_array_element( ctx->var, ctx->count, line, 0 );
+        ctx->count++;
+    }
+
+    free( line );
+}
+
+static int do_complete( const config_container_t* const p_cfg,
+                        dir_list_t p_list,
+                        const char* const p_word )
+{
+    struct complete_ctx ctx;
+
+    unbind_variable( COMPLETE_VAR );
+    ctx.var = make_new_array_variable( COMPLETE_VAR );
+    ctx.count = 0;
+    ctx.word = p_word;
+    ctx.word_len = strlen( p_word );
+
+    if( p_list != NULL ) {
+        list_dirs_with( p_list, complete_line, &ctx );
+    }
+
+    return( EXECUTION_SUCCESS );
+}
+
+static int do_reply( const config_container_t* const p_cfg,
+                     dir_list_t p_list )
+{
+    int ret_val = EXECUTION_FAILURE;
+    const char* const id = p_cfg->wd_bookmark_name;
+    size_t idx;
+    int found = 0;
+
+    if( p_list != NULL ) {
+        if( p_cfg->wd_oper == WD_OPER_GET_BY_BM_NAME ) {
+            found = dir_list_find_name( p_list, id, &idx );
+        } else if( sscanf( id, PFFST, &idx ) == 1 ) {
+            found = ( idx < dir_list_get_count( p_list ));
+        } else {
+            found = dir_list_find_name( p_list, id, &idx ) ||
+                    ( dir_list_find_dir( p_list, id, &idx ) &&
+                      ( dir_list_get_name( p_list, idx ) != NULL ));
+        }
+    }
+
+    unbind_variable( REPLY_VAR );
+
+    if( found ) {
+        char* dir = (char*)dir_list_get_dir( p_list, idx );
+        char* formatted = format_dir( p_cfg->wd_dir_form,
+                                      p_cfg->wd_escape_output,
+                                      dir );
+        if( formatted != NULL ) {
+            bind_variable( REPLY_VAR, formatted, 0 );
+            if( formatted != dir ) {
+                free( formatted );
+            }
+            ret_val = EXECUTION_SUCCESS;
+        }
+    }
+
+    return( ret_val );
+}
+
+/** Run the wd executable with the specified arguments */
+static int run_external( WORD_LIST* p_list )
+{
+    int ret_val = EXECUTION_FAILURE;
+    char* exe = find_user_command( BUILTIN_NAME );
+
+    if( exe == NULL ) {
+        builtin_error( "unable to find the " BUILTIN_NAME " executable" );
+    } else {
+        WORD_LIST* l;
+        char* quoted = sh_single_quote( exe );
+        size_t len = strlen( quoted ) + 1;
+        char* cmd;
+
+        for( l = p_list; l != NULL; l = l->next ) {
+            char* arg = sh_single_quote( l->word->word );
+            len += strlen( arg ) + 1;
+            free( arg );
+        }
+
+        cmd = (char*)xmalloc( len );
+        strcpy( cmd, quoted );
+        free( quoted );
+
+        for( l = p_list; l != NULL; l = l->next ) {
+            char* arg = sh_single_quote( l->word->word );
+            strcat( cmd, " " );
+            strcat( cmd, arg );
+            free( arg );
+        }
+
+        /* evalstring() takes ownership of cmd */
+        ret_val = evalstring( cmd, BUILTIN_NAME, SEVAL_NOHIST );
+        free( exe );
+    }
+
+    return( ret_val );
+}
+
+int wd_builtin( WORD_LIST* p_list )
+{
+    int ret_val = EXECUTION_FAILURE;
+    const char* word = NULL;
+    int reply = 0;
+    int argc = 1;
+    char** argv;
+    WORD_LIST* l;
+    config_container_t cfg;
+
+    cfg.list_fn = NULL;
+    cfg.wd_tags = NULL;
+    cfg.wd_search = NULL;
+
+    /* Convert to argc/argv, picking out the builtin-specific options */
+    argv = (char**)xmalloc( sizeof( char* ) * ( list_length( p_list ) + 2 ));
+    argv[0] = BUILTIN_NAME;
+    for( l = p_list; l != NULL; l = l->next ) {
+        if(( 0 == strcmp( l->word->word, COMPLETE_OPT )) &&
+           ( l->next != NULL )) {
+            l = l->next;
+            word = l->word->word;
+        } else if( 0 == strcmp( l->word->word, REPLY_OPT )) {
+            reply = 1;
+        } else {
+            argv[ argc++ ] = l->word->word;
+        }
+    }
+    argv[ argc ] = NULL;
+
+    if(( word == NULL ) && !reply ) {
+        ret_val = run_external( p_list );
+    } else if( WD_SUCCEEDED( init_cmdln( &cfg )) &&
+               WD_SUCCEEDED( process_env( &cfg )) &&
+               WD_SUCCEEDED( process_cmdln( &cfg, argc, argv ))) {
+        if( wd_cache == NULL ) {
+            wd_cache = new_list_cache();
+        }
+
+        if(( word != NULL ) && ( cfg.wd_oper == WD_OPER_LIST )) {
+            ret_val = do_complete( &cfg,
+                                   list_cache_get( wd_cache, &cfg, cfg.list_fn ),
+                                   word );
+        } else if( reply &&
+                   !cfg.wd_store_access &&
+                   (( cfg.wd_oper == WD_OPER_GET ) ||
+                    ( cfg.wd_oper == WD_OPER_GET_BY_BM_NAME ))) {
+            ret_val = do_reply( &cfg,
+                                list_cache_get( wd_cache, &cfg, cfg.list_fn ));
+        } else {
+            builtin_usage();
+            ret_val = EX_USAGE;
+        }
+    }
+    free( cfg.list_fn );
+    free( cfg.wd_tags );
+    search_free( cfg.wd_search );
+    free( argv );
+
+    return( ret_val );
+}
+
+int wd_builtin_load( char* p_name )
+{
+    return( 1 );
+}
+
+void wd_builtin_unload( char* p_name )
+{
+    free_list_cache( wd_cache );
+    wd_cache = NULL;
+}
+
+char* wd_doc[] = {
+    "Store and retrieve bookmarked directories.",
+    "",
+    "With --complete WORD, sets COMPREPLY to the lines of the listing",
+    "requested with -l which begin with WORD.  With --reply, sets WD_REPLY",
+    "to the path of the bookmark requested with -g or -n.",
+    "Otherwise runs the wd executable with the specified arguments.",
+    (char*)NULL
+};
+
+struct builtin wd_struct = {
+    BUILTIN_NAME,
+    wd_builtin,
+    BUILTIN_ENABLED,
+    wd_doc,
+    BUILTIN_NAME " [--complete word | --reply] [options]",
+    0
+};
@@ -0,0 +1,244 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "wd.h"
+#include "write_behind.h"
+#include "snapshot.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define LOCK_SUFFIX ".lock"
+/** Descriptors above this aren't closed by the saving process.  wd itself
+    never has that many open, so any are unlikely to have been inherited */
+#define MAX_CLOSE_FD 1024
+
+/** Bytes of the lock file which are locked, each independently.  The file
+    itself holds the most recently issued ticket */
+typedef enum {
+    LOCK_WRITER,   /**< Held exclusively by the process writing the list */
+    LOCK_TICKET,   /**< Held exclusively while issuing a ticket */
+    LOCK_PENDING   /**< Held shared by each process with a save to make */
+} lock_byte_t;
+
+/** \returns malloc()'d name of the lock file for p_fn, or NULL */
+static char* lock_fn( const char* const p_fn )
+{
+    const size_t len = strlen( p_fn ) + sizeof( LOCK_SUFFIX );
+    char* const ret_val = (char*)malloc( len );
+
+    if( ret_val != NULL ) {
+        snprintf( ret_val, len, "%s" LOCK_SUFFIX, p_fn );
+    }
+
+    return( ret_val );
+}
+
+/** Apply a lock of p_type (F_RDLCK, F_WRLCK or F_UNLCK) to p_byte of the
+    lock file, waiting for it if p_wait is set */
+static int lock_byte( const int p_fd, const lock_byte_t p_byte,
+                      const short p_type, const int p_wait )
+{
+    struct flock fl;
+    int res;
+
+    memset( &fl, 0, sizeof( fl ));
+    fl.l_type   = p_type;
+    fl.l_whence = SEEK_SET;
+    fl.l_start  = (off_t)p_byte;
+    fl.l_len    = 1;
+
+    do {
+        res = fcntl( p_fd, p_wait ? F_SETLKW : F_SETLK, &fl );
+    } while(( res != 0 ) && ( errno == EINTR ));
+
+    return(( res == 0 ) ? WD_SUCCESS : WD_GENERIC_FAIL );
+}
+
+/** \returns The most recently issued ticket, or 0 if there has been none */
+static uint64_t read_ticket( const int p_fd )
+{
+    uint64_t ret_val = 0;
+
+    if( pread( p_fd, &ret_val, sizeof( ret_val ), 0 ) != (ssize_t)sizeof( ret_val )) {
+        ret_val = 0;
+    }
+
+    return( ret_val );
+}
+
+int write_behind_lock( const char* const p_fn, const int p_create )
+{
+    char* const fn = lock_fn( p_fn );
+    int fd = ( fn != NULL ) ?
+                 open( fn, p_create ? ( O_RDWR | O_CREAT ) : O_RDWR, S_IRUSR | S_IWUSR ) : -1;
+
+    /* Precondition check */
+    assert( p_fn != NULL );
+    /* !Precondition check */
+
+    /* Saves hold the pending byte shared until they finish, so an exclusive
+       lock can only be had once there are none.  A save requested after
+       that can't start writing until the writer byte is released */
+    if(( fd != -1 ) &&
+       !( WD_SUCCEEDED( lock_byte( fd, LOCK_PENDING, F_WRLCK, 1 )) &&
+          WD_SUCCEEDED( lock_byte( fd, LOCK_PENDING, F_UNLCK, 0 )) &&
+          WD_SUCCEEDED( lock_byte( fd, LOCK_WRITER, F_RDLCK, 1 )))) {
+        close( fd );
+        fd = -1;
+    }
+
+    free( fn );
+
+    return( fd );
+}
+
+void write_behind_unlock( const int p_lock )
+{
+    if( p_lock != -1 ) {
+        /* Closing the file releases its locks */
+        close( p_lock );
+    }
+}
+
+/** Body of the detached process which saves the list.  p_ready is written
+    to once the save is registered as pending, at which point the invoking
+    process is free to exit.  Does not return */
+static void save_process( const dir_list_t p_list, const char* const p_fn,
+                          const int p_ready )
+{
+    char* const fn = lock_fn( p_fn );
+    const int fd = ( fn != NULL ) ? open( fn, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR ) : -1;
+    const long open_max = sysconf( _SC_OPEN_MAX );
+    const int max_fd = (( open_max < 0 ) || ( open_max > MAX_CLOSE_FD )) ?
+                           MAX_CLOSE_FD : (int)open_max;
+    int null_fd;
+    int other;
+
+    if(( fd != -1 ) &&
+       WD_SUCCEEDED( lock_byte( fd, LOCK_PENDING, F_RDLCK, 1 )) &&
+       WD_SUCCEEDED( lock_byte( fd, LOCK_TICKET, F_WRLCK, 1 ))) {
+        const uint64_t ticket = read_ticket( fd ) + 1U;
+        const int issued = ( pwrite( fd, &ticket, sizeof( ticket ), 0 ) ==
+                             (ssize_t)sizeof( ticket ));
+        const char ready = 1;
+
+        (void)lock_byte( fd, LOCK_TICKET, F_UNLCK, 0 );
+
+        if( issued && ( write( p_ready, &ready, 1 ) == 1 )) {
+            close( p_ready );
+
+            /* Don't hold open anything which may be waited on for end of
+               file, e.g. a pipe into which the shell reads the output or (in
+               the daemon) the client's streams */
+            (void)setsid();
+            null_fd = open( "/dev/null", O_RDWR );
+            if( null_fd >= 0 ) {
+                (void)dup2( null_fd, STDIN_FILENO );
+                (void)dup2( null_fd, STDOUT_FILENO );
+                (void)dup2( null_fd, STDERR_FILENO );
+            }
+            for( other = STDERR_FILENO + 1; other < max_fd; other++ ) {
+                if( other != fd ) {
+                    (void)close( other );
+                }
+            }
+
+            if( WD_SUCCEEDED( lock_byte( fd, LOCK_WRITER, F_WRLCK, 1 ))) {
+                /* Superseded if another save was requested while waiting */
+                if( read_ticket( fd ) == ticket ) {
+                    if( WD_SUCCEEDED( save_dir_list( p_list, p_fn ))) {
+                        snapshot_invalidate( p_fn );
+                    }
+                } else {
+                    DEBUG_OUT("save superseded");
+                }
+            }
+        }
+    }
+
+    /* Exiting releases the locks */
+    _exit( EXIT_SUCCESS );
+}
+
+int write_behind_save( const dir_list_t p_list, const char* const p_fn )
+{
+    int ret_val = WD_GENERIC_FAIL;
+    int ready[ 2 ];
+    pid_t child;
+
+    /* Precondition check */
+    assert( p_list != NULL );
+    assert( p_fn != NULL );
+    /* !Precondition check */
+
+    /* Nothing buffered should be output twice */
+    (void)fflush( stdout );
+    (void)fflush( stderr );
+
+    if( pipe( ready ) == 0 ) {
+        child = fork();
+
+        if( child == 0 ) {
+            close( ready[0] );
+            /* The intermediate process exits straight away, so that the
+               process which saves needn't be waited for */
+            if( fork() == 0 ) {
+                save_process( p_list, p_fn, ready[1] );
+            }
+            _exit( EXIT_SUCCESS );
+        }
+
+        close( ready[1] );
+
+        if( child > 0 ) {
+            char byte;
+            ssize_t got;
+
+            (void)waitpid( child, NULL, 0 );
+
+            /* The save is only handed over once it's pending, so that it's
+               waited for by the next invocation.  End of file means that it
+               failed to get that far */
+            do {
+                got = read( ready[0], &byte, 1 );
+            } while(( got < 0 ) && ( errno == EINTR ));
+
+            if( got == 1 ) {
+                const int null_fd = open( "/dev/null", O_WRONLY );
+
+                if( null_fd >= 0 ) {
+                    (void)dup2( null_fd, STDOUT_FILENO );
+                    close( null_fd );
+                }
+                ret_val = WD_SUCCESS;
+            }
+        }
+
+        close( ready[0] );
+    }
+
+    return( ret_val );
+}
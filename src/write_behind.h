@@ -0,0 +1,73 @@
+/**
+   \file
+   \brief The write_behind module saves bookmark lists in a detached process,
+          so that an invocation can exit as soon as its result has been
+          output rather than waiting for the list file to be rewritten (see
+          --write-behind)
+
+   Saves of the same list are coordinated via fcntl() locks on
+   "<list file>.lock", so they work on network filesystems which support
+   them:
+     - Only one process writes the list at a time
+     - Each save takes a ticket when it's requested.  A save which is still
+       waiting to write when a later one is requested is abandoned, as the
+       later one supersedes it
+     - Invocations wait for pending saves before reading the list, and
+       hold off saves until they've finished with it, so that they never see
+       a partially written or superseded file
+
+   \copyright Copyright 2018 John Bailey
+
+   \section LICENSE
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#if !defined( WRITE_BEHIND_H )
+#define       WRITE_BEHIND_H
+
+#include "dir_list.h"
+
+/**
+    Wait for any pending saves of p_fn to complete, then prevent further
+    saves from starting to write it until write_behind_unlock() is called
+
+    \param[in] p_fn     Name of the list file about to be read
+    \param[in] p_create Non-zero if the lock file should be created if it
+                        doesn't exist.  Otherwise there's nothing to wait
+                        for, as write-behind has never been used for the list
+    \returns Lock to be passed to write_behind_unlock(), or -1 if there's no
+             lock file or it couldn't be used
+*/
+int  write_behind_lock( const char* const p_fn, const int p_create );
+
+/**
+    Release a lock taken by write_behind_lock()
+
+    \param[in] p_lock Value returned by write_behind_lock()
+*/
+void write_behind_unlock( const int p_lock );
+
+/**
+    Output anything buffered for stdout, close it & arrange for p_list to be
+    saved to p_fn by a detached process
+
+    \param[in] p_list The list to save
+    \param[in] p_fn   Name of the list file
+    \returns WD_SUCCESS if the save has been handed over, WD_GENERIC_FAIL if
+             it couldn't be, in which case the caller should save the list
+             itself
+*/
+int  write_behind_save( const dir_list_t p_list, const char* const p_fn );
+
+#endif
@@ -0,0 +1,68 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/* Preloaded into wd by streaming.sh to make an allocation part way through
+   a listing fail.  Only allocations made by the main thread are considered,
+   as the order of those made by other threads varies between runs.
+
+   If SHIM_ALLOC_LOG is set, the size of each allocation is appended to the
+   named file.  If SHIM_FAIL_SIZE & SHIM_FAIL_AT are set, the SHIM_FAIL_AT'th
+   allocation (counting from 1) of SHIM_FAIL_SIZE bytes fails. */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+extern void* __libc_malloc( size_t p_size );
+
+void* malloc( size_t p_size )
+{
+    static unsigned long seen = 0;
+    void* ret_val = NULL;
+
+    if( syscall( SYS_gettid ) != getpid() ) {
+        ret_val = __libc_malloc( p_size );
+    } else {
+        /* Nothing here may allocate, so the log is written directly */
+        const char* const log = getenv( "SHIM_ALLOC_LOG" );
+        const char* const fail_size = getenv( "SHIM_FAIL_SIZE" );
+        const char* const fail_at = getenv( "SHIM_FAIL_AT" );
+        int fail = 0;
+
+        if( log != NULL ) {
+            const int fd = open( log, O_WRONLY | O_CREAT | O_APPEND, 0600 );
+            if( fd >= 0 ) {
+                char line[ 32 ];
+                const int len = snprintf( line, sizeof( line ), "%zu\n", p_size );
+                (void)write( fd, line, (size_t)len );
+                close( fd );
+            }
+        }
+        if(( fail_size != NULL ) && ( fail_at != NULL ) &&
+           ( p_size == strtoul( fail_size, NULL, 10 ))) {
+            seen++;
+            fail = ( seen == strtoul( fail_at, NULL, 10 ));
+        }
+        if( !fail ) {
+            ret_val = __libc_malloc( p_size );
+        }
+    }
+
+    return ret_val;
+}
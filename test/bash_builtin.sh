@@ -0,0 +1,68 @@
+#!/usr/bin/env bash
+#
+# Drive BASH non-interactively to check that the wd loadable builtin produces
+# the same completions & look-ups as the wd executable.
+#
+# Usage: bash_builtin.sh [path/to/src]
+#   The directory should contain both the wd executable and wd.so
+
+source "$(dirname "${BASH_SOURCE[0]}")/lib.sh"
+
+SHELL_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/../shell" && pwd)"
+LIST="${SCRATCH}/list"
+
+if [ ! -f "${SRC}/wd.so" ]; then
+    echo "wd.so must be built in ${SRC} (make builtin)"
+    exit 1
+fi
+
+mkdir -p "${SCRATCH}/dir one" "${SCRATCH}/dir_two" "${SCRATCH}/other"
+touch "${SCRATCH}/a_file"
+
+export WD_OPTS="-f ${LIST}"
+
+wd -a "${SCRATCH}/dir one" one
+wd -a "${SCRATCH}/dir_two" two
+wd -a "${SCRATCH}/other" 
+wd -a "${SCRATCH}/a_file" file
+wd -a "${SCRATCH}/missing" missing
+
+# Run a snippet in a fresh, non-interactive shell with wd.bash sourced, either
+#  with or without the builtin
+run_bash()
+{
+    local builtin="$1"
+    shift
+    WD_BUILTIN="${builtin}" bash --norc --noprofile -c "
+        source '${SHELL_DIR}/wd.bash'
+        $*"
+}
+
+# Compare the output of a snippet with & without the builtin
+check_builtin()
+{
+    local desc="$1"
+    shift
+    check "${desc}" "$(run_bash /nonexistent "$@" 2>&1)" \
+          "$(run_bash "${SRC}/wd.so" "[ -n \"\${WD_HAVE_BUILTIN}\" ] || echo 'builtin not loaded'; $*" 2>&1)"
+}
+
+complete_word()
+{
+    echo "COMP_WORDS=(wcd '$1'); COMP_CWORD=1; COMP_LINE='wcd $1';
+          _wd_complete wcd; printf '<%s>\n' \"\${COMPREPLY[@]}\""
+}
+
+check_builtin "complete empty word"       "$(complete_word '')"
+check_builtin "complete bookmark prefix"  "$(complete_word 't')"
+check_builtin "complete numeric prefix"   "$(complete_word '1')"
+check_builtin "complete path with space"  "$(complete_word "${SCRATCH}/dir")"
+check_builtin "complete no match"         "$(complete_word 'zzz')"
+check_builtin "complete after list change" \
+              "wd -a '${SCRATCH}' scratch >/dev/null 2>&1; $(complete_word 's')"
+check_builtin "wcd by name"               "wcd one; pwd"
+check_builtin "wcd by index"              "wcd 1; pwd"
+check_builtin "wcd unknown"               "wcd nothing_here; pwd"
+check_builtin "get passed to executable"  "wd -g two"
+
+exit ${FAILED}
@@ -0,0 +1,76 @@
+#!/usr/bin/env bash
+#
+# Check that --batch performs newline & NUL terminated commands in turn,
+# answering each with ok or error (a failure not stopping the batch), and that
+# the list is saved once, after the last command, before "commit ok".
+#
+# Usage: batch.sh [path/to/src]
+#   The directory should contain the wd executable
+
+source "$(dirname "${BASH_SOURCE[0]}")/lib.sh"
+
+LIST="${SCRATCH}/list"
+
+mkdir -p "${SCRATCH}/d1" "${SCRATCH}/d2" "${SCRATCH}/d3" "${SCRATCH}/sp ace"
+
+wd -f "${LIST}" -a "${SCRATCH}/d1" one 2>/dev/null
+
+# Bytes of stdin, as characters (so that NULs can be compared)
+bytes()
+{
+    od -An -c | tr -s ' \n' ' '
+}
+
+printf 'add %s\ttwo\nget two\nrename nothing\tx\nbogus\n\nadd %s\nget 2\n' \
+       "${SCRATCH}/d2" "${SCRATCH}/d3" | \
+    wd -f "${LIST}" --batch --timings > "${SCRATCH}/out" 2> "${SCRATCH}/err"
+check "newline terminated results" "ok
+${SCRATCH}/d2
+ok
+error
+error
+ok
+ok
+${SCRATCH}/d3
+ok
+commit ok" "$(cat "${SCRATCH}/out")"
+check "failures reported" "2" \
+      "$(grep -c -e "Couldn't find an appropriate entry for 'nothing'" \
+                 -e "Unrecognised batch command: 'bogus'" "${SCRATCH}/err")"
+check "commands after failure performed" "${SCRATCH}/d1
+${SCRATCH}/d2
+${SCRATCH}/d3" "$(wd -f "${LIST}" -l p)"
+
+# Without output from the commands, only saving the list is counted, so
+# anything beyond a single copy of it shows
+printf 'tag one\tx\ntag two\ty\ntag 2\tz\n' | \
+    wd -f "${LIST}" --batch --timings > /dev/null 2> "${SCRATCH}/err"
+check "list saved once" "$(wc -c < "${LIST}")" \
+      "$(awk '/bytes written/ { print $3 }' "${SCRATCH}/err")"
+
+printf 'add %s\tsp\0rename two\tt\nw\0tag sp\ta,b\0get 9\0get sp' \
+       "${SCRATCH}/sp ace" | \
+    wd -f "${LIST}" --batch -0 > "${SCRATCH}/out" 2>/dev/null
+check "NUL terminated results" \
+      "$(printf 'ok\000ok\000ok\000error\000%s\000ok\000commit ok\000' \
+                "${SCRATCH}/sp ace" | bytes)" \
+      "$(bytes < "${SCRATCH}/out")"
+check "NUL terminated commands performed" "$(printf 't\nw')" \
+      "$(wd -f "${LIST}" -l b | sed -n 2,3p)"
+check "tags set" "${SCRATCH}/sp ace" "$(wd -f "${LIST}" -l p --tag a)"
+
+# Drive a batch over a pipe, as a script would, to see that the list isn't
+# saved until the input ends
+BEFORE="$(cat "${LIST}")"
+coproc BATCH { wd -f "${LIST}" --batch 2>/dev/null; }
+printf 'remove one\n' >&"${BATCH[1]}"
+read -r -u "${BATCH[0]}" RESULT
+check "result before input ends" "ok" "${RESULT}"
+check "list unchanged before input ends" "${BEFORE}" "$(cat "${LIST}")"
+exec {BATCH[1]}>&-
+read -r -u "${BATCH[0]}" RESULT
+check "committed once input ends" "commit ok" "${RESULT}"
+wait
+check "list saved once input ends" "" "$(wd -f "${LIST}" -l b | grep -x one)"
+
+exit ${FAILED}
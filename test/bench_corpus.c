@@ -0,0 +1,185 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/* Generate a synthetic bookmark list for benchmarking, along with a scratch
+   tree containing the entries which are meant to exist.
+
+   The output depends only on the arguments: entries are generated from a
+   fixed seed, so a list of N entries is always the first N entries of any
+   larger list, and lists of different sizes can share the same tree.
+
+   Usage: bench_corpus <count> <list file> <scratch dir>
+
+   Of the entries, roughly:
+     70% are directories, 10% are files & 20% don't exist
+     40% have a bookmark name
+     60% have an access time, 25% have a hit count
+   Only the first MAX_CREATE existing entries are actually created, so that
+   very large lists don't need a correspondingly large tree; beyond that,
+   entries which would exist are left missing. */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define MAX_CREATE  20000UL
+#define MIN_DEPTH   2U
+#define MAX_DEPTH   6U
+/* Time of the first bookmark & the period over which they were added */
+#define TIME_START  1388534400L
+#define TIME_SPAN   ( 3L * 365L * 24L * 60L * 60L )
+
+static const char* const words[] = {
+    "src", "work", "projects", "home", "build", "lib", "include", "docs",
+    "tools", "scripts", "test", "release", "vendor", "third_party", "app",
+    "server", "client", "common", "core", "util", "data", "config", "web",
+    "Program Files", "deploy", "api", "modules", "packages", "tmp", "old",
+    "archive", "misc"
+};
+#define WORD_COUNT ( sizeof( words ) / sizeof( words[0] ))
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ULL;
+
+/* xorshift64* - the same sequence on every platform */
+static unsigned long rng( void )
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return( (unsigned long)(( rng_state * 0x2545F4914F6CDD1DULL ) >> 32 ));
+}
+
+/* Create p_path and any missing parents */
+static int make_dirs( char* const p_path )
+{
+    char* sep;
+
+    for( sep = strchr( p_path + 1, '/' ); sep != NULL; sep = strchr( sep + 1, '/' )) {
+        *sep = '\0';
+        if(( mkdir( p_path, 0755 ) != 0 ) && ( errno != EEXIST )) {
+            *sep = '/';
+            return( 0 );
+        }
+        *sep = '/';
+    }
+
+    return(( mkdir( p_path, 0755 ) == 0 ) || ( errno == EEXIST ));
+}
+
+static void put_time( FILE* const p_file, const char p_tag, const time_t p_time )
+{
+    char buff[ 32 ];
+
+    strftime( buff, sizeof( buff ), "%Y/%m/%d %H:%M:%S", gmtime( &p_time ));
+    fprintf( p_file, "%c:%s\n", p_tag, buff );
+}
+
+int main( int argc, char* argv[] )
+{
+    char root[ PATH_MAX ];
+    char path[ PATH_MAX ];
+    unsigned long count;
+    unsigned long created = 0;
+    unsigned long loop;
+    FILE* file;
+
+    if( argc != 4 ) {
+        fprintf( stderr, "Usage: %s <count> <list file> <scratch dir>\n", argv[0] );
+        return( EXIT_FAILURE );
+    }
+
+    count = strtoul( argv[1], NULL, 10 );
+
+    /* wd stores canonical paths, so the tree is referred to by its real
+       location */
+    if(( snprintf( path, sizeof( path ), "%s", argv[3] ) >= (int)sizeof( path )) ||
+       !make_dirs( path ) ||
+       ( realpath( argv[3], root ) == NULL )) {
+        fprintf( stderr, "%s: Error: Unable to create '%s'\n", argv[0], argv[3] );
+        return( EXIT_FAILURE );
+    }
+
+    file = fopen( argv[2], "wt" );
+    if( file == NULL ) {
+        fprintf( stderr, "%s: Error: Unable to create '%s'\n", argv[0], argv[2] );
+        return( EXIT_FAILURE );
+    }
+
+    fprintf( file, "# WD directory list file\n# File format: version 1\n" );
+
+    for( loop = 0; loop < count; loop++ ) {
+        const unsigned depth = MIN_DEPTH + (unsigned)( rng() % ( MAX_DEPTH - MIN_DEPTH + 1U ));
+        const unsigned kind = (unsigned)( rng() % 10U );
+        const time_t added = (time_t)( TIME_START + (long)( rng() % (unsigned long)TIME_SPAN ));
+        size_t len = (size_t)snprintf( path, sizeof( path ), "%s", root );
+        unsigned level;
+        char type = 'U';
+
+        for( level = 0; level < depth; level++ ) {
+            len += (size_t)snprintf( path + len, sizeof( path ) - len, "/%s",
+                                     words[ rng() % WORD_COUNT ] );
+        }
+        /* The leaf makes each path unique */
+        len += (size_t)snprintf( path + len, sizeof( path ) - len, "/e%lu", loop );
+
+        if(( kind < 8U ) && ( created < MAX_CREATE )) {
+            if( kind < 7U ) {
+                if( make_dirs( path )) {
+                    type = 'D';
+                }
+            } else {
+                FILE* target;
+                char* const leaf = strrchr( path, '/' );
+
+                *leaf = '\0';
+                (void)make_dirs( path );
+                *leaf = '/';
+                target = fopen( path, "a" );
+                if( target != NULL ) {
+                    fclose( target );
+                    type = 'F';
+                }
+            }
+            created++;
+        }
+
+        fprintf( file, ":%s\n", path );
+        if(( rng() % 10U ) < 4U ) {
+            /* Truncated so that names don't contain spaces */
+            fprintf( file, "N:%.4s%lu\n", words[ rng() % WORD_COUNT ], loop );
+        }
+        put_time( file, 'A', added );
+        if(( rng() % 10U ) < 6U ) {
+            put_time( file, 'C', added + (time_t)( rng() % ( 90UL * 24UL * 60UL * 60UL )));
+        }
+        if(( rng() % 4U ) == 0 ) {
+            fprintf( file, "H:%lu\n", 1UL + ( rng() % 500UL ));
+        }
+        fprintf( file, "T:%c\n", type );
+    }
+
+    if( fclose( file ) != 0 ) {
+        fprintf( stderr, "%s: Error: Unable to write '%s'\n", argv[0], argv[2] );
+        return( EXIT_FAILURE );
+    }
+
+    return( EXIT_SUCCESS );
+}
@@ -0,0 +1,376 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/* Time complete invocations of wd against bookmark lists (as generated by
+   bench_corpus) and report percentiles of the wall-clock time for each
+   operation, optionally comparing the medians against a previous run.
+
+   Usage: bench_wd [-r <reps>] [-o <results>] [-b <baseline>] [-t <pct>]
+                   <wd> <list> [<list> ...]
+     -r : Number of timed runs of each operation (default 20)
+     -o : Also write the results to a file, for use as a later baseline
+     -b : Compare against results previously written with -o
+     -t : Percentage change in the median reported as a regression or
+          improvement (default 10)
+
+   Each list is copied before use, as adding & removing bookmarks re-writes
+   the file.  The exit status is non-zero if any operation regressed. */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_REPS      20U
+#define DEFAULT_THRESHOLD 10.0
+#define MAX_ARGS          8U
+#define MAX_BASELINE      256U
+
+typedef struct {
+    const char* name;
+    /* Arguments following "-f <list>", NULL-terminated */
+    const char* args[ MAX_ARGS ];
+} bench_case_t;
+
+typedef struct {
+    unsigned long count;
+    char          name[ 16 ];
+    double        p50;
+} baseline_t;
+
+static baseline_t baseline[ MAX_BASELINE ];
+static size_t     baseline_count = 0;
+
+static double now_us( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return(( ts.tv_sec * 1e6 ) + ( ts.tv_nsec / 1e3 ));
+}
+
+/* Run wd with the specified arguments, discarding its output.
+   \returns Elapsed time in microseconds, or a negative value on failure */
+static double run( const char* const p_wd, const char* const p_list,
+                   const char* const* const p_args )
+{
+    const char* argv[ MAX_ARGS + 4U ];
+    double start;
+    size_t argc = 0;
+    size_t loop;
+    pid_t pid;
+    int status;
+
+    argv[ argc++ ] = p_wd;
+    argv[ argc++ ] = "-f";
+    argv[ argc++ ] = p_list;
+    for( loop = 0; p_args[ loop ] != NULL; loop++ ) {
+        argv[ argc++ ] = p_args[ loop ];
+    }
+    argv[ argc ] = NULL;
+
+    start = now_us();
+    pid = fork();
+    if( pid == 0 ) {
+        const int null_fd = open( "/dev/null", O_WRONLY );
+        if( null_fd >= 0 ) {
+            dup2( null_fd, STDOUT_FILENO );
+            dup2( null_fd, STDERR_FILENO );
+        }
+        execv( p_wd, (char* const*)argv );
+        _exit( 127 );
+    }
+    if(( pid < 0 ) ||
+       ( waitpid( pid, &status, 0 ) != pid ) ||
+       !WIFEXITED( status ) || ( WEXITSTATUS( status ) == 127 )) {
+        return( -1.0 );
+    }
+
+    return( now_us() - start );
+}
+
+static int compare_doubles( const void* p_a, const void* p_b )
+{
+    const double a = *(const double*)p_a;
+    const double b = *(const double*)p_b;
+    return(( a > b ) - ( a < b ));
+}
+
+/* Nearest-rank percentile of sorted samples */
+static double percentile( const double* const p_samples, const size_t p_count,
+                          const unsigned p_pct )
+{
+    size_t rank = (( p_count * p_pct ) + 99U ) / 100U;
+    return( p_samples[ ( rank == 0 ) ? 0 : ( rank - 1U ) ] );
+}
+
+static const baseline_t* find_baseline( const unsigned long p_count,
+                                        const char* const p_name )
+{
+    size_t loop;
+
+    for( loop = 0; loop < baseline_count; loop++ ) {
+        if(( baseline[ loop ].count == p_count ) &&
+           ( 0 == strcmp( baseline[ loop ].name, p_name ))) {
+            return( &baseline[ loop ] );
+        }
+    }
+
+    return( NULL );
+}
+
+static int load_baseline( const char* const p_fn )
+{
+    FILE* const file = fopen( p_fn, "rt" );
+    char line[ 256 ];
+
+    if( file == NULL ) {
+        return( 0 );
+    }
+
+    while(( fgets( line, sizeof( line ), file ) != NULL ) &&
+          ( baseline_count < MAX_BASELINE )) {
+        baseline_t* const entry = &baseline[ baseline_count ];
+        if(( line[0] != '#' ) &&
+           ( sscanf( line, "%lu %15s %lf", &entry->count, entry->name,
+                     &entry->p50 ) == 3 )) {
+            baseline_count++;
+        }
+    }
+    fclose( file );
+
+    return( 1 );
+}
+
+/* Copy p_src to p_dest, also picking out the number of entries, the path of
+   the middle entry and a bookmark name from around the middle */
+static int prepare_list( const char* const p_src, const char* const p_dest,
+                         unsigned long* const p_count,
+                         char* const p_path, char* const p_name )
+{
+    FILE* const in = fopen( p_src, "rt" );
+    FILE* const out = fopen( p_dest, "wt" );
+    char line[ PATH_MAX + 8U ];
+    unsigned long count = 0;
+    int pass;
+
+    if(( in == NULL ) || ( out == NULL )) {
+        if( in != NULL ) fclose( in );
+        if( out != NULL ) fclose( out );
+        return( 0 );
+    }
+
+    p_path[0] = '\0';
+    p_name[0] = '\0';
+
+    /* The first pass counts the entries & copies the file, the second finds
+       the probes */
+    for( pass = 0; pass < 2; pass++ ) {
+        unsigned long entry = 0;
+
+        rewind( in );
+        while( fgets( line, sizeof( line ), in ) != NULL ) {
+            if( pass == 0 ) {
+                fputs( line, out );
+                count += ( line[0] == ':' );
+            } else {
+                line[ strcspn( line, "\r\n" ) ] = '\0';
+                if( line[0] == ':' ) {
+                    entry++;
+                    if( entry == (( count / 2U ) + 1U )) {
+                        strcpy( p_path, line + 1 );
+                    }
+                } else if(( line[0] == 'N' ) && ( line[1] == ':' ) &&
+                          ( entry > ( count / 2U )) && ( p_name[0] == '\0' )) {
+                    strcpy( p_name, line + 2 );
+                }
+            }
+        }
+    }
+
+    fclose( in );
+    *p_count = count;
+
+    return(( fclose( out ) == 0 ) && ( count > 0 ));
+}
+
+static int report( FILE* const p_results, const unsigned long p_count,
+                   const char* const p_name, double* const p_samples,
+                   const size_t p_reps, const double p_threshold )
+{
+    const baseline_t* base = find_baseline( p_count, p_name );
+    int regressed = 0;
+    double p50;
+
+    qsort( p_samples, p_reps, sizeof( double ), compare_doubles );
+    p50 = percentile( p_samples, p_reps, 50U );
+
+    printf( "%8lu %-8s %10.0f %10.0f %10.0f %10.0f %10.0f",
+            p_count, p_name, p_samples[0], p50,
+            percentile( p_samples, p_reps, 90U ),
+            percentile( p_samples, p_reps, 99U ),
+            p_samples[ p_reps - 1U ] );
+    if( base != NULL ) {
+        const double change = (( p50 - base->p50 ) * 100.0 ) / base->p50;
+        printf( " %+7.1f%%%s", change,
+                ( change > p_threshold ) ? " REGRESSED" :
+                ( change < -p_threshold ) ? " improved" : "" );
+        regressed = ( change > p_threshold );
+    }
+    printf( "\n" );
+
+    if( p_results != NULL ) {
+        fprintf( p_results, "%lu %s %.1f\n", p_count, p_name, p50 );
+    }
+
+    return( regressed );
+}
+
+int main( int argc, char* argv[] )
+{
+    size_t reps = DEFAULT_REPS;
+    double threshold = DEFAULT_THRESHOLD;
+    const char* results_fn = NULL;
+    FILE* results = NULL;
+    const char* wd;
+    double* samples;
+    double* undo_samples;
+    char add_dir[ PATH_MAX ];
+    int regressions = 0;
+    int opt;
+
+    while(( opt = getopt( argc, argv, "r:o:b:t:" )) != -1 ) {
+        switch( opt ) {
+            case 'r':
+                reps = strtoul( optarg, NULL, 10 );
+                break;
+            case 'o':
+                results_fn = optarg;
+                break;
+            case 'b':
+                if( !load_baseline( optarg )) {
+                    fprintf( stderr, "%s: Warning: No baseline in '%s'\n", argv[0], optarg );
+                }
+                break;
+            case 't':
+                threshold = strtod( optarg, NULL );
+                break;
+            default:
+                return( EXIT_FAILURE );
+        }
+    }
+
+    if(( argc - optind < 2 ) || ( reps == 0 )) {
+        fprintf( stderr, "Usage: %s [-r <reps>] [-o <results>] [-b <baseline>] "
+                         "[-t <pct>] <wd> <list> [<list> ...]\n", argv[0] );
+        return( EXIT_FAILURE );
+    }
+
+    wd = argv[ optind++ ];
+    samples = (double*)malloc( reps * sizeof( double ));
+    undo_samples = (double*)malloc( reps * sizeof( double ));
+    /* The directory added & removed again - not in any generated list */
+    if(( samples == NULL ) || ( undo_samples == NULL ) ||
+       ( getcwd( add_dir, sizeof( add_dir )) == NULL )) {
+        return( EXIT_FAILURE );
+    }
+
+    if( results_fn != NULL ) {
+        results = fopen( results_fn, "wt" );
+        if( results == NULL ) {
+            fprintf( stderr, "%s: Error: Unable to create '%s'\n", argv[0], results_fn );
+            return( EXIT_FAILURE );
+        }
+        fprintf( results, "# entries operation p50(us)\n" );
+    }
+
+    printf( "%8s %-8s %10s %10s %10s %10s %10s  (microseconds)\n",
+            "entries", "op", "min", "p50", "p90", "p99", "max" );
+
+    for( ; optind < argc; optind++ ) {
+        char copy[ PATH_MAX ];
+        char path[ PATH_MAX ];
+        char name[ PATH_MAX ];
+        char index[ 24 ];
+        unsigned long count;
+        size_t loop;
+        size_t rep;
+
+        snprintf( copy, sizeof( copy ), "%s.bench", argv[ optind ] );
+        if( !prepare_list( argv[ optind ], copy, &count, path, name )) {
+            fprintf( stderr, "%s: Error: Unable to use list '%s'\n", argv[0], argv[ optind ] );
+            regressions = 1;
+            continue;
+        }
+        snprintf( index, sizeof( index ), "%lu", count / 2U );
+
+        {
+            const bench_case_t cases[] = {
+                { "g-index", { "-g", index, NULL }},
+                { "g-path",  { "-g", path, NULL }},
+                { "n",       { "-n", name, NULL }},
+                { "l-l",     { "-l", "l", NULL }},
+                { "l-1b",    { "-l", "1b", NULL }},
+                { "l-p-d",   { "-l", "p", "-e", "d", NULL }},
+                { "l-l-e",   { "-l", "l", "-e", "a", NULL }},
+                { "d",       { "-d", NULL }},
+            };
+            const char* const add_args[] = { "-a", add_dir, "benchadd", NULL };
+            const char* const remove_args[] = { "-r", add_dir, NULL };
+
+            for( loop = 0; loop < ( sizeof( cases ) / sizeof( cases[0] )); loop++ ) {
+                /* Warm-up, so that the list is in the page cache */
+                int ok = ( run( wd, copy, cases[ loop ].args ) >= 0 );
+
+                for( rep = 0; ok && ( rep < reps ); rep++ ) {
+                    samples[ rep ] = run( wd, copy, cases[ loop ].args );
+                    ok = ( samples[ rep ] >= 0 );
+                }
+                if( ok ) {
+                    regressions |= report( results, count, cases[ loop ].name,
+                                           samples, reps, threshold );
+                } else {
+                    fprintf( stderr, "%s: Error: Unable to run '%s'\n", argv[0], wd );
+                    return( EXIT_FAILURE );
+                }
+            }
+
+            /* Each addition is undone by the following removal, so the
+               list is the same for every repetition */
+            for( rep = 0; rep < reps; rep++ ) {
+                samples[ rep ] = run( wd, copy, add_args );
+                undo_samples[ rep ] = run( wd, copy, remove_args );
+            }
+            regressions |= report( results, count, "a", samples, reps, threshold );
+            regressions |= report( results, count, "r", undo_samples, reps, threshold );
+        }
+
+        unlink( copy );
+    }
+
+    if( results != NULL ) {
+        fclose( results );
+    }
+    free( samples );
+    free( undo_samples );
+
+    return( regressions ? EXIT_FAILURE : EXIT_SUCCESS );
+}
@@ -0,0 +1,70 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/* Preloaded into wd by parallel_load.sh so that the parallel loader can be
+   checked on machines with a single CPU.
+
+   If SHIM_CPUS is set, it's reported as the number of CPUs online.  If
+   SHIM_THREAD_LOG is set, a line is appended to the named file for each
+   thread started, showing whether the parallel path was actually taken. */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+long sysconf( int p_name )
+{
+    static long ( *real )( int ) = NULL;
+    const char* const cpus = getenv( "SHIM_CPUS" );
+    long ret_val;
+
+    if(( p_name == _SC_NPROCESSORS_ONLN ) && ( cpus != NULL )) {
+        ret_val = atol( cpus );
+    } else {
+        if( real == NULL ) {
+            real = ( long (*)( int ))dlsym( RTLD_NEXT, "sysconf" );
+        }
+        ret_val = real( p_name );
+    }
+
+    return ret_val;
+}
+
+int pthread_create( pthread_t* p_thread, const pthread_attr_t* p_attr,
+                    void* ( *p_start )( void* ), void* p_arg )
+{
+    static int ( *real )( pthread_t*, const pthread_attr_t*,
+                          void* (*)( void* ), void* ) = NULL;
+    const char* const log = getenv( "SHIM_THREAD_LOG" );
+
+    if( log != NULL ) {
+        FILE* const file = fopen( log, "a" );
+        if( file != NULL ) {
+            fputs( "thread\n", file );
+            fclose( file );
+        }
+    }
+    if( real == NULL ) {
+        real = ( int (*)( pthread_t*, const pthread_attr_t*,
+                          void* (*)( void* ), void* ))
+               dlsym( RTLD_NEXT, "pthread_create" );
+    }
+
+    return real( p_thread, p_attr, p_start, p_arg );
+}
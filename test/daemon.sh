@@ -0,0 +1,67 @@
+#!/usr/bin/env bash
+#
+# Check that --use-daemon falls back to reading the list when no daemon is
+# running, and that a running daemon handles operations (without the client
+# parsing the list) with the same results.
+#
+# Usage: daemon.sh [path/to/src]
+#   The directory should contain the wd executable
+
+source "$(dirname "${BASH_SOURCE[0]}")/lib.sh"
+
+LIST="${SCRATCH}/list"
+
+export XDG_RUNTIME_DIR="${SCRATCH}/run"
+mkdir -p "${XDG_RUNTIME_DIR}" "${SCRATCH}/d1" "${SCRATCH}/d2"
+
+stop_daemon()
+{
+    pkill -f -- "--daemon -f ${LIST}"
+    for i in $(seq 50); do
+        [ -e "${XDG_RUNTIME_DIR}/wd.sock" ] || break
+        sleep 0.1
+    done
+}
+
+trap 'stop_daemon; rm -rf "${SCRATCH}"' EXIT
+
+# Number of bookmarks the invocation parsed itself
+parsed()
+{
+    wd --timings "$@" 2>&1 >/dev/null | awk '/records parsed/ { print $3 }'
+}
+
+wd -f "${LIST}" -a "${SCRATCH}/d1" one 2>/dev/null
+
+check "fallback without daemon" "${SCRATCH}/d1" \
+      "$(wd --use-daemon -f "${LIST}" -g one)"
+check "fallback parses list" "1" "$(parsed --use-daemon -f "${LIST}" -g one)"
+
+wd --daemon -f "${LIST}"
+check "socket created" "yes" \
+      "$([ -S "${XDG_RUNTIME_DIR}/wd.sock" ] && echo yes)"
+check "second daemon refused" "1" \
+      "$(wd --daemon -f "${LIST}" 2>&1 | grep -c 'Daemon already running')"
+
+check "look-up via daemon" "${SCRATCH}/d1" \
+      "$(wd --use-daemon -f "${LIST}" -g one)"
+check "daemon parses list" "0" "$(parsed --use-daemon -f "${LIST}" -g one)"
+check "unknown bookmark via daemon" "$(wd -f "${LIST}" -g nothing 2>&1 | sed -e 's|^.*wd:|wd:|')" \
+      "$(wd --use-daemon -f "${LIST}" -g nothing 2>&1 | sed -e 's|^.*wd:|wd:|')"
+
+wd --use-daemon -f "${LIST}" -a "${SCRATCH}/d2" two
+check "daemon saves changes" "$(printf '%s\n' "${SCRATCH}/d1" one "${SCRATCH}/d2" two)" \
+      "$(wd -f "${LIST}" -l l)"
+
+# Changes made without the daemon are picked up by it
+wd -f "${LIST}" -r "${SCRATCH}/d1"
+check "daemon sees changes to file" "$(printf '%s\n' "${SCRATCH}/d2" two)" \
+      "$(wd --use-daemon -f "${LIST}" -l l)"
+
+stop_daemon
+check "socket removed when stopped" "" \
+      "$([ -e "${XDG_RUNTIME_DIR}/wd.sock" ] && echo yes)"
+check "fallback after daemon stopped" "${SCRATCH}/d2" \
+      "$(wd --use-daemon -f "${LIST}" -g two)"
+
+exit ${FAILED}
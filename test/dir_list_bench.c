@@ -0,0 +1,521 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/* Microbenchmarks for the inner functions of dir_list.c, which is included
+   directly so that its static functions can be called.
+
+   Each kernel is run over a fixed, generated corpus: once to warm up and
+   then a number of timed repetitions, of which the median is reported as
+   time, cycles & input bytes per operation.  Optionally, hardware counters
+   are read using perf_event_open(); otherwise cycles are measured using the
+   time-stamp counter where available.
+
+   Usage: dir_list_bench [-p] [-r <reps>] [-n <ops>] [<kernel>]
+     -p : Also report instructions, cache misses & branch misses per op
+     -r : Number of timed repetitions (default 11)
+     -n : Operations per repetition (default 100000)
+     <kernel> : Only run kernels whose names contain this */
+
+#include "../src/dir_list.c"
+
+#include <getopt.h>
+#if defined __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#if ( defined __x86_64__ || defined __i386__ ) && defined __GNUC__
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#define CORPUS_SIZE  4096U
+#define LIST_SIZE    4096U
+#define DEFAULT_REPS 11U
+#define DEFAULT_OPS  100000U
+#define MAX_REPS     101U
+
+/** Hardware counters, in the order they're read from the group */
+enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_CACHE_MISSES,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_COUNT
+};
+
+typedef struct {
+    const char* name;
+    /** Carry out p_ops operations, returning a value depending on the
+        results so that they can't be optimised away */
+    size_t      (*fn)( const size_t p_ops );
+    /** Average number of input bytes per operation, or 0 if not meaningful */
+    double      bytes_per_op;
+} kernel_t;
+
+static char*      paths[ CORPUS_SIZE ];
+static char*      win_paths[ CORPUS_SIZE ];
+static char*      names[ CORPUS_SIZE ];
+static char       times[ CORPUS_SIZE ][ 20 ];
+static dir_list_t list;
+static config_container_t cfg;
+static char       scratch[ FORMATTED_DIR_MAX( MAXPATHLEN ) ];
+
+/** A mixture of directories, files & things which don't exist */
+static const char* const type_paths[] = {
+    "/", ".", "..", "../src", "../src/dir_list.c", "/dev/null",
+    "/nonexistent/wd/bench", "missing", "../src/missing/deeper"
+};
+#define TYPE_PATH_COUNT ( sizeof( type_paths ) / sizeof( type_paths[0] ))
+
+static const char* const words[] = {
+    "src", "work", "projects", "home", "build", "lib", "include", "docs",
+    "My Documents", "Program Files", "tools", "release", "vendor", "app",
+    "third_party", "web"
+};
+#define WORD_COUNT ( sizeof( words ) / sizeof( words[0] ))
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ULL;
+
+static unsigned long rng( void )
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return( (unsigned long)(( rng_state * 0x2545F4914F6CDD1DULL ) >> 32 ));
+}
+
+static char* make_path( const char p_sep, const char* const p_root, const size_t p_idx )
+{
+    char path[ MAXPATHLEN ];
+    const unsigned depth = 2U + (unsigned)( rng() % 6U );
+    size_t len = (size_t)snprintf( path, sizeof( path ), "%s", p_root );
+    unsigned level;
+
+    for( level = 0; level < depth; level++ ) {
+        len += (size_t)snprintf( path + len, sizeof( path ) - len, "%c%s",
+                                 p_sep, words[ rng() % WORD_COUNT ] );
+    }
+    snprintf( path + len, sizeof( path ) - len, "%ce%lu", p_sep, (unsigned long)p_idx );
+
+    return( strdup( path ));
+}
+
+static void make_corpus( void )
+{
+    size_t loop;
+
+    cfg.wd_dir_form = WD_DIRFORM_NONE;
+    cfg.wd_entity_type = WD_ENTITY_ANY;
+    cfg.wd_output_all = 1;
+
+    list = new_dir_list();
+    list->cfg = &cfg;
+
+    for( loop = 0; loop < CORPUS_SIZE; loop++ ) {
+        const time_t t = (time_t)( 1388534400L + (long)( rng() % 94608000UL ));
+        char name[ 32 ];
+
+        paths[ loop ] = make_path( '/', "", loop );
+        win_paths[ loop ] = make_path( '\\', "C:", loop );
+        snprintf( name, sizeof( name ), "%.4s%lu", words[ rng() % WORD_COUNT ],
+                  (unsigned long)loop );
+        names[ loop ] = strdup( name );
+        strftime( times[ loop ], sizeof( times[ loop ] ), TIME_FORMAT_STRING, gmtime( &t ));
+
+        if( loop < LIST_SIZE ) {
+            (void)add_dir( list, paths[ loop ], names[ loop ], t, -1, WD_ENTITY_DIR );
+        }
+    }
+}
+
+static double average_length( char* const* const p_strs )
+{
+    size_t total = 0;
+    size_t loop;
+
+    for( loop = 0; loop < CORPUS_SIZE; loop++ ) {
+        total += strlen( p_strs[ loop ] );
+    }
+
+    return( (double)total / CORPUS_SIZE );
+}
+
+static size_t bench_sscan_time( const size_t p_ops )
+{
+    size_t sink = 0;
+    size_t loop;
+
+    for( loop = 0; loop < p_ops; loop++ ) {
+        sink += (size_t)sscan_time( times[ loop % CORPUS_SIZE ] );
+    }
+
+    return( sink );
+}
+
+static size_t bench_format_cygwin( const size_t p_ops )
+{
+    size_t sink = 0;
+    size_t loop;
+
+    for( loop = 0; loop < p_ops; loop++ ) {
+        sink += format_dir_to( scratch, WD_DIRFORM_CYGWIN, 0,
+                               win_paths[ loop % CORPUS_SIZE ] );
+    }
+
+    return( sink );
+}
+
+static size_t bench_format_windows_esc( const size_t p_ops )
+{
+    size_t sink = 0;
+    size_t loop;
+
+    for( loop = 0; loop < p_ops; loop++ ) {
+        sink += format_dir_to( scratch, WD_DIRFORM_WINDOWS, 1,
+                               paths[ loop % CORPUS_SIZE ] );
+    }
+
+    return( sink );
+}
+
+static size_t bench_escape_string( const size_t p_ops )
+{
+    size_t sink = 0;
+    size_t loop;
+
+    for( loop = 0; loop < p_ops; loop++ ) {
+        sink += escape_string_to( scratch, 1, paths[ loop % CORPUS_SIZE ] );
+    }
+
+    return( sink );
+}
+
+static size_t bench_escape_string_2( const size_t p_ops )
+{
+    size_t sink = 0;
+    size_t loop;
+
+    for( loop = 0; loop < p_ops; loop++ ) {
+        sink += escape_string_to( scratch, 2, win_paths[ loop % CORPUS_SIZE ] );
+    }
+
+    return( sink );
+}
+
+static size_t bench_get_type( const size_t p_ops )
+{
+    size_t sink = 0;
+    size_t loop;
+
+    for( loop = 0; loop < p_ops; loop++ ) {
+        sink += (size_t)get_type( type_paths[ loop % TYPE_PATH_COUNT ] );
+    }
+
+    return( sink );
+}
+
+/* Build lists of LIST_SIZE entries, so that the cost of growing the list is
+   included */
+static size_t bench_add_dir( const size_t p_ops )
+{
+    size_t sink = 0;
+    size_t done = 0;
+
+    while( done < p_ops ) {
+        dir_list_t build = new_dir_list();
+        size_t loop;
+
+        build->cfg = &cfg;
+        for( loop = 0; ( loop < LIST_SIZE ) && ( done < p_ops ); loop++, done++ ) {
+            (void)add_dir( build, paths[ loop ], names[ loop ],
+                           (time_t)1388534400L + (time_t)loop, -1, WD_ENTITY_DIR );
+        }
+        sink += dir_list_get_count( build );
+        free_dir_list( build );
+    }
+
+    return( sink );
+}
+
+/* One in eight look-ups is for something not in the list */
+static size_t bench_find_name( const size_t p_ops )
+{
+    size_t sink = 0;
+    size_t loop;
+
+    for( loop = 0; loop < p_ops; loop++ ) {
+        size_t idx = 0;
+        const char* const name = (( loop & 7U ) == 7U ) ? "absent" :
+                                 names[ ( loop * 7919U ) % LIST_SIZE ];
+        sink += (size_t)dir_list_find_name( list, name, &idx ) + idx;
+    }
+
+    return( sink );
+}
+
+static size_t bench_find_dir( const size_t p_ops )
+{
+    size_t sink = 0;
+    size_t loop;
+
+    for( loop = 0; loop < p_ops; loop++ ) {
+        size_t idx = 0;
+        const char* const dir = (( loop & 7U ) == 7U ) ? "/absent" :
+                                paths[ ( loop * 7919U ) % LIST_SIZE ];
+        sink += (size_t)dir_list_find_dir( list, dir, &idx ) + idx;
+    }
+
+    return( sink );
+}
+
+static size_t bench_bookmark_in_list( const size_t p_ops )
+{
+    size_t sink = 0;
+    size_t loop;
+
+    for( loop = 0; loop < p_ops; loop++ ) {
+        sink += (size_t)bookmark_in_list( list, names[ ( loop * 7919U ) % LIST_SIZE ] );
+    }
+
+    return( sink );
+}
+
+static int open_counters( int* const p_fds )
+{
+#if defined __linux__
+    static const unsigned long long configs[ COUNTER_COUNT ] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    size_t loop;
+
+    for( loop = 0; loop < COUNTER_COUNT; loop++ ) {
+        struct perf_event_attr attr;
+
+        memset( &attr, 0, sizeof( attr ));
+        attr.size = sizeof( attr );
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[ loop ];
+        attr.disabled = ( loop == 0 );
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+
+        p_fds[ loop ] = (int)syscall( __NR_perf_event_open, &attr, 0, -1,
+                                      ( loop == 0 ) ? -1 : p_fds[0], 0 );
+        if( p_fds[ loop ] < 0 ) {
+            while( loop > 0 ) {
+                loop--;
+                close( p_fds[ loop ] );
+            }
+            return( 0 );
+        }
+    }
+
+    return( 1 );
+#else
+    (void)p_fds;
+    return( 0 );
+#endif
+}
+
+/* Run p_fn, returning the elapsed time and (if p_fds is non-NULL) the
+   counter values */
+static double measure( const kernel_t* const p_kernel, const size_t p_ops,
+                       const int* const p_fds, unsigned long long* const p_counts,
+                       unsigned long long* const p_tsc, size_t* const p_sink )
+{
+    struct timespec start;
+    struct timespec end;
+#if defined HAVE_TSC
+    unsigned long long tsc;
+#endif
+
+#if defined __linux__
+    if( p_fds != NULL ) {
+        ioctl( p_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP );
+        ioctl( p_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
+    }
+#endif
+    clock_gettime( CLOCK_MONOTONIC, &start );
+#if defined HAVE_TSC
+    tsc = __rdtsc();
+#endif
+
+    *p_sink += p_kernel->fn( p_ops );
+
+#if defined HAVE_TSC
+    *p_tsc = __rdtsc() - tsc;
+#else
+    *p_tsc = 0;
+#endif
+    clock_gettime( CLOCK_MONOTONIC, &end );
+#if defined __linux__
+    if( p_fds != NULL ) {
+        unsigned long long values[ 1U + COUNTER_COUNT ];
+
+        ioctl( p_fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP );
+        if( read( p_fds[0], values, sizeof( values )) == (ssize_t)sizeof( values )) {
+            memcpy( p_counts, values + 1, COUNTER_COUNT * sizeof( values[0] ));
+        }
+    }
+#else
+    (void)p_counts;
+#endif
+
+    return((( end.tv_sec - start.tv_sec ) * 1e9 ) + ( end.tv_nsec - start.tv_nsec ));
+}
+
+static int compare_reps( const void* p_a, const void* p_b )
+{
+    const double a = *(const double*)p_a;
+    const double b = *(const double*)p_b;
+    return(( a > b ) - ( a < b ));
+}
+
+int main( int argc, char* argv[] )
+{
+    kernel_t kernels[] = {
+        { "sscan_time",          bench_sscan_time,          19.0 },
+        { "format_dir_cygwin",   bench_format_cygwin,       0 },
+        { "format_dir_win_esc",  bench_format_windows_esc,  0 },
+        { "escape_string",       bench_escape_string,       0 },
+        { "escape_string_2",     bench_escape_string_2,     0 },
+        { "get_type",            bench_get_type,            0 },
+        { "add_dir",             bench_add_dir,             0 },
+        { "find_name",           bench_find_name,           0 },
+        { "find_dir",            bench_find_dir,            0 },
+        { "bookmark_in_list",    bench_bookmark_in_list,    0 },
+    };
+    int fds[ COUNTER_COUNT ];
+    int use_counters = 0;
+    size_t reps = DEFAULT_REPS;
+    size_t ops = DEFAULT_OPS;
+    const char* filter = NULL;
+    size_t sink = 0;
+    size_t loop;
+    int opt;
+
+    while(( opt = getopt( argc, argv, "pr:n:" )) != -1 ) {
+        switch( opt ) {
+            case 'p':
+                use_counters = 1;
+                break;
+            case 'r':
+                reps = strtoul( optarg, NULL, 10 );
+                break;
+            case 'n':
+                ops = strtoul( optarg, NULL, 10 );
+                break;
+            default:
+                return( EXIT_FAILURE );
+        }
+    }
+    if( optind < argc ) {
+        filter = argv[ optind ];
+    }
+    if(( reps == 0 ) || ( reps > MAX_REPS ) || ( ops == 0 )) {
+        fprintf( stderr, "%s: Error: Repetitions must be 1-%u and operations non-zero\n",
+                 argv[0], MAX_REPS );
+        return( EXIT_FAILURE );
+    }
+
+    if( use_counters && !open_counters( fds )) {
+        fprintf( stderr, "%s: Warning: Hardware counters unavailable (%s)\n",
+                 argv[0], strerror( errno ));
+        use_counters = 0;
+    }
+
+    make_corpus();
+    kernels[1].bytes_per_op = average_length( win_paths );
+    kernels[2].bytes_per_op = average_length( paths );
+    kernels[3].bytes_per_op = average_length( paths );
+    kernels[4].bytes_per_op = average_length( win_paths );
+
+    printf( "%-20s %10s %10s %9s %9s", "kernel", "ns/op", "cycles/op",
+            "bytes/op", "MB/s" );
+    if( use_counters ) {
+        printf( " %10s %10s %10s", "instr/op", "cmiss/op", "bmiss/op" );
+    }
+    printf( "   (median of %lu x %lu ops)\n", (unsigned long)reps, (unsigned long)ops );
+
+    for( loop = 0; loop < ( sizeof( kernels ) / sizeof( kernels[0] )); loop++ ) {
+        const kernel_t* const kernel = &kernels[ loop ];
+        double ns[ MAX_REPS ];
+        double cycles[ MAX_REPS ];
+        unsigned long long counts[ MAX_REPS ][ COUNTER_COUNT ];
+        size_t median = 0;
+        size_t rep;
+
+        if(( filter != NULL ) && ( strstr( kernel->name, filter ) == NULL )) {
+            continue;
+        }
+
+        /* Warm-up */
+        {
+            unsigned long long tsc;
+            (void)measure( kernel, ops, NULL, counts[0], &tsc, &sink );
+        }
+
+        for( rep = 0; rep < reps; rep++ ) {
+            unsigned long long tsc;
+
+            memset( counts[ rep ], 0, sizeof( counts[ rep ] ));
+            ns[ rep ] = measure( kernel, ops, use_counters ? fds : NULL,
+                                 counts[ rep ], &tsc, &sink );
+            cycles[ rep ] = use_counters ? (double)counts[ rep ][ COUNTER_CYCLES ] :
+                                           (double)tsc;
+        }
+
+        /* The repetition with the median time supplies all of the figures */
+        {
+            double sorted[ MAX_REPS ];
+
+            memcpy( sorted, ns, reps * sizeof( double ));
+            qsort( sorted, reps, sizeof( double ), compare_reps );
+            while( ns[ median ] != sorted[ reps / 2U ] ) {
+                median++;
+            }
+        }
+
+        printf( "%-20s %10.2f", kernel->name, ns[ median ] / ops );
+        if( cycles[ median ] > 0 ) {
+            printf( " %10.2f", cycles[ median ] / ops );
+        } else {
+            printf( " %10s", "-" );
+        }
+        if( kernel->bytes_per_op > 0 ) {
+            printf( " %9.1f %9.1f", kernel->bytes_per_op,
+                    ( kernel->bytes_per_op * ops * 1e3 ) / ns[ median ] );
+        } else {
+            printf( " %9s %9s", "-", "-" );
+        }
+        if( use_counters ) {
+            printf( " %10.2f %10.4f %10.4f",
+                    (double)counts[ median ][ COUNTER_INSTRUCTIONS ] / ops,
+                    (double)counts[ median ][ COUNTER_CACHE_MISSES ] / ops,
+                    (double)counts[ median ][ COUNTER_BRANCH_MISSES ] / ops );
+        }
+        printf( "\n" );
+    }
+
+    free_dir_list( list );
+
+    /* Depending on the results means the work can't be discarded */
+
+    return(( sink != 0 ) ? EXIT_SUCCESS : EXIT_FAILURE );
+}
@@ -0,0 +1,95 @@
+#!/usr/bin/env bash
+#
+# Check that --import reads each of the supported formats, skipping paths
+# already in the list (however they're written) and carrying over names, use
+# counts & access times.
+#
+# Usage: import.sh [path/to/src]
+#   The directory should contain the wd executable
+
+source "$(dirname "${BASH_SOURCE[0]}")/lib.sh"
+
+# Imported paths are canonicalised, so the scratch directory must be too
+SCRATCH="$(cd "${SCRATCH}" && pwd -P)"
+LIST="${SCRATCH}/list"
+NOW=1700000000
+
+mkdir -p "${SCRATCH}/a" "${SCRATCH}/b" "${SCRATCH}/c" "${SCRATCH}/d" \
+         "${SCRATCH}/e"
+ln -s "${SCRATCH}/a" "${SCRATCH}/link_a"
+
+# The lines of the list file making up the bookmark for a path
+record()
+{
+    awk -v path=":$1" '/^:/ { show = ( $0 == path ) } show' "${LIST}"
+}
+
+stamp()
+{
+    date -u -d "@$1" '+%Y/%m/%d %H:%M:%S'
+}
+
+wd -z $(( NOW - 1000 )) -f "${LIST}" -a "${SCRATCH}/a" existing 2>/dev/null
+BEFORE="$(record "${SCRATCH}/a")"
+
+cat > "${SCRATCH}/z" << EOF
+${SCRATCH}/b|12.4|1600000000
+${SCRATCH}/link_a|3|1600000100
+${SCRATCH}/b/../c|1|1600000200
+not a z line
+EOF
+check "z" "Imported 2 bookmark(s), 1 already in list" \
+      "$(wd -z ${NOW} -f "${LIST}" --import z "${SCRATCH}/z" 2>"${SCRATCH}/err")"
+check "z bad line reported" "1" \
+      "$(grep -c "Unrecognised content on line 4 of '${SCRATCH}/z'" "${SCRATCH}/err")"
+check "z rank & time kept" ":${SCRATCH}/b
+A:$(stamp ${NOW})
+C:$(stamp 1600000000)
+H:12
+T:D" "$(record "${SCRATCH}/b")"
+check "z path canonicalised" ":${SCRATCH}/c
+A:$(stamp ${NOW})
+C:$(stamp 1600000200)
+H:1
+T:D" "$(record "${SCRATCH}/c")"
+check "existing bookmark untouched" "${BEFORE}" "$(record "${SCRATCH}/a")"
+check "no bookmark for link" "" "$(record "${SCRATCH}/link_a")"
+check "z again" "Imported 0 bookmark(s), 3 already in list" \
+      "$(wd -f "${LIST}" --import z "${SCRATCH}/z" 2>/dev/null)"
+
+printf '7.6\t%s\n2\t%s\n' "${SCRATCH}/d" "${SCRATCH}/c" > "${SCRATCH}/autojump"
+check "autojump" "Imported 1 bookmark(s), 1 already in list" \
+      "$(wd -z $(( NOW + 1 )) -f "${LIST}" --import autojump "${SCRATCH}/autojump")"
+check "autojump weight kept" ":${SCRATCH}/d
+A:$(stamp $(( NOW + 1 )))
+H:8
+T:D" "$(record "${SCRATCH}/d")"
+check "count of existing bookmark untouched" "H:1" \
+      "$(record "${SCRATCH}/c" | grep '^H:')"
+
+printf 'proj %s\nexisting %s\n' "${SCRATCH}/e" "${SCRATCH}/d/x" > "${SCRATCH}/cdargs"
+check "cdargs" "Imported 1 bookmark(s), 0 already in list" \
+      "$(wd -z $(( NOW + 2 )) -f "${LIST}" --import cdargs "${SCRATCH}/cdargs" 2>/dev/null)"
+check "cdargs name kept" ":${SCRATCH}/e
+N:proj
+A:$(stamp $(( NOW + 2 )))
+T:D" "$(record "${SCRATCH}/e")"
+check "cdargs name clash skipped" "" "$(record "${SCRATCH}/d/x")"
+
+check "plain from stdin" "Imported 1 bookmark(s), 1 already in list" \
+      "$(printf '%s/\n%s/new/.\n' "${SCRATCH}/e" "${SCRATCH}" | \
+         wd -z $(( NOW + 3 )) -f "${LIST}" --import plain -)"
+check "plain" ":${SCRATCH}/new
+A:$(stamp $(( NOW + 3 )))
+T:U" "$(record "${SCRATCH}/new")"
+
+check "bookmarks" "${SCRATCH}/a
+${SCRATCH}/b
+${SCRATCH}/c
+${SCRATCH}/d
+${SCRATCH}/e
+${SCRATCH}/new" "$(wd -f "${LIST}" -l p)"
+check "counts mark list as version 2" "# File format: version 2" \
+      "$(sed -n 2p "${LIST}")"
+
+exit ${FAILED}
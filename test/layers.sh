@@ -0,0 +1,83 @@
+#!/usr/bin/env bash
+#
+# Check that --layer lists are searched after the user's list in the order
+# given, with earlier lists taking precedence, that each is only read when
+# the lists before it can't satisfy the operation, and that changes are only
+# ever written to the user's list.
+#
+# Usage: layers.sh [path/to/src]
+#   The directory should contain the wd executable
+
+source "$(dirname "${BASH_SOURCE[0]}")/lib.sh"
+
+TOP="${SCRATCH}/list"
+TEAM="${SCRATCH}/team.list"
+SYS="${SCRATCH}/sys.list"
+
+mkdir -p "${SCRATCH}/mine" "${SCRATCH}/shared" "${SCRATCH}/sys" \
+         "${SCRATCH}/clash" "${SCRATCH}/new"
+
+wd -f "${TOP}" -a "${SCRATCH}/mine" mine 2>/dev/null
+wd -f "${TEAM}" -a "${SCRATCH}/shared" team 2>/dev/null
+wd -f "${TEAM}" -a "${SCRATCH}/mine" hidden
+wd -f "${TEAM}" -a "${SCRATCH}/clash" mine
+wd -f "${SYS}" -a "${SCRATCH}/sys" sys 2>/dev/null
+wd -f "${SYS}" -a "${SCRATCH}/shared" also-hidden
+
+# The layers are read-only, as shared lists would usually be
+chmod a-w "${TEAM}" "${SYS}"
+cp -p "${TEAM}" "${SCRATCH}/team.orig"
+cp -p "${SYS}" "${SCRATCH}/sys.orig"
+
+layered()
+{
+    wd -f "${TOP}" --layer "${TEAM}" --layer "${SYS}" "$@"
+}
+
+# Number of bookmarks read from all of the lists
+parsed()
+{
+    layered --timings "$@" 2>&1 >/dev/null | awk '/records parsed/ { print $3 }'
+}
+
+check "found in user's list" "${SCRATCH}/mine" "$(layered -g mine)"
+check "layers not read for user's bookmark" "1" "$(parsed -g mine)"
+check "found in first layer" "${SCRATCH}/shared" "$(layered -g team)"
+check "second layer not read" "4" "$(parsed -g team)"
+check "found in second layer" "${SCRATCH}/sys" "$(layered -g sys)"
+check "all lists read" "6" "$(parsed -g sys)"
+
+check "entry hidden by user's list" "" "$(layered -g hidden 2>/dev/null)"
+check "entry hidden by earlier layer" "" "$(layered -g also-hidden 2>/dev/null)"
+check "listing in precedence order" "${SCRATCH}/mine
+mine
+${SCRATCH}/shared
+team
+${SCRATCH}/clash
+${SCRATCH}/clash
+${SCRATCH}/sys
+sys" "$(layered -l l)"
+
+BEFORE="$(cat "${TOP}")"
+layered -g sys > /dev/null
+check "layer look-up leaves user's list" "${BEFORE}" "$(cat "${TOP}")"
+check "layer bookmark can't be removed" "1" \
+      "$(layered -r "${SCRATCH}/shared" 2>&1 | grep -c 'Directory not in list')"
+
+layered -a "${SCRATCH}/new" new
+check "addition written to user's list" "${SCRATCH}/new" \
+      "$(wd -f "${TOP}" -g new)"
+layered -a "${SCRATCH}/sys" mine-too
+check "layer bookmark copied to user's list" "${SCRATCH}/sys" \
+      "$(wd -f "${TOP}" -g mine-too)"
+check "copy takes precedence" "${SCRATCH}/sys
+mine-too" "$(layered -l l | grep -A1 -x "${SCRATCH}/sys")"
+
+check "first layer untouched" "same" \
+      "$(cmp -s "${SCRATCH}/team.orig" "${TEAM}" && echo same)"
+check "second layer untouched" "same" \
+      "$(cmp -s "${SCRATCH}/sys.orig" "${SYS}" && echo same)"
+check "layers still read-only" "${TEAM} ${SYS}" \
+      "$(find "${TEAM}" "${SYS}" ! -perm -u+w | tr '\n' ' ' | sed -e 's/ $//')"
+
+exit ${FAILED}
@@ -0,0 +1,41 @@
+#
+# Set-up & checks shared by the test scripts, which source this file.
+#
+# Provides:
+#   SRC      The directory containing the wd executable, taken from the
+#            script's first argument or defaulting to ../src
+#   SCRATCH  A temporary directory, removed when the script exits
+#   FAILED   Set to 1 by check() on a failure, for use as the exit status
+#   check    Compare expected & actual output, reporting PASS or FAIL
+
+SRC="$(cd "${1:-$(dirname "${BASH_SOURCE[0]}")/../src}" && pwd)"
+SCRATCH="$(mktemp -d)"
+FAILED=0
+
+trap 'rm -rf "${SCRATCH}"' EXIT
+
+if [ ! -x "${SRC}/wd" ]; then
+    echo "wd must be built in ${SRC} (make)"
+    exit 1
+fi
+
+export PATH="${SRC}:${PATH}"
+export XDG_CACHE_HOME="${SCRATCH}/cache"
+unset WD_OPTS
+
+# Usage: check description expected actual
+check()
+{
+    local desc="$1"
+    local expected="$2"
+    local actual="$3"
+
+    if [ "${expected}" = "${actual}" ]; then
+        echo "PASS: ${desc}"
+    else
+        echo "FAIL: ${desc}"
+        echo "  expected: ${expected}"
+        echo "  actual:   ${actual}"
+        FAILED=1
+    fi
+}
@@ -0,0 +1,151 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/* Exercise libwd from several threads at once: readers continuously look up
+   bookmarks while a writer adds & removes others and re-loads the file.  Each
+   reader checks that every snapshot it acquires is self-consistent.
+
+   Usage: libwd_test <scratch list file> */
+
+#include "wd.h"
+#include "libwd.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define READERS     4
+#define ITERATIONS  200
+#define FIXED       3
+
+static const char* const fixed_dirs[ FIXED ] = { "/tmp/one", "/tmp/two", "/tmp/three" };
+static const char* const fixed_names[ FIXED ] = { "one", "two", "three" };
+
+static wd_handle_t* handle;
+static int writer_done = 0;
+static int failures = 0;
+
+static void fail( const char* const p_msg )
+{
+    fprintf( stderr, "libwd_test: Error: %s\n", p_msg );
+    __atomic_add_fetch( &failures, 1, __ATOMIC_SEQ_CST );
+}
+
+static void* reader( void* p_arg )
+{
+    wd_options_t opts;
+    char buf[ 4096 ];
+    unsigned long reads = 0;
+
+    wd_options_init( &opts );
+
+    while( !__atomic_load_n( &writer_done, __ATOMIC_SEQ_CST ) || ( reads == 0 )) {
+        wd_snapshot_t* snap = wd_snapshot_acquire( handle );
+        size_t count = wd_count( snap );
+        size_t len = wd_list( snap, &opts, NULL, 0 );
+        size_t lines = 0;
+        size_t loop;
+
+        for( loop = 0; loop < FIXED; loop++ ) {
+            if(( wd_lookup( snap, fixed_names[ loop ], &opts, buf, sizeof( buf )) < 0 ) ||
+               ( 0 != strcmp( buf, fixed_dirs[ loop ] ))) {
+                fail( "fixed bookmark not found" );
+            }
+        }
+
+        /* Listing length & line count must agree with the snapshot's count */
+        if( len >= sizeof( buf )) {
+            fail( "listing unexpectedly long" );
+        } else if( wd_list( snap, &opts, buf, sizeof( buf )) != len ) {
+            fail( "listing changed within a snapshot" );
+        } else {
+            for( loop = 0; loop < len; loop++ ) {
+                lines += ( buf[ loop ] == '\n' );
+            }
+            if( lines != count ) {
+                fail( "listing doesn't match count" );
+            }
+        }
+
+        if( wd_entry( snap, count, &opts, buf, sizeof( buf ), NULL, 0 ) != -1 ) {
+            fail( "entry beyond end of list" );
+        }
+
+        wd_snapshot_release( snap );
+        reads++;
+    }
+
+    return( NULL );
+}
+
+int main( int argc, char* argv[] )
+{
+    pthread_t readers[ READERS ];
+    char dir[ 64 ];
+    size_t loop;
+
+    if( argc != 2 ) {
+        fprintf( stderr, "Usage: %s <list file>\n", argv[0] );
+        return( EXIT_FAILURE );
+    }
+
+    remove( argv[1] );
+    handle = wd_open( argv[1] );
+    if( handle == NULL ) {
+        fail( "unable to open list" );
+        return( EXIT_FAILURE );
+    }
+
+    for( loop = 0; loop < FIXED; loop++ ) {
+        if( !WD_SUCCEEDED( wd_add( handle, fixed_dirs[ loop ], fixed_names[ loop ], 1386181003 ))) {
+            fail( "unable to add fixed bookmark" );
+        }
+    }
+
+    for( loop = 0; loop < READERS; loop++ ) {
+        pthread_create( &readers[ loop ], NULL, reader, NULL );
+    }
+
+    for( loop = 0; loop < ITERATIONS; loop++ ) {
+        snprintf( dir, sizeof( dir ), "/tmp/transient/" PFFST, loop );
+        if( !WD_SUCCEEDED( wd_add( handle, dir, NULL, 1386181003 ))) {
+            fail( "unable to add transient bookmark" );
+        }
+        if( WD_SUCCEEDED( wd_add( handle, dir, NULL, 1386181003 ))) {
+            fail( "duplicate bookmark added" );
+        }
+        if( !WD_SUCCEEDED( wd_refresh( handle ))) {
+            fail( "unable to refresh" );
+        }
+        if( !WD_SUCCEEDED( wd_remove( handle, dir ))) {
+            fail( "unable to remove transient bookmark" );
+        }
+    }
+    __atomic_store_n( &writer_done, 1, __ATOMIC_SEQ_CST );
+
+    for( loop = 0; loop < READERS; loop++ ) {
+        pthread_join( readers[ loop ], NULL );
+    }
+
+    wd_close( handle );
+
+    if( failures == 0 ) {
+        printf( "libwd: all checks passed\n" );
+    }
+
+    return(( failures == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE );
+}
@@ -0,0 +1,110 @@
+#!/usr/bin/env bash
+#
+# Check the NUL terminated (-0) & length-prefixed (--length-prefixed) output
+# of listings & look-ups, including for a path & name containing a newline,
+# and that the BASH (and, if it's installed, ZSH) support passes such paths
+# through as they are.
+#
+# Usage: output_forms.sh [path/to/src]
+#   The directory should contain the wd executable
+
+source "$(dirname "${BASH_SOURCE[0]}")/lib.sh"
+
+SHELL_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/../shell" && pwd)"
+LIST="${SCRATCH}/list"
+NL_DIR="${SCRATCH}/new"$'\n'"line"
+NL_NAME=$'n\nl'
+SP_DIR="${SCRATCH}/sp ace"
+
+mkdir -p "${NL_DIR}" "${SP_DIR}"
+
+wd -f "${LIST}" -a "${NL_DIR}" "${NL_NAME}" 2>/dev/null
+wd -f "${LIST}" -a "${SP_DIR}" "sp ace"
+
+# Bytes of stdin, as characters (so that NULs can be compared)
+bytes()
+{
+    od -An -c | tr -s ' \n' ' '
+}
+
+# A 4-byte big-endian length
+be32()
+{
+    local n="$1"
+    printf "\\$(printf '%03o' $(( ( n >> 24 ) & 255 )))"
+    printf "\\$(printf '%03o' $(( ( n >> 16 ) & 255 )))"
+    printf "\\$(printf '%03o' $(( ( n >> 8 ) & 255 )))"
+    printf "\\$(printf '%03o' $(( n & 255 )))"
+}
+
+check "newline continued in list file" ":${SCRATCH}/new
++line
+N:n
++l" "$(sed -n -e '/^:.*new$/,/^+l$/p' "${LIST}")"
+check "continuation marks list as version 2" "# File format: version 2" \
+      "$(sed -n 2p "${LIST}")"
+check "newline kept in list" "${NL_DIR}" "$(wd -f "${LIST}" -g 0)"
+check "NUL terminated listing" \
+      "$(printf '0 %s\0001 %s\000' "${NL_NAME}" "sp ace" | bytes)" \
+      "$(wd -f "${LIST}" -l 1b -0 | bytes)"
+check "NUL terminated paths" \
+      "$(printf '%s\000%s\000' "${NL_DIR}" "${SP_DIR}" | bytes)" \
+      "$(wd -f "${LIST}" -l p -0 | bytes)"
+check "NUL terminated listing not escaped" \
+      "$(wd -f "${LIST}" -l p -0 | bytes)" \
+      "$(wd -f "${LIST}" -l p -0 -C | bytes)"
+check "NUL terminated look-up" "$(printf '%s\000' "${NL_DIR}" | bytes)" \
+      "$(wd -f "${LIST}" -g "${NL_NAME}" -0 | bytes)"
+check "length-prefixed listing" \
+      "$( ( be32 ${#NL_NAME}; printf '%s' "${NL_NAME}"; be32 6; printf 'sp ace' ) | bytes)" \
+      "$(wd -f "${LIST}" -l b --length-prefixed | bytes)"
+check "length-prefixed look-up" \
+      "$( ( be32 ${#NL_DIR}; printf '%s' "${NL_DIR}" ) | bytes)" \
+      "$(wd -f "${LIST}" -g "${NL_NAME}" --length-prefixed | bytes)"
+check "list file re-read" "$(wd -f "${LIST}" -l p -0 | bytes)" \
+      "$(wd -f "${LIST}" -l p -0 --shm-cache | bytes)"
+
+export WD_OPTS="-f ${LIST}"
+
+# Run a snippet in a fresh, non-interactive BASH with wd.bash sourced (but not
+# the builtin, which is checked by bash_builtin.sh)
+run_bash()
+{
+    WD_BUILTIN=/nonexistent bash --norc --noprofile -c "
+        source '${SHELL_DIR}/wd.bash'
+        $*"
+}
+
+check "bash wcd to path with newline" "${NL_DIR}" \
+      "$(run_bash "wcd \$'n\\nl'; pwd")"
+check "bash wcd to path with space" "${SP_DIR}" \
+      "$(run_bash "wcd 'sp ace'; pwd")"
+check "bash completes name with newline" "<\$'n\\nl'>" \
+      "$(run_bash "COMP_WORDS=(wcd n); COMP_CWORD=1; COMP_LINE='wcd n';
+                   _wd_complete wcd; printf '<%s>\n' \"\${COMPREPLY[@]}\"")"
+check "bash completes name with space" "<sp\\ ace>" \
+      "$(run_bash "COMP_WORDS=(wcd sp); COMP_CWORD=1; COMP_LINE='wcd sp';
+                   _wd_complete wcd; printf '<%s>\n' \"\${COMPREPLY[@]}\"")"
+check "bash completes indices" "<0 \$'n\\nl'>
+<1 sp\\ ace>" \
+      "$(run_bash "COMP_WORDS=(wcd ''); COMP_CWORD=1; COMP_LINE='wcd ';
+                   _wd_complete wcd; printf '<%s>\n' \"\${COMPREPLY[@]}\"")"
+
+if command -v zsh > /dev/null; then
+    run_zsh()
+    {
+        zsh -f -c "
+            source '${SHELL_DIR}/wd.zsh'
+            $*"
+    }
+
+    check "zsh wcd to path with newline" "${NL_DIR}" \
+          "$(run_zsh "wcd \$'n\\nl'; pwd")"
+    check "zsh completes name with newline" "<${NL_NAME}>
+<sp ace>" \
+          "$(run_zsh "wd_complete; printf '<%s>\n' \"\${reply[@]}\"")"
+else
+    echo "SKIP: zsh isn't installed"
+fi
+
+exit ${FAILED}
@@ -0,0 +1,68 @@
+#!/usr/bin/env bash
+#
+# Check that a list large enough to be loaded in parallel gives the same
+# dumps, listings & saved file as when it's loaded serially.  The number of
+# CPUs is faked by cpus_shim.so, so that both paths are taken whatever the
+# machine.
+#
+# Usage: parallel_load.sh [path/to/src]
+#   The directory should contain the wd executable, and that containing
+#   this script the bench_corpus generator & cpus_shim.so
+
+source "$(dirname "${BASH_SOURCE[0]}")/lib.sh"
+
+TEST_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+LIST="${SCRATCH}/list"
+TREE="${SCRATCH}/tree"
+THREAD_LOG="${SCRATCH}/threads"
+
+"${TEST_DIR}/bench_corpus" 20000 "${SCRATCH}/corpus" "${TREE}" > /dev/null
+
+# Part way through, add records which span lines or refer to tags also used
+# by a record near the start, so that they fall in different chunks
+awk -v tree="${TREE}" '
+    /^:/ { n++ }
+    /^:/ && ( n == 3 ) { print ":" tree "/tagged"; print "G:alpha" }
+    /^:/ && ( n == 10000 ) {
+        print ":" tree "/multi"; print "+line"
+        print "N:multi"; print "+name"
+        print "G:beta,alpha"
+        print "X:2023/11/14 22:13:20\t" tree "/gone"; print "+too"
+    }
+    { print }' "${SCRATCH}/corpus" > "${LIST}"
+
+# Run wd with the given number of CPUs
+on_cpus()
+{
+    local cpus="$1"
+    shift
+    SHIM_CPUS="${cpus}" SHIM_THREAD_LOG="${THREAD_LOG}" \
+        LD_PRELOAD="${TEST_DIR}/cpus_shim.so" wd "$@"
+}
+
+check "list large enough" "yes" \
+      "$([ "$(wc -c < "${LIST}")" -gt 1048576 ] && echo yes)"
+
+for opts in "-d" "-l l -o name" "-l 1b -o path" "-l p -o accessed -e d" \
+            "-l l -o path --tag alpha" "-l p -o added --tag beta"; do
+    rm -f "${THREAD_LOG}"
+    on_cpus 1 -f "${LIST}" ${opts} > "${SCRATCH}/serial" 2>&1
+    check "${opts} loaded serially" "" "$(cat "${THREAD_LOG}" 2>/dev/null)"
+    on_cpus 4 -f "${LIST}" ${opts} > "${SCRATCH}/parallel" 2>&1
+    check "${opts} loaded in parallel" "3" "$(wc -l < "${THREAD_LOG}")"
+    check "${opts} matches" "" \
+          "$(diff "${SCRATCH}/serial" "${SCRATCH}/parallel" | head -5)"
+done
+
+# Saving writes out everything loaded, including the removal
+cp "${LIST}" "${SCRATCH}/list.serial"
+cp "${LIST}" "${SCRATCH}/list.parallel"
+mkdir -p "${TREE}/added"
+on_cpus 1 -z 1700000000 -f "${SCRATCH}/list.serial" -a "${TREE}/added"
+on_cpus 4 -z 1700000000 -f "${SCRATCH}/list.parallel" -a "${TREE}/added"
+check "saved lists match" "" \
+      "$(diff "${SCRATCH}/list.serial" "${SCRATCH}/list.parallel" | head -5)"
+check "removal kept" "X:2023/11/14 22:13:20	${TREE}/gone
++too" "$(grep -A1 '^X:' "${SCRATCH}/list.parallel")"
+
+exit ${FAILED}
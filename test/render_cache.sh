@@ -0,0 +1,53 @@
+#!/usr/bin/env bash
+#
+# Check that --render-cache serves listings from the cache until the list
+# changes, keeping those for each combination of options apart, and that
+# listings filtered by entity type expire after --render-ttl seconds.
+#
+# Usage: render_cache.sh [path/to/src]
+#   The directory should contain the wd executable
+
+source "$(dirname "${BASH_SOURCE[0]}")/lib.sh"
+
+LIST="${SCRATCH}/list"
+
+mkdir -p "${SCRATCH}/d1" "${SCRATCH}/d2" "${SCRATCH}/d3"
+
+# Number of bookmarks the invocation parsed itself
+parsed()
+{
+    wd --timings "$@" 2>&1 >/dev/null | awk '/records parsed/ { print $3 }'
+}
+
+wd -f "${LIST}" -a "${SCRATCH}/d1" one 2>/dev/null
+wd -f "${LIST}" -a "${SCRATCH}/d2" two
+
+check "first listing rendered" "2" \
+      "$(parsed --render-cache -f "${LIST}" -l l)"
+check "cache written" "1" "$(ls "${XDG_CACHE_HOME}/wd" | wc -l)"
+check "later listing served from cache" "0" \
+      "$(parsed --render-cache -f "${LIST}" -l l)"
+check "cached listing" "$(wd -f "${LIST}" -l l)" \
+      "$(wd --render-cache -f "${LIST}" -l l)"
+check "cached per options" "$(wd -f "${LIST}" -l 1p -c)" \
+      "$(wd --render-cache -f "${LIST}" -l 1p -c)"
+check "options cached apart" "2" "$(ls "${XDG_CACHE_HOME}/wd" | wc -l)"
+
+wd -f "${LIST}" -a "${SCRATCH}/d3" three
+check "changed list rendered again" "3" \
+      "$(parsed --render-cache -f "${LIST}" -l l)"
+check "changed list" "$(wd -f "${LIST}" -l l)" \
+      "$(wd --render-cache -f "${LIST}" -l l)"
+
+# Listings filtered by type depend on the filesystem as well as the list
+wd --render-cache --render-ttl 1 -f "${LIST}" -l p -e d > /dev/null
+rmdir "${SCRATCH}/d2"
+check "filtered listing served until it expires" \
+      "$(printf '%s\n' "${SCRATCH}/d1" "${SCRATCH}/d2" "${SCRATCH}/d3")" \
+      "$(wd --render-cache --render-ttl 1 -f "${LIST}" -l p -e d)"
+sleep 2
+check "filtered listing expired" \
+      "$(printf '%s\n' "${SCRATCH}/d1" "${SCRATCH}/d3")" \
+      "$(wd --render-cache --render-ttl 1 -f "${LIST}" -l p -e d)"
+
+exit ${FAILED}
@@ -0,0 +1,53 @@
+#!/usr/bin/env bash
+#
+# Check that --scan bookmarks the directories containing a --match marker,
+# skipping pruned directories, symbolic links & the insides of matches, and
+# that scanning again changes nothing.
+#
+# Usage: scan.sh [path/to/src]
+#   The directory should contain the wd executable
+
+source "$(dirname "${BASH_SOURCE[0]}")/lib.sh"
+
+# Found paths are canonicalised, so the scratch directory must be too
+SCRATCH="$(cd "${SCRATCH}" && pwd -P)"
+LIST="${SCRATCH}/list"
+TREE="${SCRATCH}/tree"
+
+mkdir -p "${TREE}/p1/.git" "${TREE}/a/p2/.git" "${TREE}/a/p2/inner/.git" \
+         "${TREE}/b/p3" "${TREE}/a/deep/er/p4/.git" \
+         "${TREE}/vendor/p5/.git" "${TREE}/node_modules/p6/.git" \
+         "${TREE}/a/plain"
+touch "${TREE}/b/p3/Cargo.toml"
+ln -s "${TREE}/p1" "${TREE}/link"
+
+wd -f "${LIST}" -a "${TREE}/p1" existing 2>/dev/null
+
+check "first scan" "Found 4 matching directories (3 new) in 10 scanned" \
+      "$(wd -f "${LIST}" --scan "${TREE}" --match .git --match Cargo.toml \
+            --prune vendor)"
+check "matches bookmarked" "${TREE}/a/deep/er/p4
+${TREE}/a/p2
+${TREE}/b/p3
+${TREE}/p1" "$(wd -f "${LIST}" -l p | sort)"
+check "existing bookmark kept" "${TREE}/p1" "$(wd -f "${LIST}" -g existing)"
+
+BEFORE="$(cat "${LIST}")"
+check "second scan" "Found 4 matching directories (0 new) in 10 scanned" \
+      "$(wd -f "${LIST}" --scan "${TREE}" --match .git --match Cargo.toml \
+            --prune vendor)"
+check "second scan not saved" "no" \
+      "$(wd -f "${LIST}" --scan "${TREE}" --match .git --match Cargo.toml \
+            --prune vendor --timings 2>&1 >/dev/null | \
+         awk '/saved/ { print $2 }')"
+check "second scan leaves list" "${BEFORE}" "$(cat "${LIST}")"
+
+# Without --prune, or --match, the marker defaults to .git
+check "unpruned scan" "Found 4 matching directories (1 new) in 12 scanned" \
+      "$(wd -f "${LIST}" --scan "${TREE}")"
+check "unpruned match" "${TREE}/vendor/p5" \
+      "$(wd -f "${LIST}" -l p | grep -F vendor)"
+check "node_modules always pruned" "" \
+      "$(wd -f "${LIST}" -l p | grep -F node_modules)"
+
+exit ${FAILED}
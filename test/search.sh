@@ -0,0 +1,68 @@
+#!/usr/bin/env bash
+#
+# Check that listings filtered by --search & --search-re include exactly the
+# bookmarks whose path or name matches, however the list is read, and that
+# the strings of removed & renamed bookmarks aren't matched.
+#
+# Usage: search.sh [path/to/src]
+#   The directory should contain the wd executable
+
+source "$(dirname "${BASH_SOURCE[0]}")/lib.sh"
+
+LIST="${SCRATCH}/list"
+
+for i in $(seq 0 99); do
+    mkdir -p "${SCRATCH}/proj${i}/src"
+    printf 'add %s\tn%d\n' "${SCRATCH}/proj${i}/src" ${i}
+done | wd -f "${LIST}" --batch 2>/dev/null > /dev/null
+wd -f "${LIST}" -a "${SCRATCH}/proj7" top7 --tag t
+
+check "glob matches whole path" "${SCRATCH}/proj7/src" \
+      "$(wd -f "${LIST}" --search '*/proj7/*')"
+check "glob matches name" "${SCRATCH}/proj42/src" \
+      "$(wd -f "${LIST}" --search 'n42' -l p)"
+check "glob brackets" "$(wd -f "${LIST}" -l p | grep -E '/proj[1-3]/')" \
+      "$(wd -f "${LIST}" --search '*/proj[1-3]/*' -l p)"
+check "glob without literal" "$(wd -f "${LIST}" -l p | grep -E '[0-9][^0-9]...$')" \
+      "$(wd -f "${LIST}" --search '*[0-9][!0-9]???')"
+check "regex" "$(wd -f "${LIST}" -l p | grep -E 'proj(1|2)5/')" \
+      "$(wd -f "${LIST}" --search-re 'proj(1|2)5/')"
+check "regex anchored to name" "n9
+n90
+n91
+n92
+n93
+n94
+n95
+n96
+n97
+n98
+n99" \
+      "$(wd -f "${LIST}" --search-re '^n9' -l b)"
+check "numbered with stored index" "100 ${SCRATCH}/proj7" \
+      "$(wd -f "${LIST}" --search 'top*' -l 1p)"
+check "with tag" "${SCRATCH}/proj7" \
+      "$(wd -f "${LIST}" --search '*proj7*' --tag t -l p)"
+check "sorted" "$(wd -f "${LIST}" -l p -o path | grep 'proj5')" \
+      "$(wd -f "${LIST}" --search-re proj5 -o path -l p)"
+check "invalid regex rejected" "1" \
+      "$(wd -f "${LIST}" --search-re 'a(' 2>/dev/null; echo $?)"
+check "not with another operation" "1" \
+      "$(wd -f "${LIST}" --search x -a "${SCRATCH}" 2>/dev/null; echo $?)"
+
+# Held in shared memory, the strings of removed & renamed bookmarks remain in
+# the list's pool
+wd -f "${LIST}" --shm-cache -l p > /dev/null
+printf 'remove n55\nrename n56\tx\n' | wd -f "${LIST}" --shm-cache --batch > /dev/null
+check "removed bookmark not found" "" \
+      "$(wd -f "${LIST}" --shm-cache --search '*proj55*')"
+check "old name not found" "" \
+      "$(wd -f "${LIST}" --shm-cache --search-re 'n56' -l b)"
+
+wd -f "${LIST}" --render-cache --search 'proj3' > /dev/null
+check "render cache keyed by pattern" "${SCRATCH}/proj4/src" \
+      "$(wd -f "${LIST}" --render-cache --search '*proj4/*')"
+check "render cache keyed by pattern type" "$(wd -f "${LIST}" -l p | grep proj3)" \
+      "$(wd -f "${LIST}" --render-cache --search-re 'proj3')"
+
+exit ${FAILED}
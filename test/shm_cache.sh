@@ -0,0 +1,57 @@
+#!/usr/bin/env bash
+#
+# Check that --shm-cache parses a list once and shares the result with later
+# invocations, and that changes to the file, whether made by wd or by other
+# means, cause it to be parsed again.
+#
+# Usage: shm_cache.sh [path/to/src]
+#   The directory should contain the wd executable
+
+source "$(dirname "${BASH_SOURCE[0]}")/lib.sh"
+
+LIST="${SCRATCH}/list"
+SHM_DIR=/dev/shm
+
+mkdir -p "${SCRATCH}/d1" "${SCRATCH}/d2" "${SCRATCH}/d3"
+
+# Remove the segments created by the test, where they can be seen
+segments()
+{
+    [ -d "${SHM_DIR}" ] && ls "${SHM_DIR}" | grep "^wd-$(id -u)-"
+}
+BEFORE="$(segments)"
+trap 'segments | grep -v -x -F "${BEFORE}" | sed -e "s|^|${SHM_DIR}/|" | \
+          xargs -r rm -f; rm -rf "${SCRATCH}"' EXIT
+
+# Number of bookmarks the invocation parsed itself
+parsed()
+{
+    wd --timings "$@" 2>&1 >/dev/null | awk '/records parsed/ { print $3 }'
+}
+
+wd -f "${LIST}" -a "${SCRATCH}/d1" one 2>/dev/null
+wd -f "${LIST}" -a "${SCRATCH}/d2" two
+
+check "first use parses list" "2" "$(parsed --shm-cache -f "${LIST}" -g one)"
+check "later use shares it" "0" "$(parsed --shm-cache -f "${LIST}" -g one)"
+check "shared look-up" "${SCRATCH}/d2" "$(wd --shm-cache -f "${LIST}" -g two)"
+check "shared listing" "$(wd -f "${LIST}" -l 1l)" \
+      "$(wd --shm-cache -f "${LIST}" -l 1l)"
+check "shared dump" "$(wd -f "${LIST}" -d)" "$(wd --shm-cache -f "${LIST}" -d)"
+
+# Changes made via the cache are published along with the list
+wd --shm-cache -f "${LIST}" -a "${SCRATCH}/d3" three
+check "change via cache not parsed again" "0" \
+      "$(parsed --shm-cache -f "${LIST}" -g three)"
+check "change via cache seen" "${SCRATCH}/d3" \
+      "$(wd --shm-cache -f "${LIST}" -g three)"
+
+# Changes made by other means invalidate the shared copy
+printf ':%s\nN:four\n' "${SCRATCH}/d4" >> "${LIST}"
+check "changed file parsed again" "4" \
+      "$(parsed --shm-cache -f "${LIST}" -g four)"
+check "changed file seen" "${SCRATCH}/d4" \
+      "$(wd --shm-cache -f "${LIST}" -g four)"
+check "shared again" "0" "$(parsed --shm-cache -f "${LIST}" -g four)"
+
+exit ${FAILED}
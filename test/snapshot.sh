@@ -0,0 +1,58 @@
+#!/usr/bin/env bash
+#
+# Check that --snapshot reads a list held in one directory (standing in for a
+# network filesystem) from its copy in another (the local cache), and that
+# changes made both by wd and by other means are seen.
+#
+# Usage: snapshot.sh [path/to/src]
+#   The directory should contain the wd executable
+
+source "$(dirname "${BASH_SOURCE[0]}")/lib.sh"
+
+REMOTE="${SCRATCH}/remote"
+LIST="${REMOTE}/list"
+
+mkdir -p "${REMOTE}" "${SCRATCH}/local" "${SCRATCH}/d1" "${SCRATCH}/d2" \
+         "${SCRATCH}/d3"
+
+export XDG_CACHE_HOME="${SCRATCH}/local"
+
+wd -f "${LIST}" -a "${SCRATCH}/d1" alpha 2>/dev/null
+
+check "read via copy" "${SCRATCH}/d1" \
+      "$(wd -f "${LIST}" --snapshot -n alpha)"
+check "copy made locally" "1" \
+      "$(ls "${XDG_CACHE_HOME}/wd" | grep -c '^snapshot-[0-9a-f]*$')"
+
+# The list is replaced, as by an editor or another host
+sed -e 's/alpha/uno/' "${LIST}" > "${LIST}.new" && mv "${LIST}.new" "${LIST}"
+check "external change seen" "${SCRATCH}/d1" \
+      "$(wd -f "${LIST}" --snapshot -n uno)"
+
+OPTS="-f ${LIST} --snapshot --snapshot-ttl 600"
+wd ${OPTS} -l l > /dev/null
+
+wd ${OPTS} -a "${SCRATCH}/d2" beta
+check "change saved to list" "${SCRATCH}/d2" "$(wd -f "${LIST}" -n beta)"
+check "change seen within ttl" "${SCRATCH}/d2" "$(wd ${OPTS} -n beta)"
+
+wd ${OPTS} --write-behind -a "${SCRATCH}/d3" gamma
+check "write-behind change seen within ttl" "${SCRATCH}/d3" \
+      "$(wd ${OPTS} -n gamma)"
+
+sed -e 's/beta/dos/' "${LIST}" > "${LIST}.new" && mv "${LIST}.new" "${LIST}"
+check "external change not checked within ttl" "${SCRATCH}/d2" \
+      "$(wd ${OPTS} -n beta)"
+
+mv "${REMOTE}" "${REMOTE}.away"
+check "list not accessed within ttl" "${SCRATCH}/d3" \
+      "$(wd ${OPTS} -n gamma)"
+mv "${REMOTE}.away" "${REMOTE}"
+
+check "external change seen after ttl" "${SCRATCH}/d2" \
+      "$(wd -f "${LIST}" --snapshot --snapshot-ttl 1 -z $(( $(date +%s) + 1200 )) -n dos)"
+
+check "listing matches list" "$(wd -f "${LIST}" -l l)" \
+      "$(wd ${OPTS} --shm-cache -l l)"
+
+exit ${FAILED}
@@ -0,0 +1,68 @@
+#!/usr/bin/env bash
+#
+# Check that --record-stats (given on the command line or in WD_OPTS) adds
+# each invocation to the stats file, which stays the same size & loses no
+# invocations made concurrently, and that --stats summarises it.
+#
+# Usage: stats.sh [path/to/src]
+#   The directory should contain the wd executable
+
+source "$(dirname "${BASH_SOURCE[0]}")/lib.sh"
+
+LIST="${SCRATCH}/list"
+STATS="${XDG_CACHE_HOME}/wd/stats"
+
+mkdir -p "${SCRATCH}/d1"
+wd -f "${LIST}" -a "${SCRATCH}/d1" one 2>/dev/null
+
+# Count column of the summary for an operation
+count()
+{
+    wd --stats | awk -v op="$1" '$1 == op { print $2 }'
+}
+
+check "nothing recorded" "wd: Error: No stats recorded (see --record-stats)" \
+      "$(wd --stats 2>&1 | sed -e 's|^.*/wd:|wd:|')"
+check "nothing recorded fails" "1" "$(wd --stats 2>/dev/null; echo $?)"
+
+wd -f "${LIST}" -g one > /dev/null
+check "not recorded without option" "" "$([ -e "${STATS}" ] && echo yes)"
+
+check "recording is quiet" "" \
+      "$(wd -f "${LIST}" -g one --record-stats 2>&1 >/dev/null)"
+wd -f "${LIST}" -g one --record-stats > /dev/null
+WD_OPTS="--record-stats" wd -f "${LIST}" -l l > /dev/null
+check "invocations counted" "2 1" "$(count get) $(count list)"
+check "operations not used aren't shown" "" "$(count add)"
+check "summary layout" "operation count time p50 ms p99 ms p999 ms mean ms share
+list total
+stat
+parse
+get total
+stat
+parse" "$(wd --stats | sed -e 's/  *[0-9][0-9.]*%*//g' -e 's/^  *//' | \
+          tr -s ' ')"
+check "total is whole" "100.0% 100.0%" \
+      "$(wd --stats | awk '$3 == "total" { printf "%s%s", sep, $NF; sep = " " }')"
+
+SIZE="$(wc -c < "${STATS}")"
+for i in $(seq 20); do
+    wd -f "${LIST}" -g one --record-stats > /dev/null &
+done
+wait
+check "concurrent invocations counted" "22" "$(count get)"
+check "file size fixed" "${SIZE}" "$(wc -c < "${STATS}")"
+
+# A file from an incompatible version is left alone
+head -c "${SIZE}" /dev/zero | tr '\0' '\377' > "${STATS}"
+wd -f "${LIST}" -g one --record-stats > /dev/null
+check "incompatible file reported" "1" \
+      "$(wd --stats 2>&1 | grep -c 'written by an incompatible version')"
+check "incompatible file untouched" "" \
+      "$(head -c "${SIZE}" /dev/zero | tr '\0' '\377' | cmp - "${STATS}")"
+
+rm "${STATS}"
+wd -f "${LIST}" -g one --record-stats > /dev/null
+check "deleting file starts afresh" "1" "$(count get)"
+
+exit ${FAILED}
@@ -0,0 +1,163 @@
+/*
+   Copyright 2018 John Bailey
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/* Check that each of the vectorised string kernels which the CPU supports
+   produces the same results as the portable implementation, across lengths
+   and alignments which exercise the block & tail handling.
+
+   Usage: str_kernel_test [-b]
+     -b : Also time each implementation */
+
+#include "str_kernel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_LEN     300U
+#define ITERATIONS  20000U
+#define BENCH_LEN   4096U
+#define BENCH_REPS  20000U
+
+/* Weighted towards the characters which the kernels look for, and including
+   bytes with the top bit set */
+static const char alphabet[] = "abcdefgh  \\\\//\x80\xff:.";
+
+static int failures = 0;
+
+static void check( const int p_ok, const char* const p_impl,
+                   const char* const p_what, const size_t p_len )
+{
+    if( !p_ok ) {
+        fprintf( stderr, "str_kernel_test: Error: %s %s differs (length %lu)\n",
+                 p_impl, p_what, (unsigned long)p_len );
+        failures++;
+    }
+}
+
+static double now( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return( ts.tv_sec + ( ts.tv_nsec / 1e9 ));
+}
+
+static void bench( const str_kernel_impl_t* const p_impl )
+{
+    static char src[ BENCH_LEN + 1 ];
+    static char dest[ BENCH_LEN ];
+    size_t sink = 0;
+    size_t rep;
+    double start;
+    double span_ns;
+    double copy_ns;
+    double find_ns;
+
+    /* A long path with no characters to find - the common case */
+    memset( src, 'a', BENCH_LEN );
+    src[ BENCH_LEN ] = '\0';
+
+    start = now();
+    for( rep = 0; rep < BENCH_REPS; rep++ ) {
+        sink += p_impl->span3( src, BENCH_LEN - ( rep & 1U ), ' ', '\\', '/' );
+    }
+    span_ns = (( now() - start ) * 1e9 ) / ( (double)BENCH_REPS * BENCH_LEN );
+
+    start = now();
+    for( rep = 0; rep < BENCH_REPS; rep++ ) {
+        p_impl->copy_replace( dest, src, BENCH_LEN - ( rep & 1U ), '/', '\\' );
+        sink += (unsigned char)dest[ rep % BENCH_LEN ];
+    }
+    copy_ns = (( now() - start ) * 1e9 ) / ( (double)BENCH_REPS * BENCH_LEN );
+
+    /* A needle which doesn't occur - the common case when searching */
+    start = now();
+    for( rep = 0; rep < BENCH_REPS; rep++ ) {
+        sink += p_impl->find( src, BENCH_LEN - ( rep & 1U ), "proj", 4U );
+    }
+    find_ns = (( now() - start ) * 1e9 ) / ( (double)BENCH_REPS * BENCH_LEN );
+
+    printf( "%-8s span3: %.3f ns/byte  copy_replace: %.3f ns/byte  "
+            "find: %.3f ns/byte  (%lu)\n",
+            p_impl->name, span_ns, copy_ns, find_ns, (unsigned long)( sink & 1U ));
+}
+
+int main( int argc, char* argv[] )
+{
+    const str_kernel_impl_t* impls;
+    size_t count = str_kernel_impls( &impls );
+    /* Extra space so that sources can start at any alignment */
+    static char src[ MAX_LEN + 64U ];
+    static char ref[ MAX_LEN + 64U ];
+    static char out[ MAX_LEN + 64U ];
+    size_t iter;
+    size_t impl;
+
+    srand( 1 );
+
+    for( iter = 0; iter < ITERATIONS; iter++ ) {
+        const size_t len = (size_t)rand() % MAX_LEN;
+        const size_t offset = (size_t)rand() % 32U;
+        /* Mostly-plain strings, so that matches occur at all positions */
+        const int density = 1 + ( rand() % 64 );
+        const char* needle;
+        size_t needle_len;
+        size_t loop;
+
+        for( loop = 0; loop < len; loop++ ) {
+            src[ offset + loop ] = (( rand() % density ) == 0 ) ?
+                alphabet[ (size_t)rand() % ( sizeof( alphabet ) - 1U ) ] : 'x';
+        }
+
+        /* Needles are usually taken from the string, so that they're found,
+           and occasionally run off its end */
+        needle_len = (size_t)rand() % 8U;
+        needle = src + offset + (( len != 0 ) ? ((size_t)rand() % len ) : 0 );
+
+        for( impl = 1; impl < count; impl++ ) {
+            check( impls[ impl ].span3( src + offset, len, ' ', '\\', '/' ) ==
+                   impls[ 0 ].span3( src + offset, len, ' ', '\\', '/' ),
+                   impls[ impl ].name, "span3", len );
+            check( impls[ impl ].span3( src + offset, len, '\x80', '\x80', '\x80' ) ==
+                   impls[ 0 ].span3( src + offset, len, '\x80', '\x80', '\x80' ),
+                   impls[ impl ].name, "span3 (high bytes)", len );
+
+            impls[ 0 ].copy_replace( ref + offset, src + offset, len, '/', '\\' );
+            impls[ impl ].copy_replace( out + offset, src + offset, len, '/', '\\' );
+            check( 0 == memcmp( ref + offset, out + offset, len ),
+                   impls[ impl ].name, "copy_replace", len );
+
+            check( impls[ impl ].find( src + offset, len, needle, needle_len ) ==
+                   impls[ 0 ].find( src + offset, len, needle, needle_len ),
+                   impls[ impl ].name, "find", len );
+        }
+    }
+
+    printf( "str_kernel: %lu implementation(s) checked:", (unsigned long)count );
+    for( impl = 0; impl < count; impl++ ) {
+        printf( " %s", impls[ impl ].name );
+    }
+    printf( "\n" );
+
+    if(( argc > 1 ) && ( 0 == strcmp( argv[1], "-b" ))) {
+        for( impl = 0; impl < count; impl++ ) {
+            bench( &impls[ impl ] );
+        }
+    }
+
+    return(( failures == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE );
+}
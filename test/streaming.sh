@@ -0,0 +1,82 @@
+#!/usr/bin/env bash
+#
+# Check that listings streamed while the list file is being read match those
+# produced from a list held in memory (as with --shm-cache, which isn't
+# streamed), and that running out of memory part way through a streamed
+# listing leaves what was output complete & reports that the rest is missing.
+#
+# Usage: streaming.sh [path/to/src]
+#   The directory should contain the wd executable, and that containing
+#   this script the bench_corpus generator, cpus_shim.so & alloc_shim.so
+
+source "$(dirname "${BASH_SOURCE[0]}")/lib.sh"
+
+TEST_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+LIST="${SCRATCH}/list"
+TREE="${SCRATCH}/tree"
+THREAD_LOG="${SCRATCH}/threads"
+ALLOC_LOG="${SCRATCH}/allocs"
+SHM_DIR=/dev/shm
+ENTRIES=20000
+# Bookmarks passed between the stages of a streamed listing at a time
+BLOCK=256
+
+# Remove the segments created by the test, where they can be seen
+segments()
+{
+    [ -d "${SHM_DIR}" ] && ls "${SHM_DIR}" | grep "^wd-$(id -u)-"
+}
+BEFORE="$(segments)"
+trap 'segments | grep -v -x -F "${BEFORE}" | sed -e "s|^|${SHM_DIR}/|" | \
+          xargs -r rm -f; rm -rf "${SCRATCH}"' EXIT
+
+"${TEST_DIR}/bench_corpus" ${ENTRIES} "${LIST}" "${TREE}" > /dev/null
+
+# Run wd, logging the threads it starts
+logged()
+{
+    rm -f "${THREAD_LOG}"
+    SHIM_THREAD_LOG="${THREAD_LOG}" LD_PRELOAD="${TEST_DIR}/cpus_shim.so" wd "$@"
+}
+
+for opts in "-l p" "-l l" "-l 1b -c" "-l 1l -C" "-l p -e d" "-l b -e f" \
+            "-l p -0"; do
+    logged -f "${LIST}" ${opts} > "${SCRATCH}/streamed" 2>&1
+    check "${opts} streamed" "3" "$(wc -l < "${THREAD_LOG}")"
+    logged --shm-cache -f "${LIST}" ${opts} > "${SCRATCH}/held" 2>&1
+    check "${opts} held" "" "$(cat "${THREAD_LOG}" 2>/dev/null)"
+    check "${opts} matches" "" \
+          "$(cmp "${SCRATCH}/streamed" "${SCRATCH}/held")"
+done
+
+# The allocations made once per block of bookmarks read are those whose
+# count matches the number of blocks - fail the largest of them near the end
+BLOCKS=$(( ( ENTRIES + BLOCK - 1 ) / BLOCK ))
+SHIM_ALLOC_LOG="${ALLOC_LOG}" LD_PRELOAD="${TEST_DIR}/alloc_shim.so" \
+    wd -f "${LIST}" -l p > /dev/null
+FAIL_SIZE="$(sort -n "${ALLOC_LOG}" | uniq -c | \
+             awk -v n=${BLOCKS} '$1 == n { size = $2 } END { print size }')"
+check "allocation per block found" "yes" "$([ -n "${FAIL_SIZE}" ] && echo yes)"
+
+FAIL_AT=$(( BLOCKS - 5 ))
+SHIM_FAIL_SIZE="${FAIL_SIZE}" SHIM_FAIL_AT=${FAIL_AT} \
+    LD_PRELOAD="${TEST_DIR}/alloc_shim.so" \
+    wd -f "${LIST}" -l p > "${SCRATCH}/partial" 2> "${SCRATCH}/err"
+check "partial listing succeeds" "0" "$?"
+check "partial listing reported" "Listing incomplete: not enough memory" \
+      "$(cat "${SCRATCH}/err")"
+check "blocks before failure listed" "$(( ( FAIL_AT - 1 ) * BLOCK ))" \
+      "$(wc -l < "${SCRATCH}/partial")"
+check "partial listing is start of listing" "" \
+      "$(wd --shm-cache -f "${LIST}" -l p | head -n $(( ( FAIL_AT - 1 ) * BLOCK )) | \
+         cmp - "${SCRATCH}/partial")"
+
+# Failing before anything is output leaves the listing to the usual path
+SHIM_FAIL_SIZE="${FAIL_SIZE}" SHIM_FAIL_AT=1 \
+    LD_PRELOAD="${TEST_DIR}/alloc_shim.so" \
+    wd -f "${LIST}" -l p > "${SCRATCH}/fallback" 2> "${SCRATCH}/err"
+check "failure before output not reported" "" "$(cat "${SCRATCH}/err")"
+check "failure before output falls back" "" \
+      "$(wd --shm-cache -f "${LIST}" -l p | cmp - "${SCRATCH}/fallback")"
+
+exit ${FAILED}
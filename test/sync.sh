@@ -0,0 +1,70 @@
+#!/usr/bin/env bash
+#
+# Check that --sync merges two copies of a list such that both end up the
+# same, with additions & removals made to either copy carried over.
+#
+# Usage: sync.sh [path/to/src]
+#   The directory should contain the wd executable
+
+source "$(dirname "${BASH_SOURCE[0]}")/lib.sh"
+
+HERE="${SCRATCH}/here"
+THERE="${SCRATCH}/there"
+NOW=$(date +%s)
+
+mkdir -p "${SCRATCH}/d1" "${SCRATCH}/d2" "${SCRATCH}/d3"
+
+# Times are given explicitly, so that each change is later than the last
+at()
+{
+    local offset="$1"
+    shift
+    wd -z $(( NOW + offset )) "$@"
+}
+
+at 0 -f "${HERE}" -a "${SCRATCH}/d1" alpha 2>/dev/null
+at 0 -f "${THERE}" -a "${SCRATCH}/d2" beta 2>/dev/null
+at 0 -f "${HERE}" -r "${SCRATCH}/d1"
+check "removals not recorded before synchronising" "0" \
+      "$(grep -c '^X:' "${HERE}")"
+at 1 -f "${HERE}" -a "${SCRATCH}/d1" alpha
+
+check "first sync" \
+      "Synchronised with '${THERE}': 1 bookmark(s) added here, 1 added there, 0 removed" \
+      "$(at 10 -f "${HERE}" --sync "${THERE}")"
+check "copies the same" "$(cat "${HERE}")" "$(cat "${THERE}")"
+
+touch -d @$(( NOW - 100 )) "${HERE}" "${THERE}"
+at 20 -f "${HERE}" --sync "${THERE}" > /dev/null
+check "unchanged copies not rewritten" "0" \
+      "$(find "${HERE}" "${THERE}" -newermt @$(( NOW - 50 )) | wc -l)"
+
+at 30 -f "${THERE}" -r "${SCRATCH}/d1"
+at 40 -f "${THERE}" --sync "${HERE}" > /dev/null
+check "removal carried over" "${SCRATCH}/d2" "$(wd -f "${HERE}" -l l | head -1)"
+check "removal recorded" "1" "$(grep -c '^X:' "${HERE}")"
+
+# An older copy of the list still has the bookmark
+at 50 -f "${HERE}.old" -a "${SCRATCH}/d1" alpha 2>/dev/null
+sed -i -e "s|^A:.*|A:$(date -u -d @$(( NOW + 1 )) '+%Y/%m/%d %H:%M:%S')|" "${HERE}.old"
+at 60 -f "${HERE}" --sync "${HERE}.old" > /dev/null
+check "removal beats older bookmark" "" "$(wd -f "${HERE}" -n alpha 2>/dev/null)"
+
+at 70 -f "${THERE}" -a "${SCRATCH}/d1" alpha
+at 80 -f "${HERE}" --sync "${THERE}" > /dev/null
+check "bookmark added after removal" "${SCRATCH}/d1" "$(wd -f "${HERE}" -n alpha)"
+check "removal record dropped" "0" "$(grep -c '^X:' "${HERE}")"
+
+at 90 -f "${THERE}" -a "${SCRATCH}/d3" alpha 2>/dev/null
+at 90 -f "${THERE}" -r "${SCRATCH}/d1"
+at 91 -f "${THERE}" -a "${SCRATCH}/d3" alpha
+at 100 -f "${HERE}" -r "${SCRATCH}/d2" --shm-cache
+at 110 -f "${HERE}" --shm-cache --sync "${THERE}" > /dev/null
+check "merged via shared memory" "${SCRATCH}/d3 alpha" \
+      "$(wd -f "${HERE}" --shm-cache -l l | tr '\n' ' ' | sed -e 's/ $//')"
+check "copies the same again" "$(cat "${HERE}")" "$(cat "${THERE}")"
+
+check "list not synchronised with itself" "1" \
+      "$(wd -f "${HERE}" --sync "${HERE}" 2>&1 | grep -c 'Error')"
+
+exit ${FAILED}
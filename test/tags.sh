@@ -0,0 +1,61 @@
+#!/usr/bin/env bash
+#
+# Check that listings filtered by tag (--tag) include exactly the bookmarks
+# with all of the tags, however the list is read, and that tags survive
+# removals which move the bookmarks following them.
+#
+# Usage: tags.sh [path/to/src]
+#   The directory should contain the wd executable
+
+source "$(dirname "${BASH_SOURCE[0]}")/lib.sh"
+
+LIST="${SCRATCH}/list"
+
+# Enough bookmarks that the tags of each span several words
+for i in $(seq 0 199); do
+    mkdir -p "${SCRATCH}/d${i}"
+    printf 'add %s\tn%d\ntag n%d\tt%d,all\n' "${SCRATCH}/d${i}" ${i} ${i} $(( i % 3 ))
+done | wd -f "${LIST}" --batch 2>/dev/null > /dev/null
+touch "${SCRATCH}/d1/file"
+wd -f "${LIST}" -a "${SCRATCH}/d1/file" file --tag t1,all
+
+printf 'remove n5\nremove n63\nremove n64\nremove n130\ntag n7\n' | \
+    wd -f "${LIST}" --batch > /dev/null
+
+# The tags expected from each bookmark's name
+expected()
+{
+    local tag="$1"
+    shift
+
+    wd -f "${LIST}" -l p "$@" | while read -r dir; do
+        n="${dir##*/d}"
+        if [ "${n}" = "1/file" ]; then
+            [ "${tag}" = "t1" ] && echo "${dir}"
+        elif [ "${n}" != "7" ]; then
+            [ "${tag}" = "t$(( n % 3 ))" ] && echo "${dir}"
+        fi
+    done
+}
+
+check "tags kept through removals" "$(expected t1)" \
+      "$(wd -f "${LIST}" -l p --tag t1)"
+check "all tags needed" "$(expected t2)" \
+      "$(wd -f "${LIST}" -l p --tag all,t2)"
+check "unknown tag matches nothing" "" \
+      "$(wd -f "${LIST}" -l p --tag t1,nonesuch)"
+check "combined with entity type" "$(expected t1 -e d)" \
+      "$(wd -f "${LIST}" -l p --tag t1 -e d)"
+check "untagged bookmark" "0" \
+      "$(wd -f "${LIST}" -l p --tag all | grep -c '/d7$')"
+check "sorted listing" "$(expected t0 -o path)" \
+      "$(wd -f "${LIST}" -l p --tag t0 -o path)"
+check "from WD_OPTS" "$(expected t2)" \
+      "$(WD_OPTS="--tag t2" wd -f "${LIST}" -l p)"
+check "via shared memory" "$(expected t0)" \
+      "$(wd -f "${LIST}" -l p --tag t0 --shm-cache)"
+wd -f "${LIST}" -l p --tag t0 --render-cache > /dev/null
+check "via render cache" "$(expected t1)" \
+      "$(wd -f "${LIST}" -l p --tag t1 --render-cache)"
+
+exit ${FAILED}
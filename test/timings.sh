@@ -0,0 +1,66 @@
+#!/usr/bin/env bash
+#
+# Check that --timings (given on the command line or in WD_OPTS) reports the
+# time taken by each phase & the counters to stderr, leaving stdout as it
+# would otherwise be, and that the counters reflect what was done.
+#
+# Usage: timings.sh [path/to/src]
+#   The directory should contain the wd executable
+
+source "$(dirname "${BASH_SOURCE[0]}")/lib.sh"
+
+LIST="${SCRATCH}/list"
+
+mkdir -p "${SCRATCH}/d1" "${SCRATCH}/d2"
+touch "${SCRATCH}/f3"
+
+wd -f "${LIST}" -a "${SCRATCH}/d1" one 2>/dev/null
+wd -f "${LIST}" -a "${SCRATCH}/d2" two
+wd -f "${LIST}" -a "${SCRATCH}/f3" three
+
+# Value of a line of the report, e.g. "saved"
+counter()
+{
+    sed -n -e "s/^  $1  *\([^ ]*\).*/\1/p" "${SCRATCH}/err"
+}
+
+wd -f "${LIST}" -g two --timings > "${SCRATCH}/out" 2> "${SCRATCH}/err"
+check "stdout unchanged" "$(wd -f "${LIST}" -g two)" "$(cat "${SCRATCH}/out")"
+check "report layout" "wd: Timings (ms):
+  environment
+  command line
+  load
+  operation
+  save
+  total
+wd: Counters:
+  records parsed
+  stats issued
+  bytes read
+  bytes written
+  allocations
+  saved" "$(sed -e 's|^.*/wd:|wd:|' -e 's/  *[0-9][0-9.]*\( (.*)\)*$//' \
+              -e 's/  *\(yes\|no\)$//' "${SCRATCH}/err")"
+check "times given to the microsecond" "" \
+      "$(sed -n -e '2,7p' "${SCRATCH}/err" | grep -v ' [0-9]*\.[0-9][0-9][0-9]$')"
+check "records parsed" "3" "$(counter 'records parsed')"
+check "bytes read" "$(wc -c < "${LIST}")" "$(counter 'bytes read')"
+check "look-up not saved" "no" "$(counter saved)"
+
+check "no report without option" "" \
+      "$(wd -f "${LIST}" -g two 2>&1 >/dev/null)"
+check "report requested via WD_OPTS" "$(cat "${SCRATCH}/err" | wc -l)" \
+      "$(WD_OPTS="--timings" wd -f "${LIST}" -g two 2>&1 >/dev/null | wc -l)"
+
+wd -f "${LIST}" -l p --timings > /dev/null 2> "${SCRATCH}/err"
+check "listing without types doesn't stat" "0" "$(counter 'stats issued')"
+wd -f "${LIST}" -l p -e d --timings > "${SCRATCH}/out" 2> "${SCRATCH}/err"
+check "listing by type stats each bookmark" "3" "$(counter 'stats issued')"
+check "bytes written" "$(wc -c < "${SCRATCH}/out")" "$(counter 'bytes written')"
+
+mkdir -p "${SCRATCH}/d4"
+wd -f "${LIST}" -a "${SCRATCH}/d4" four --timings 2> "${SCRATCH}/err"
+check "addition saved" "yes" "$(counter saved)"
+check "save written" "$(wc -c < "${LIST}")" "$(counter 'bytes written')"
+
+exit ${FAILED}